@@ -0,0 +1,160 @@
+#pragma once
+#include <coroutine>
+#include <exception>
+#include <memory>
+#include <utility>
+
+#include "FramePool.h"
+
+//异步生成器：生成器协程通过co_yield逐个产生数据，消费者每次co_await next()拉取下一个
+//生成器只有在被拉取时才继续执行，拉取之间一直挂起在co_yield处，所以数据是按需产生的
+//生成器和消费者之间通过对称转移切换，不经过loop；生成器挂起在连接的awaiter上时，消费者也一起挂起，由loop恢复生成器之后再转移回消费者
+//next()的结果是指向当前数据的指针，在下一次next()之前有效，生成器结束时为nullptr；生成器中的异常在next()处重新抛出
+//C++20没有for co_await，使用方式：
+//  auto frames = conn->frames();
+//  while(true)
+//  {
+//      Frame* frame = co_await frames.next();
+//      if(!frame) break;
+//      ...
+//  }
+//销毁生成器时挂起的生成器协程一起销毁，由它挂起的awaiter撤销等待
+template <typename T>
+class AsyncGenerator
+{
+public:
+    struct promise_type
+    {
+        T* current_ = nullptr;                  //当前数据的地址，数据保存在生成器的帧中
+        std::coroutine_handle<>consumer_;       //正在拉取数据的协程
+        std::exception_ptr exception_;
+
+        static void* operator new(size_t size)
+        {
+            return FramePool::allocateFrame(size);
+        }
+
+        static void operator delete(void* ptr,size_t size)
+        {
+            FramePool::releaseFrame(ptr,size);
+        }
+
+        //产生数据或者执行完毕之后转移回消费者
+        struct YieldAwaiter
+        {
+            bool await_ready()noexcept {return false;}
+
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type>h)noexcept
+            {
+                return h.promise().consumer_;
+            }
+
+            void await_resume()noexcept {}
+        };
+
+        AsyncGenerator get_return_object()
+        {
+            return AsyncGenerator{std::coroutine_handle<promise_type>::from_promise(*this)};
+        }
+
+        std::suspend_always initial_suspend()
+        {
+            return {};
+        }
+
+        //co_yield的临时对象一直存活到生成器恢复，可以直接记录地址
+        YieldAwaiter yield_value(T& value)
+        {
+            current_ = std::addressof(value);
+            return {};
+        }
+
+        YieldAwaiter yield_value(T&& value)
+        {
+            current_ = std::addressof(value);
+            return {};
+        }
+
+        YieldAwaiter final_suspend()noexcept
+        {
+            current_ = nullptr;
+            return {};
+        }
+
+        void return_void(){}
+
+        void unhandled_exception()
+        {
+            exception_ = std::current_exception();
+        }
+    };
+
+    //拉取下一个数据：记录消费者，然后直接转移到生成器继续执行
+    struct NextAwaiter
+    {
+        std::coroutine_handle<promise_type>handle_;
+
+        bool await_ready()
+        {
+            return !handle_||handle_.done();
+        }
+
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<>consumer)
+        {
+            handle_.promise().consumer_ = consumer;
+            return handle_;
+        }
+
+        T* await_resume()
+        {
+            if(!handle_) return nullptr;
+            auto& promise = handle_.promise();
+            if(promise.exception_) std::rethrow_exception(std::exchange(promise.exception_,nullptr));
+            return handle_.done()?nullptr:promise.current_;
+        }
+    };
+
+    explicit AsyncGenerator(std::coroutine_handle<promise_type>handle)
+        :handle_(handle)
+    {}
+    ~AsyncGenerator()
+    {
+        destroy();
+    }
+
+    AsyncGenerator(const AsyncGenerator&) = delete;
+    AsyncGenerator& operator=(const AsyncGenerator&) = delete;
+
+    AsyncGenerator(AsyncGenerator&&other)
+        :handle_(std::exchange(other.handle_,nullptr))
+    {}
+    AsyncGenerator& operator=(AsyncGenerator&&other)
+    {
+        if(this!=&other)
+        {
+            destroy();
+            handle_ = std::exchange(other.handle_,nullptr);
+        }
+        return *this;
+    }
+
+    void destroy()
+    {
+        if(handle_)
+        {
+            handle_.destroy();
+            handle_ = nullptr;
+        }
+    }
+
+    //消费者被恢复之前不能再次调用
+    NextAwaiter next()
+    {
+        return NextAwaiter{handle_};
+    }
+
+    bool done()const {return !handle_||handle_.done();}
+
+private:
+    std::coroutine_handle<promise_type>handle_;
+};
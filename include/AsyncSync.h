@@ -0,0 +1,177 @@
+#pragma once
+
+#include <atomic>
+#include <coroutine>
+#include <cstdint>
+#include <mutex>
+#include <utility>
+
+#include "noncopyable.h"
+#include "IoUringLoop.h"
+#include "ThreadPool.h"
+
+//协程使用的同步原语：AsyncSemaphore、AsyncMutex、AsyncEvent
+//等待时挂起协程而不是阻塞线程，等待节点保存在awaiter(也就是协程帧)中，不需要分配内存
+//被唤醒的协程在它挂起时所在的loop中恢复：唤醒者在同一个loop中时放入就绪队列，不需要加锁和唤醒；
+//唤醒者在其它线程中时通过目标loop的切换链表恢复(见LoopHop)；在线程池中挂起的协程重新放入线程池的任务队列；
+//在其它线程中挂起的协程由唤醒者直接恢复
+//等待中的awaiter不能销毁，不能在whenAny中取消
+
+//等待节点
+struct AsyncWaiter
+{
+    std::coroutine_handle<>handle_;
+    IoUringLoop* loop_;     //挂起时所在的loop
+    ThreadPool* pool_;      //挂起时所在的线程池
+    AsyncWaiter* next_;
+    LoopHop hop_;           //跨线程唤醒时加入目标loop的切换链表
+
+    AsyncWaiter()
+        :handle_(nullptr)
+        ,loop_(nullptr)
+        ,pool_(nullptr)
+        ,next_(nullptr)
+        ,hop_{nullptr,nullptr}
+    {}
+
+    //挂起之前记录协程和所在的loop或者线程池
+    void park(std::coroutine_handle<>h);
+    //在挂起时所在的loop或者线程池中恢复协程，调用之后不能再访问这个节点
+    void wake();
+};
+
+//计数信号量，许可按照等待的先后顺序分配
+//有许可时获取和没有等待者时释放都只需要一次原子操作，只有需要等待时才加锁
+class AsyncSemaphore: noncopyable
+{
+public:
+    class AcquireAwaiter
+    {
+    private:
+        AsyncSemaphore* sem_;
+        AsyncWaiter waiter_;
+    public:
+        explicit AcquireAwaiter(AsyncSemaphore* sem)
+            :sem_(sem)
+        {}
+
+        bool await_ready(){return sem_->tryAcquire();}
+        bool await_suspend(std::coroutine_handle<>h);
+        void await_resume(){}
+    };
+
+    explicit AsyncSemaphore(int64_t permits);
+
+    //有许可时获取并返回true，不会等待
+    bool tryAcquire();
+    //co_await acquire()获取一个许可，没有许可时等待
+    AcquireAwaiter acquire(){return AcquireAwaiter(this);}
+    //释放一个许可，有等待者时直接交给最早的等待者，可以在任意线程中调用
+    void release();
+    //当前可以直接获取的许可数量
+    int64_t available()const;
+
+private:
+    //许可数量减去等待(包括正在进入等待)的协程数量，小于0表示有等待者
+    std::atomic<int64_t>count_;
+    //保护等待链表，只在需要等待或者有等待者时使用
+    std::mutex mtx_;
+    AsyncWaiter* head_;
+    AsyncWaiter* tail_;
+    //释放时等待者还没有进入链表，留给它直接获取的许可数量
+    size_t pending_;
+
+    //在count_中登记之后获取许可或者进入等待，返回是否需要挂起
+    bool acquireOrWait(AsyncWaiter* waiter);
+};
+
+class AsyncMutex;
+
+//离开作用域时释放锁
+class AsyncLockGuard
+{
+private:
+    AsyncMutex* mutex_;
+public:
+    explicit AsyncLockGuard(AsyncMutex* mutex)
+        :mutex_(mutex)
+    {}
+    AsyncLockGuard(AsyncLockGuard&& other)
+        :mutex_(std::exchange(other.mutex_,nullptr))
+    {}
+    AsyncLockGuard(const AsyncLockGuard&) = delete;
+    AsyncLockGuard& operator=(const AsyncLockGuard&) = delete;
+    AsyncLockGuard& operator=(AsyncLockGuard&&) = delete;
+    ~AsyncLockGuard();
+};
+
+//互斥锁，相当于只有一个许可的信号量，解锁时锁直接交给最早的等待者
+//持有锁时可以挂起(比如在临界区中等待io)，同一个loop中的其它协程仍然可以运行
+class AsyncMutex: noncopyable
+{
+public:
+    class ScopedLockAwaiter
+    {
+    private:
+        AsyncMutex* mutex_;
+        AsyncSemaphore::AcquireAwaiter acquire_;
+    public:
+        explicit ScopedLockAwaiter(AsyncMutex* mutex)
+            :mutex_(mutex)
+            ,acquire_(&mutex->sem_)
+        {}
+
+        bool await_ready(){return acquire_.await_ready();}
+        bool await_suspend(std::coroutine_handle<>h){return acquire_.await_suspend(h);}
+        AsyncLockGuard await_resume(){return AsyncLockGuard(mutex_);}
+    };
+
+    AsyncMutex()
+        :sem_(1)
+    {}
+
+    bool tryLock(){return sem_.tryAcquire();}
+    //co_await lock()获取锁，之后需要调用unlock
+    AsyncSemaphore::AcquireAwaiter lock(){return sem_.acquire();}
+    //auto guard = co_await scopedLock()，guard析构时解锁
+    ScopedLockAwaiter scopedLock(){return ScopedLockAwaiter(this);}
+    void unlock(){sem_.release();}
+    bool isLocked()const {return sem_.available()==0;}
+
+private:
+    AsyncSemaphore sem_;
+};
+
+//手动复位的事件，设置之后所有等待者都被唤醒，之后的等待直接返回，直到reset
+//等待、设置和复位都只需要原子操作，不需要加锁
+class AsyncEvent: noncopyable
+{
+public:
+    class WaitAwaiter
+    {
+    private:
+        AsyncEvent* event_;
+        AsyncWaiter waiter_;
+    public:
+        explicit WaitAwaiter(AsyncEvent* event)
+            :event_(event)
+        {}
+
+        bool await_ready(){return event_->isSet();}
+        bool await_suspend(std::coroutine_handle<>h);
+        void await_resume(){}
+    };
+
+    explicit AsyncEvent(bool set = false);
+
+    bool isSet()const;
+    //设置事件并唤醒所有等待者，可以在任意线程中调用
+    void set();
+    //复位事件，已经被唤醒的等待者不受影响
+    void reset();
+    WaitAwaiter wait(){return WaitAwaiter(this);}
+
+private:
+    //等于this表示已经设置，否则是等待者组成的栈的栈顶，nullptr表示没有等待者
+    std::atomic<void*>state_;
+};
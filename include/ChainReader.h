@@ -0,0 +1,116 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <endian.h>
+
+#include "ChunkPool.h"
+#include "InputChainBuffer.h"
+
+//输入缓冲区上的只读游标，用于直接在chunk链表上解析整数、varint和定长结构体，不需要先拷贝到std::string
+//值落在一个chunk中时直接读取，跨越chunk边界时才逐段拷贝
+//读取只移动游标，调用commit()之后才会把读过的数据从缓冲区中一次性移除
+//注意：在commit()之前不要通过其它方式消费同一个缓冲区，否则游标会失效
+class ChainReader
+{
+private:
+    InputChainBuffer& buffer_;
+    const Chunk* chunk_;    //游标所在的chunk，为空表示还没有定位
+    size_t offset_;         //游标在chunk中相对于beginRead()的偏移量
+    size_t consumed_;       //从上一次commit开始读过的字节数
+    bool is_error_;         //是否读到了格式错误的数据，出错之后数据无法再继续解析
+
+    //让游标指向下一个可读的字节，游标在最后一个chunk的末尾时保持不动
+    void normalize();
+
+    //跨越chunk边界的读取
+    void readSlow(void* target,size_t len);
+
+    //标记varint格式错误，返回false
+    bool malformedVarint();
+
+    //读取len个字节到target中，数据不足时返回false并且不移动游标
+    inline bool readRaw(void* target,size_t len)
+    {
+        if(readable()<len) return false;
+        //长度为0时不需要定位游标，缓冲区可能为空
+        if(len==0) return true;
+        normalize();
+        //快速路径，数据在一个chunk中
+        if(offset_+len<=chunk_->readableBytes())
+        {
+            std::memcpy(target,chunk_->beginRead()+offset_,len);
+            offset_ += len;
+            consumed_ += len;
+            return true;
+        }
+        readSlow(target,len);
+        return true;
+    }
+
+    template <typename T>
+    static T byteSwapToHost(T value,bool big_endian)
+    {
+        if constexpr (sizeof(T)==1) return value;
+        else if constexpr (sizeof(T)==2) return big_endian?be16toh(value):le16toh(value);
+        else if constexpr (sizeof(T)==4) return big_endian?be32toh(value):le32toh(value);
+        else return big_endian?be64toh(value):le64toh(value);
+    }
+
+    template <typename T>
+    bool readInt(T& value,bool big_endian)
+    {
+        static_assert(std::is_integral_v<T>&&(sizeof(T)==1||sizeof(T)==2||sizeof(T)==4||sizeof(T)==8),"only support 8/16/32/64 bits integer");
+        using U = std::make_unsigned_t<T>;
+        U raw;
+        if(!readRaw(&raw,sizeof(raw))) return false;
+        value = static_cast<T>(byteSwapToHost(raw,big_endian));
+        return true;
+    }
+
+public:
+    explicit ChainReader(InputChainBuffer& buffer);
+
+    //游标之后还可以读取的字节数
+    size_t readable()const {return buffer_.getTotalLen()-consumed_;}
+    //从上一次commit开始读过的字节数
+    size_t consumed()const {return consumed_;}
+    //是否出现了格式错误，为true时应该关闭连接而不是继续等待数据
+    bool isError()const {return is_error_;}
+
+    //读取大端(网络字节序)整数
+    template <typename T>
+    bool readBE(T& value){return readInt(value,true);}
+
+    //读取小端整数
+    template <typename T>
+    bool readLE(T& value){return readInt(value,false);}
+
+    //读取定长的结构体，结构体按照内存布局直接拷贝，不做字节序转换
+    template <typename T>
+    bool readStruct(T& value)
+    {
+        static_assert(std::is_trivially_copyable_v<T>,"struct must be trivially copyable");
+        return readRaw(&value,sizeof(T));
+    }
+
+    //读取LEB128编码的无符号varint，数据不完整或者格式错误时返回false并且不移动游标，两者通过isError()区分
+    //超过10个字节或者第10个字节大于1(超出64位)视为格式错误，之后的readVarint都返回false
+    bool readVarint(uint64_t& value);
+    //读取zigzag编码的有符号varint
+    bool readVarintSigned(int64_t& value);
+
+    //读取len个字节
+    bool readBytes(char* target,size_t len){return readRaw(target,len);}
+    bool readString(std::string& target,size_t len);
+
+    //跳过len个字节
+    bool skip(size_t len);
+
+    //放弃从上一次commit开始的读取，游标回到缓冲区的开头
+    void rewind();
+
+    //把从上一次commit开始读过的数据从缓冲区中一次性移除
+    void commit();
+};
@@ -0,0 +1,414 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <coroutine>
+#include <cstddef>
+#include <mutex>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "noncopyable.h"
+#include "AsyncSync.h"
+
+//有界通道，在loop和线程池之间传递数据，可以把解码、处理、编码分成多个阶段放在不同的线程中流水执行
+//co_await send(value)在通道满时挂起，返回false表示通道已经关闭，数据被丢弃
+//co_await receive()在通道空时挂起，返回std::nullopt表示通道已经关闭并且没有剩余的数据
+//被唤醒的一方在它挂起时所在的loop或者线程池中恢复(见AsyncWaiter)，等待节点保存在awaiter中，不需要分配内存
+//等待中的awaiter不能销毁，不能在whenAny中取消
+//容量至少为1
+
+//单生产者单消费者通道，环形缓冲区的读写位置都是原子变量，收发都不需要加锁
+//同一时刻最多只能有一个协程(或者线程)发送、一个协程接收
+template<typename T>
+class SpscChannel: noncopyable
+{
+public:
+    class SendAwaiter
+    {
+    private:
+        SpscChannel* channel_;
+        T value_;
+        bool ok_;
+        AsyncWaiter waiter_;
+    public:
+        SendAwaiter(SpscChannel* channel,T value)
+            :channel_(channel)
+            ,value_(std::move(value))
+            ,ok_(false)
+        {}
+
+        bool await_ready()
+        {
+            ok_ = channel_->trySend(std::move(value_));
+            return ok_||channel_->isClosed();
+        }
+        bool await_suspend(std::coroutine_handle<>h)
+        {
+            waiter_.park(h);
+            return channel_->park(channel_->send_waiter_,&waiter_,[this](){return channel_->isClosed()||channel_->size()<channel_->capacity_;});
+        }
+        //被唤醒时一定有空位，除非通道已经关闭
+        bool await_resume(){return ok_||channel_->trySend(std::move(value_));}
+    };
+
+    class ReceiveAwaiter
+    {
+    private:
+        SpscChannel* channel_;
+        std::optional<T> value_;
+        AsyncWaiter waiter_;
+    public:
+        explicit ReceiveAwaiter(SpscChannel* channel)
+            :channel_(channel)
+        {}
+
+        bool await_ready()
+        {
+            value_ = channel_->tryReceive();
+            return value_.has_value()||channel_->isClosed();
+        }
+        bool await_suspend(std::coroutine_handle<>h)
+        {
+            waiter_.park(h);
+            return channel_->park(channel_->receive_waiter_,&waiter_,[this](){return channel_->isClosed()||channel_->size()>0;});
+        }
+        //被唤醒时一定有数据，除非通道已经关闭
+        std::optional<T> await_resume()
+        {
+            if(!value_) value_ = channel_->tryReceive();
+            return std::move(value_);
+        }
+    };
+
+    explicit SpscChannel(size_t capacity)
+        :capacity_(std::max<size_t>(capacity,1))
+        ,slots_(capacity_)
+        ,head_(0)
+        ,tail_(0)
+        ,closed_(false)
+        ,send_waiter_(nullptr)
+        ,receive_waiter_(nullptr)
+    {}
+
+    SendAwaiter send(T value){return SendAwaiter(this,std::move(value));}
+    ReceiveAwaiter receive(){return ReceiveAwaiter(this);}
+
+    //有空位并且没有关闭时放入数据并返回true，失败时value不会被移动
+    template<typename U>
+    bool trySend(U&& value)
+    {
+        if(closed_.load(std::memory_order_acquire)) return false;
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        if(tail-head_.load(std::memory_order_acquire)>=capacity_) return false;
+        slots_[tail%capacity_].emplace(std::forward<U>(value));
+        tail_.store(tail+1,std::memory_order_seq_cst);
+        notify(receive_waiter_);
+        return true;
+    }
+
+    //有数据时取出，没有时返回std::nullopt，关闭之后仍然可以取出剩余的数据
+    std::optional<T> tryReceive()
+    {
+        size_t head = head_.load(std::memory_order_relaxed);
+        if(head==tail_.load(std::memory_order_acquire)) return std::nullopt;
+        auto& slot = slots_[head%capacity_];
+        std::optional<T> value(std::move(*slot));
+        slot.reset();
+        head_.store(head+1,std::memory_order_seq_cst);
+        notify(send_waiter_);
+        return value;
+    }
+
+    //关闭通道并唤醒等待的双方，可以在任意线程中调用
+    void close()
+    {
+        closed_.store(true,std::memory_order_seq_cst);
+        notify(send_waiter_);
+        notify(receive_waiter_);
+    }
+
+    bool isClosed()const {return closed_.load(std::memory_order_seq_cst);}
+    size_t size()const {return tail_.load(std::memory_order_seq_cst)-head_.load(std::memory_order_seq_cst);}
+    size_t capacity()const {return capacity_;}
+
+private:
+    const size_t capacity_;
+    std::vector<std::optional<T>>slots_;
+    //读写位置只增加，取余之后是在缓冲区中的下标，分别放在不同的缓存行中
+    alignas(64) std::atomic<size_t>head_;
+    alignas(64) std::atomic<size_t>tail_;
+    std::atomic_bool closed_;
+    //挂起的发送者和接收者，唤醒者通过exchange取得之后唤醒，保证只唤醒一次
+    alignas(64) std::atomic<AsyncWaiter*>send_waiter_;
+    alignas(64) std::atomic<AsyncWaiter*>receive_waiter_;
+
+    //先登记等待者再检查条件，和对方先修改位置再检查等待者对应，两边至少有一方能看到另一方的修改
+    //条件已经满足时撤销登记，撤销失败说明对方已经取得等待者，会唤醒它
+    template<typename Ready>
+    bool park(std::atomic<AsyncWaiter*>& slot,AsyncWaiter* waiter,Ready ready)
+    {
+        slot.store(waiter,std::memory_order_seq_cst);
+        if(ready())
+        {
+            AsyncWaiter* expected = waiter;
+            if(slot.compare_exchange_strong(expected,nullptr,std::memory_order_seq_cst)) return false;
+        }
+        return true;
+    }
+
+    void notify(std::atomic<AsyncWaiter*>& slot)
+    {
+        if(!slot.load(std::memory_order_seq_cst)) return;
+        AsyncWaiter* waiter = slot.exchange(nullptr,std::memory_order_acq_rel);
+        if(waiter) waiter->wake();
+    }
+};
+
+//多生产者通道，也允许多个消费者，环形缓冲区和等待链表由互斥锁保护，唤醒在锁外进行
+//满的时候发送者按照先后顺序排队，接收时把最早的发送者的数据移入缓冲区；空的时候发送者把数据直接交给最早的接收者
+template<typename T>
+class Channel: noncopyable
+{
+public:
+    class SendAwaiter
+    {
+        friend Channel;
+    private:
+        Channel* channel_;
+        T value_;
+        bool ok_;
+        SendAwaiter* next_;
+        AsyncWaiter waiter_;
+    public:
+        SendAwaiter(Channel* channel,T value)
+            :channel_(channel)
+            ,value_(std::move(value))
+            ,ok_(false)
+            ,next_(nullptr)
+        {}
+
+        bool await_ready(){return false;}
+        bool await_suspend(std::coroutine_handle<>h)
+        {
+            waiter_.park(h);
+            return channel_->sendOrWait(this);
+        }
+        bool await_resume(){return ok_;}
+    };
+
+    class ReceiveAwaiter
+    {
+        friend Channel;
+    private:
+        Channel* channel_;
+        std::optional<T> value_;
+        ReceiveAwaiter* next_;
+        AsyncWaiter waiter_;
+    public:
+        explicit ReceiveAwaiter(Channel* channel)
+            :channel_(channel)
+            ,next_(nullptr)
+        {}
+
+        bool await_ready(){return false;}
+        bool await_suspend(std::coroutine_handle<>h)
+        {
+            waiter_.park(h);
+            return channel_->receiveOrWait(this);
+        }
+        std::optional<T> await_resume(){return std::move(value_);}
+    };
+
+    explicit Channel(size_t capacity)
+        :capacity_(std::max<size_t>(capacity,1))
+        ,slots_(capacity_)
+        ,head_(0)
+        ,size_(0)
+        ,closed_(false)
+        ,senders_head_(nullptr)
+        ,senders_tail_(nullptr)
+        ,receivers_head_(nullptr)
+        ,receivers_tail_(nullptr)
+    {}
+
+    SendAwaiter send(T value){return SendAwaiter(this,std::move(value));}
+    ReceiveAwaiter receive(){return ReceiveAwaiter(this);}
+
+    //有空位或者有等待的接收者并且没有关闭时放入数据并返回true，失败时value不会被移动
+    template<typename U>
+    bool trySend(U&& value)
+    {
+        ReceiveAwaiter* receiver = nullptr;
+        {
+            std::lock_guard<std::mutex>lock(mtx_);
+            if(closed_) return false;
+            if(receivers_head_)
+            {
+                receiver = popReceiver();
+                receiver->value_.emplace(std::forward<U>(value));
+            }
+            else if(size_<capacity_) push(std::forward<U>(value));
+            else return false;
+        }
+        if(receiver) receiver->waiter_.wake();
+        return true;
+    }
+
+    //有数据时取出，没有时返回std::nullopt，关闭之后仍然可以取出剩余的数据
+    std::optional<T> tryReceive()
+    {
+        std::optional<T> value;
+        SendAwaiter* sender = nullptr;
+        {
+            std::lock_guard<std::mutex>lock(mtx_);
+            if(size_==0) return std::nullopt;
+            value.emplace(pop());
+            sender = refill();
+        }
+        if(sender) sender->waiter_.wake();
+        return value;
+    }
+
+    //关闭通道，等待的发送者返回false，等待的接收者返回std::nullopt，可以在任意线程中调用
+    void close()
+    {
+        SendAwaiter* senders = nullptr;
+        ReceiveAwaiter* receivers = nullptr;
+        {
+            std::lock_guard<std::mutex>lock(mtx_);
+            if(closed_) return;
+            closed_ = true;
+            senders = std::exchange(senders_head_,nullptr);
+            receivers = std::exchange(receivers_head_,nullptr);
+            senders_tail_ = nullptr;
+            receivers_tail_ = nullptr;
+        }
+        //唤醒之后awaiter可能已经销毁，先取出下一个
+        while(senders)
+        {
+            auto next = senders->next_;
+            senders->ok_ = false;
+            senders->waiter_.wake();
+            senders = next;
+        }
+        while(receivers)
+        {
+            auto next = receivers->next_;
+            receivers->waiter_.wake();
+            receivers = next;
+        }
+    }
+
+    bool isClosed()
+    {
+        std::lock_guard<std::mutex>lock(mtx_);
+        return closed_;
+    }
+    size_t size()
+    {
+        std::lock_guard<std::mutex>lock(mtx_);
+        return size_;
+    }
+    size_t capacity()const {return capacity_;}
+
+private:
+    const size_t capacity_;
+    std::mutex mtx_;
+    std::vector<std::optional<T>>slots_;
+    size_t head_;
+    size_t size_;
+    bool closed_;
+    //等待的发送者只在缓冲区满时存在，等待的接收者只在缓冲区空时存在
+    SendAwaiter* senders_head_;
+    SendAwaiter* senders_tail_;
+    ReceiveAwaiter* receivers_head_;
+    ReceiveAwaiter* receivers_tail_;
+
+    bool sendOrWait(SendAwaiter* sender)
+    {
+        ReceiveAwaiter* receiver = nullptr;
+        {
+            std::lock_guard<std::mutex>lock(mtx_);
+            if(closed_) return false;
+            sender->ok_ = true;
+            if(receivers_head_)
+            {
+                receiver = popReceiver();
+                receiver->value_.emplace(std::move(sender->value_));
+            }
+            else if(size_<capacity_) push(std::move(sender->value_));
+            else
+            {
+                sender->ok_ = false;
+                if(senders_tail_) senders_tail_->next_ = sender;
+                else senders_head_ = sender;
+                senders_tail_ = sender;
+                return true;
+            }
+        }
+        if(receiver) receiver->waiter_.wake();
+        return false;
+    }
+
+    bool receiveOrWait(ReceiveAwaiter* receiver)
+    {
+        SendAwaiter* sender = nullptr;
+        {
+            std::lock_guard<std::mutex>lock(mtx_);
+            if(size_>0)
+            {
+                receiver->value_.emplace(pop());
+                sender = refill();
+            }
+            else if(closed_) return false;
+            else
+            {
+                if(receivers_tail_) receivers_tail_->next_ = receiver;
+                else receivers_head_ = receiver;
+                receivers_tail_ = receiver;
+                return true;
+            }
+        }
+        if(sender) sender->waiter_.wake();
+        return false;
+    }
+
+    template<typename U>
+    void push(U&& value)
+    {
+        slots_[(head_+size_)%capacity_].emplace(std::forward<U>(value));
+        size_++;
+    }
+
+    T pop()
+    {
+        auto& slot = slots_[head_];
+        T value(std::move(*slot));
+        slot.reset();
+        head_ = (head_+1)%capacity_;
+        size_--;
+        return value;
+    }
+
+    //取出数据之后把最早的等待发送者的数据移入缓冲区，返回需要唤醒的发送者
+    SendAwaiter* refill()
+    {
+        if(!senders_head_) return nullptr;
+        SendAwaiter* sender = senders_head_;
+        senders_head_ = sender->next_;
+        if(!senders_head_) senders_tail_ = nullptr;
+        push(std::move(sender->value_));
+        sender->ok_ = true;
+        return sender;
+    }
+
+    ReceiveAwaiter* popReceiver()
+    {
+        ReceiveAwaiter* receiver = receivers_head_;
+        receivers_head_ = receiver->next_;
+        if(!receivers_head_) receivers_tail_ = nullptr;
+        return receiver;
+    }
+};
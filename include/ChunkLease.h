@@ -0,0 +1,61 @@
+#pragma once
+#include <vector>
+#include <string>
+
+#include "noncopyable.h"
+
+struct Chunk;
+struct ChunkPoolManagerInput;
+
+//从输入缓冲区中取出的一段chunk链表的租约，可以转移到线程池的工作线程中零拷贝地处理数据
+//chunk属于loop的buffer ring，只能在loop线程中归还，在其它线程中释放时会放入归还队列，由loop的任务队列批量归还
+//注意：租约必须在所属的loop析构之前释放
+class ChunkLease:noncopyable
+{
+public:
+    struct Segment
+    {
+        Chunk* chunk_;      //数据所在的chunk
+        const char* data_;  //数据的起始地址
+        size_t len_;        //数据的长度
+    };
+
+private:
+    ChunkPoolManagerInput* owner_;  //chunk所属的内存池
+    std::vector<Segment>segments_;
+    size_t total_len_;
+
+public:
+    ChunkLease();
+    explicit ChunkLease(ChunkPoolManagerInput* owner);
+    ~ChunkLease();
+
+    ChunkLease(ChunkLease&& other);
+    ChunkLease& operator=(ChunkLease&& other);
+
+    //追加一段数据，由InputChainBuffer调用
+    void append(Chunk* chunk,const char* data,size_t len);
+
+    size_t size()const {return total_len_;}
+    bool empty()const {return total_len_==0;}
+
+    const std::vector<Segment>& segments()const {return segments_;}
+
+    //按顺序遍历每一段内存，f的签名为 void(const char* data,size_t len)
+    template <typename F>
+    void forEachSegment(F&& f)const
+    {
+        for(auto& seg:segments_)
+        {
+            f(seg.data_,seg.len_);
+        }
+    }
+
+    //将数据拷贝到target中，target至少要有size()的大小
+    size_t copyTo(char* target)const;
+
+    std::string toString()const;
+
+    //归还所有的chunk，可以在任意线程中调用
+    void release();
+};
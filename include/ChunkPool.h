@@ -10,6 +10,7 @@ struct Chunk
     Chunk* next_=nullptr; //链表指针，指向下一个chunk的地址
     size_t head_=0;       //数据起始的偏移量
     size_t tail_=0;       //数据结束时的偏移量
+    uint16_t shares_=0;   //除了当前持有者之外，还有多少个租约(ChunkLease)共享这个chunk，只在loop线程中修改
 
     Chunk(char* data_ptr,uint16_t idx)
         :data_ptr_(data_ptr)
@@ -32,13 +33,15 @@ struct ChunkPool
     const size_t bytes_;    //内存池的总内存大小
     const size_t chunks_;   //内存的块数
 
-    ChunkPool(size_t chunk_size,size_t chunk_num)
+    //locked为false时不使用MAP_LOCKED，比如注册为固定缓冲区的内存会被内核固定，不需要再锁定
+    ChunkPool(size_t chunk_size,size_t chunk_num,bool locked = true)
         :bytes_(chunk_size*chunk_num)
         ,chunks_(chunk_num)
         ,data_ptr_(nullptr)
     {
         //TODO 使用mmap分配地址，MAP_LOCKED为锁定内存，防止swap
-        int flags = MAP_ANONYMOUS|MAP_PRIVATE|MAP_HUGETLB|MAP_LOCKED;
+        int flags = MAP_ANONYMOUS|MAP_PRIVATE|MAP_HUGETLB;
+        if(locked) flags |= MAP_LOCKED;
         data_ptr_ = (char*)mmap(nullptr,bytes_,PROT_READ|PROT_WRITE,flags,-1,0);
         //如果MAP_HUGETLB失败，则不开启大页优化
         if(data_ptr_ ==MAP_FAILED)
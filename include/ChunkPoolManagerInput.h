@@ -2,18 +2,38 @@
 
 
 #include <vector>
+#include <mutex>
 #include <liburing.h>
 
 
 #include "ChunkPool.h"
+#include "ChunkLease.h"
 
 class IoUringLoop;
 
 
+//输入内存池的统计信息，只在loop线程中修改
+struct InputPoolStats
+{
+    uint64_t appended_chunks_=0;    //内核填充并追加到缓冲区的chunk数量
+    uint64_t compacted_chunks_=0;   //因为合并到前一个chunk而提前归还的chunk数量
+    uint64_t compacted_bytes_=0;    //合并时拷贝的字节数
+    int64_t in_use_chunks_=0;       //当前被缓冲区或者租约持有的chunk数量
+    int64_t peak_in_use_chunks_=0;  //持有chunk数量的峰值
+
+    //合并率，越高说明小数据越多，合并节省的chunk越多
+    double compactionRate()const {return appended_chunks_?double(compacted_chunks_)/appended_chunks_:0;}
+};
+
 struct ChunkPoolManagerInput
 {
     ChunkPool pool_;    //具体的内存池
     IoUringLoop& loop_;
+    const size_t chunk_size_;   //每一个chunk的大小
+
+    //新数据小于等于这个值并且前一个chunk剩余空间足够时，把数据拷贝到前一个chunk中并立即归还，为0时不合并
+    size_t compact_threshold_;
+    InputPoolStats stats_;
 
     std::vector<Chunk>chunks_data_;      //所有chunk对象，chunk元数据,按序号排序
 
@@ -33,5 +53,36 @@ struct ChunkPoolManagerInput
 
     void returnOneChunk(Chunk* chunk);
 
+    //将chunk放回buffer ring但是不提交，批量归还时使用，最后需要调用commitChunks
+    void recycleChunk(Chunk* chunk);
+    //提交之前放回的所有chunk，对内核可见
+    void commitChunks();
+
+    //租约归还的chunk，其它线程归还时先放入这里，由loop的任务队列批量归还，访问时需要加锁
+    std::mutex remote_mtx_;
+    std::vector<Chunk*>remote_returns_;
+
+    //chunk的一个持有者放弃了这个chunk，如果没有其它持有者就放回buffer ring，只能在loop线程中调用
+    void releaseShared(Chunk* chunk);
+
+    //归还租约中的chunk，可以在任意线程中调用
+    void returnLeased(const std::vector<ChunkLease::Segment>& segments);
+
+    //在loop线程中批量归还其它线程放回的chunk
+    void drainRemoteReturns();
+
     inline uint16_t get_buf_group_id()const {return reg_.bgid;}
+
+    void setCompactThreshold(size_t threshold){compact_threshold_ = threshold;}
+    const InputPoolStats& stats()const {return stats_;}
+
+    //内核填充了一个chunk，更新统计信息
+    inline void onChunkFilled(){stats_.appended_chunks_++;}
+
+    //chunk被缓冲区持有，和recycleChunk中的减少对应
+    inline void onChunkHeld()
+    {
+        stats_.in_use_chunks_++;
+        if(stats_.in_use_chunks_>stats_.peak_in_use_chunks_) stats_.peak_in_use_chunks_ = stats_.in_use_chunks_;
+    }
 };
\ No newline at end of file
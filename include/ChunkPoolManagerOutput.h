@@ -0,0 +1,51 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <liburing.h>
+
+#include "ChunkPool.h"
+
+class IoUringLoop;
+
+//输出内存池，内存通过io_uring_register_buffers注册为固定缓冲区，chunk的序号就是固定缓冲区的序号
+//用户直接在chunk中序列化要发送的数据(TcpConnection::reserve/commit)，然后使用WRITE_FIXED或者SEND_ZC固定缓冲区发送，
+//不需要用户侧的std::string，内核也不需要在每次发送时固定页面
+//每个loop一个，在第一次使用时创建，只能在loop线程中使用
+struct ChunkPoolManagerOutput
+{
+    static constexpr size_t kDefaultChunkSize = 64*1024;
+    static constexpr size_t kDefaultChunkNum = 64;
+    //内存池耗尽时临时分配的chunk的序号，这些chunk没有注册，只能使用普通的writev发送
+    static constexpr uint16_t kOverflowIndex = UINT16_MAX;
+
+    ChunkPool pool_;    //具体的内存池
+    IoUringLoop& loop_;
+    const size_t chunk_size_;   //每一个chunk的大小
+
+    std::vector<Chunk>chunks_data_;     //所有chunk对象，按序号排序
+    Chunk* free_list_;                  //空闲的chunk链表
+    size_t free_count_;                 //空闲的chunk数量
+    bool registered_;                   //是否注册成功，注册失败时chunk只作为普通内存使用
+    size_t overflow_chunks_;            //内存池耗尽时临时分配的chunk的数量，用于判断内存池是否太小
+
+    ChunkPoolManagerOutput(IoUringLoop& loop,size_t chunk_size = kDefaultChunkSize,size_t chunk_num = kDefaultChunkNum);
+
+    ~ChunkPoolManagerOutput();
+
+    //取出一个空闲的chunk，内存池耗尽时临时分配一个没有注册的chunk
+    Chunk* acquireChunk();
+
+    //归还chunk，临时分配的chunk直接释放
+    void releaseChunk(Chunk* chunk);
+
+    //chunk是否是注册过的固定缓冲区，可以使用WRITE_FIXED发送
+    bool isRegistered(const Chunk* chunk)const {return registered_&&chunk->index_!=kOverflowIndex;}
+
+    size_t chunkSize()const {return chunk_size_;}
+    size_t freeChunks()const {return free_count_;}
+    size_t overflowChunks()const {return overflow_chunks_;}
+    bool registered()const {return registered_;}
+    //chunk中还可以写入的空间
+    size_t writableBytes(const Chunk* chunk)const {return chunk_size_-chunk->tail_;}
+};
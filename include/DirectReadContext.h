@@ -0,0 +1,43 @@
+#pragma once
+#include <memory>
+#include <coroutine>
+
+#include "IoContext.h"
+#include "noncopyable.h"
+
+class TcpConnection;
+struct ReadContext;
+
+//大消息直接接收：停止multishot之后，使用 MSG_WAITALL 的 recv 把数据直接写入用户提供的缓冲区
+//不经过buffer ring，避免大量chunk被占用以及从chunk拷贝到用户缓冲区的开销
+struct DirectReadContext:public IoContext ,noncopyable
+{
+    std::shared_ptr<TcpConnection>holder_;  //提交了sqe避免tcp connection提前析构
+    std::coroutine_handle<>read_handle_;    //业务协程的句柄
+
+    //这里只是持有fd用于提交，并不管理这个fd，fd的管理有连接类进行管理
+    int fd_;
+    char* buf_;         //用户提供的缓冲区
+    size_t len_;        //需要接收的总长度
+    size_t filled_;     //已经接收的长度
+    bool is_reading_;   //是否有recv sqe还没有返回
+    bool is_error_;     //是否出错
+
+    DirectReadContext(int fd);
+    ~DirectReadContext();
+
+    //准备接收新的消息
+    void reset(char* buf,size_t len);
+
+    //从输入缓冲区中拷贝已经接收到的数据，返回是否已经接收完整
+    bool drain(ReadContext& r_ctx);
+
+    //multishot已经停止，先拷贝缓冲区中剩余的数据，然后提交直接接收的请求，接收完整时直接唤醒协程
+    void start(ReadContext& r_ctx,std::shared_ptr<TcpConnection> holder);
+
+    bool handleError();
+
+    void on_completion();
+
+    bool done()const {return filled_==len_;}
+};
@@ -0,0 +1,67 @@
+#pragma once
+#include <sys/types.h>
+
+#include "IoContext.h"
+#include "noncopyable.h"
+
+struct WriteContext;
+struct FileSendContext;
+struct TxFragment;
+struct Chunk;
+class IoUringLoop;
+
+//文件分片发送中的一个请求：把文件中的数据读入中转(管道或者内存)，或者把中转的数据写入socket
+struct FileSendOp:public IoContext ,noncopyable
+{
+    FileSendContext& owner_;
+    size_t len_;        //请求的字节数，为0表示这一次不提交
+
+    FileSendOp(FileSendContext& owner);
+    ~FileSendOp();
+
+    void on_completion();
+};
+
+//发送文件分片，一次发送由两个链接的请求组成：
+//默认使用splice把文件中的数据读入从loop借用的管道，再从管道splice到socket，数据不经过用户态
+//文件不支持splice时改为把文件读入输出内存池中注册过的chunk(READ_FIXED)，再使用WRITE_FIXED发送
+//读入中转的数据没有全部写入socket时，下一次只发送中转中剩余的数据，中转为空时才归还管道或者chunk
+//发送文件分片时这个连接没有其它的发送请求在内核中，所以文件分片和内存中的分片按照追加的顺序发送
+struct FileSendContext:public IoContext ,noncopyable
+{
+    WriteContext& owner_;
+    IoUringLoop& loop_;
+    FileSendOp in_;         //文件 -> 中转
+    FileSendOp out_;        //中转 -> socket
+
+    int file_fd_;           //这一次读取的文件
+    off_t file_offset_;     //这一次读取的位置
+
+    int pipe_[2];           //从loop借用的管道，没有借用时为-1
+    Chunk* chunk_;          //不使用splice时的中转内存
+    size_t chunk_offset_;   //chunk中还没有写入socket的数据的起始位置
+    size_t staged_;         //已经读入中转但是还没有写入socket的字节数
+
+    bool use_splice_;       //为false时把文件读入内存再发送，每次从空的中转开始时按照连接的设置重新选择
+    bool wait_writable_;    //上一次splice没有写完(socket的缓冲区满)，下一次先等待socket可写，splice不会自己等待
+    size_t pending_;        //这一次还没有返回的请求数量
+    size_t sent_;           //这一次写入socket的字节数
+    int error_;             //这一次的第一个错误，被取消的请求不算
+
+    size_t spliced_bytes_;  //通过splice发送的字节数
+    size_t copied_bytes_;   //通过内存中转发送的字节数
+
+    FileSendContext(WriteContext& owner,IoUringLoop& loop);
+    ~FileSendContext();
+
+    //根据下一个要发送的文件分片准备这一次的请求，中转中还有数据时只发送剩余的数据
+    void prepare(const TxFragment* fragment);
+
+    //一个请求返回，全部返回之后把结果交给WriteContext
+    void onOpResult(FileSendOp* op);
+
+    //中转为空时归还管道和chunk
+    void releaseStage();
+
+    bool registered()const;
+};
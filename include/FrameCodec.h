@@ -0,0 +1,119 @@
+#pragma once
+#include <iostream>
+#include <string>
+#include <string_view>
+
+#include "ChunkPool.h"
+
+class InputChainBuffer;
+
+//一个完整的帧(不含长度头)，数据仍然保存在输入缓冲区的chunk链表中，是零拷贝的视图
+//注意：视图只在同一个连接下一次 readFrame/readFrames/read/peek/retrieve 之前有效
+class Frame
+{
+private:
+    const Chunk* chunk_;    //帧数据起始所在的chunk
+    size_t offset_;         //帧数据在起始chunk中相对于beginRead()的偏移量
+    size_t len_;            //帧数据的长度
+    bool valid_;            //连接关闭或者协议错误时返回无效帧
+
+public:
+    Frame()
+        :chunk_(nullptr)
+        ,offset_(0)
+        ,len_(0)
+        ,valid_(false)
+    {}
+
+    Frame(const Chunk* chunk,size_t offset,size_t len)
+        :chunk_(chunk)
+        ,offset_(offset)
+        ,len_(len)
+        ,valid_(true)
+    {}
+
+    bool valid()const {return valid_;}
+    explicit operator bool()const {return valid_;}
+
+    size_t size()const {return len_;}
+
+    //帧数据是否完全落在一个chunk中
+    bool isContiguous()const {return !chunk_||offset_+len_<=chunk_->readableBytes();}
+
+    //只有在帧数据连续的时候才返回视图，否则返回空视图，此时应使用forEachSegment或者copyTo
+    std::string_view view()const
+    {
+        if(!chunk_||!isContiguous()) return {};
+        return {chunk_->beginRead()+offset_,len_};
+    }
+
+    //按顺序遍历帧数据所在的每一段内存，f的签名为 void(const char* data,size_t len)
+    template <typename F>
+    void forEachSegment(F&& f)const
+    {
+        const Chunk* chunk = chunk_;
+        size_t offset = offset_;
+        size_t remain = len_;
+        while(remain>0&&chunk)
+        {
+            size_t seg = std::min(chunk->readableBytes()-offset,remain);
+            if(seg>0) f(chunk->beginRead()+offset,seg);
+            remain -= seg;
+            offset = 0;
+            chunk = chunk->next_;
+        }
+    }
+
+    //将帧数据拷贝到target中，target至少要有size()的大小
+    size_t copyTo(char* target)const;
+
+    std::string toString()const;
+};
+
+//u32 长度前缀(网络字节序，长度不包含头部本身)的帧解码器，每个连接持有一个
+//已经交给用户的帧不会立即从缓冲区中移除，而是在下一次读取时统一移除，从而保证视图有效
+class FrameDecoder
+{
+public:
+    static constexpr size_t kHeaderLen = sizeof(uint32_t);
+    static constexpr size_t kDefaultMaxFrameLen = 1024*1024;
+
+private:
+    size_t max_frame_len_;  //允许的最大帧长度，超过视为协议错误
+    size_t delivered_;      //已经交给用户但是还没有从缓冲区移除的字节数
+    size_t need_;           //下一帧完整所需要的缓冲区总字节数(包含delivered_)，用于快速判断
+    bool is_error_;         //是否出现了协议错误
+
+    //delivered_位置对应的chunk和偏移量，避免每一帧都从头节点开始遍历，缓冲区被消费之后失效
+    const Chunk* cursor_chunk_;
+    size_t cursor_offset_;
+
+    uint32_t frame_len_;    //已经解析出的下一帧的长度
+    bool header_parsed_;    //下一帧的头部是否已经解析
+
+    //将游标向后移动len个字节
+    void advance(const InputChainBuffer& buffer,size_t len);
+
+    //解析从delivered_开始的帧头部，如果数据不足返回false
+    bool parseHeader(const InputChainBuffer& buffer);
+
+public:
+    explicit FrameDecoder(size_t max_frame_len=kDefaultMaxFrameLen);
+
+    //缓冲区中是否已经有一个完整的帧，同时更新need_
+    bool hasFrame(const InputChainBuffer& buffer);
+
+    //取出下一个完整的帧，调用前必须保证hasFrame返回true
+    Frame next(const InputChainBuffer& buffer);
+
+    //将之前交给用户的帧从缓冲区中移除，缓冲区被其它方式消费之前也必须调用，用于重置游标
+    void release(InputChainBuffer& buffer);
+
+    //等待帧数据时所需要的缓冲区总字节数
+    size_t need()const {return need_;}
+
+    bool isError()const {return is_error_;}
+
+    void setMaxFrameLength(size_t len){max_frame_len_ = len;}
+    size_t maxFrameLength()const {return max_frame_len_;}
+};
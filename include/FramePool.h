@@ -0,0 +1,74 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <array>
+
+#include "noncopyable.h"
+
+//协程帧的内存池，每个loop一个，按照大小分级缓存释放的帧，避免每个连接和每层嵌套的协程都经过全局的operator new
+//Task的promise通过operator new/delete使用当前线程的帧内存池，没有loop的线程直接使用堆
+//每一级的内存块都是单独从堆中分配的同样大小的块，所以在任何线程中释放都是安全的：
+//释放时如果当前线程有内存池并且没有超过缓存上限就缓存起来，否则直接还给堆，不需要记录内存块来自哪个内存池
+//只能在所属的线程中使用，不加锁
+class FramePool : noncopyable
+{
+public:
+    //分级的大小：64,128,...,4096，超过的直接使用堆
+    static constexpr size_t kMinClassSize = 64;
+    static constexpr size_t kNumClasses = 7;
+    static constexpr size_t kMaxClassSize = kMinClassSize<<(kNumClasses-1);
+    //每一级默认最多缓存的空闲块数量
+    static constexpr size_t kDefaultCacheLimit = 1024;
+
+    struct Stats
+    {
+        uint64_t hits_;         //从缓存中分配的次数
+        uint64_t misses_;       //缓存为空，从堆中分配的次数
+        uint64_t oversize_;     //超过最大分级，直接从堆中分配的次数
+        uint64_t released_;     //释放回缓存的次数
+        uint64_t dropped_;      //缓存已满，直接还给堆的次数
+        size_t cached_;         //当前缓存的空闲块数量
+    };
+
+    FramePool();
+    ~FramePool();
+
+    void* allocate(size_t size);
+    //size必须和分配时的大小相同
+    void release(void* ptr,size_t size);
+
+    //预先分配count个可以容纳size字节的帧，放入缓存，这一级的缓存上限至少为count
+    void reserve(size_t size,size_t count);
+    //设置每一级的缓存上限，为0时相当于不使用缓存，超过上限的空闲块立即释放
+    void setCacheLimit(size_t limit);
+
+    Stats stats()const;
+
+    //当前线程的帧内存池，由loop在构造时设置，没有时为nullptr
+    static FramePool* current();
+    static void setCurrent(FramePool* pool);
+
+    //promise的operator new/delete使用的接口，当前线程没有内存池时使用堆
+    static void* allocateFrame(size_t size);
+    static void releaseFrame(void* ptr,size_t size);
+
+private:
+    struct FreeBlock
+    {
+        FreeBlock* next_;
+    };
+
+    struct SizeClass
+    {
+        FreeBlock* free_list_;
+        size_t cached_;
+        size_t limit_;
+    };
+
+    std::array<SizeClass,kNumClasses>classes_;
+    Stats stats_;
+
+    //size对应的分级，超过最大分级时返回kNumClasses
+    static size_t classIndex(size_t size);
+    static size_t classSize(size_t index){return kMinClassSize<<index;}
+};
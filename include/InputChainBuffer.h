@@ -2,6 +2,8 @@
 #include <iostream>
 #include <string_view>
 
+#include "ChunkLease.h"
+
 struct Chunk;
 class ChunkPoolManagerInput;
 class TcpConnection;
@@ -20,8 +22,8 @@ private:
 
     bool push_back(uint16_t index,int len);//这里len用int类型的是因为io_uring中cqe res字段的类型为signed int
 
-    //弹出头节点并把头节点返回给内存池
-    bool pop_front();
+    //弹出头节点并把头节点返回给内存池，commit为false时只放回不提交，由调用者统一提交
+    bool pop_front(bool commit=true);
 
     Chunk* front()const {return head_;}
     Chunk* back()const {return tail_;}
@@ -44,10 +46,21 @@ public:
     //自己手动移动指针来消费数据
     void retrieve(size_t len);
 
+    //把前len个字节所在的chunk从链表中取出，交给租约持有，不拷贝数据
+    //最后一个chunk只取了一部分时，这个chunk由缓冲区和租约共同持有
+    ChunkLease detach(size_t len);
+
     void append(uint16_t index,int len);
 
+    //追加数据，数据较少并且尾节点剩余的空间足够时，把数据拷贝到尾节点中并立即归还新的chunk
+    //已有数据的位置不会改变，所以不影响已经交给用户的视图和游标
+    void appendCompact(uint16_t index,int len);
+
     size_t getTotalLen()const {return total_len_;}
 
     size_t getTotalChunk()const {return chunks_;}
 
+    //只读访问链表的头节点，用于在不拷贝的情况下解析数据
+    const Chunk* frontChunk()const {return head_;}
+
 };
\ No newline at end of file
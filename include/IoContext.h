@@ -6,7 +6,12 @@ enum class ContextType : uint8_t {
     Read,
     Write,
     Accept,
-    Wakeup
+    Wakeup,
+    DirectRead,
+    ZeroCopySend,
+    WriteOp,
+    FileSend,
+    FileSendOp
 };
 
 struct IoContext
@@ -6,6 +6,8 @@
 #include <functional>
 #include <memory>
 #include <queue>
+#include <array>
+#include <coroutine>
 
 #include "noncopyable.h"
 #include "Timestamp.h"
@@ -14,13 +16,20 @@
 #include "IoContext.h"
 #include "TimerId.h"
 #include "Callbacks.h"
+#include "LoopHop.h"
 
 class Acceptor;
 class ChunkPoolManagerInput;
+struct ChunkPoolManagerOutput;
+class TxFragmentPool;
+class FramePool;
 class TimerQueue;
 class ReadContext;
 class WriteContext;
 class AcceptContext;
+struct DirectReadContext;
+struct ZeroCopySendContext;
+struct FileSendContext;
 
 struct IoUringLoopParams
 {
@@ -31,10 +40,94 @@ struct IoUringLoopParams
     size_t chunk_num_;      //buffer ring中内存块的块数，注意要是2的n次方
 };
 
+//loop的运行统计，用于找出长时间占用loop的处理函数
+struct LoopStats
+{
+    uint64_t iterations_;       //循环的次数
+    uint64_t cqes_;             //处理的cqe数量
+    uint64_t functors_;         //执行的任务数量
+    uint64_t resumes_;          //从就绪队列中恢复的协程数量
+    uint64_t yields_;           //yield的次数
+    uint64_t budget_exhausted_; //因为预算用完把剩下的工作留到下一次循环的次数
+    uint64_t slow_handlers_;    //耗时超过阈值的处理函数的数量
+    int64_t max_handler_us_;    //开启计时之后最慢的一次处理的耗时
+};
+
+//处理函数耗时超过阈值时的回调，ctx是对应的上下文(可以和连接的getReadContext/getWriteContext比较找到连接)，任务和yield的协程为空
+//处理函数可能已经关闭并释放了连接，回调时ctx可能已经失效，只能用来比较地址，不能解引用
+using SlowHandlerCallback = std::function<void(const IoContext* ctx,int64_t micro_seconds)>;
+
+class IoUringLoop;
+
+//让出loop，协程放入就绪队列的末尾，等这一次循环中的其它cqe、协程和任务处理完之后再恢复
+class LoopYieldAwaiter
+{
+private:
+    IoUringLoop* loop_;
+    std::coroutine_handle<>parked_;     //在就绪队列中等待时的句柄，恢复之后为空
+public:
+    //在就绪队列中被销毁时撤销，可以在whenAny中取消
+    static constexpr bool kCancelOnDestroy = true;
+    IoUringLoop* parkLoop()const {return loop_;}
+
+    explicit LoopYieldAwaiter(IoUringLoop* loop)
+        :loop_(loop)
+        ,parked_(nullptr)
+    {}
+    ~LoopYieldAwaiter();
+
+    bool await_ready(){return false;}
+    void await_suspend(std::coroutine_handle<>h);
+    void await_resume(){parked_ = nullptr;}
+};
+
+//切换到指定的loop继续执行，已经在这个loop的线程中时不挂起
+//挂起之后不能销毁(不能在whenAny中取消)
+class LoopSwitchAwaiter
+{
+private:
+    IoUringLoop* loop_;
+    LoopHop hop_;
+public:
+    explicit LoopSwitchAwaiter(IoUringLoop* loop)
+        :loop_(loop)
+        ,hop_{nullptr,nullptr}
+    {}
+
+    bool await_ready();
+    void await_suspend(std::coroutine_handle<>h);
+    void await_resume(){}
+};
+
+//回到协程所属的loop(Task创建时所在的loop，见Task.hpp)继续执行，已经在这个loop中或者协程不属于任何loop时不挂起
+class OwnLoopAwaiter
+{
+private:
+    LoopHop hop_;
+public:
+    OwnLoopAwaiter()
+        :hop_{nullptr,nullptr}
+    {}
+
+    bool await_ready(){return false;}
+
+    //Promise需要有home_loop_成员
+    template <typename Promise>
+    bool await_suspend(std::coroutine_handle<Promise>h);
+    void await_resume(){}
+};
+
+//co_await switchTo(loop)：切换到loop的线程中继续执行，之后可以直接访问只属于这个loop的数据
+LoopSwitchAwaiter switchTo(IoUringLoop& loop);
+//co_await resumeOnOwnLoop()：从线程池或者其它loop回到协程所属的loop
+inline OwnLoopAwaiter resumeOnOwnLoop(){return OwnLoopAwaiter();}
+
 class IoUringLoop: noncopyable , IoContext
 {
+    friend LoopYieldAwaiter;
 private:
     friend ChunkPoolManagerInput;
+    friend ChunkPoolManagerOutput;
 
     using Functor=std::function<void()>;
     io_uring* ring_;
@@ -53,6 +146,17 @@ private:
     const size_t CHUNK_SIZE;//每一个内存块的大小
     const size_t CHUNK_NUM; //内存块的数量
 
+    //输出缓冲区分片的对象池，这个loop中所有连接共用
+    std::unique_ptr<TxFragmentPool>fragment_pool_;
+    //这个loop线程中协程帧的内存池，在构造时设置为当前线程的帧内存池
+    std::unique_ptr<FramePool>frame_pool_;
+    //注册为固定缓冲区的输出内存池，第一次使用时创建
+    std::unique_ptr<ChunkPoolManagerOutput>output_chunk_manager_;
+
+    //splice发送文件时中转使用的空闲管道，连接只在发送文件分片的过程中借用，中转的数据发送完之后归还
+    std::vector<std::array<int,2>>free_pipes_;
+    size_t pipe_size_;      //管道的容量，第一次创建管道时设置
+
 
     //每次循环调用poller时的时间点
     Timestamp pollReturnTime_; 
@@ -64,6 +168,11 @@ private:
     std::atomic_bool calling_pending_functors_;
     //可能有其它线程在任务队列中追加任务，所以要加锁
     std::mutex mtx_;
+    //切换到这个loop的协程组成的链表，和任务队列使用同一个锁，每次循环在恢复就绪队列之前取出
+    LoopHop* hop_head_;
+    LoopHop* hop_tail_;
+    std::atomic_bool has_hops_;     //链表不为空，没有切换时不需要加锁
+    void takeHops();
 
 
     //用于跨线程唤醒操作
@@ -77,6 +186,35 @@ private:
 
     io_uring_sqe* getIoUringSqe(bool force_submit);
 
+    //这一次循环中有数据要发送的连接，在循环末尾统一提交，同一个连接多次追加的数据只需要一次提交
+    std::vector<WriteContext*>pending_writes_;
+    std::vector<WriteContext*>flushing_writes_;
+    void flushPendingWrites();
+
+    //就绪队列中的协程，ctx_是唤醒它的上下文，yield的协程为空
+    struct ReadyEntry
+    {
+        std::coroutine_handle<>handle_;
+        IoContext* ctx_;
+    };
+    //开启延迟恢复时读写完成之后等待恢复的协程和yield的协程，在这一批cqe全部处理完之后按照顺序恢复
+    std::vector<ReadyEntry>ready_handles_;
+    bool defer_resume_;
+    size_t resume_budget_;      //每次循环最多恢复的协程数量，为0表示不限制
+    void doingReadyHandles();
+
+    //每次循环最多处理的cqe数量和执行的任务数量，为0表示不限制
+    size_t cqe_budget_;
+    size_t functor_budget_;
+    bool functors_left_;        //任务队列中还有因为预算留到下一次循环的任务
+
+    LoopStats stats_;
+    int64_t slow_threshold_us_;     //超过这个时间的处理函数被记录为慢处理，为0表示不计时
+    SlowHandlerCallback slow_handler_callback_;
+    //记录一次处理的耗时，超过阈值时调用回调
+    //ctx在处理之后可能已经释放，只作为标识传给回调，type是处理之前取出的上下文类型，没有上下文时为-1
+    void checkSlow(const IoContext* ctx,int type,MonotonicTimestamp start);
+
     using WaitEntry =IoContext*;
     std::queue<WaitEntry>waiting_submit_queue_;
     void doingSubmitWaitingTask();
@@ -90,6 +228,9 @@ private:
     void _submitReadMultishut(ReadContext* ctx);
     void _submitWriteMsg(WriteContext* ctx);
     void _submitAcceptMultishut(AcceptContext* ctx);
+    void _submitDirectRead(DirectReadContext* ctx);
+    void _submitZeroCopySend(ZeroCopySendContext* ctx);
+    void _submitFileSend(FileSendContext* ctx);
 
 public:
     /// @brief 构造函数
@@ -117,6 +258,10 @@ public:
 
     //通过eventfd唤醒loop执行队列中的任务
     void wakeUp();
+    //把切换到这个loop的协程加入链表，在下一次循环中恢复，可以在任意线程中调用
+    void queueHop(LoopHop* hop);
+    //把协程放入就绪队列，不需要加锁也不需要唤醒，只能在loop线程中调用
+    void post(std::coroutine_handle<>h){ready_handles_.push_back({h,nullptr});}
 
     //判断此eventloop知否在当前线程中
     bool isInLoopThread()const {return this->thread_id_==CurrentThread::tid();}
@@ -124,11 +269,60 @@ public:
     void submitReadMultishut(ReadContext* ctx);
     void submitWriteMsg(WriteContext* ctx);
     void submitAcceptMultishut(AcceptContext* ctx);
-    void submitCancel(ReadContext* ctx);
+    void submitDirectRead(DirectReadContext* ctx);
+    void submitZeroCopySend(ZeroCopySendContext* ctx);
+    void submitFileSend(FileSendContext* ctx);
+    void submitCancel(IoContext* ctx);
+    //在这一次循环结束时发送ctx中的数据，只能在loop线程中调用
+    void queueWrite(WriteContext* ctx){pending_writes_.push_back(ctx);}
+
+    //开启或关闭延迟恢复，默认关闭
+    //关闭时读写完成之后在处理cqe的过程中直接恢复等待的协程；开启之后先放入就绪队列，这一批cqe全部处理完之后再依次恢复，
+    //业务代码不会插在cqe之间执行，同一批中同一个连接的多个cqe只唤醒一次；只能在loop线程中或者loop开始之前调用
+    void setDeferredResume(bool on){defer_resume_ = on;}
+    //每次循环最多从就绪队列中恢复的协程数量，剩下的留到下一次循环，在大量连接同时就绪时保证新的cqe能及时被处理
+    //为0表示不限制，默认为kDefaultResumeBudget
+    void setResumeBudget(size_t budget){resume_budget_ = budget;}
+    static constexpr size_t kDefaultResumeBudget = 64;
+    //每次循环最多处理的cqe数量，剩下的留在完成队列中，不超过构造时的cqes_size，为0表示使用cqes_size
+    void setCqeBudget(size_t budget){cqe_budget_ = budget;}
+    //每次循环最多执行的任务数量，剩下的按照顺序留到下一次循环，为0表示不限制(默认)
+    void setFunctorBudget(size_t budget){functor_budget_ = budget;}
+    //就绪队列中等待恢复的协程数量
+    size_t readyCount()const {return ready_handles_.size();}
+    //恢复等待读写的协程，当前线程的loop开启了延迟恢复时放入就绪队列，否则直接恢复，ctx是唤醒协程的上下文
+    static void resumeHandle(std::coroutine_handle<>h,IoContext* ctx = nullptr);
+    //co_await loop.yield()让出loop，在loop线程中执行长时间的计算时分段调用，让其它连接的处理可以插入进来
+    //在其它线程中调用时切换到loop线程继续执行
+    LoopYieldAwaiter yield(){return LoopYieldAwaiter(this);}
+
+    //开启计时：cqe的处理函数、就绪队列中的协程和任务每次执行超过threshold微秒时计入统计并调用cb，没有cb时打印日志
+    //threshold为0时关闭计时(默认)，计时需要每次处理前后读取时钟；只能在loop线程中或者loop开始之前调用
+    void setSlowHandlerThreshold(int64_t threshold_us,SlowHandlerCallback cb = nullptr);
+    //只能在loop线程中调用
+    LoopStats stats()const {return stats_;}
+    //撤销就绪队列中还没有恢复的协程，协程在恢复之前被销毁时由awaiter调用，只在loop线程中有效
+    void cancelReady(std::coroutine_handle<>h);
 
     uint32_t remainedSqe()const {return io_uring_sq_space_left(ring_);}
 
     ChunkPoolManagerInput& getInputPool() {return *input_chunk_manager_;}
+    TxFragmentPool& getFragmentPool() {return *fragment_pool_;}
+    //只能在loop线程中使用
+    FramePool& getFramePool() {return *frame_pool_;}
+    //只能在loop线程中调用
+    ChunkPoolManagerOutput& getOutputPool();
+
+    //管道的期望容量，一次splice最多中转这么多数据
+    static constexpr size_t kPipeSize = 1024*1024;
+    //最多缓存的空闲管道数量，超过的直接关闭
+    static constexpr size_t kMaxFreePipes = 16;
+    //借用一个空的管道，没有空闲的管道时创建，创建失败返回false，只能在loop线程中调用
+    bool acquirePipe(int fds[2]);
+    //归还借用的管道，管道中不能有数据
+    void releasePipe(int fds[2]);
+    //管道的实际容量，可能因为系统限制小于kPipeSize
+    size_t pipeSize()const {return pipe_size_;}
 
     //定时器相关
     //在固定时间执行定时任务,注意when应当是相对时间
@@ -141,3 +335,12 @@ public:
     void cancel(TimerId timer_id);
 };
 
+template <typename Promise>
+bool OwnLoopAwaiter::await_suspend(std::coroutine_handle<Promise>h)
+{
+    IoUringLoop* loop = h.promise().home_loop_;
+    if(!loop||loop->isInLoopThread()) return false;
+    hop_.handle_ = h;
+    loop->queueHop(&hop_);
+    return true;
+}
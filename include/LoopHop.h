@@ -0,0 +1,12 @@
+#pragma once
+#include <coroutine>
+
+//跨线程切换到loop的协程，节点保存在awaiter(也就是协程帧)中，入队时不需要分配内存
+//loop每次循环一次性取出所有节点，run_为空时直接放入就绪队列；
+//不为空时在loop线程中调用run_，由它决定把协程放入就绪队列(IoUringLoop::post)还是在loop中挂起
+struct LoopHop
+{
+    std::coroutine_handle<>handle_;
+    LoopHop* next_;
+    void (*run_)(LoopHop*) = nullptr;
+};
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <atomic>
+#include <new>
+#include <string>
+#include <string_view>
+#include <cstring>
+#include <cstdint>
+#include <utility>
+
+//不可变的共享数据，数据和引用计数在同一次分配中，复制只增加引用计数
+//引用计数是原子的，同一个Payload可以同时被多个loop中的发送队列引用，最后一个引用释放时归还内存
+//用于广播：一份数据追加到成千上万个连接的发送队列中，每个连接只持有一个引用，不需要拷贝数据
+class Payload
+{
+private:
+    struct Block
+    {
+        std::atomic<uint32_t> refs_;
+        size_t len_;
+
+        char* data(){return reinterpret_cast<char*>(this+1);}
+    };
+
+    Block* block_;  //为空表示没有数据
+
+    void release()
+    {
+        if(block_&&block_->refs_.fetch_sub(1,std::memory_order_acq_rel)==1)
+        {
+            block_->~Block();
+            ::operator delete(block_);
+        }
+        block_ = nullptr;
+    }
+
+public:
+    Payload():block_(nullptr){}
+
+    //拷贝一次数据，之后的复制都只增加引用计数
+    Payload(const char* data,size_t len)
+        :block_(nullptr)
+    {
+        if(len==0) return;
+        block_ = new (::operator new(sizeof(Block)+len)) Block{{1},len};
+        std::memcpy(block_->data(),data,len);
+    }
+
+    explicit Payload(std::string_view data)
+        :Payload(data.data(),data.size())
+    {}
+
+    Payload(const Payload& other)
+        :block_(other.block_)
+    {
+        if(block_) block_->refs_.fetch_add(1,std::memory_order_relaxed);
+    }
+
+    Payload(Payload&& other)noexcept
+        :block_(std::exchange(other.block_,nullptr))
+    {}
+
+    Payload& operator=(Payload other)noexcept
+    {
+        std::swap(block_,other.block_);
+        return *this;
+    }
+
+    ~Payload()
+    {
+        release();
+    }
+
+    const char* data()const {return block_?block_->data():nullptr;}
+    size_t size()const {return block_?block_->len_:0;}
+    bool empty()const {return block_==nullptr;}
+    std::string_view view()const {return {data(),size()};}
+
+    //当前的引用数量，只用于测试和统计
+    uint32_t useCount()const {return block_?block_->refs_.load(std::memory_order_relaxed):0;}
+};
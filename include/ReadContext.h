@@ -4,8 +4,10 @@
 
 #include "IoContext.h"
 #include "InputChainBuffer.h"
+#include "FrameCodec.h"
 #include "noncopyable.h"
 class TcpConnection;
+struct DirectReadContext;
 
 struct ReadContext:public IoContext ,noncopyable
 {
@@ -27,6 +29,19 @@ struct ReadContext:public IoContext ,noncopyable
         CANCELING   //因为背压提交了取消的sqe，但是cancel sqe 的cqe还没有返回
     };
     ReadStatus status_;
+
+    //业务协程正在等待一个完整的帧时不为空，此时只有帧完整才唤醒协程
+    FrameDecoder* frame_waiter_;
+
+    //业务协程等待的最少字节数，缓冲区中的数据达到这个数量才唤醒协程
+    size_t wake_len_;
+
+    //业务协程正在等待直接接收时不为空，multishot停止之后把接收交给它
+    DirectReadContext* direct_waiter_;
+
+    //等待不完整的帧或者指定长度的数据时最多能缓冲的字节数，为输入buffer ring容量的一半
+    //buffer ring由loop中所有连接共享，不能让一个连接为了等待数据占满它
+    const size_t max_wait_len_;
     
     ReadContext(size_t high_water_mark,size_t high_water_mark_chunk,int fd,ChunkPoolManagerInput&manager);
     ~ReadContext();
@@ -35,8 +50,22 @@ struct ReadContext:public IoContext ,noncopyable
 
     void on_completion();
 
+    //如果正在等待一个还不完整的帧或者指定长度的数据，不触发背压，否则永远无法接收完整
+    //但是最多只缓冲max_wait_len_个字节，帧长度和PrepareToRead的min_len都被限制在这个范围内
     inline bool overLoad()const
-    {return input_buffer_.getTotalLen()>high_water_mark_||input_buffer_.getTotalChunk()>high_water_mark_chunk_;}
+    {
+        size_t len = input_buffer_.getTotalLen();
+        bool waiting = (frame_waiter_&&len<frame_waiter_->need())||len<wake_len_;
+        if(waiting&&len<max_wait_len_) return false;
+        return len>high_water_mark_||input_buffer_.getTotalChunk()>high_water_mark_chunk_;
+    }
+
+    //是否满足唤醒业务协程的条件
+    inline bool readyToWake()
+    {
+        if(input_buffer_.getTotalLen()<wake_len_) return false;
+        return !frame_waiter_||frame_waiter_->hasFrame(input_buffer_)||frame_waiter_->isError();
+    }
 
     inline bool isEmpty()const {return input_buffer_.getTotalLen()==0;}
 };
\ No newline at end of file
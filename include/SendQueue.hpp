@@ -7,32 +7,238 @@
 #include <memory>
 #include <cstring>
 #include <sys/uio.h>
+#include <sys/types.h>
 #include <type_traits>
 #include <utility>
+#include <algorithm>
+#include <cstdint>
+#include <span>
+#include <string_view>
 
-//可选扩展：对象池扩展，但是要考虑背压问题或者是使用动态扩展策略
+#include "noncopyable.h"
+#include "ChunkPoolManagerOutput.h"
+#include "Payload.hpp"
 
 //一个逻辑数据分片
+//分片自己持有数据的所有权，不需要额外分配共享的holder：
+//小数据直接拷贝到分片内部的inline_中，std::string和std::vector<char>的右值直接移动到分片中
+//开启合并之后，小数据会被连续地拷贝到暂存块中，多次小的写入只占用一个分片和一个iovec
+//Payload只增加引用计数，多个连接的分片指向同一块数据
+//文件分片只记录文件的范围，由WriteContext通过splice直接从文件发送到socket，数据不经过用户态
+//一次send追加的数据是一条消息，高优先级的消息只会插入到两条消息之间，不会打断正在发送的消息
 struct TxFragment
 {
+    //inline存储的容量，不超过这个大小的数据直接拷贝到分片中
+    static constexpr size_t kInlineCapacity = 64;
+
+    //数据的存放位置
+    enum class Storage : uint8_t
+    {
+        Inline,     //分片内部的inline_
+        String,     //分片中的str_
+        Vector,     //分片中的vec_
+        Guard,      //外部的内存，由guard_保活
+        Staging,    //暂存块block_，可以继续在末尾追加数据
+        Fixed,      //输出内存池中注册过的chunk_，可以继续在末尾追加数据
+        Shared,     //共享的不可变数据payload_
+        File,       //文件file_fd_中从file_offset_开始的数据，guard_可以用于保活fd，没有ptr_
+    };
+
     const char* ptr_;   //指向原始数据的指针
     size_t len_;        //这块数据的大小
     size_t written_;    //已经发送出去的数据的大小
-
-    std::shared_ptr<void>guard_;
+    size_t queued_;     //已经交给iovec的数据的大小，不小于written_
 
     TxFragment* next_;
+    Storage storage_;
+
+    char* block_;       //暂存块，由SendQueue申请和释放
+    size_t capacity_;   //暂存块的容量
+    Chunk* chunk_;      //输出内存池的chunk，分片独占这个chunk，释放分片时归还
+    int file_fd_;       //文件分片的fd，分片不管理这个fd
+    off_t file_offset_; //文件分片在文件中的起始位置
+
+    uint32_t zc_refs_;  //引用这个分片并且还没有收到通知的零拷贝发送的数量
+    bool detached_;     //已经从链表中移除，但是还有零拷贝发送在引用，最后一个通知返回时释放
+    bool msg_end_;      //分片的末尾是一条消息的结尾，只有多段数据组成的消息中间的分片为false
+
+    std::string str_;
+    std::vector<char> vec_;
+    std::shared_ptr<const void>guard_;
+    Payload payload_;
+
+    char inline_[kInlineCapacity];
     
     TxFragment()
         :ptr_(nullptr)
         ,len_(0)
         ,written_(0)
+        ,queued_(0)
+        ,next_(nullptr)
+        ,storage_(Storage::Inline)
+        ,block_(nullptr)
+        ,capacity_(0)
+        ,chunk_(nullptr)
+        ,file_fd_(-1)
+        ,file_offset_(0)
+        ,zc_refs_(0)
+        ,detached_(false)
+        ,msg_end_(true)
         ,guard_(nullptr)
-        ,next_(nullptr) 
     {}
 
     const char* beginRead()const {return ptr_+written_;}
     size_t remainData()const {return len_-written_;}
+    //暂存块中剩余的空间
+    size_t stagingSpace()const {return storage_==Storage::Staging?capacity_-len_:0;}
+
+    //归还到对象池之前释放持有的数据，分片可以直接复用，暂存块要在这之前归还
+    void reset()
+    {
+        switch (storage_)
+        {
+        case Storage::String:
+            std::string().swap(str_);
+            break;
+        case Storage::Vector:
+            std::vector<char>().swap(vec_);
+            break;
+        case Storage::Guard:
+        case Storage::File:
+            guard_.reset();
+            break;
+        case Storage::Shared:
+            payload_ = Payload();
+            break;
+        default:
+            break;
+        }
+        ptr_ = nullptr;
+        block_ = nullptr;
+        chunk_ = nullptr;
+        file_fd_ = -1;
+        file_offset_ = 0;
+        len_ = written_ = queued_ = capacity_ = 0;
+        zc_refs_ = 0;
+        detached_ = false;
+        msg_end_ = true;
+        next_ = nullptr;
+        storage_ = Storage::Inline;
+    }
+};
+
+//分片的对象池，每个loop一个，只能在loop线程中使用
+//分片按照slab批量分配，释放的分片通过空闲链表复用，稳定状态下追加和移除分片都不需要分配内存
+//注意：slab在对象池销毁之前不会还给系统，分片的数量受输出缓冲区的高水位线限制
+class TxFragmentPool : noncopyable
+{
+private:
+    TxFragment* free_list_;                             //空闲分片链表
+    std::vector<std::unique_ptr<TxFragment[]>>slabs_;   //所有分配过的slab
+    const size_t slab_size_;                            //每个slab中分片的数量
+
+    std::vector<char*>free_blocks_;     //空闲的暂存块
+    const size_t block_size_;           //暂存块的大小
+    const size_t max_free_blocks_;      //最多缓存的空闲暂存块数量，超过的直接释放
+
+    size_t capacity_;   //分片的总数
+    size_t in_use_;     //正在使用的分片数量
+
+    void grow()
+    {
+        auto slab = std::make_unique<TxFragment[]>(slab_size_);
+        for(size_t i=0;i<slab_size_;++i)
+        {
+            slab[i].next_ = free_list_;
+            free_list_ = &slab[i];
+        }
+        slabs_.emplace_back(std::move(slab));
+        capacity_ += slab_size_;
+    }
+
+public:
+    static constexpr size_t kDefaultBlockSize = 16*1024;
+
+    explicit TxFragmentPool(size_t slab_size = 256,size_t block_size = kDefaultBlockSize,size_t max_free_blocks = 64)
+        :free_list_(nullptr)
+        ,slab_size_(slab_size)
+        ,block_size_(block_size)
+        ,max_free_blocks_(max_free_blocks)
+        ,capacity_(0)
+        ,in_use_(0)
+    {}
+
+    ~TxFragmentPool()
+    {
+        for(auto block:free_blocks_) delete[] block;
+    }
+
+    TxFragment* acquire()
+    {
+        if(!free_list_) grow();
+        auto fragment = free_list_;
+        free_list_ = fragment->next_;
+        fragment->next_ = nullptr;
+        in_use_++;
+        return fragment;
+    }
+
+    void release(TxFragment* fragment)
+    {
+        fragment->reset();
+        fragment->next_ = free_list_;
+        free_list_ = fragment;
+        in_use_--;
+    }
+
+    char* acquireBlock()
+    {
+        if(free_blocks_.empty()) return new char[block_size_];
+        auto block = free_blocks_.back();
+        free_blocks_.pop_back();
+        return block;
+    }
+
+    void releaseBlock(char* block)
+    {
+        if(free_blocks_.size()<max_free_blocks_) free_blocks_.push_back(block);
+        else delete[] block;
+    }
+
+    size_t blockSize()const {return block_size_;}
+    size_t capacity()const {return capacity_;}
+    size_t inUse()const {return in_use_;}
+};
+
+//调用者持有的连续数据，guard_在数据发送完成之前保证数据有效，追加时不拷贝；guard_为空时追加时拷贝
+struct GuardedView
+{
+    std::string_view data_;
+    std::shared_ptr<const void>guard_;
+};
+
+//调用者持有的分散数据，按顺序追加，每一段和GuardedView一样处理，所有段共享同一个guard_
+//iovec数组本身只需要在追加之前有效
+struct GuardedIovecs
+{
+    std::span<const iovec> iovecs_;
+    std::shared_ptr<const void>guard_;
+};
+
+//消息的优先级，高优先级的消息在还没有开始发送的普通消息之前发送
+enum class Priority : uint8_t
+{
+    Normal,
+    High,
+};
+
+//文件中的一段数据，fd在发送完成之前要保持打开，可以由guard_保活
+struct FileRange
+{
+    int fd_;
+    off_t offset_;
+    size_t len_;
+    std::shared_ptr<const void>guard_;
 };
 
 class SendQueue
@@ -45,9 +251,26 @@ private:
     size_t slice_size_;//链表的大小
     size_t total_len_; //数据的总大小
 
-    void push_back()
+    //分片的对象池，为空时直接new/delete分片
+    TxFragmentPool* pool_;
+
+    //不超过这个大小的数据拷贝到暂存块中合并发送，为0表示不合并
+    size_t coalesce_threshold_;
+
+    //固定缓冲区分片所在的输出内存池，第一次追加固定缓冲区分片时设置
+    ChunkPoolManagerOutput* fixed_pool_;
+
+    //还没有插入到链表中的高优先级消息，提取数据之前由placeHigh插入，数据计入total_len_
+    TxFragment* high_head_;
+    TxFragment* high_tail_;
+    //最后一个插入到链表中的高优先级分片，之后的高优先级消息插入到它后面，保证高优先级的消息之间的顺序
+    TxFragment* placed_high_;
+
+
+    TxFragment* push_back(size_t len)
     {
-        auto fragment = new TxFragment();
+        auto fragment = pool_?pool_->acquire():new TxFragment();
+        fragment->len_ = len;
 
         if(!tail_)
         {
@@ -61,8 +284,25 @@ private:
         //如果之前数据都发送了但是还没发完，这时要更新curr_指针
         if(!curr_) curr_=tail_;
         slice_size_++;
+        total_len_ += len;
+        return fragment;
     }  
 
+    void releaseFragment(TxFragment* fragment)
+    {
+        if(fragment->storage_==TxFragment::Storage::Staging)
+        {
+            if(pool_) pool_->releaseBlock(fragment->block_);
+            else delete[] fragment->block_;
+        }
+        else if(fragment->storage_==TxFragment::Storage::Fixed)
+        {
+            fixed_pool_->releaseChunk(fragment->chunk_);
+        }
+        if(pool_) pool_->release(fragment);
+        else delete fragment;
+    }
+
     void pop_front()
     {
         if(!head_) return;
@@ -73,22 +313,55 @@ private:
         {
             curr_=tail_=nullptr;
         }
+        if(del_fragment==placed_high_) placed_high_ = nullptr;
 
-        delete del_fragment;
+        //内核可能还在引用零拷贝发送的数据，等到通知返回之后再释放
+        if(del_fragment->zc_refs_>0) del_fragment->detached_ = true;
+        else releaseFragment(del_fragment);
         slice_size_--;
     }
 
+    //把小数据追加到暂存块中，尾部的暂存块空间不够时申请一个新的
+    //只会在暂存块的末尾追加，已经交给内核的数据不会被移动
+    void appendStaging(const char* data,size_t len)
+    {
+        if(!tail_||tail_->stagingSpace()<len)
+        {
+            auto fragment = push_back(0);
+            fragment->block_ = pool_?pool_->acquireBlock():new char[TxFragmentPool::kDefaultBlockSize];
+            fragment->capacity_ = pool_?pool_->blockSize():TxFragmentPool::kDefaultBlockSize;
+            fragment->ptr_ = fragment->block_;
+            fragment->storage_ = TxFragment::Storage::Staging;
+        }
+        std::memcpy(tail_->block_+tail_->len_,data,len);
+        tail_->len_ += len;
+        total_len_ += len;
+        //尾部的暂存块可能已经全部交给内核，新追加的部分要从这个分片继续提取
+        if(!curr_) curr_ = tail_;
+    }
+
 public:
-    SendQueue()
+    explicit SendQueue(TxFragmentPool* pool = nullptr,size_t coalesce_threshold = 0)
         : head_(nullptr)
         , tail_(nullptr)
         , curr_(nullptr)
         , slice_size_(0)
         , total_len_(0)
-    {}
+        , pool_(pool)
+        , coalesce_threshold_(coalesce_threshold)
+        , fixed_pool_(nullptr)
+        , high_head_(nullptr)
+        , high_tail_(nullptr)
+        , placed_high_(nullptr)
+    {
+        //暂存块要能放下一次合并的数据
+        size_t block_size = pool_?pool_->blockSize():TxFragmentPool::kDefaultBlockSize;
+        if(coalesce_threshold_>block_size) coalesce_threshold_ = block_size;
+    }
 
     ~SendQueue()
     {
+        placeHigh();
         while (head_) pop_front();
     }
 
@@ -101,51 +374,247 @@ public:
     )
     void append(Buffer&& data)
     {
-        push_back();
         using T = std::remove_cvref_t<Buffer>;
-        auto holder = std::make_shared<T>(std::forward<Buffer>(data));
-        tail_->ptr_ = holder->data();
-        tail_->len_ = holder->size();
+        //小数据直接拷贝，避免持有一块单独的堆内存
+        if(data.size()<=std::max(TxFragment::kInlineCapacity,coalesce_threshold_))
+        {
+            append(data.data(),data.size());
+            return;
+        }
 
-        //BUG FIX 是holder->size()而不是data.size()
-        total_len_ += holder->size();
-        tail_->guard_ = std::move(holder);
+        auto fragment = push_back(data.size());
+        if constexpr (std::is_same_v<T, std::string>)
+        {
+            fragment->str_ = std::forward<Buffer>(data);
+            fragment->ptr_ = fragment->str_.data();
+            fragment->storage_ = TxFragment::Storage::String;
+        }
+        else
+        {
+            fragment->vec_ = std::forward<Buffer>(data);
+            fragment->ptr_ = fragment->vec_.data();
+            fragment->storage_ = TxFragment::Storage::Vector;
+        }
     }
 
     void append(const char*data,size_t len)
     {
-        push_back();
-        auto holder = std::make_shared<std::string>(data, len);
-        tail_->ptr_ = holder->data();
-        tail_->len_ = holder->size();
-        tail_->guard_ = std::move(holder);
+        if(len==0) return;
+        if(len<=coalesce_threshold_)
+        {
+            appendStaging(data,len);
+            return;
+        }
+        auto fragment = push_back(len);
+        if(len<=TxFragment::kInlineCapacity)
+        {
+            std::memcpy(fragment->inline_,data,len);
+            fragment->ptr_ = fragment->inline_;
+            fragment->storage_ = TxFragment::Storage::Inline;
+        }
+        else
+        {
+            fragment->str_.assign(data,len);
+            fragment->ptr_ = fragment->str_.data();
+            fragment->storage_ = TxFragment::Storage::String;
+        }
+    }
+
+    //追加共享的数据，只持有一个引用，不拷贝数据；和std::string一样，小数据直接拷贝
+    void append(const Payload& payload)
+    {
+        if(payload.size()<=std::max(TxFragment::kInlineCapacity,coalesce_threshold_))
+        {
+            append(payload.data(),payload.size());
+            return;
+        }
+        auto fragment = push_back(payload.size());
+        fragment->payload_ = payload;
+        fragment->ptr_ = fragment->payload_.data();
+        fragment->storage_ = TxFragment::Storage::Shared;
+    }
+
+    //追加调用者持有的数据，有guard_时只引用数据；小数据和std::string一样直接拷贝
+    void append(const GuardedView& view)
+    {
+        if(!view.guard_||view.data_.size()<=std::max(TxFragment::kInlineCapacity,coalesce_threshold_))
+        {
+            append(view.data_.data(),view.data_.size());
+            return;
+        }
+        auto fragment = push_back(view.data_.size());
+        fragment->guard_ = view.guard_;
+        fragment->ptr_ = view.data_.data();
+        fragment->storage_ = TxFragment::Storage::Guard;
+    }
+
+    //多段数据是一条消息，最后一段之前的分片不是消息的结尾
+    void append(const GuardedIovecs& iovecs)
+    {
+        for(auto& iov:iovecs.iovecs_)
+        {
+            append(GuardedView{{static_cast<const char*>(iov.iov_base),iov.iov_len},iovecs.guard_});
+            if(tail_) tail_->msg_end_ = false;
+        }
+        if(tail_) tail_->msg_end_ = true;
+    }
+
+    //追加文件中的一段数据，发送时不经过用户态，长度为0时忽略
+    void append(const FileRange& range)
+    {
+        if(range.len_==0) return;
+        auto fragment = push_back(range.len_);
+        fragment->file_fd_ = range.fd_;
+        fragment->file_offset_ = range.offset_;
+        fragment->guard_ = range.guard_;
+        fragment->storage_ = TxFragment::Storage::File;
+    }
+
+    //按照优先级追加一条消息，高优先级的消息先放在单独的链表中，等到下一次提取数据之前再插入
+    template <typename Data>
+    void append(Data&& data,Priority priority)
+    {
+        if(priority==Priority::Normal)
+        {
+            append(std::forward<Data>(data));
+            return;
+        }
+        //在高优先级的链表上追加，连续的小消息同样会合并到暂存块中
+        std::swap(head_,high_head_);
+        std::swap(tail_,high_tail_);
+        auto curr = std::exchange(curr_,nullptr);
+        append(std::forward<Data>(data));
+        curr_ = curr;
+        std::swap(head_,high_head_);
+        std::swap(tail_,high_tail_);
+    }
+
+    bool hasPendingHigh()const {return high_head_!=nullptr;}
+
+    //把等待中的高优先级消息插入到链表中：已经开始发送(交给iovec或者发送了一部分)的分片之后第一个消息的边界
+    //在提取数据之前调用，这时没有请求在内核中，没有写完的请求要先rewind才能被高优先级的消息插队
+    void placeHigh()
+    {
+        if(!high_head_) return;
+        TxFragment* prev = placed_high_;
+        TxFragment* next = prev?prev->next_:head_;
+        while(next&&(next->queued_>0||next->written_>0||(prev&&!prev->msg_end_)))
+        {
+            prev = next;
+            next = next->next_;
+        }
+
+        high_tail_->next_ = next;
+        if(prev) prev->next_ = high_head_;
+        else head_ = high_head_;
+        if(!next) tail_ = high_tail_;
+        //插入的位置之前的数据都已经交给了iovec，下一次从高优先级的消息开始提取
+        if(curr_==next) curr_ = high_head_;
+        placed_high_ = high_tail_;
+        high_head_ = high_tail_ = nullptr;
+    }
 
+    //把chunk中新写入的len个字节作为固定缓冲区的分片追加到尾部，chunk的所有权转移给分片
+    void appendFixed(ChunkPoolManagerOutput* fixed_pool,Chunk* chunk,size_t len)
+    {
+        fixed_pool_ = fixed_pool;
+        auto fragment = push_back(len);
+        fragment->ptr_ = chunk->beginWrite();
+        fragment->chunk_ = chunk;
+        fragment->storage_ = TxFragment::Storage::Fixed;
+        chunk->tail_ += len;
+    }
+
+    //尾部是固定缓冲区的分片时返回这个分片，可以在它的chunk末尾继续写入
+    TxFragment* fixedTail()const
+    {
+        return tail_&&tail_->storage_==TxFragment::Storage::Fixed?tail_:nullptr;
+    }
+
+    //尾部固定缓冲区的分片的chunk中又写入了len个字节，和暂存块一样只在末尾追加，已经交给内核的数据不会被移动
+    void extendFixedTail(size_t len)
+    {
+        tail_->len_ += len;
+        tail_->chunk_->tail_ += len;
         total_len_ += len;
+        if(!curr_) curr_ = tail_;
+    }
+
+    //固定缓冲区的分片需要单独使用WRITE_FIXED发送，文件分片没有内存中的数据，都不能和其它分片一起放入iovec中
+    bool sendAlone(const TxFragment* fragment)const
+    {
+        return fragment->storage_==TxFragment::Storage::File
+            ||(fragment->storage_==TxFragment::Storage::Fixed&&fixed_pool_->isRegistered(fragment->chunk_));
     }
 
-    iovec getOneIovec()
+    //下一个要发送的分片是文件分片时返回这个分片
+    TxFragment* pendingFile()const
+    {
+        return curr_&&curr_->storage_==TxFragment::Storage::File?curr_:nullptr;
+    }
+
+    //下一个要发送的分片，没有时返回nullptr
+    TxFragment* pendingFragment()const {return curr_;}
+
+    //取出下一个分片中还没有交给iovec的数据，最多max_len个字节，分片中剩余的数据下一次继续取出
+    iovec getOneIovec(size_t max_len = SIZE_MAX)
     {
         if(!curr_) return iovec{};
         iovec ret{};
-        ret.iov_base = (void*)curr_->beginRead();
-        ret.iov_len =curr_->remainData();
-        curr_ = curr_->next_;
+        ret.iov_base = (void*)(curr_->ptr_+curr_->queued_);
+        ret.iov_len =std::min(curr_->len_-curr_->queued_,max_len);
+        curr_->queued_ += ret.iov_len;
+        if(curr_->queued_==curr_->len_) curr_ = curr_->next_;
         return ret;
     }
 
     //要求传入的iovecs为空，否则可能会重复发送
-    void getBatchFragment(std::vector<iovec>&iovecs,size_t max_count)
+    //固定缓冲区的分片不会放入批量的iovec中，需要单独取出
+    //max_bytes限制这一批数据的总大小，超过时最后一个分片只取出一部分
+    void getBatchFragment(std::vector<iovec>&iovecs,size_t max_count,size_t max_bytes = SIZE_MAX)
+    {
+        size_t i =0;
+        size_t bytes = 0;
+        while(i<max_count&&curr_&&!sendAlone(curr_)&&bytes<max_bytes)
+        {
+            iovecs.emplace_back(getOneIovec(max_bytes-bytes));
+            bytes += iovecs.back().iov_len;
+            i++;
+        }
+        iovecs.resize(i);
+    }
+
+    //取出iovec的同时记录对应的分片，用于零拷贝发送
+    void getBatchFragment(std::vector<iovec>&iovecs,size_t max_count,std::vector<TxFragment*>&fragments)
     {
         size_t i =0;
-        while(i<max_count&&curr_)
+        while(i<max_count&&curr_&&!sendAlone(curr_))
         {
+            fragments.push_back(curr_);
             iovecs.emplace_back(getOneIovec());
             i++;
         }
         iovecs.resize(i);
     }
 
+    //零拷贝发送提交之前调用，在对应的通知返回之前分片不会被释放
+    void pin(TxFragment* fragment){fragment->zc_refs_++;}
+
+    //零拷贝发送的通知返回之后调用，分片已经从链表中移除并且没有其它引用时释放
+    void unpin(TxFragment* fragment)
+    {
+        if(--fragment->zc_refs_==0&&fragment->detached_) releaseFragment(fragment);
+    }
+
+    //移除已经发送的len个字节，已经交给iovec但是还没有发送的数据要重新提取
     void retrieve(size_t len)
+    {
+        consume(len);
+        rewind();
+    }
+
+    //移除已经发送的len个字节，不影响已经交给iovec的数据，用于多个请求同时在内核中的情况
+    void consume(size_t len)
     {
         size_t written = 0;
         while(written<len&&head_)
@@ -158,10 +627,30 @@ public:
                 pop_front();
             }
         }
-        curr_ = head_;
         total_len_ -= written;
     }
 
+    //放弃已经交给iovec但是还没有发送的数据，下一次从头部重新提取
+    void rewind()
+    {
+        for(auto fragment=head_;fragment&&fragment->queued_>fragment->written_;fragment=fragment->next_)
+        {
+            fragment->queued_ = fragment->written_;
+        }
+        curr_ = head_;
+    }
+
+    //设置合并的阈值，为0表示关闭合并，阈值不会超过暂存块的大小
+    void setCoalesceThreshold(size_t threshold)
+    {
+        size_t block_size = pool_?pool_->blockSize():TxFragmentPool::kDefaultBlockSize;
+        coalesce_threshold_ = std::min(threshold,block_size);
+    }
+    size_t coalesceThreshold()const {return coalesce_threshold_;}
+
+    //链表中分片的数量
+    size_t sliceSize()const {return slice_size_;}
+
     bool isEmpty()const {return total_len_==0;}
 
     size_t getTotalLen()const {return total_len_;}
@@ -1,7 +1,182 @@
 #pragma once
 #include <iostream>
+#include <atomic>
 #include <coroutine>
+#include <exception>
+#include <utility>
+#include <type_traits>
 
+#include "FramePool.h"
+
+//Task可以直接co_await：被等待的Task在co_await时才开始执行，执行完毕之后通过对称转移(symmetric transfer)直接恢复等待它的协程
+//嵌套调用不经过loop，开启优化时也不会增加调用栈的深度(对称转移被编译成尾调用)；Task挂起在连接的awaiter上时，awaiter记录的是最内层的协程，恢复之后逐层返回
+//外层的协程持有内层的Task，销毁外层的协程时内层的协程一起销毁
+//被等待的Task中的异常在co_await处重新抛出，没有被等待的Task(比如连接的业务协程)仍然只打印异常信息
+//协程帧从当前线程所属loop的帧内存池中分配，没有loop的线程使用堆
+//协程记录创建时所在的loop，切换到线程池或者其它loop之后可以通过co_await resumeOnOwnLoop()回来(见IoUringLoop.h)
+//作为whenAll/whenAny的分支时，挂起在可以取消(kCancelOnDestroy)的awaiter上的时候记录所在的loop，分支只在这个loop中被取消(见TaskCombinators.hpp)
+//注意：gcc 12中协程的第一个co_await如果写在if/while的条件中，协程体不会被执行，先把结果保存到变量中再判断
+
+template <typename T>
+struct Task;
+
+class IoUringLoop;
+//当前线程所属的loop，没有loop的线程为nullptr，定义在IoUringLoop.cc中
+IoUringLoop* currentLoop();
+
+template <typename A>
+constexpr bool cancelOnDestroy()
+{
+    if constexpr(requires{A::kCancelOnDestroy;}) return A::kCancelOnDestroy;
+    else return false;
+}
+
+//await_transform返回的awaiter，按引用转发到co_await表达式中的awaiter
+//awaiter可以取消(kCancelOnDestroy)并且在whenAll/whenAny的分支中时，挂起时在cancel_loop_中记录挂起所在的loop，恢复时清空
+//awaiter的parkLoop()不是当前的loop时(比如在其它线程中通过切换链表挂起)记录为空，这时不能被取消
+template <typename Awaiter>
+struct CancellableAwaiter
+{
+    Awaiter& awaiter_;
+    std::atomic<IoUringLoop*>* cancel_loop_;    //为空时只转发
+
+    bool await_ready(){return awaiter_.await_ready();}
+
+    template <typename Promise>
+    decltype(auto) await_suspend(std::coroutine_handle<Promise>h)
+    {
+        if(cancel_loop_)
+        {
+            IoUringLoop* loop = currentLoop();
+            if constexpr(requires{awaiter_.parkLoop();})
+            {
+                if(awaiter_.parkLoop()!=loop) loop = nullptr;
+            }
+            cancel_loop_->store(loop,std::memory_order_release);
+        }
+        return awaiter_.await_suspend(h);
+    }
+
+    decltype(auto) await_resume()
+    {
+        if(cancel_loop_) cancel_loop_->store(nullptr,std::memory_order_relaxed);
+        return awaiter_.await_resume();
+    }
+};
+
+//协程的await_transform
+//awaitable是co_await表达式中的临时对象，生命周期覆盖整个挂起过程，所以可以按引用转发；
+//不能直接返回awaitable的引用，gcc 12会把不是纯右值的awaiter拷贝一份，whenAll等不能拷贝的awaiter无法编译
+template <typename A>
+decltype(auto) cancellableAwait(A& awaitable,std::atomic<IoUringLoop*>* cancel_loop)
+{
+    //Task等通过operator co_await得到新的awaiter，不需要包装
+    if constexpr(requires{awaitable.operator co_await();}) return (awaitable);
+    else return CancellableAwaiter<A>{awaitable,cancelOnDestroy<std::remove_cv_t<A>>()?cancel_loop:nullptr};
+}
+
+//和返回值类型无关的部分
+struct TaskPromiseBase
+{
+    std::coroutine_handle<>continuation_;   //等待这个Task的协程，为空表示没有被等待
+    std::exception_ptr exception_;          //被等待时抛出的异常，在co_await处重新抛出
+    IoUringLoop* home_loop_ = currentLoop(); //协程所属的loop，co_await resumeOnOwnLoop()回到这里；被等待时继承等待者的loop
+    std::atomic<IoUringLoop*>* cancel_loop_ = nullptr; //所在的whenAll/whenAny分支记录挂起所在loop的位置，被等待时继承等待者的，不是分支时为空
+
+    std::atomic<IoUringLoop*>* cancelLoopSlot(){return cancel_loop_;}
+
+    template <typename A>
+    decltype(auto) await_transform(A&& awaitable)
+    {
+        return cancellableAwait(awaitable,cancel_loop_);
+    }
+
+    static void* operator new(size_t size)
+    {
+        return FramePool::allocateFrame(size);
+    }
+
+    static void operator delete(void* ptr,size_t size)
+    {
+        FramePool::releaseFrame(ptr,size);
+    }
+
+    //执行完毕之后转移到等待的协程，没有被等待时停在这里，由Task销毁
+    struct FinalAwaiter
+    {
+        bool await_ready()noexcept {return false;}
+
+        template <typename Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise>h)noexcept
+        {
+            auto continuation = h.promise().continuation_;
+            return continuation?continuation:std::noop_coroutine();
+        }
+
+        void await_resume()noexcept {}
+    };
+
+    std::suspend_always initial_suspend()
+    {
+        return {};
+    }
+
+    FinalAwaiter final_suspend()noexcept
+    {
+        return {};
+    }
+
+    void unhandled_exception()
+    {
+        if(continuation_)
+        {
+            exception_ = std::current_exception();
+            return;
+        }
+        try
+        {
+            std::rethrow_exception(std::current_exception());
+        }
+        catch(const std::exception& e)
+        {
+            std::cerr << e.what() << '\n';
+        }
+    }
+
+    void rethrowIfException()
+    {
+        if(exception_) std::rethrow_exception(std::exchange(exception_,nullptr));
+    }
+};
+
+//co_await一个Task：记录等待的协程，然后直接转移到被等待的协程开始执行
+template <typename Promise>
+struct TaskAwaiter
+{
+    std::coroutine_handle<Promise>handle_;
+
+    bool await_ready()
+    {
+        return handle_.done();
+    }
+
+    template <typename CallerPromise>
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<CallerPromise>caller)
+    {
+        //在线程池等其它线程中创建的子协程仍然属于等待者的loop
+        if constexpr (std::is_base_of_v<TaskPromiseBase,CallerPromise>)
+        {
+            if(auto home = caller.promise().home_loop_) handle_.promise().home_loop_ = home;
+        }
+        //在whenAll/whenAny的分支中被等待时，最内层的awaiter挂起时记录到分支中
+        if constexpr (requires{caller.promise().cancelLoopSlot();})
+        {
+            handle_.promise().cancel_loop_ = caller.promise().cancelLoopSlot();
+        }
+        handle_.promise().continuation_ = caller;
+        return handle_;
+    }
+};
 
 template <typename T=void>
 struct Task
@@ -9,7 +184,6 @@ struct Task
     struct promise_type;
     std::coroutine_handle<promise_type>handle_;
 
-
     Task(std::coroutine_handle<promise_type>handle)
         :handle_(handle)
     {}
@@ -30,7 +204,7 @@ struct Task
     // 禁用复制
     Task(const Task&) = delete;
     Task& operator=(const Task&) = delete;
-    
+
     //BUG FIX 如果不自定义移动构造函数，原有的临时对象的handle_可能不会置为nullptr，从而导致协程直接销毁
     // 允许移动
     Task(Task&&other)
@@ -40,8 +214,12 @@ struct Task
     }
     Task& operator=(Task&&other)
     {
-        this->handle_ = other.handle_;
-        other.handle_ = nullptr;
+        if(this!=&other)
+        {
+            destroy();
+            this->handle_ = other.handle_;
+            other.handle_ = nullptr;
+        }
         return *this;
     }
 
@@ -50,7 +228,9 @@ struct Task
         handle_.resume();
     }
 
-    struct promise_type
+    bool done()const {return !handle_||handle_.done();}
+
+    struct promise_type:TaskPromiseBase
     {
         T curr_value;
         T ret_value;
@@ -59,19 +239,10 @@ struct Task
             return Task<T>{std::coroutine_handle<promise_type>::from_promise(*this)};
         }
 
-        std::suspend_always initial_suspend()
-        {
-            return {};
-        }
-
-        std::suspend_always final_suspend()noexcept
+        template <typename U = T>
+        void return_value(U&&value)
         {
-            return {};
-        }
-
-        void return_value(T&&value)
-        {
-            ret_value = std::forward<T>(value);
+            ret_value = std::forward<U>(value);
         }
 
         std::suspend_always yield_value(T&&value)
@@ -79,22 +250,24 @@ struct Task
             curr_value =std::forward<T>(value);
             return {};
         }
+    };
 
-        void unhandled_exception()
+    //co_await的结果是返回值，被等待的协程抛出的异常在这里重新抛出
+    struct Awaiter:TaskAwaiter<promise_type>
+    {
+        T await_resume()
         {
-            try
-            {
-                std::rethrow_exception(std::current_exception());
-            }
-            catch(const std::exception& e)
-            {
-                std::cerr << e.what() << '\n';
-            }
-            
+            auto& promise = this->handle_.promise();
+            promise.rethrowIfException();
+            return std::move(promise.ret_value);
         }
-        
     };
 
+    Awaiter operator co_await()
+    {
+        return Awaiter{{handle_}};
+    }
+
     //定义获取变量的方法
     T currentValue(){return handle_.promise().curr_value;}
     T returnValue(){return handle_.promise().ret_value;}
@@ -107,7 +280,6 @@ struct Task<void>
     struct promise_type;
     std::coroutine_handle<promise_type>handle_;
 
-
     Task(std::coroutine_handle<promise_type>handle)
         :handle_(handle)
     {}
@@ -118,7 +290,7 @@ struct Task<void>
     // 禁用复制
     Task(const Task&) = delete;
     Task& operator=(const Task&) = delete;
-    
+
     // 允许移动
     Task(Task&&other)
         :handle_(other.handle_)
@@ -127,8 +299,12 @@ struct Task<void>
     }
     Task& operator=(Task&&other)
     {
-        this->handle_ = other.handle_;
-        other.handle_ = nullptr;
+        if(this!=&other)
+        {
+            destroy();
+            this->handle_ = other.handle_;
+            other.handle_ = nullptr;
+        }
         return *this;
     }
 
@@ -145,40 +321,29 @@ struct Task<void>
     {
         handle_.resume();
     }
-    
-    struct promise_type
+
+    bool done()const {return !handle_||handle_.done();}
+
+    struct promise_type:TaskPromiseBase
     {
         Task<void> get_return_object()
         {
             return Task<void>{std::coroutine_handle<promise_type>::from_promise(*this)};
         }
 
-        std::suspend_always initial_suspend()
-        {
-            return {};
-        }
-
-        std::suspend_always final_suspend()noexcept
-        {
-            return {};
-        }
-
-        void return_value(){}
-
+        void return_void(){}
+    };
 
-        void unhandled_exception()
+    struct Awaiter:TaskAwaiter<promise_type>
+    {
+        void await_resume()
         {
-            try
-            {
-                std::rethrow_exception(std::current_exception());
-            }
-            catch(const std::exception& e)
-            {
-                std::cerr << e.what() << '\n';
-            }
-            
+            this->handle_.promise().rethrowIfException();
         }
-        
     };
 
-};
\ No newline at end of file
+    Awaiter operator co_await()
+    {
+        return Awaiter{{handle_}};
+    }
+};
@@ -0,0 +1,447 @@
+#pragma once
+#include <atomic>
+#include <array>
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "FramePool.h"
+#include "Task.hpp"
+
+//whenAll/whenAny：同时等待多个Task或者awaiter(例如PrepareToRead、send、switchThread返回的awaiter)
+//每个awaitable被移动到一个分支协程中执行，分支协程的帧从帧内存池中分配；计数、分支的句柄等状态保存在被co_await的awaiter中，也就是在等待的协程的帧中
+//所有分支在co_await时按照参数的顺序开始执行，同一个连接上的多次send按照参数的顺序追加
+//whenAll在所有分支完成之后恢复等待的协程，返回每个分支的结果，void的结果为std::monostate；有分支抛出异常时重新抛出第一个分支的异常
+//whenAny在第一个分支完成之后取消其它的分支，然后恢复等待的协程，返回std::variant，index()是完成的分支
+//取消：还没有开始的分支直接销毁；已经开始的分支是否可以销毁在取消时决定：
+//分支(包括分支中逐层等待的Task)当前挂起在可以取消(kCancelOnDestroy)的awaiter上，并且挂起所在的loop就是执行取消的loop时直接销毁，awaiter在析构时撤销在连接上的等待；
+//其它的分支(例如挂起在switchThread、recvInto上，或者正在其它线程中执行)被分离，继续执行到结束，由分支自己销毁，结果被丢弃
+//等待的协程在挂起时被销毁(比如连接关闭时销毁业务协程)，按照同样的规则销毁或者分离还没有结束的分支
+//注意：
+//1. 等待的协程在最后一个完成的分支所在的线程中恢复
+//2. 被分离的分支会继续访问分支中保存的数据，不要在分支中引用等待的协程中的局部变量
+//3. 同一个连接上同时只能有一个分支在等待读取，也只能有一个分支因为高水位线等待发送
+
+struct WhenState;
+
+//分支协程的promise中和结果类型无关的部分
+struct WhenBranchPromiseBase
+{
+    std::atomic<WhenState*>state_;      //所属的状态，被分离之后为空
+    size_t index_;                      //分支的序号
+    std::atomic<IoUringLoop*>cancel_loop_;  //挂起在可以取消的awaiter上时所在的loop，否则为空
+    std::exception_ptr exception_;
+
+    WhenBranchPromiseBase()
+        :state_(nullptr)
+        ,index_(0)
+        ,cancel_loop_(nullptr)
+    {}
+
+    std::atomic<IoUringLoop*>* cancelLoopSlot(){return &cancel_loop_;}
+
+    template <typename A>
+    decltype(auto) await_transform(A&& awaitable)
+    {
+        return cancellableAwait(awaitable,&cancel_loop_);
+    }
+
+    //挂起在可以取消的awaiter上，并且就挂起在当前的loop中，销毁时不会和恢复同时进行
+    bool cancellableHere()const
+    {
+        IoUringLoop* loop = cancel_loop_.load(std::memory_order_acquire);
+        return loop&&loop==currentLoop();
+    }
+
+    static void* operator new(size_t size)
+    {
+        return FramePool::allocateFrame(size);
+    }
+
+    static void operator delete(void* ptr,size_t size)
+    {
+        FramePool::releaseFrame(ptr,size);
+    }
+
+    //执行完毕之后通知所属的状态，被分离时自己销毁
+    struct FinalAwaiter
+    {
+        bool await_ready()noexcept {return false;}
+
+        template <typename Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise>h)noexcept;
+
+        void await_resume()noexcept {}
+    };
+
+    std::suspend_always initial_suspend()
+    {
+        return {};
+    }
+
+    FinalAwaiter final_suspend()noexcept
+    {
+        return {};
+    }
+
+    void unhandled_exception()
+    {
+        exception_ = std::current_exception();
+    }
+};
+
+template <typename T>
+struct WhenBranch
+{
+    struct promise_type:WhenBranchPromiseBase
+    {
+        std::optional<T> value_;
+
+        WhenBranch get_return_object()
+        {
+            return WhenBranch{std::coroutine_handle<promise_type>::from_promise(*this)};
+        }
+
+        template <typename U>
+        void return_value(U&&value)
+        {
+            value_.emplace(std::forward<U>(value));
+        }
+    };
+
+    std::coroutine_handle<promise_type>handle_;
+};
+
+//一个分支在状态中的记录，只由开始分支的线程和完成的分支依次访问
+struct WhenSlot
+{
+    std::coroutine_handle<>handle_;     //分支的句柄，销毁或者分离之后为空
+    WhenBranchPromiseBase* promise_;
+    bool started_;
+};
+
+struct WhenState
+{
+    static constexpr size_t kNoWinner = size_t(-1);
+
+    std::atomic<size_t>pending_;        //还没有结束的分支数量，加上开始分支时持有的一个
+    std::atomic<size_t>winner_;         //whenAny中第一个完成的分支
+    std::atomic<int>cancel_gate_;       //whenAny中开始分支和有分支完成这两件事都发生之后才取消其它的分支，避免和开始分支同时进行
+    std::coroutine_handle<>continuation_;
+    WhenSlot* slots_;
+    size_t count_;
+    bool any_;
+
+    WhenState(size_t count,bool any)
+        :pending_(count+1)
+        ,winner_(kNoWinner)
+        ,cancel_gate_(2)
+        ,continuation_(nullptr)
+        ,slots_(nullptr)
+        ,count_(count)
+        ,any_(any)
+    {}
+
+    //销毁已经完成的分支，等待的协程被销毁时(比如连接关闭)和取消时一样销毁或者分离还没有结束的分支
+    ~WhenState()
+    {
+        for(size_t i=0;i<count_&&slots_;++i)
+        {
+            auto& slot = slots_[i];
+            if(!slot.handle_) continue;
+            //为空说明分支已经执行完毕，停在final_suspend中
+            if(slot.started_&&slot.promise_->state_.exchange(nullptr,std::memory_order_acq_rel))
+            {
+                //不能取消的分支被分离，执行完毕之后自己销毁
+                if(!slot.promise_->cancellableHere()) continue;
+            }
+            slot.handle_.destroy();
+        }
+    }
+
+    //按顺序开始所有的分支，返回false表示所有的分支都已经结束，不需要挂起
+    bool start(std::coroutine_handle<>continuation)
+    {
+        continuation_ = continuation;
+        for(size_t i=0;i<count_;++i)
+        {
+            //whenAny中已经有分支完成时不再开始剩下的分支，之后直接销毁
+            if(any_&&winner_.load(std::memory_order_acquire)!=kNoWinner) break;
+            slots_[i].started_ = true;
+            slots_[i].handle_.resume();
+        }
+        if(any_) passCancelGate();
+        return pending_.fetch_sub(1,std::memory_order_acq_rel)!=1;
+    }
+
+    //分支执行完毕，返回下一个要执行的协程
+    std::coroutine_handle<> branchDone(size_t index)
+    {
+        if(any_)
+        {
+            size_t none = kNoWinner;
+            if(winner_.compare_exchange_strong(none,index,std::memory_order_acq_rel)) passCancelGate();
+        }
+        return settle();
+    }
+
+    std::coroutine_handle<> settle()
+    {
+        if(pending_.fetch_sub(1,std::memory_order_acq_rel)==1) return continuation_;
+        return std::noop_coroutine();
+    }
+
+    void passCancelGate()
+    {
+        if(cancel_gate_.fetch_sub(1,std::memory_order_acq_rel)==1) cancelLosers();
+    }
+
+    //取消除了完成的分支之外的所有分支，执行的线程持有一个计数，所以这里不会恢复等待的协程
+    void cancelLosers()
+    {
+        size_t winner = winner_.load(std::memory_order_acquire);
+        for(size_t i=0;i<count_;++i)
+        {
+            auto& slot = slots_[i];
+            if(i==winner||!slot.handle_) continue;
+            if(slot.started_)
+            {
+                //为空说明这个分支已经执行完毕，由它自己减少计数
+                if(!slot.promise_->state_.exchange(nullptr,std::memory_order_acq_rel)) continue;
+                //不能取消的分支被分离，执行完毕之后自己销毁
+                if(slot.promise_->cancellableHere()) slot.handle_.destroy();
+            }
+            else
+            {
+                slot.handle_.destroy();
+            }
+            slot.handle_ = nullptr;
+            pending_.fetch_sub(1,std::memory_order_acq_rel);
+        }
+    }
+};
+
+template <typename Promise>
+std::coroutine_handle<> WhenBranchPromiseBase::FinalAwaiter::await_suspend(std::coroutine_handle<Promise>h)noexcept
+{
+    auto& promise = h.promise();
+    WhenState* state = promise.state_.exchange(nullptr,std::memory_order_acq_rel);
+    if(!state)
+    {
+        h.destroy();
+        return std::noop_coroutine();
+    }
+    return state->branchDone(promise.index_);
+}
+
+//awaitable的co_await结果类型，Task通过operator co_await得到awaiter
+template <typename A>
+decltype(auto) whenGetAwaiter(A& awaitable)
+{
+    if constexpr(requires{awaitable.operator co_await();}) return awaitable.operator co_await();
+    else return (awaitable);
+}
+
+template <typename A>
+using WhenAwaitResult = decltype(whenGetAwaiter(std::declval<A&>()).await_resume());
+
+template <typename A>
+using WhenValue = std::conditional_t<std::is_void_v<WhenAwaitResult<A>>,std::monostate,std::decay_t<WhenAwaitResult<A>>>;
+
+template <typename A>
+WhenBranch<WhenValue<A>> whenBranch(A awaitable)
+{
+    if constexpr(std::is_void_v<WhenAwaitResult<A>>)
+    {
+        co_await awaitable;
+        co_return std::monostate{};
+    }
+    else
+    {
+        co_return co_await awaitable;
+    }
+}
+
+//创建分支，分支在co_await时才开始执行
+template <typename A>
+WhenSlot makeWhenSlot(A&& awaitable,WhenState& state,size_t index)
+{
+    using Awaitable = std::decay_t<A>;
+    auto handle = whenBranch<Awaitable>(std::forward<A>(awaitable)).handle_;
+    auto& promise = handle.promise();
+    promise.state_.store(&state,std::memory_order_relaxed);
+    promise.index_ = index;
+    return WhenSlot{handle,&promise,false};
+}
+
+template <typename A>
+auto& whenBranchPromise(const WhenSlot& slot)
+{
+    using Promise = typename WhenBranch<WhenValue<A>>::promise_type;
+    return std::coroutine_handle<Promise>::from_address(slot.handle_.address()).promise();
+}
+
+//whenAll和whenAny共用的部分：保存awaitable和分支
+template <bool Any,typename... As>
+class WhenTupleAwaiter
+{
+protected:
+    std::tuple<As...>awaitables_;
+    std::array<WhenSlot,sizeof...(As)>slots_;
+    WhenState state_;
+
+    template <size_t... I>
+    void createBranches(std::index_sequence<I...>)
+    {
+        ((slots_[I] = makeWhenSlot(std::move(std::get<I>(awaitables_)),state_,I)),...);
+    }
+
+    template <size_t I>
+    auto& value()
+    {
+        using A = std::tuple_element_t<I,std::tuple<As...>>;
+        return *whenBranchPromise<A>(slots_[I]).value_;
+    }
+
+public:
+    template <typename... Args>
+    explicit WhenTupleAwaiter(Args&&... args)
+        :awaitables_(std::forward<Args>(args)...)
+        ,slots_{}
+        ,state_(sizeof...(As),Any)
+    {}
+
+    WhenTupleAwaiter(const WhenTupleAwaiter&) = delete;
+    WhenTupleAwaiter& operator=(const WhenTupleAwaiter&) = delete;
+
+    bool await_ready()
+    {
+        return sizeof...(As)==0;
+    }
+
+    bool await_suspend(std::coroutine_handle<>h)
+    {
+        createBranches(std::index_sequence_for<As...>{});
+        state_.slots_ = slots_.data();
+        return state_.start(h);
+    }
+};
+
+template <typename... As>
+class WhenAllAwaiter:public WhenTupleAwaiter<false,As...>
+{
+private:
+    template <size_t... I>
+    std::tuple<WhenValue<As>...> collect(std::index_sequence<I...>)
+    {
+        return std::tuple<WhenValue<As>...>(std::move(this->template value<I>())...);
+    }
+public:
+    using WhenTupleAwaiter<false,As...>::WhenTupleAwaiter;
+
+    std::tuple<WhenValue<As>...> await_resume()
+    {
+        for(auto& slot:this->slots_)
+        {
+            if(slot.promise_->exception_) std::rethrow_exception(slot.promise_->exception_);
+        }
+        return collect(std::index_sequence_for<As...>{});
+    }
+};
+
+template <typename... As>
+class WhenAnyAwaiter:public WhenTupleAwaiter<true,As...>
+{
+private:
+    template <size_t... I>
+    std::variant<WhenValue<As>...> collect(size_t winner,std::index_sequence<I...>)
+    {
+        std::optional<std::variant<WhenValue<As>...>> result;
+        ((I==winner?(void)result.emplace(std::in_place_index<I>,std::move(this->template value<I>())):void()),...);
+        return std::move(*result);
+    }
+public:
+    using WhenTupleAwaiter<true,As...>::WhenTupleAwaiter;
+
+    std::variant<WhenValue<As>...> await_resume()
+    {
+        size_t winner = this->state_.winner_.load(std::memory_order_acquire);
+        if(auto exception = this->slots_[winner].promise_->exception_) std::rethrow_exception(exception);
+        return collect(winner,std::index_sequence_for<As...>{});
+    }
+};
+
+//数量在运行时确定的whenAll，例如向多个连接发送同一份数据
+template <typename A>
+class WhenAllRangeAwaiter
+{
+private:
+    std::vector<A>awaitables_;
+    std::vector<WhenSlot>slots_;
+    WhenState state_;
+public:
+    explicit WhenAllRangeAwaiter(std::vector<A> awaitables)
+        :awaitables_(std::move(awaitables))
+        ,state_(awaitables_.size(),false)
+    {}
+
+    WhenAllRangeAwaiter(const WhenAllRangeAwaiter&) = delete;
+    WhenAllRangeAwaiter& operator=(const WhenAllRangeAwaiter&) = delete;
+
+    bool await_ready()
+    {
+        return awaitables_.empty();
+    }
+
+    bool await_suspend(std::coroutine_handle<>h)
+    {
+        slots_.reserve(awaitables_.size());
+        for(size_t i=0;i<awaitables_.size();++i)
+        {
+            slots_.push_back(makeWhenSlot(std::move(awaitables_[i]),state_,i));
+        }
+        state_.slots_ = slots_.data();
+        return state_.start(h);
+    }
+
+    std::vector<WhenValue<A>> await_resume()
+    {
+        std::vector<WhenValue<A>> results;
+        results.reserve(slots_.size());
+        for(auto& slot:slots_)
+        {
+            if(slot.promise_->exception_) std::rethrow_exception(slot.promise_->exception_);
+        }
+        for(auto& slot:slots_)
+        {
+            results.push_back(std::move(*whenBranchPromise<A>(slot).value_));
+        }
+        return results;
+    }
+};
+
+//同时等待所有的awaitable，awaitable按值保存，左值会被拷贝(Task只能移动)
+template <typename... As>
+WhenAllAwaiter<std::decay_t<As>...> whenAll(As&&... awaitables)
+{
+    return WhenAllAwaiter<std::decay_t<As>...>(std::forward<As>(awaitables)...);
+}
+
+template <typename A>
+WhenAllRangeAwaiter<A> whenAll(std::vector<A> awaitables)
+{
+    return WhenAllRangeAwaiter<A>(std::move(awaitables));
+}
+
+//等待第一个完成的awaitable，取消其它的awaitable
+template <typename... As>
+WhenAnyAwaiter<std::decay_t<As>...> whenAny(As&&... awaitables)
+{
+    static_assert(sizeof...(As)>0,"whenAny needs at least one awaitable");
+    return WhenAnyAwaiter<std::decay_t<As>...>(std::forward<As>(awaitables)...);
+}
@@ -3,21 +3,46 @@
 #include <memory>
 #include <coroutine>
 #include <vector>
+#include <span>
+#include <algorithm>
+#include <string>
+#include <string_view>
+#include <concepts>
+#include <sys/uio.h>
 
 #include "IoContext.h"
 #include "Task.hpp"
+#include "AsyncGenerator.hpp"
 #include "noncopyable.h"
 #include "Socket.h"
 #include "ReadContext.h"
 #include "WriteContext.h"
+#include "ChainReader.h"
+#include "DirectReadContext.h"
 #include "Callbacks.h"
 #include "InetAddress.h"
+#include "Payload.hpp"
+#include "LoopHop.h"
 
 
 class IoUringLoop;
+class TcpServer;
 
 class RecvDataAwaiter;
+class SendAwaiterBase;
+template <typename Data>
 class SendDataAwaiter;
+class RecvFrameAwaiter;
+class RecvFramesAwaiter;
+class RecvIntoAwaiter;
+class CommitAwaiter;
+
+//有连续的char数据的缓冲区，例如std::string和std::vector<char>
+template <typename Buffer>
+concept ContiguousBuffer = requires(const Buffer& buf){
+    {buf.data()}->std::convertible_to<const char*>;
+    {buf.size()}->std::convertible_to<size_t>;
+};
 
 class TcpConnection:noncopyable , public std::enable_shared_from_this<TcpConnection>
 {
@@ -25,7 +50,15 @@ private:
     friend WriteContext;
     friend ReadContext;
     friend RecvDataAwaiter;
-    friend SendDataAwaiter;
+    friend SendAwaiterBase;
+    template <typename Data>
+    friend class SendDataAwaiter;
+    friend RecvFrameAwaiter;
+    friend RecvFramesAwaiter;
+    friend RecvIntoAwaiter;
+    friend CommitAwaiter;
+    friend DirectReadContext;
+    friend TcpServer;
 
     const std::string name_;    //这个连接的名字
 
@@ -43,16 +76,29 @@ private:
 
     ReadContext read_context_;
     WriteContext write_context_;
+    DirectReadContext direct_read_context_;
+
+    FrameDecoder frame_decoder_;    //长度前缀帧的解码器
+
+    //将已经交给用户的帧从输入缓冲区中移除
+    void releaseFrames(){frame_decoder_.release(read_context_.input_buffer_);}
 
     //处理连接关闭的清理操作
     void handleClose(); 
 
-    void sendInLoop(std::string data);
+    //追加共享的数据，只增加引用计数，用于广播；不检查高水位线
+    void sendInLoop(const Payload& payload);
+    //如果当前没有正在进行的发送，就开始发送输出缓冲区中的数据
+    void startSending();
 
     void submitWrite(WriteContext* w_ctx);
     void submitRead(ReadContext* r_ctx);
     //向内核提交取消read sqe的请求，因为read sqe 时multishut，不主动取消不会停止
     void submitCancel(ReadContext* r_ctx);
+    void submitDirectRead(DirectReadContext* d_ctx);
+    void submitZeroCopySend(ZeroCopySendContext* zc_ctx);
+    //提交文件分片的发送请求
+    void submitFileSend(FileSendContext* file_ctx);
 
 public:
     TcpConnection(
@@ -68,18 +114,86 @@ public:
     
     ~TcpConnection();
 
-    //发送数据
-    SendDataAwaiter send(std::string data);
+    //每次send的数据是一条消息，Priority::High的消息在还没有开始发送的普通消息之前发送，但是不会打断正在发送的消息
+    //例如在大量流式数据之后发送心跳或者延迟敏感的请求，高优先级的数据同样计入高水位线
+
+    //发送数据，数据的所有权转移到发送队列中
+    SendDataAwaiter<std::string> send(std::string data,Priority priority = Priority::Normal);
+    SendDataAwaiter<std::vector<char>> send(std::vector<char> data,Priority priority = Priority::Normal);
+    //发送共享的不可变数据，只增加引用计数
+    SendDataAwaiter<Payload> send(Payload payload,Priority priority = Priority::Normal);
+    //发送调用者持有的数据，guard在数据发送完成之前保证数据有效，不拷贝；guard为空时在追加到发送队列时拷贝
+    SendDataAwaiter<GuardedView> send(std::string_view data,std::shared_ptr<const void> guard,Priority priority = Priority::Normal);
+    //按顺序发送多段数据，例如头部和数据体，不需要拼接；数据的生命周期和string_view的版本相同，iovec数组只需要在co_await期间有效
+    SendDataAwaiter<GuardedIovecs> send(std::span<const iovec> iovecs,std::shared_ptr<const void> guard = nullptr,Priority priority = Priority::Normal);
+    //发送智能指针持有的连续内存，例如std::shared_ptr<const std::string>，智能指针就是guard
+    template <ContiguousBuffer Buffer>
+    SendDataAwaiter<GuardedView> send(std::shared_ptr<Buffer> buffer,Priority priority = Priority::Normal);
+    //发送文件中[offset,offset+len)的数据，默认使用splice经过管道发送，数据不经过用户态
+    //和其它的send按照调用的顺序发送，fd在发送完成之前要保持打开，可以由guard保活(比如持有关闭fd的对象)
+    //文件中的数据也计入高水位线，len很大时协程会挂起直到大部分数据发送出去
+    SendDataAwaiter<FileRange> sendFile(int fd,off_t offset,size_t len,std::shared_ptr<const void> guard = nullptr);
+
+    //在注册过的输出内存中预留至少n个字节，直接在其中序列化要发送的数据，然后调用commit提交，返回的空间可能大于n
+    //只能在loop线程中调用，reserve和commit之间不能挂起协程，也不能调用send
+    //n大于输出内存块的大小或者连接已经关闭时返回空，内存池耗尽时使用临时分配的内存，按照普通的方式发送
+    std::span<char> reserve(size_t n);
+    //发送预留的内存中前n个字节，和send一样在超过高水位线时挂起，返回false表示连接出错
+    CommitAwaiter commit(size_t n);
 
 
     //准备读取数据
     RecvDataAwaiter PrepareToRead();
+    //准备读取数据，缓冲区中至少有min_len个字节时才唤醒协程，用于接收已经知道长度的完整消息
+    //min_len不能超过输入buffer ring容量的一半，否则直接返回-1，更长的消息应该使用recvInto接收
+    RecvDataAwaiter PrepareToRead(size_t min_len);
     //读取数据
     std::string read(size_t size);
     //只查看数据
     std::pair<char *,size_t>peek();
     //手动偏移数据
     void retrieve(size_t size);
+
+    //读取一个u32长度前缀的帧，只有在帧完整时才会唤醒协程，返回无效帧表示连接关闭或者协议错误
+    RecvFrameAwaiter readFrame();
+    //一次读取最多batch个完整的帧，至少返回一个，返回空表示连接关闭或者协议错误
+    RecvFramesAwaiter readFrames(size_t batch);
+    //逐个产生完整的帧的生成器，只有在被拉取时才读取下一帧，帧在下一次拉取之前有效，连接关闭或者协议错误时结束
+    //消费者处理得慢时数据留在输入缓冲区中，超过高水位线之后停止接收，由TCP的流量控制把压力传给对端
+    AsyncGenerator<Frame> frames();
+    //开启或关闭Nagle算法
+    void setTcpNoDelay(bool on){sock_.setTcpNoDelay(on);}
+    //设置零拷贝发送的阈值，一次发送中有不小于这个大小的分片时使用SENDMSG_ZC发送，为0表示关闭(默认)
+    //零拷贝要等到内核的通知返回之后才能释放数据，只有大块数据并且网卡支持时才划算，回环网卡上内核仍然会拷贝
+    //需要在loop线程中或者连接开始发送数据之前调用
+    void setZeroCopyThreshold(size_t threshold){write_context_.zero_copy_threshold_ = threshold;}
+    //设置小数据合并的阈值，不超过这个大小的数据会被拷贝到暂存块中合并发送，为0表示关闭合并
+    //需要在loop线程中或者连接开始发送数据之前调用
+    void setWriteCoalesceThreshold(size_t threshold){write_context_.output_buffer_.setCoalesceThreshold(threshold);}
+    //开启低延迟发送，每次send/commit都立即提交发送请求；默认关闭，同一次循环中的多次发送在循环末尾合并成一次提交
+    //例如先发送头部再发送数据体时，默认只需要一个writev，低延迟模式下需要两个
+    void setLowLatencySend(bool on){write_context_.low_latency_ = on;}
+    //关闭时文件分片先读入注册过的输出内存再发送，默认开启splice，文件不支持splice时会自动关闭
+    //需要在loop线程中或者连接开始发送文件之前调用
+    void setFileSplice(bool on){write_context_.file_splice_ = on;}
+    //设置同时在内核中的发送请求的最大数量(默认为1)，多个请求使用IOSQE_IO_LINK按顺序链接，前一个请求写完之后内核直接开始下一个，不需要等待cqe返回
+    //适合输出缓冲区中经常积压大量数据的连接，数量会被限制在[1,WriteContext::kMaxInflightLimit]中
+    //需要在loop线程中或者连接开始发送数据之前调用
+    void setMaxInflightWrites(size_t n){write_context_.max_inflight_ = std::clamp<size_t>(n,1,WriteContext::kMaxInflightLimit);}
+    //设置允许的最大帧长度，会被限制在输入buffer ring容量的一半(包含头部)以内，更长的帧视为协议错误
+    void setMaxFrameLength(size_t len);
+
+    //把接下来的len个字节直接接收到buf中，缓冲区中已有的数据先拷贝，剩余部分停止multishot之后由内核直接写入buf
+    //适用于已经知道长度的大消息，返回接收的长度，出错或者连接关闭返回-1
+    //之后的 PrepareToRead/readFrame 会重新开启multishot
+    RecvIntoAwaiter recvInto(char* buf,size_t len);
+
+    //把输入缓冲区中前len个字节所在的chunk取出交给租约，可以转移到线程池中零拷贝地处理
+    //租约可以在任意线程中释放，chunk会通过loop的任务队列批量归还
+    ChunkLease lease(size_t len);
+
+    //在输入缓冲区上创建一个读取游标，可以不拷贝地解析二进制数据，解析完成后调用commit移除数据
+    ChainReader reader();
     
 
     std::shared_ptr<TcpConnection>getSharedPtr(){return shared_from_this();}
@@ -102,7 +216,8 @@ public:
 };
 
 
-class RecvDataAwaiter
+//在其它线程中等待时awaiter本身作为节点加入loop的切换链表(见LoopHop)，不需要分配内存
+class RecvDataAwaiter:private LoopHop
 {
 private:
     /* 
@@ -110,11 +225,27 @@ private:
     TcpConnection就不会销毁，因为Awaiter中的指针是有效的 
     */
     TcpConnection* conn_;  
+    size_t min_len_;        //唤醒协程需要的最少字节数
+    std::coroutine_handle<>parked_;     //挂起时交给连接的句柄，恢复之后为空
+
+    //在loop线程中调用，数据不够时挂起协程并提交读任务
+    void suspendInLoop(std::coroutine_handle<>h);
+    //从切换链表中取出之后在loop线程中调用
+    static void runHop(LoopHop* hop);
+    //等待的字节数超过了连接允许缓冲的上限，永远无法满足
+    bool tooLong()const {return min_len_>conn_->read_context_.max_wait_len_;}
 public:
-    RecvDataAwaiter(TcpConnection* conn)
+    //挂起时被销毁会撤销在连接上的等待，可以在whenAny中取消
+    static constexpr bool kCancelOnDestroy = true;
+    //挂起所在的loop，只有在这个loop中等待时才能被取消
+    IoUringLoop* parkLoop()const {return conn_->getLoop();}
+
+    RecvDataAwaiter(TcpConnection* conn,size_t min_len=1)
         :conn_(conn)
+        ,min_len_(min_len)
+        ,parked_(nullptr)
     {}
-    ~RecvDataAwaiter()= default;
+    ~RecvDataAwaiter();
     bool await_ready();
 
     void await_suspend(std::coroutine_handle<>h);
@@ -122,17 +253,191 @@ public:
     int await_resume();
 };
 
-class SendDataAwaiter
+//发送数据的awaiter中和数据类型无关的部分
+//在其它线程中发送时awaiter本身作为节点加入loop的切换链表(见LoopHop)，不需要分配内存
+class SendAwaiterBase:protected LoopHop
 {
-private:
+protected:
     TcpConnection* conn_;
-    std::string data_;
+    Priority priority_;
+    std::coroutine_handle<>parked_;     //因为高水位线挂起时交给连接的句柄，恢复之后为空
+
+    bool inLoopThread()const;
+    //把awaiter加入loop的切换链表，在loop线程中取出之后调用run
+    void queueHop(std::coroutine_handle<>h,void (*run)(LoopHop*));
+    //在loop线程中调用，数据追加之后开始发送，并判断是否可以直接返回
+    bool readyInLoop();
+    //在loop线程中调用，超过高水位线时挂起协程
+    void suspendInLoop(std::coroutine_handle<>h);
+    //在loop线程中调用，可以返回时放入就绪队列，否则挂起
+    void resumeOrSuspendInLoop(bool ready);
 public:
-    SendDataAwaiter(TcpConnection* conn,std::string data)
+    //挂起时被销毁会撤销在连接上的等待，已经追加的数据仍然会发送
+    static constexpr bool kCancelOnDestroy = true;
+    IoUringLoop* parkLoop()const {return conn_->getLoop();}
+
+    SendAwaiterBase(TcpConnection* conn,Priority priority)
         :conn_(conn)
+        ,priority_(priority)
+        ,parked_(nullptr)
+    {}
+    ~SendAwaiterBase();
+
+    //返回输出缓冲区是否出错，正确为true，错误为false
+    bool await_resume();
+};
+
+//Data是可以追加到SendQueue中的数据，在loop线程中追加
+template <typename Data>
+class SendDataAwaiter:public SendAwaiterBase
+{
+private:
+    Data data_;
+
+    bool appendInLoop()
+    {
+        conn_->write_context_.output_buffer_.append(std::move(data_),priority_);
+        return readyInLoop();
+    }
+
+    static void runHop(LoopHop* hop)
+    {
+        auto self = static_cast<SendDataAwaiter*>(hop);
+        self->resumeOrSuspendInLoop(self->appendInLoop());
+    }
+public:
+    SendDataAwaiter(TcpConnection* conn,Data data,Priority priority = Priority::Normal)
+        :SendAwaiterBase(conn,priority)
         ,data_(std::move(data))
     {}
-    ~SendDataAwaiter()=default;
+
+    bool await_ready()
+    {
+        //如果连接已经关闭，直接返回
+        if(conn_->closing()) return true;
+
+        //判断是否在当前的线程中，如果不在，直接挂起
+        if(!inLoopThread()) return false;
+
+        //如果在loop线程，直接追加数据并提交任务，超过高水位线时挂起
+        return appendInLoop();
+    }
+
+    void await_suspend(std::coroutine_handle<>h)
+    {
+        //如果不在loop线程，交给loop追加数据，再检查水位线决定恢复还是挂起
+        if(!inLoopThread())
+        {
+            queueHop(h,&SendDataAwaiter::runHop);
+        }
+        else
+        {
+            suspendInLoop(h);
+        }
+    }
+};
+
+
+template <ContiguousBuffer Buffer>
+SendDataAwaiter<GuardedView> TcpConnection::send(std::shared_ptr<Buffer> buffer,Priority priority)
+{
+    std::string_view data(buffer->data(),buffer->size());
+    return send(data,std::shared_ptr<const void>(std::move(buffer)),priority);
+}
+
+//等待一个完整的长度前缀帧
+//在其它线程中等待时awaiter本身作为节点加入loop的切换链表(见LoopHop)，不需要分配内存
+class RecvFrameAwaiter:private LoopHop
+{
+protected:
+    TcpConnection* conn_;
+    std::coroutine_handle<>parked_;     //挂起时交给连接的句柄，恢复之后为空
+
+    //在loop线程中调用，释放之前交给用户的帧，并判断是否可以直接返回
+    bool readyInLoop();
+    //在loop线程中调用，挂起协程并提交读任务
+    void suspendInLoop(std::coroutine_handle<>h);
+    //协程恢复后清理等待状态，返回是否有完整的帧
+    bool resumeInLoop();
+    //从切换链表中取出之后在loop线程中调用
+    static void runHop(LoopHop* hop);
+public:
+    //挂起时被销毁会撤销在连接上的等待
+    static constexpr bool kCancelOnDestroy = true;
+    IoUringLoop* parkLoop()const {return conn_->getLoop();}
+
+    RecvFrameAwaiter(TcpConnection* conn)
+        :conn_(conn)
+        ,parked_(nullptr)
+    {}
+    ~RecvFrameAwaiter();
+    bool await_ready();
+
+    void await_suspend(std::coroutine_handle<>h);
+
+    Frame await_resume();
+};
+
+//等待至少一个完整的帧，并一次取出最多batch_个
+class RecvFramesAwaiter:public RecvFrameAwaiter
+{
+private:
+    size_t batch_;
+public:
+    RecvFramesAwaiter(TcpConnection* conn,size_t batch)
+        :RecvFrameAwaiter(conn)
+        ,batch_(batch)
+    {}
+
+    std::vector<Frame> await_resume();
+};
+
+//直接把数据接收到用户的缓冲区中
+//内核在recv返回之前还会写入缓冲区，所以不能在挂起时取消，在whenAny中会被分离，继续执行到recv返回
+//在其它线程中等待时awaiter本身作为节点加入loop的切换链表(见LoopHop)，不需要分配内存
+class RecvIntoAwaiter:private LoopHop
+{
+private:
+    TcpConnection* conn_;
+    char* buf_;
+    size_t len_;
+
+    //在loop线程中调用，挂起协程并停止multishot
+    void suspendInLoop(std::coroutine_handle<>h);
+    //从切换链表中取出之后在loop线程中调用
+    static void runHop(LoopHop* hop);
+public:
+    RecvIntoAwaiter(TcpConnection* conn,char* buf,size_t len)
+        :conn_(conn)
+        ,buf_(buf)
+        ,len_(len)
+    {}
+    ~RecvIntoAwaiter()= default;
+    bool await_ready();
+
+    void await_suspend(std::coroutine_handle<>h);
+
+    ssize_t await_resume();
+};
+
+//提交reserve预留的内存中的数据
+class CommitAwaiter
+{
+private:
+    TcpConnection* conn_;
+    size_t len_;
+    std::coroutine_handle<>parked_;     //因为高水位线挂起时交给连接的句柄，恢复之后为空
+public:
+    //挂起时被销毁会撤销在连接上的等待，已经提交的数据仍然会发送
+    static constexpr bool kCancelOnDestroy = true;
+    IoUringLoop* parkLoop()const {return conn_->getLoop();}
+
+    CommitAwaiter(TcpConnection* conn,size_t len)
+        :conn_(conn)
+        ,len_(len)
+        ,parked_(nullptr)
+    {}
+    ~CommitAwaiter();
 
     bool await_ready();
 
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <unordered_map>
+#include <unordered_set>
 #include <memory>
 
 #include "IoUringLoopThreadPool.h"
@@ -9,13 +10,25 @@
 #include "InetAddress.h"
 #include "TcpConnection.h"
 #include "Task.hpp"
+#include "Payload.hpp"
 
 class TcpServer
 {
+public:
+    //广播时判断一个连接是否需要接收数据，在连接所在的loop线程中调用
+    using BroadcastFilter = std::function<bool(const TcpConnection&)>;
+
 private:
     using ConnectionMap = std::unordered_map<std::string,TcpConnectionPtr>;
     using CoroutineHandler = std::function<Task<>(TcpConnectionPtr)>;
 
+    //一个loop中属于这个server的所有连接，只能在对应的loop线程中访问
+    //连接在建立时加入，在关闭的回调中移除，connection_map_ 中的智能指针保证其中的连接有效
+    struct LoopConnections
+    {
+        std::unordered_set<TcpConnection*> conns_;
+    };
+
     IoUringLoop *loop_; //IoUringLoopThreadPool 中的baseloop(也就是mainloop)
     std::string ip_port; //ip和端口
     std::string name_; //tcp server 的名字
@@ -26,6 +39,9 @@ private:
     
     ConnectionMap connection_map_; //保存所有连接的容器
 
+    //每个loop中的连接，在start中创建，之后只读，用于广播
+    std::unordered_map<IoUringLoop*,std::shared_ptr<LoopConnections>>loop_connections_;
+
     ConnecitonCallback connection_callback_; //当连接建立和停止时所调用的回调函数
     WriteCompleteCallback write_complete_callback_; //当数据完全发送完毕时执行的回调函数
 
@@ -38,6 +54,9 @@ private:
 
     CoroutineHandler coroutine_handler_;    //具体的业务协程
 
+    size_t warmup_frame_size_;  //每个loop预先分配的协程帧的大小
+    size_t warmup_frame_count_; //每个loop预先分配的协程帧的数量，为0时不预先分配
+
 
     void newConnection(int sock_fd,const InetAddress&peer_addr);//用于建立新连接的函数，在acceptor中作为回调函数调用
     
@@ -67,6 +86,15 @@ public:
 
     void setThreadNum(int thread_num); //设置线程池中的线程数量
 
+    //在start时为每个loop的帧内存池预先分配count个可以容纳frame_size字节的协程帧，避免连接建立时从堆中分配
+    //frame_size按照业务协程和它嵌套调用的协程中最大的帧估计，需要在start之前调用
+    void setFramePoolWarmup(size_t frame_size,size_t count);
+
+    //把同一份数据发送给所有满足filter的连接，filter为空时发送给所有连接，可以在任意线程中调用，需要在start之后调用
+    //每个loop只提交一个任务，在loop线程中把payload追加到这个loop中每个连接的发送队列，连接之间共享数据，不拷贝
+    //广播不检查高水位线，慢的连接会一直积压数据，可以在filter中跳过
+    void broadcast(Payload payload,BroadcastFilter filter = nullptr);
+
     /*
     Pass-by-Value and Move 进行优化，
     这里如果时右值绑定到cb对象，直接调用移动构造函数，总共有两次移动，0拷贝
@@ -24,7 +24,6 @@ private:
     size_t max_size_;
     std::vector<std::thread>threads_;
 
-    void enqueue(std::coroutine_handle<>h);
 public:
     ThreadPool(size_t thread_num,size_t queue_size);
     ~ThreadPool();
@@ -37,10 +36,15 @@ public:
     bool isStarted()const {return started_.load();}
 
     SwitchThreadAwaiter switchThread();
+    //把协程放入任务队列，由工作线程恢复，可以在任意线程中调用
+    void enqueue(std::coroutine_handle<>h);
 
     bool isFull();
 };
 
+//当前线程所属的线程池，不是工作线程时返回nullptr
+ThreadPool* currentThreadPool();
+
 class SwitchThreadAwaiter
 {
 private:
@@ -6,13 +6,26 @@
 
 #include "IoContext.h"
 #include "SendQueue.hpp"
+#include "ZeroCopySendContext.h"
+#include "WriteOpContext.h"
+#include "FileSendContext.h"
 #include "noncopyable.h"
 
 class TcpConnection;
 
 //返回的cqe调用的就是这个类，所以这个类要决定返回后业务协程是否唤醒等一系列操作
+//发送请求由WriteOpContext提交，这个类作为一个整体放入loop的等待队列中，保证同一批链接的请求连续地提交
 struct WriteContext:public IoContext ,noncopyable
 {
+    //默认的小数据合并阈值，不超过这个大小的数据拷贝到暂存块中合并成一个iovec
+    static constexpr size_t kDefaultCoalesceThreshold = 512;
+    //默认同时在内核中的发送请求的数量
+    static constexpr size_t kDefaultMaxInflight = 1;
+    //同时在内核中的发送请求数量的上限，一批请求要能一次放入io_uring的队列中
+    static constexpr size_t kMaxInflightLimit = 16;
+    //有多个请求时每个请求最多发送的字节数，前面的请求尽快返回，让协程在后面的请求发送的同时继续追加数据
+    static constexpr size_t kMaxOpBytes = 256*1024;
+
     std::shared_ptr<TcpConnection>holder_;//在提交sqe后保活
     std::coroutine_handle<>write_handle_;//业务协程的句柄
     SendQueue output_buffer_;//输出缓冲区
@@ -22,22 +35,88 @@ struct WriteContext:public IoContext ,noncopyable
     int fd_;
     bool is_sending_;       //标识当前连接是否正在等待cqe中
     bool is_error_;         //是否出错要关闭连接
+    bool low_latency_;      //为true时每次追加数据都立即提交发送请求，否则同一次循环中追加的数据在循环末尾一起提交
+    bool flush_queued_;     //已经加入loop中等待在循环末尾发送
+    size_t submitted_ops_;  //提交过的发送请求的数量
+
+    size_t max_slices_;             //一个请求中最多的slices数量
+
+    //多个发送请求相关
+    size_t max_inflight_;           //同时在内核中的发送请求的最大数量
+    std::vector<std::unique_ptr<WriteOpContext>>ops_;   //所有创建过的发送请求，前chain_len_个是正在发送的请求
+    size_t chain_len_;              //这一批链接在一起提交的请求数量
+    size_t completed_;              //这一批请求中已经返回的数量
+    int chain_error_;               //这一批请求中第一个错误，被取消(-ECANCELED)的请求不算
+
+    //零拷贝发送相关
+    std::vector<iovec>temp_data_;   //零拷贝发送的iovec
 
-    size_t max_slices_;             //一次性发送的最大的slices数量
-    std::vector<iovec>temp_data_;   //交给cqe发送但是还有没回来的iovec
+    size_t zero_copy_threshold_;        //一批数据中有不小于这个大小的分片时使用SENDMSG_ZC发送，为0表示关闭
+    std::vector<TxFragment*>temp_fragments_;    //temp_data_对应的分片
+    std::vector<std::unique_ptr<ZeroCopySendContext>>zc_contexts_;  //所有创建过的零拷贝请求
+    std::vector<ZeroCopySendContext*>zc_free_;                      //没有在使用的零拷贝请求
+    size_t zc_sends_;       //零拷贝发送的次数
+    size_t zc_copied_;      //内核实际上进行了拷贝的零拷贝发送次数(比如回环网卡)
 
-    WriteContext(size_t high_water_mark,int fd,size_t max_slices =256);
+    //固定缓冲区相关
+    ChunkPoolManagerOutput* output_pool_;   //输出内存池，第一次reserve时设置
+    Chunk* reserved_chunk_;                 //reserve新取出的chunk，commit之后转移给分片
+    char* reserved_ptr_;                    //reserve返回的写入位置
+    size_t reserved_len_;                   //reserve返回的可写入的长度
+
+    //文件分片相关
+    bool file_splice_;                              //为false时文件分片读入内存再发送
+    std::unique_ptr<FileSendContext>file_send_;     //第一次发送文件分片时创建
+
+    WriteContext(size_t high_water_mark,int fd,TxFragmentPool* pool = nullptr,size_t max_slices =256);
     ~WriteContext();
 
-    //批量提取数据提交数据到io_uring中
+    //批量提取数据提交数据到io_uring中，没有写完的请求先提交，之后装填新的请求直到max_inflight_个
     void flush();
 
+    //在循环末尾由loop调用，发送这一次循环中追加的数据
+    void flushQueued();
+
+    //发送输出缓冲区头部的文件分片，文件分片单独发送，不和其它的请求同时在内核中
+    void flushFile();
+    //文件分片的一次发送返回
+    void onFileSendResult(FileSendContext* ctx);
+
+    //在这一批请求的末尾追加一个空的请求
+    WriteOpContext* appendOp();
+
+    //检查下一批数据是否使用零拷贝发送，如果是就提交零拷贝请求并返回true，否则把已经提取的数据放入第一个请求中
+    bool flushZeroCopy();
+    //提交一个零拷贝发送的请求，buf_index不小于0时发送的是固定缓冲区中的数据
+    void submitZeroCopy(int buf_index);
+
+    //在输出内存池中预留至少len个字节，优先使用尾部固定缓冲区分片的chunk剩余的空间，len大于chunk的大小时返回nullptr
+    char* reserve(ChunkPoolManagerOutput& pool,size_t len);
+    //把预留的内存中前len个字节追加到输出缓冲区，没有预留时返回false
+    bool commit(size_t len);
+    //归还预留但是还没有提交的chunk
+    void releaseReserved();
+
+    //一个发送请求返回，整批请求都返回之后再提交下一批
+    void onWriteOpResult(WriteOpContext* op);
+
+    //零拷贝发送的结果返回，按照普通发送的结果处理
+    void onZeroCopyResult(int res);
+    //零拷贝发送的通知返回(或者不会再有通知)，释放引用的分片并回收请求
+    void finishZeroCopy(ZeroCopySendContext* ctx);
+
     //处理错误
     bool handleError();
 
-    //cqe返回后调用的回调函数
+    //零拷贝发送的结果返回后调用的回调函数
     void on_completion();
 
+    //一批发送完成之后处理错误、继续发送或者结束发送，结果在res_中
+    void afterSend();
+
+    //数据低于高水位线时唤醒等待的协程
+    void resumeWriter();
+
     bool isError()const {return is_error_;}
 
     bool overLoad()const {return output_buffer_.getTotalLen()>high_water_mark_;}
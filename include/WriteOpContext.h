@@ -0,0 +1,38 @@
+#pragma once
+#include <vector>
+#include <sys/uio.h>
+#include <sys/socket.h>
+
+#include "IoContext.h"
+#include "noncopyable.h"
+
+struct WriteContext;
+
+//一次发送请求，一个连接最多同时有max_inflight_个请求在内核中
+//同一批提交的请求使用IOSQE_IO_LINK按顺序链接，不是最后一个的请求使用MSG_WAITALL的sendmsg，内核写完全部数据才会开始下一个请求
+//某个请求出错或者没有写完时内核会取消链接在它之后的请求(-ECANCELED)，没有写完的请求从写到的位置重新提交，不需要重新从缓冲区中提取
+struct WriteOpContext:public IoContext ,noncopyable
+{
+    WriteContext& owner_;
+    std::vector<iovec>iovecs_;  //这次请求发送的iovec
+    size_t offset_;             //iovecs_中第一个没有写完的iovec的下标
+    size_t bytes_;              //还没有写完的字节数
+    int fixed_index_;           //不小于0时表示发送的是固定缓冲区中的数据(WRITE_FIXED)，iovecs_中只有一个iovec
+    msghdr msg_;                //使用sendmsg提交时的消息，直到结果返回之前都有效
+
+    WriteOpContext(WriteContext& owner);
+    ~WriteOpContext();
+
+    //清空请求，用于装填新的数据
+    void reset();
+    //iovecs_中装填完数据之后调用，统计要发送的字节数
+    void prepare();
+    //写入了len个字节，推进iovec，没有写完的部分在下一次提交时继续发送
+    void advance(size_t len);
+
+    iovec* pendingIovecs() {return iovecs_.data()+offset_;}
+    size_t pendingCount()const {return iovecs_.size()-offset_;}
+    bool done()const {return bytes_==0;}
+
+    void on_completion();
+};
@@ -0,0 +1,28 @@
+#pragma once
+#include <memory>
+#include <vector>
+#include <sys/socket.h>
+
+#include "IoContext.h"
+#include "noncopyable.h"
+
+class TcpConnection;
+struct WriteContext;
+struct TxFragment;
+
+//一次 SENDMSG_ZC 请求，这个请求会返回两个cqe，都由这个上下文接收：
+//第一个cqe是发送的结果，带有IORING_CQE_F_MORE标志时表示之后还会有一个带IORING_CQE_F_NOTIF标志的通知
+//收到通知之前内核可能还在引用发送的数据，所以这次发送引用的分片和连接都要保活到通知返回
+struct ZeroCopySendContext:public IoContext ,noncopyable
+{
+    WriteContext& owner_;
+    std::shared_ptr<TcpConnection>holder_;  //通知返回之前保活连接
+    std::vector<TxFragment*>pinned_;        //这次发送引用的分片
+    msghdr msg_;                            //提交的消息，iovec使用WriteContext中的temp_data_
+    int buf_index_;                         //不小于0时表示发送固定缓冲区中的数据(SEND_ZC)，msg_中只有一个iovec
+
+    ZeroCopySendContext(WriteContext& owner);
+    ~ZeroCopySendContext();
+
+    void on_completion();
+};
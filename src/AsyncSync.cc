@@ -0,0 +1,156 @@
+#include "AsyncSync.h"
+#include "Task.hpp"
+
+void AsyncWaiter::park(std::coroutine_handle<> h)
+{
+    handle_ = h;
+    loop_ = currentLoop();
+    pool_ = loop_?nullptr:currentThreadPool();
+    next_ = nullptr;
+}
+
+void AsyncWaiter::wake()
+{
+    //没有loop时回到线程池，都没有时由唤醒者直接恢复
+    if(!loop_)
+    {
+        if(pool_) pool_->enqueue(handle_);
+        else handle_.resume();
+        return;
+    }
+    //同一个loop中放入就绪队列，唤醒者继续执行，之后再恢复等待者
+    if(loop_==currentLoop())
+    {
+        loop_->post(handle_);
+        return;
+    }
+    hop_.handle_ = handle_;
+    loop_->queueHop(&hop_);
+}
+
+AsyncSemaphore::AsyncSemaphore(int64_t permits)
+    :count_(permits)
+    ,head_(nullptr)
+    ,tail_(nullptr)
+    ,pending_(0)
+{
+}
+
+bool AsyncSemaphore::tryAcquire()
+{
+    int64_t count = count_.load(std::memory_order_acquire);
+    while(count>0)
+    {
+        if(count_.compare_exchange_weak(count,count-1,std::memory_order_acq_rel,std::memory_order_acquire)) return true;
+    }
+    return false;
+}
+
+bool AsyncSemaphore::AcquireAwaiter::await_suspend(std::coroutine_handle<> h)
+{
+    waiter_.park(h);
+    return sem_->acquireOrWait(&waiter_);
+}
+
+bool AsyncSemaphore::acquireOrWait(AsyncWaiter *waiter)
+{
+    //登记之后还有许可，直接获取
+    if(count_.fetch_sub(1,std::memory_order_acq_rel)>0) return false;
+
+    std::lock_guard<std::mutex>lock(mtx_);
+    //释放者已经看到了这个等待者，但是它还没有进入链表
+    if(pending_>0)
+    {
+        pending_--;
+        return false;
+    }
+    if(tail_) tail_->next_ = waiter;
+    else head_ = waiter;
+    tail_ = waiter;
+    return true;
+}
+
+void AsyncSemaphore::release()
+{
+    //没有等待者
+    if(count_.fetch_add(1,std::memory_order_acq_rel)>=0) return;
+
+    AsyncWaiter* waiter = nullptr;
+    {
+        std::lock_guard<std::mutex>lock(mtx_);
+        if(!head_)
+        {
+            pending_++;
+            return;
+        }
+        waiter = head_;
+        head_ = waiter->next_;
+        if(!head_) tail_ = nullptr;
+    }
+    //在锁外唤醒，等待者可能在这个线程中直接恢复
+    waiter->wake();
+}
+
+int64_t AsyncSemaphore::available() const
+{
+    int64_t count = count_.load(std::memory_order_acquire);
+    return count>0?count:0;
+}
+
+AsyncLockGuard::~AsyncLockGuard()
+{
+    if(mutex_) mutex_->unlock();
+}
+
+AsyncEvent::AsyncEvent(bool set)
+    :state_(set?static_cast<void*>(this):nullptr)
+{
+}
+
+bool AsyncEvent::isSet() const
+{
+    return state_.load(std::memory_order_acquire)==this;
+}
+
+bool AsyncEvent::WaitAwaiter::await_suspend(std::coroutine_handle<> h)
+{
+    waiter_.park(h);
+    void* state = event_->state_.load(std::memory_order_acquire);
+    do
+    {
+        //在挂起之前被设置
+        if(state==event_) return false;
+        waiter_.next_ = static_cast<AsyncWaiter*>(state);
+    } while (!event_->state_.compare_exchange_weak(state,&waiter_,std::memory_order_release,std::memory_order_acquire));
+    return true;
+}
+
+void AsyncEvent::set()
+{
+    void* state = state_.exchange(this,std::memory_order_acq_rel);
+    if(state==this) return;
+
+    //栈中是后进先出的顺序，反转之后按照等待的顺序唤醒
+    AsyncWaiter* waiters = nullptr;
+    auto waiter = static_cast<AsyncWaiter*>(state);
+    while(waiter)
+    {
+        auto next = waiter->next_;
+        waiter->next_ = waiters;
+        waiters = waiter;
+        waiter = next;
+    }
+    while(waiters)
+    {
+        //唤醒之后节点所在的协程帧可能已经销毁，先取出下一个
+        auto next = waiters->next_;
+        waiters->wake();
+        waiters = next;
+    }
+}
+
+void AsyncEvent::reset()
+{
+    void* state = this;
+    state_.compare_exchange_strong(state,nullptr,std::memory_order_acq_rel);
+}
@@ -0,0 +1,142 @@
+#include <cassert>
+
+#include "ChainReader.h"
+#include "Logger.h"
+
+ChainReader::ChainReader(InputChainBuffer &buffer)
+    :buffer_(buffer)
+    ,chunk_(nullptr)
+    ,offset_(0)
+    ,consumed_(0)
+    ,is_error_(false)
+{}
+
+void ChainReader::normalize()
+{
+    if(!chunk_)
+    {
+        chunk_ = buffer_.frontChunk();
+        offset_ = 0;
+        //缓冲区为空，没有可以定位的chunk
+        if(!chunk_) return;
+    }
+    while(chunk_->next_&&offset_>=chunk_->readableBytes())
+    {
+        offset_ -= chunk_->readableBytes();
+        chunk_ = chunk_->next_;
+    }
+}
+
+void ChainReader::readSlow(void *target, size_t len)
+{
+    char* dst = static_cast<char*>(target);
+    size_t filled = 0;
+    while(filled<len)
+    {
+        normalize();
+        size_t seg = std::min(chunk_->readableBytes()-offset_,len-filled);
+        std::memcpy(dst+filled,chunk_->beginRead()+offset_,seg);
+        filled += seg;
+        offset_ += seg;
+    }
+    consumed_ += len;
+}
+
+bool ChainReader::malformedVarint()
+{
+    LOG_ERROR("ChainReader malformed varint, more than 64 bits");
+    is_error_ = true;
+    return false;
+}
+
+bool ChainReader::readVarint(uint64_t &value)
+{
+    constexpr size_t kMaxVarintLen = 10;
+    if(is_error_||readable()==0) return false;
+    normalize();
+
+    //快速路径，varint在当前chunk中结束
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(chunk_->beginRead()+offset_);
+    size_t avail = std::min(chunk_->readableBytes()-offset_,kMaxVarintLen);
+    uint64_t result = 0;
+    for(size_t i=0;i<avail;++i)
+    {
+        if(i==kMaxVarintLen-1&&p[i]>1) return malformedVarint();
+        result |= uint64_t(p[i]&0x7f)<<(7*i);
+        if(!(p[i]&0x80))
+        {
+            value = result;
+            offset_ += i+1;
+            consumed_ += i+1;
+            return true;
+        }
+    }
+
+    //varint跨越了chunk的边界，使用临时的游标逐字节读取，成功后才移动游标
+    const Chunk* chunk = chunk_;
+    size_t offset = offset_;
+    size_t remain = readable();
+    result = 0;
+    for(size_t i=0;i<kMaxVarintLen&&i<remain;++i)
+    {
+        while(offset>=chunk->readableBytes())
+        {
+            offset -= chunk->readableBytes();
+            chunk = chunk->next_;
+        }
+        uint8_t byte = static_cast<uint8_t>(chunk->beginRead()[offset++]);
+        if(i==kMaxVarintLen-1&&byte>1) return malformedVarint();
+        result |= uint64_t(byte&0x7f)<<(7*i);
+        if(!(byte&0x80))
+        {
+            value = result;
+            chunk_ = chunk;
+            offset_ = offset;
+            consumed_ += i+1;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ChainReader::readVarintSigned(int64_t &value)
+{
+    uint64_t raw;
+    if(!readVarint(raw)) return false;
+    value = static_cast<int64_t>((raw>>1)^(~(raw&1)+1));
+    return true;
+}
+
+bool ChainReader::readString(std::string &target, size_t len)
+{
+    if(readable()<len) return false;
+    target.resize(len);
+    if(len==0) return true;
+    return readRaw(target.data(),len);
+}
+
+bool ChainReader::skip(size_t len)
+{
+    if(readable()<len) return false;
+    if(len==0) return true;
+    normalize();
+    offset_ += len;
+    consumed_ += len;
+    return true;
+}
+
+void ChainReader::rewind()
+{
+    chunk_ = nullptr;
+    offset_ = 0;
+    consumed_ = 0;
+}
+
+void ChainReader::commit()
+{
+    if(consumed_>0)
+    {
+        buffer_.retrieve(consumed_);
+    }
+    rewind();
+}
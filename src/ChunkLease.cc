@@ -0,0 +1,74 @@
+#include <cstring>
+
+#include "ChunkLease.h"
+#include "ChunkPoolManagerInput.h"
+
+ChunkLease::ChunkLease()
+    :owner_(nullptr)
+    ,total_len_(0)
+{}
+
+ChunkLease::ChunkLease(ChunkPoolManagerInput *owner)
+    :owner_(owner)
+    ,total_len_(0)
+{}
+
+ChunkLease::~ChunkLease()
+{
+    release();
+}
+
+ChunkLease::ChunkLease(ChunkLease &&other)
+    :owner_(other.owner_)
+    ,segments_(std::move(other.segments_))
+    ,total_len_(other.total_len_)
+{
+    other.segments_.clear();
+    other.total_len_ = 0;
+}
+
+ChunkLease &ChunkLease::operator=(ChunkLease &&other)
+{
+    if(this!=&other)
+    {
+        release();
+        owner_ = other.owner_;
+        segments_ = std::move(other.segments_);
+        total_len_ = other.total_len_;
+        other.segments_.clear();
+        other.total_len_ = 0;
+    }
+    return *this;
+}
+
+void ChunkLease::append(Chunk *chunk, const char *data, size_t len)
+{
+    segments_.push_back({chunk,data,len});
+    total_len_ += len;
+}
+
+size_t ChunkLease::copyTo(char *target) const
+{
+    size_t copied = 0;
+    for(auto& seg:segments_)
+    {
+        std::memcpy(target+copied,seg.data_,seg.len_);
+        copied += seg.len_;
+    }
+    return copied;
+}
+
+std::string ChunkLease::toString() const
+{
+    std::string ret(total_len_,0);
+    copyTo(ret.data());
+    return ret;
+}
+
+void ChunkLease::release()
+{
+    if(segments_.empty()) return;
+    owner_->returnLeased(segments_);
+    segments_.clear();
+    total_len_ = 0;
+}
@@ -12,6 +12,8 @@ uint16_t generateBid()
 ChunkPoolManagerInput::ChunkPoolManagerInput(IoUringLoop &loop)
     :loop_(loop)
     ,pool_(loop.CHUNK_SIZE,loop.CHUNK_NUM)
+    ,chunk_size_(loop.CHUNK_SIZE)
+    ,compact_threshold_(loop.CHUNK_SIZE/8)
     ,count_(0)
 {
     //分割内存成chunk，然后注册buffer ring
@@ -103,6 +105,15 @@ Chunk *ChunkPoolManagerInput::getChunkById(uint16_t id)
 
 void ChunkPoolManagerInput::returnOneChunk(Chunk *chunk)
 {
+    recycleChunk(chunk);
+    //之前是攒够32个再批量提交，但是如果总buffer数量太少，可能导致大量buffer被滞留，频繁引发ENOBUFS
+    //批量归还的场景使用recycleChunk+commitChunks
+    commitChunks();
+}
+
+void ChunkPoolManagerInput::recycleChunk(Chunk *chunk)
+{
+    stats_.in_use_chunks_--;
     chunk->reset();
     //向io_uring 中归还这个获取的地址
     io_uring_buf_ring_add(
@@ -114,11 +125,65 @@ void ChunkPoolManagerInput::returnOneChunk(Chunk *chunk)
         count_
     );
     count_++;
-    //如果计数器达到了一定次数则批量提交一次
-    //之前是32，但是如果总buffer数量太少，可能导致大量buffer被滞留，频繁引发ENOBUFS
-    if(count_>=1)
+}
+
+void ChunkPoolManagerInput::commitChunks()
+{
+    if(count_>0)
     {
         io_uring_buf_ring_advance(this->input_buf_ring_,count_);
         count_=0;
     }
 }
+
+void ChunkPoolManagerInput::releaseShared(Chunk *chunk)
+{
+    if(chunk->shares_>0)
+    {
+        chunk->shares_--;
+        return;
+    }
+    recycleChunk(chunk);
+}
+
+void ChunkPoolManagerInput::returnLeased(const std::vector<ChunkLease::Segment> &segments)
+{
+    if(loop_.isInLoopThread())
+    {
+        for(auto& seg:segments)
+        {
+            releaseShared(seg.chunk_);
+        }
+        commitChunks();
+        return;
+    }
+
+    bool need_notify = false;
+    {
+        std::lock_guard<std::mutex>lock(remote_mtx_);
+        //队列为空说明loop中没有等待执行的归还任务，需要追加一个，否则由已经追加的任务一起归还
+        need_notify = remote_returns_.empty();
+        for(auto& seg:segments)
+        {
+            remote_returns_.push_back(seg.chunk_);
+        }
+    }
+    if(need_notify)
+    {
+        loop_.queueInLoop([this](){drainRemoteReturns();});
+    }
+}
+
+void ChunkPoolManagerInput::drainRemoteReturns()
+{
+    std::vector<Chunk*>chunks;
+    {
+        std::lock_guard<std::mutex>lock(remote_mtx_);
+        chunks.swap(remote_returns_);
+    }
+    for(auto chunk:chunks)
+    {
+        releaseShared(chunk);
+    }
+    commitChunks();
+}
@@ -0,0 +1,83 @@
+#include <cstring>
+#include <sys/uio.h>
+
+#include "ChunkPoolManagerOutput.h"
+#include "IoUringLoop.h"
+#include "Logger.h"
+
+ChunkPoolManagerOutput::ChunkPoolManagerOutput(IoUringLoop &loop,size_t chunk_size,size_t chunk_num)
+    :pool_(chunk_size,chunk_num,false)
+    ,loop_(loop)
+    ,chunk_size_(chunk_size)
+    ,free_list_(nullptr)
+    ,free_count_(0)
+    ,registered_(false)
+    ,overflow_chunks_(0)
+{
+    if(chunk_num>=kOverflowIndex)
+    {
+        LOG_FATAL("the num of output chunk must be less than %u",(unsigned)kOverflowIndex);
+    }
+
+    //分割内存成chunk，放入空闲链表
+    chunks_data_.reserve(pool_.chunks_);
+    std::vector<iovec>iovecs(pool_.chunks_);
+    for(size_t i=0;i<pool_.chunks_;++i)
+    {
+        chunks_data_.emplace_back(pool_.data_ptr_+chunk_size*i,i);
+        iovecs[i].iov_base = chunks_data_[i].data_ptr_;
+        iovecs[i].iov_len = chunk_size;
+    }
+    for(auto it=chunks_data_.rbegin();it!=chunks_data_.rend();++it)
+    {
+        it->next_ = free_list_;
+        free_list_ = &*it;
+    }
+    free_count_ = pool_.chunks_;
+
+    //注册固定缓冲区，一个ring只能注册一组
+    int ret = io_uring_register_buffers(loop_.ring_,iovecs.data(),iovecs.size());
+    if(ret<0)
+    {
+        LOG_ERROR("io_uring_register_buffers failed, fallback to normal write, error:%s",strerror(-ret));
+        return;
+    }
+    registered_ = true;
+}
+
+ChunkPoolManagerOutput::~ChunkPoolManagerOutput()
+{
+    //取消注册固定缓冲区
+    if(registered_&&loop_.ring_)
+    {
+        io_uring_unregister_buffers(loop_.ring_);
+    }
+}
+
+Chunk *ChunkPoolManagerOutput::acquireChunk()
+{
+    if(!free_list_)
+    {
+        overflow_chunks_++;
+        return new Chunk(new char[chunk_size_],kOverflowIndex);
+    }
+    auto chunk = free_list_;
+    free_list_ = chunk->next_;
+    chunk->next_ = nullptr;
+    free_count_--;
+    return chunk;
+}
+
+void ChunkPoolManagerOutput::releaseChunk(Chunk *chunk)
+{
+    if(chunk->index_==kOverflowIndex)
+    {
+        delete[] chunk->data_ptr_;
+        delete chunk;
+        return;
+    }
+    chunk->reset();
+    chunk->next_ = free_list_;
+    free_list_ = chunk;
+    free_count_++;
+}
@@ -0,0 +1,130 @@
+#include <cassert>
+#include <cstring>
+#include <liburing.h>
+
+#include "DirectReadContext.h"
+#include "ReadContext.h"
+#include "TcpConnection.h"
+#include "Logger.h"
+
+DirectReadContext::DirectReadContext(int fd)
+    :IoContext(ContextType::DirectRead)
+    ,holder_(nullptr)
+    ,read_handle_(nullptr)
+    ,fd_(fd)
+    ,buf_(nullptr)
+    ,len_(0)
+    ,filled_(0)
+    ,is_reading_(false)
+    ,is_error_(false)
+{
+}
+
+DirectReadContext::~DirectReadContext()
+{
+}
+
+void DirectReadContext::reset(char *buf, size_t len)
+{
+    buf_ = buf;
+    len_ = len;
+    filled_ = 0;
+}
+
+bool DirectReadContext::drain(ReadContext &r_ctx)
+{
+    //在multishot停止之前已经进入缓冲区的数据在数据流中排在前面，必须先拷贝
+    filled_ += r_ctx.input_buffer_.remove(buf_+filled_,len_-filled_);
+    return done();
+}
+
+void DirectReadContext::start(ReadContext &r_ctx, std::shared_ptr<TcpConnection> holder)
+{
+    if(drain(r_ctx))
+    {
+        auto handle = read_handle_;
+        read_handle_ = nullptr;
+        handle.resume();
+        return;
+    }
+    holder_ = std::move(holder);
+    holder_->submitDirectRead(this);
+}
+
+bool DirectReadContext::handleError()
+{
+    //res =0 是对端关闭了连接
+    if(res_==0)
+    {
+        is_error_ = true;
+        return true;
+    }
+    int err = -res_;
+    switch (err)
+    {
+    //被信号中断，继续接收
+    case EINTR:
+    case EAGAIN:
+        return false;
+
+    //连接关闭时提交的取消请求
+    case ECANCELED:
+        is_error_ = true;
+        return true;
+
+    default:
+        LOG_ERROR("DirectReadContext error happened msg: %s",strerror(err));
+        is_error_ = true;
+        return true;
+    }
+}
+
+void DirectReadContext::on_completion()
+{
+    assert(holder_&&"the holder should not be nullptr,some logic is wrong");
+    is_reading_ = false;
+
+    //连接已经关闭，业务协程在recv返回之前不能销毁，否则内核会写入已经释放的缓冲区，这里再次执行关闭流程销毁协程
+    if(holder_->closing())
+    {
+        auto holder = std::move(holder_);
+        read_handle_ = nullptr;
+        holder->handleClose();
+        return;
+    }
+
+    bool need_close = false;
+    if(res_<=0)
+    {
+        need_close = handleError();
+    }
+    else
+    {
+        filled_ += res_;
+    }
+
+    //MSG_WAITALL 仍然可能因为信号等原因提前返回，没有接收完整就继续提交
+    if(!need_close&&!done())
+    {
+        holder_->submitDirectRead(this);
+        return;
+    }
+
+    auto holder = std::move(holder_);
+    auto handle = read_handle_;
+    //和ReadContext一样，出现致命错误时恢复协程之后句柄仍然保留，handleClose据此销毁协程，
+    //否则协程结束之后协程帧中持有的连接和协程帧互相引用，都无法释放
+    if(!need_close)
+    {
+        read_handle_ = nullptr;
+    }
+    if(handle)
+    {
+        handle.resume();
+    }
+    if(need_close)
+    {
+        holder->handleClose();
+        read_handle_ = nullptr;
+    }
+}
@@ -0,0 +1,181 @@
+#include <algorithm>
+#include <cstring>
+#include <unistd.h>
+#include <errno.h>
+
+#include "FileSendContext.h"
+#include "WriteContext.h"
+#include "IoUringLoop.h"
+#include "ChunkPoolManagerOutput.h"
+#include "SendQueue.hpp"
+#include "Logger.h"
+
+FileSendOp::FileSendOp(FileSendContext &owner)
+    :IoContext(ContextType::FileSendOp)
+    ,owner_(owner)
+    ,len_(0)
+{
+}
+
+FileSendOp::~FileSendOp()
+{
+}
+
+void FileSendOp::on_completion()
+{
+    LOG_DEBUG("FileSendOp res : %d flags: %u",(int)res_,flags_);
+    owner_.onOpResult(this);
+}
+
+FileSendContext::FileSendContext(WriteContext &owner, IoUringLoop &loop)
+    :IoContext(ContextType::FileSend)
+    ,owner_(owner)
+    ,loop_(loop)
+    ,in_(*this)
+    ,out_(*this)
+    ,file_fd_(-1)
+    ,file_offset_(0)
+    ,pipe_{-1,-1}
+    ,chunk_(nullptr)
+    ,chunk_offset_(0)
+    ,staged_(0)
+    ,use_splice_(owner.file_splice_)
+    ,wait_writable_(false)
+    ,pending_(0)
+    ,sent_(0)
+    ,error_(0)
+    ,spliced_bytes_(0)
+    ,copied_bytes_(0)
+{
+}
+
+FileSendContext::~FileSendContext()
+{
+    //管道中可能还有没有发送的数据，不能再给其它连接使用
+    if(pipe_[0]>=0)
+    {
+        ::close(pipe_[0]);
+        ::close(pipe_[1]);
+    }
+    if(chunk_) loop_.getOutputPool().releaseChunk(chunk_);
+}
+
+void FileSendContext::prepare(const TxFragment *fragment)
+{
+    in_.len_ = 0;
+    sent_ = 0;
+    error_ = 0;
+
+    //中转为空时从文件中读取下一段数据，文件分片此时一定在输出缓冲区的头部，written_就是已经发送的字节数
+    if(staged_==0)
+    {
+        file_fd_ = fragment->file_fd_;
+        file_offset_ = fragment->file_offset_+fragment->written_;
+        use_splice_ = owner_.file_splice_;
+
+        //管道创建失败(比如fd耗尽)时这一次使用内存中转
+        if(use_splice_&&pipe_[0]<0&&!loop_.acquirePipe(pipe_))
+        {
+            LOG_ERROR("FileSendContext failed to create a pipe, fallback to read");
+            use_splice_ = false;
+        }
+
+        size_t capacity = 0;
+        if(use_splice_)
+        {
+            capacity = loop_.pipeSize();
+        }
+        else
+        {
+            if(!chunk_) chunk_ = loop_.getOutputPool().acquireChunk();
+            chunk_offset_ = 0;
+            capacity = loop_.getOutputPool().chunkSize();
+        }
+        in_.len_ = std::min(fragment->len_-fragment->written_,capacity);
+    }
+    out_.len_ = in_.len_>0?in_.len_:staged_;
+    pending_ = in_.len_>0?2:1;
+}
+
+void FileSendContext::onOpResult(FileSendOp *op)
+{
+    int res = op->res_;
+    pending_--;
+    if(op==&in_)
+    {
+        //读取没有完成时内核会取消之后的写入，读入的数据留在中转中，下一次发送
+        if(res>0)
+        {
+            staged_ += res;
+        }
+        else if(res==0)
+        {
+            LOG_ERROR("FileSendContext the file fd=%d is shorter than the fragment",file_fd_);
+            if(error_==0) error_ = -EIO;
+        }
+        //文件不支持splice，改为读入内存之后重新发送
+        else if(use_splice_&&(res==-EINVAL||res==-EOPNOTSUPP))
+        {
+            LOG_INFO("FileSendContext splice is not supported for fd=%d, fallback to read, error:%s",file_fd_,strerror(-res));
+            use_splice_ = false;
+            owner_.file_splice_ = false;
+        }
+        else if(res!=-ECANCELED&&error_==0)
+        {
+            error_ = res;
+        }
+    }
+    else
+    {
+        if(res>=0)
+        {
+            staged_ -= res;
+            sent_ += res;
+            if(use_splice_)
+            {
+                spliced_bytes_ += res;
+                wait_writable_ = staged_>0;
+            }
+            else
+            {
+                chunk_offset_ += res;
+                copied_bytes_ += res;
+            }
+        }
+        //socket的缓冲区满了，下一次先等待socket可写
+        else if(res==-EAGAIN)
+        {
+            wait_writable_ = true;
+        }
+        else if(res!=-ECANCELED&&error_==0)
+        {
+            error_ = res;
+        }
+    }
+
+    if(pending_>0) return;
+    if(staged_==0) releaseStage();
+    res_ = error_;
+    owner_.onFileSendResult(this);
+}
+
+void FileSendContext::releaseStage()
+{
+    if(pipe_[0]>=0)
+    {
+        loop_.releasePipe(pipe_);
+        pipe_[0] = pipe_[1] = -1;
+    }
+    if(chunk_)
+    {
+        loop_.getOutputPool().releaseChunk(chunk_);
+        chunk_ = nullptr;
+    }
+    chunk_offset_ = 0;
+    wait_writable_ = false;
+}
+
+bool FileSendContext::registered() const
+{
+    return chunk_&&loop_.getOutputPool().isRegistered(chunk_);
+}
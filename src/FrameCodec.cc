@@ -0,0 +1,139 @@
+#include <cstring>
+#include <cassert>
+#include <arpa/inet.h>
+
+#include "FrameCodec.h"
+#include "InputChainBuffer.h"
+#include "Logger.h"
+
+size_t Frame::copyTo(char *target)const
+{
+    size_t copied = 0;
+    forEachSegment([&](const char* data,size_t len){
+        std::memcpy(target+copied,data,len);
+        copied += len;
+    });
+    return copied;
+}
+
+std::string Frame::toString()const
+{
+    std::string ret(len_,0);
+    ret.resize(copyTo(ret.data()));
+    return ret;
+}
+
+FrameDecoder::FrameDecoder(size_t max_frame_len)
+    :max_frame_len_(max_frame_len)
+    ,delivered_(0)
+    ,need_(kHeaderLen)
+    ,is_error_(false)
+    ,cursor_chunk_(nullptr)
+    ,cursor_offset_(0)
+    ,frame_len_(0)
+    ,header_parsed_(false)
+{}
+
+void FrameDecoder::advance(const InputChainBuffer &buffer, size_t len)
+{
+    if(!cursor_chunk_)
+    {
+        cursor_chunk_ = buffer.frontChunk();
+        cursor_offset_ = 0;
+    }
+    cursor_offset_ += len;
+    //游标停在最后一个chunk的末尾时保持不动，等待新的chunk追加到链表中
+    while(cursor_chunk_->next_&&cursor_offset_>=cursor_chunk_->readableBytes())
+    {
+        cursor_offset_ -= cursor_chunk_->readableBytes();
+        cursor_chunk_ = cursor_chunk_->next_;
+    }
+}
+
+bool FrameDecoder::parseHeader(const InputChainBuffer &buffer)
+{
+    if(header_parsed_) return true;
+    if(buffer.getTotalLen()<delivered_+kHeaderLen) return false;
+
+    advance(buffer,0);
+    uint32_t net_len;
+    //头部在一个chunk中时直接读取
+    if(cursor_offset_+kHeaderLen<=cursor_chunk_->readableBytes())
+    {
+        std::memcpy(&net_len,cursor_chunk_->beginRead()+cursor_offset_,kHeaderLen);
+    }
+    else
+    {
+        //头部跨越chunk的边界，逐段拷贝
+        char header[kHeaderLen];
+        const Chunk* chunk = cursor_chunk_;
+        size_t offset = cursor_offset_;
+        size_t filled = 0;
+        while(filled<kHeaderLen&&chunk)
+        {
+            size_t seg = std::min(chunk->readableBytes()-offset,kHeaderLen-filled);
+            std::memcpy(header+filled,chunk->beginRead()+offset,seg);
+            filled += seg;
+            offset = 0;
+            chunk = chunk->next_;
+        }
+        assert(filled==kHeaderLen&&"total len is enough but chunks are not, some logic is wrong");
+        std::memcpy(&net_len,header,kHeaderLen);
+    }
+
+    frame_len_ = ntohl(net_len);
+    header_parsed_ = true;
+    return true;
+}
+
+bool FrameDecoder::hasFrame(const InputChainBuffer &buffer)
+{
+    if(is_error_) return false;
+    //数据量还没有达到上一次计算的需求，直接返回
+    if(buffer.getTotalLen()<need_) return false;
+
+    if(!parseHeader(buffer))
+    {
+        need_ = delivered_+kHeaderLen;
+        return false;
+    }
+
+    if(frame_len_>max_frame_len_)
+    {
+        LOG_ERROR("FrameDecoder frame length %u exceeds the limit %lu",frame_len_,max_frame_len_);
+        is_error_ = true;
+        return false;
+    }
+
+    need_ = delivered_+kHeaderLen+frame_len_;
+    return buffer.getTotalLen()>=need_;
+}
+
+Frame FrameDecoder::next(const InputChainBuffer &buffer)
+{
+    bool ok = parseHeader(buffer);
+    assert(ok&&buffer.getTotalLen()>=delivered_+kHeaderLen+frame_len_&&"call hasFrame first, some logic is wrong");
+    (void)ok;
+
+    size_t frame_len = frame_len_;
+    advance(buffer,kHeaderLen);
+    Frame frame(cursor_chunk_,cursor_offset_,frame_len);
+    advance(buffer,frame_len);
+
+    delivered_ += kHeaderLen+frame_len;
+    need_ = delivered_+kHeaderLen;
+    header_parsed_ = false;
+    return frame;
+}
+
+void FrameDecoder::release(InputChainBuffer &buffer)
+{
+    //释放之后缓冲区还可能被用户以其它方式消费，游标和解析结果都失效，下一次重新解析
+    cursor_chunk_ = nullptr;
+    cursor_offset_ = 0;
+    header_parsed_ = false;
+    need_ = kHeaderLen;
+    if(delivered_==0) return;
+    buffer.retrieve(delivered_);
+    delivered_ = 0;
+}
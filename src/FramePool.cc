@@ -0,0 +1,154 @@
+#include <new>
+
+#include "FramePool.h"
+
+namespace
+{
+thread_local FramePool* t_framePoolInThisThread = nullptr;
+}
+
+FramePool::FramePool()
+    :stats_{}
+{
+    for(auto& cls:classes_)
+    {
+        cls.free_list_ = nullptr;
+        cls.cached_ = 0;
+        cls.limit_ = kDefaultCacheLimit;
+    }
+}
+
+FramePool::~FramePool()
+{
+    if(t_framePoolInThisThread==this) t_framePoolInThisThread = nullptr;
+    for(auto& cls:classes_)
+    {
+        while(cls.free_list_)
+        {
+            auto block = cls.free_list_;
+            cls.free_list_ = block->next_;
+            ::operator delete(block);
+        }
+    }
+}
+
+size_t FramePool::classIndex(size_t size)
+{
+    size_t index = 0;
+    while(index<kNumClasses&&classSize(index)<size) index++;
+    return index;
+}
+
+void *FramePool::allocate(size_t size)
+{
+    size_t index = classIndex(size);
+    if(index==kNumClasses)
+    {
+        stats_.oversize_++;
+        return ::operator new(size);
+    }
+
+    auto& cls = classes_[index];
+    if(cls.free_list_)
+    {
+        auto block = cls.free_list_;
+        cls.free_list_ = block->next_;
+        cls.cached_--;
+        stats_.cached_--;
+        stats_.hits_++;
+        return block;
+    }
+    stats_.misses_++;
+    //按照分级的大小分配，释放之后可以给同一级的任何帧使用
+    return ::operator new(classSize(index));
+}
+
+void FramePool::release(void *ptr, size_t size)
+{
+    size_t index = classIndex(size);
+    if(index==kNumClasses)
+    {
+        ::operator delete(ptr);
+        return;
+    }
+
+    auto& cls = classes_[index];
+    if(cls.cached_>=cls.limit_)
+    {
+        stats_.dropped_++;
+        ::operator delete(ptr);
+        return;
+    }
+    auto block = static_cast<FreeBlock*>(ptr);
+    block->next_ = cls.free_list_;
+    cls.free_list_ = block;
+    cls.cached_++;
+    stats_.cached_++;
+    stats_.released_++;
+}
+
+void FramePool::reserve(size_t size, size_t count)
+{
+    size_t index = classIndex(size);
+    if(index==kNumClasses) return;
+
+    auto& cls = classes_[index];
+    if(cls.limit_<count) cls.limit_ = count;
+    while(cls.cached_<count)
+    {
+        auto block = static_cast<FreeBlock*>(::operator new(classSize(index)));
+        block->next_ = cls.free_list_;
+        cls.free_list_ = block;
+        cls.cached_++;
+        stats_.cached_++;
+    }
+}
+
+void FramePool::setCacheLimit(size_t limit)
+{
+    for(auto& cls:classes_)
+    {
+        cls.limit_ = limit;
+        while(cls.cached_>limit)
+        {
+            auto block = cls.free_list_;
+            cls.free_list_ = block->next_;
+            cls.cached_--;
+            stats_.cached_--;
+            ::operator delete(block);
+        }
+    }
+}
+
+FramePool::Stats FramePool::stats() const
+{
+    return stats_;
+}
+
+FramePool *FramePool::current()
+{
+    return t_framePoolInThisThread;
+}
+
+void FramePool::setCurrent(FramePool *pool)
+{
+    t_framePoolInThisThread = pool;
+}
+
+void *FramePool::allocateFrame(size_t size)
+{
+    if(auto pool = t_framePoolInThisThread) return pool->allocate(size);
+    //同样按照分级的大小分配，这个帧可能在有内存池的线程中释放并被缓存
+    size_t index = classIndex(size);
+    return ::operator new(index<kNumClasses?classSize(index):size);
+}
+
+void FramePool::releaseFrame(void *ptr, size_t size)
+{
+    if(auto pool = t_framePoolInThisThread)
+    {
+        pool->release(ptr,size);
+        return;
+    }
+    ::operator delete(ptr);
+}
@@ -1,3 +1,5 @@
+#include <cstring>
+
 #include "InputChainBuffer.h"
 #include "ChunkPoolManagerInput.h"
 #include "Logger.h"
@@ -6,6 +8,8 @@ bool InputChainBuffer::push_back(uint16_t index, int len)
 {
     //从io_uring的cqe flags中获取内存编号，构建chunk并加入到缓冲区中
     auto new_chunk = chunk_pool_manager_.getChunkById(index);
+    //所有进入缓冲区的chunk都在这里计数，归还时在recycleChunk中减少
+    chunk_pool_manager_.onChunkHeld();
 
     if(!tail_)
     {
@@ -21,7 +25,7 @@ bool InputChainBuffer::push_back(uint16_t index, int len)
     return true;
 }
 
-bool InputChainBuffer::pop_front()
+bool InputChainBuffer::pop_front(bool commit)
 {
     if(chunks_==0) return false;
     auto ret = head_;
@@ -34,7 +38,12 @@ bool InputChainBuffer::pop_front()
         head_=head_->next_;
     }
 
-    chunk_pool_manager_.returnOneChunk(ret);
+    //chunk还被租约持有时只放弃自己的持有权
+    chunk_pool_manager_.releaseShared(ret);
+    if(commit)
+    {
+        chunk_pool_manager_.commitChunks();
+    }
 
     chunks_--;
     return true;
@@ -74,9 +83,11 @@ size_t InputChainBuffer::remove(char *target, size_t len)
         //2.如果chunk完全空了，则归还这个chunk
         if(head_->readableBytes()==0)
         {
-            pop_front();
+            pop_front(false);
         }  
     }
+    //所有空的chunk一次性提交给内核
+    chunk_pool_manager_.commitChunks();
     
     LOG_DEBUG("chunks : %lu",chunks_);
     total_len_-=read_count;
@@ -112,12 +123,49 @@ void InputChainBuffer::retrieve(size_t len)
         read_bytes += offset;
         if(head_->readableBytes()==0)
         {
-            pop_front();
+            pop_front(false);
         }
     }
+    chunk_pool_manager_.commitChunks();
     total_len_ -= read_bytes;
 }
 
+ChunkLease InputChainBuffer::detach(size_t len)
+{
+    ChunkLease lease(&chunk_pool_manager_);
+    len = std::min(len,total_len_);
+    while(len>0&&head_)
+    {
+        size_t seg = std::min(head_->readableBytes(),len);
+        if(seg==head_->readableBytes())
+        {
+            //整个chunk都交给租约，持有权转移，不需要修改共享计数
+            Chunk* chunk = head_;
+            lease.append(chunk,chunk->beginRead(),seg);
+            if(head_==tail_)
+            {
+                head_=tail_=nullptr;
+            }
+            else
+            {
+                head_=head_->next_;
+            }
+            chunk->next_ = nullptr;
+            chunks_--;
+        }
+        else
+        {
+            //只取一部分，缓冲区和租约共同持有
+            head_->shares_++;
+            lease.append(head_,head_->beginRead(),seg);
+            head_->head_ += seg;
+        }
+        total_len_ -= seg;
+        len -= seg;
+    }
+    return lease;
+}
+
 // 这里的index 是cqe返回的buffer ring中内存块的下标
 void InputChainBuffer::append(uint16_t index, int len)
 {
@@ -126,3 +174,27 @@ void InputChainBuffer::append(uint16_t index, int len)
     tail_->tail_+=len;
     total_len_ += len;
 }
+
+void InputChainBuffer::appendCompact(uint16_t index, int len)
+{
+    auto& pool = chunk_pool_manager_;
+    //尾节点被租约共享时不合并，租约可能正在其它线程中读取这个chunk
+    if(tail_&&len>0&&(size_t)len<=pool.compact_threshold_&&tail_->shares_==0&&
+        pool.chunk_size_-tail_->tail_>=(size_t)len)
+    {
+        Chunk* chunk = pool.getChunkById(index);
+        std::memcpy(tail_->beginWrite(),chunk->data_ptr_,len);
+        tail_->tail_ += len;
+        total_len_ += len;
+
+        pool.onChunkFilled();
+        pool.stats_.compacted_chunks_++;
+        pool.stats_.compacted_bytes_ += len;
+        //立即归还给内核，没有进入缓冲区，但是归还时会减少持有数量，这里先计数
+        pool.onChunkHeld();
+        pool.returnOneChunk(chunk);
+        return;
+    }
+    pool.onChunkFilled();
+    append(index,len);
+}
@@ -1,3 +1,6 @@
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include <sys/eventfd.h>
 #include <cstring>
 #include <cassert>
@@ -6,10 +9,17 @@
 #include "IoUringLoop.h"
 #include "Logger.h"
 #include "ChunkPoolManagerInput.h"
+#include "ChunkPoolManagerOutput.h"
 #include "ReadContext.h"
 #include "WriteContext.h"
+#include "WriteOpContext.h"
+#include "SendQueue.hpp"
 #include "AcceptContext.h"
+#include "DirectReadContext.h"
+#include "ZeroCopySendContext.h"
+#include "FileSendContext.h"
 #include "TimerQueue.h"
+#include "FramePool.h"
 
 //防止一个线程创建多个eventloop
 //因为这个变量仅供内部判断使用，所以定义在实现文件，不对外暴露
@@ -60,6 +70,17 @@ void IoUringLoop::doingSubmitWaitingTask()
             case ContextType::Accept:
                 _submitAcceptMultishut(static_cast<AcceptContext*>(ctx));
                 break;
+            case ContextType::DirectRead:
+                _submitDirectRead(static_cast<DirectReadContext*>(ctx));
+                break;
+            case ContextType::ZeroCopySend:
+                _submitZeroCopySend(static_cast<ZeroCopySendContext*>(ctx));
+                break;
+            case ContextType::FileSend:
+                _submitFileSend(static_cast<FileSendContext*>(ctx));
+                break;
+            default:
+                break;
         }
         
         waiting_submit_queue_.pop();
@@ -107,14 +128,39 @@ void IoUringLoop::_submitReadMultishut(ReadContext *read_ctx)
 
 void IoUringLoop::_submitWriteMsg(WriteContext* write_ctx)
 {
-    //这里理论上sqe是不为nullptr的
-    auto sqe = getIoUringSqe(false);
-    assert(sqe&&"the sqe should not be nullptr");
+    //同一批链接的请求必须在同一次提交中连续地放入队列，空间不够时先把队列中已有的请求提交给内核
+    if(remainedSqe()<write_ctx->chain_len_) io_uring_submit(ring_);
 
-    // BUG FIX: 不要使用局部变量 msghdr，因为它在函数返回后会失效，导致内核读取垃圾数据
-    // 改用 writev，直接使用 WriteContext 中持久化的 iovec 数组
-    io_uring_prep_writev(sqe, write_ctx->fd_, write_ctx->temp_data_.data(), write_ctx->temp_data_.size(), 0);
-    io_uring_sqe_set_data(sqe,write_ctx);
+    for(size_t i=0;i<write_ctx->chain_len_;++i)
+    {
+        //这里理论上sqe是不为nullptr的
+        auto sqe = getIoUringSqe(false);
+        assert(sqe&&"the sqe should not be nullptr");
+
+        auto op = write_ctx->ops_[i].get();
+        bool link = i+1<write_ctx->chain_len_;
+        if(op->fixed_index_>=0)
+        {
+            //固定缓冲区中的数据，只有一个iovec，内核不需要再固定页面，没有写完时内核会断开链接
+            auto& iov = *op->pendingIovecs();
+            io_uring_prep_write_fixed(sqe, write_ctx->fd_, iov.iov_base, iov.iov_len, 0, op->fixed_index_);
+        }
+        else if(link)
+        {
+            //后面还有链接的请求，writev部分写入时链接就会断开，使用MSG_WAITALL让内核写完全部数据之后再开始下一个请求
+            op->msg_.msg_iov = op->pendingIovecs();
+            op->msg_.msg_iovlen = op->pendingCount();
+            io_uring_prep_sendmsg(sqe, write_ctx->fd_, &op->msg_, MSG_WAITALL);
+        }
+        else
+        {
+            // BUG FIX: 不要使用局部变量 msghdr，因为它在函数返回后会失效，导致内核读取垃圾数据
+            // 改用 writev，直接使用 WriteOpContext 中持久化的 iovec 数组
+            io_uring_prep_writev(sqe, write_ctx->fd_, op->pendingIovecs(), op->pendingCount(), 0);
+        }
+        if(link) sqe->flags |= IOSQE_IO_LINK;
+        io_uring_sqe_set_data(sqe,op);
+    }
 }
 
 void IoUringLoop::_submitAcceptMultishut(AcceptContext* accept_ctx)
@@ -129,6 +175,92 @@ void IoUringLoop::_submitAcceptMultishut(AcceptContext* accept_ctx)
     io_uring_sqe_set_data(sqe,accept_ctx);
 }
 
+void IoUringLoop::_submitDirectRead(DirectReadContext* direct_ctx)
+{
+    //这里理论上sqe是不为nullptr的
+    auto sqe = getIoUringSqe(false);
+    assert(sqe&&"the sqe should not be nullptr");
+
+    //直接写入用户的缓冲区，MSG_WAITALL 让内核在数据完整之后才返回cqe
+    io_uring_prep_recv(sqe, direct_ctx->fd_, direct_ctx->buf_+direct_ctx->filled_, direct_ctx->len_-direct_ctx->filled_, MSG_WAITALL);
+    io_uring_sqe_set_data(sqe,direct_ctx);
+}
+
+void IoUringLoop::_submitZeroCopySend(ZeroCopySendContext* zc_ctx)
+{
+    //这里理论上sqe是不为nullptr的
+    auto sqe = getIoUringSqe(false);
+    assert(sqe&&"the sqe should not be nullptr");
+
+    //固定缓冲区中的数据直接使用SEND_ZC，通知中报告内核是否实际进行了拷贝
+    if(zc_ctx->buf_index_>=0)
+    {
+        auto& iov = zc_ctx->msg_.msg_iov[0];
+        io_uring_prep_send_zc_fixed(sqe, zc_ctx->owner_.fd_, iov.iov_base, iov.iov_len, 0, IORING_SEND_ZC_REPORT_USAGE, zc_ctx->buf_index_);
+    }
+    else
+    {
+        //msghdr保存在上下文中，直到结果返回之前都有效
+        io_uring_prep_sendmsg_zc(sqe, zc_ctx->owner_.fd_, &zc_ctx->msg_, 0);
+        sqe->ioprio |= IORING_SEND_ZC_REPORT_USAGE;
+    }
+    io_uring_sqe_set_data(sqe,zc_ctx);
+}
+
+void IoUringLoop::_submitFileSend(FileSendContext* ctx)
+{
+    //链接的两个请求必须连续地放入队列，空间不够时先把队列中已有的请求提交给内核
+    if(remainedSqe()<2) io_uring_submit(ring_);
+
+    int sock_fd = ctx->owner_.fd_;
+    if(ctx->in_.len_>0)
+    {
+        //这里理论上sqe是不为nullptr的
+        auto sqe = getIoUringSqe(false);
+        assert(sqe&&"the sqe should not be nullptr");
+        //没有读完时内核会断开链接，之后的写入被取消
+        if(ctx->use_splice_)
+        {
+            io_uring_prep_splice(sqe, ctx->file_fd_, ctx->file_offset_, ctx->pipe_[1], -1, ctx->in_.len_, 0);
+        }
+        else if(ctx->registered())
+        {
+            io_uring_prep_read_fixed(sqe, ctx->file_fd_, ctx->chunk_->data_ptr_, ctx->in_.len_, ctx->file_offset_, ctx->chunk_->index_);
+        }
+        else
+        {
+            io_uring_prep_read(sqe, ctx->file_fd_, ctx->chunk_->data_ptr_, ctx->in_.len_, ctx->file_offset_);
+        }
+        sqe->flags |= IOSQE_IO_LINK;
+        io_uring_sqe_set_data(sqe,&ctx->in_);
+    }
+    else if(ctx->wait_writable_)
+    {
+        //socket的缓冲区满时splice直接返回EAGAIN，不会像普通的写入一样等待，所以先等待socket可写，poll的结果不需要处理
+        auto sqe = getIoUringSqe(false);
+        assert(sqe&&"the sqe should not be nullptr");
+        io_uring_prep_poll_add(sqe, sock_fd, POLLOUT);
+        sqe->flags |= IOSQE_IO_LINK;
+        io_uring_sqe_set_data(sqe,0);
+    }
+
+    auto sqe = getIoUringSqe(false);
+    assert(sqe&&"the sqe should not be nullptr");
+    if(ctx->use_splice_)
+    {
+        io_uring_prep_splice(sqe, ctx->pipe_[0], -1, sock_fd, -1, ctx->out_.len_, 0);
+    }
+    else if(ctx->registered())
+    {
+        io_uring_prep_write_fixed(sqe, sock_fd, ctx->chunk_->data_ptr_+ctx->chunk_offset_, ctx->out_.len_, 0, ctx->chunk_->index_);
+    }
+    else
+    {
+        io_uring_prep_write(sqe, sock_fd, ctx->chunk_->data_ptr_+ctx->chunk_offset_, ctx->out_.len_, 0);
+    }
+    io_uring_sqe_set_data(sqe,&ctx->out_);
+}
+
 IoUringLoop::IoUringLoop(size_t ring_size,size_t cqes_size,size_t low_water_mark,size_t chunk_size,size_t chunk_num)
     :IoContext(ContextType::Wakeup)
     ,ring_(new io_uring{})
@@ -138,6 +270,9 @@ IoUringLoop::IoUringLoop(size_t ring_size,size_t cqes_size,size_t low_water_mark
     ,time_out_(kPollTimeS)
     ,sqe_low_water_mark_(low_water_mark)
     ,calling_pending_functors_(false)
+    ,hop_head_(nullptr)
+    ,hop_tail_(nullptr)
+    ,has_hops_(false)
     ,wakeup_fd_(createEventFd())
     ,input_chunk_manager_(nullptr)
     ,thread_id_(CurrentThread::tid())
@@ -145,6 +280,16 @@ IoUringLoop::IoUringLoop(size_t ring_size,size_t cqes_size,size_t low_water_mark
     ,timer_queue_(std::make_unique<TimerQueue>(*this))
     ,CHUNK_SIZE(chunk_size)
     ,CHUNK_NUM(chunk_num)
+    ,fragment_pool_(std::make_unique<TxFragmentPool>())
+    ,frame_pool_(std::make_unique<FramePool>())
+    ,pipe_size_(0)
+    ,defer_resume_(false)
+    ,resume_budget_(kDefaultResumeBudget)
+    ,cqe_budget_(0)
+    ,functor_budget_(0)
+    ,functors_left_(false)
+    ,stats_{}
+    ,slow_threshold_us_(0)
 {
     LOG_DEBUG("IoUringLoop created %p in thread %d", this, this->thread_id_);
     //one loop per thread,如果t_loopInThisThread不为空，说明当前线程已有一个实例
@@ -153,6 +298,8 @@ IoUringLoop::IoUringLoop(size_t ring_size,size_t cqes_size,size_t low_water_mark
         LOG_FATAL("another eventLoop %p already exists in this thread %d",t_loopInThisThread,this->thread_id_)
     }
     t_loopInThisThread=this;
+    //之后这个线程中创建的协程帧从这个loop的内存池中分配
+    FramePool::setCurrent(frame_pool_.get());
 
     //检查chunk_num是否是2的n次方
     if(chunk_num&(chunk_num-1))
@@ -173,6 +320,14 @@ IoUringLoop::IoUringLoop(const IoUringLoopParams &params)
 IoUringLoop::~IoUringLoop()
 {
     ::close(this->wakeup_fd_);
+    for(auto& fds:free_pipes_)
+    {
+        ::close(fds[0]);
+        ::close(fds[1]);
+    }
+    //内存池析构时要取消注册，必须在io_uring销毁之前
+    output_chunk_manager_.reset();
+    input_chunk_manager_.reset();
     io_uring_queue_exit(ring_);
     delete ring_;
     t_loopInThisThread=nullptr;//重新设置此线程的eventloop对象为空指针
@@ -192,9 +347,13 @@ void IoUringLoop::loop()
     while(!quit_)
     {
         io_uring_submit(ring_);
+        stats_.iterations_++;
+        //超过预算的cqe留在完成队列中，下一次循环再处理
+        size_t cqe_limit = cqe_budget_?std::min(cqe_budget_,cqes_.size()):cqes_.size();
         //等待cqe返回
-        int count = io_uring_peek_batch_cqe(ring_,cqes_.data(),cqes_.size());
-        if(count == 0)
+        int count = io_uring_peek_batch_cqe(ring_,cqes_.data(),cqe_limit);
+        //就绪队列、任务队列或者切换链表中还有工作时不能阻塞等待
+        if(count == 0 && ready_handles_.empty() && !functors_left_ && !has_hops_.load(std::memory_order_acquire))
         {
             //获取超时时间
             __kernel_timespec ts = getTimeOutPeriod();
@@ -213,11 +372,14 @@ void IoUringLoop::loop()
                 }
             }
 
-            count = io_uring_peek_batch_cqe(ring_,cqes_.data(),cqes_.size());
+            count = io_uring_peek_batch_cqe(ring_,cqes_.data(),cqe_limit);
             this->pollReturnTime_ = Timestamp::now();
 
         }
         LOG_DEBUG("%d events happend",count)
+        stats_.cqes_ += count;
+        //取满了预算，完成队列中可能还有剩下的cqe
+        if(cqe_limit<cqes_.size()&&size_t(count)==cqe_limit) stats_.budget_exhausted_++;
         //处理定时器任务
         timer_queue_->handleRead();
 
@@ -237,16 +399,23 @@ void IoUringLoop::loop()
             IoContext*context = reinterpret_cast<IoContext*>(cqe->user_data);
             context->flags_ = cqe->flags;
             context->res_ = cqe->res;
+            //处理函数可能关闭连接并释放上下文，之后不能再访问context
+            ContextType type = context->type_;
+
+            //处理函数中可能修改阈值，计时前后使用同一个判断
+            bool timing = slow_threshold_us_>0;
+            MonotonicTimestamp start;
+            if(timing) start = MonotonicTimestamp::now();
 
             //使用 Switch + Static Cast 替代虚函数 on_completion()
             //能够极大减少分支预测失败的开销，并消除 vptr
-            switch (context->type_)
+            switch (type)
             {
                 case ContextType::Read:
                     static_cast<ReadContext*>(context)->on_completion();
                     break;
-                case ContextType::Write:
-                    static_cast<WriteContext*>(context)->on_completion();
+                case ContextType::WriteOp:
+                    static_cast<WriteOpContext*>(context)->on_completion();
                     break;
                 case ContextType::Accept:
                     static_cast<AcceptContext*>(context)->on_completion();
@@ -254,26 +423,132 @@ void IoUringLoop::loop()
                 case ContextType::Wakeup:
                     static_cast<IoUringLoop*>(context)->on_completion();
                     break;
+                case ContextType::DirectRead:
+                    static_cast<DirectReadContext*>(context)->on_completion();
+                    break;
+                case ContextType::ZeroCopySend:
+                    static_cast<ZeroCopySendContext*>(context)->on_completion();
+                    break;
+                case ContextType::FileSendOp:
+                    static_cast<FileSendOp*>(context)->on_completion();
+                    break;
                 default:
                     LOG_ERROR("unknown context");
                     break;
             } 
+            if(timing) checkSlow(context,int(type),start);
         }
 
         //推进cq
         if(count!=0) io_uring_cq_advance(ring_,count);
 
+        //恢复这一批cqe唤醒的协程和其它线程切换过来的协程
+        if(has_hops_.load(std::memory_order_acquire)) takeHops();
+        doingReadyHandles();
 
         //执行submit等待队列中的请求
         doingSubmitWaitingTask();
         //执行其它loop追加到这个loop的任务
         this->doingPendingFunctors();
+        //在下一次提交之前发送这一次循环中追加的数据
+        flushPendingWrites();
     }
 
     looping_=false;
     LOG_INFO("EventLoop %p stop looping", this);
 }
 
+void IoUringLoop::doingReadyHandles()
+{
+    if(ready_handles_.empty()) return;
+    //只恢复这一次开始时已经在队列中的协程，恢复过程中yield的协程留到下一次循环
+    size_t end = ready_handles_.size();
+    size_t budget = resume_budget_?resume_budget_:end;
+    size_t resumed = 0;
+    size_t i = 0;
+    //恢复的协程可能撤销队列中后面的协程(比如whenAny取消其它分支)，被撤销的位置为空
+    for(;i<end&&resumed<budget;++i)
+    {
+        //先置空，恢复的协程之后再次挂起时不会被cancelReady误删
+        auto entry = std::exchange(ready_handles_[i],ReadyEntry{nullptr,nullptr});
+        if(!entry.handle_) continue;
+        resumed++;
+        bool timing = slow_threshold_us_>0;
+        MonotonicTimestamp start;
+        int type = -1;
+        if(timing)
+        {
+            //恢复的协程可能关闭连接并释放上下文，先取出类型
+            if(entry.ctx_) type = int(entry.ctx_->type_);
+            start = MonotonicTimestamp::now();
+        }
+        entry.handle_.resume();
+        if(timing) checkSlow(entry.ctx_,type,start);
+    }
+    stats_.resumes_ += resumed;
+    if(i<end) stats_.budget_exhausted_++;
+    ready_handles_.erase(ready_handles_.begin(),ready_handles_.begin()+i);
+}
+
+void IoUringLoop::resumeHandle(std::coroutine_handle<> h,IoContext* ctx)
+{
+    auto loop = t_loopInThisThread;
+    if(loop&&loop->defer_resume_)
+    {
+        loop->ready_handles_.push_back({h,ctx});
+        return;
+    }
+    h.resume();
+}
+
+void IoUringLoop::cancelReady(std::coroutine_handle<> h)
+{
+    if(!isInLoopThread()) return;
+    for(auto& entry:ready_handles_)
+    {
+        if(entry.handle_==h) entry = {nullptr,nullptr};
+    }
+}
+
+void IoUringLoop::setSlowHandlerThreshold(int64_t threshold_us, SlowHandlerCallback cb)
+{
+    slow_threshold_us_ = threshold_us;
+    slow_handler_callback_ = std::move(cb);
+}
+
+void IoUringLoop::checkSlow(const IoContext *ctx, int type, MonotonicTimestamp start)
+{
+    int64_t cost = MonotonicTimestamp::now().microSecondsSinceEpoch()-start.microSecondsSinceEpoch();
+    if(cost>stats_.max_handler_us_) stats_.max_handler_us_ = cost;
+    if(cost<slow_threshold_us_) return;
+    stats_.slow_handlers_++;
+    if(slow_handler_callback_)
+    {
+        slow_handler_callback_(ctx,cost);
+    }
+    else
+    {
+        LOG_INFO("%p slow handler: context %p type %d took %ld us",this,ctx,type,cost);
+    }
+}
+
+LoopYieldAwaiter::~LoopYieldAwaiter()
+{
+    if(parked_) loop_->cancelReady(parked_);
+}
+
+void LoopYieldAwaiter::await_suspend(std::coroutine_handle<> h)
+{
+    if(!loop_->isInLoopThread())
+    {
+        loop_->queueInLoop([h](){h.resume();});
+        return;
+    }
+    parked_ = h;
+    loop_->stats_.yields_++;
+    loop_->ready_handles_.push_back({h,nullptr});
+}
+
 void IoUringLoop::quit()
 {
     quit_=true;
@@ -313,6 +588,68 @@ void IoUringLoop::queueInLoop(Functor cb)
     }
 }
 
+void IoUringLoop::queueHop(LoopHop *hop)
+{
+    hop->next_ = nullptr;
+    bool first = false;
+    {
+        std::lock_guard<std::mutex>lock(mtx_);
+        if(hop_tail_) hop_tail_->next_ = hop;
+        else
+        {
+            hop_head_ = hop;
+            first = true;
+        }
+        hop_tail_ = hop;
+        has_hops_.store(true,std::memory_order_release);
+    }
+    //链表不为空时loop已经被唤醒，会在同一次循环中一起取出，不需要再写eventfd
+    if(first&&(!isInLoopThread()||calling_pending_functors_))
+    {
+        this->wakeUp();
+    }
+}
+
+void IoUringLoop::takeHops()
+{
+    LoopHop* hops = nullptr;
+    {
+        std::lock_guard<std::mutex>lock(mtx_);
+        hops = std::exchange(hop_head_,nullptr);
+        hop_tail_ = nullptr;
+        has_hops_.store(false,std::memory_order_relaxed);
+    }
+    //按照切换的顺序放入就绪队列，和其它就绪的协程一样受预算的限制
+    while(hops)
+    {
+        auto hop = hops;
+        hops = hop->next_;
+        if(hop->run_) hop->run_(hop);
+        else ready_handles_.push_back({hop->handle_,nullptr});
+    }
+}
+
+IoUringLoop* currentLoop()
+{
+    return t_loopInThisThread;
+}
+
+LoopSwitchAwaiter switchTo(IoUringLoop &loop)
+{
+    return LoopSwitchAwaiter(&loop);
+}
+
+bool LoopSwitchAwaiter::await_ready()
+{
+    return loop_->isInLoopThread();
+}
+
+void LoopSwitchAwaiter::await_suspend(std::coroutine_handle<> h)
+{
+    hop_.handle_ = h;
+    loop_->queueHop(&hop_);
+}
+
 void IoUringLoop::wakeUp()
 {
     uint64_t data=1;
@@ -324,6 +661,49 @@ void IoUringLoop::wakeUp()
     }
 }
 
+ChunkPoolManagerOutput &IoUringLoop::getOutputPool()
+{
+    if(!output_chunk_manager_)
+    {
+        output_chunk_manager_ = std::make_unique<ChunkPoolManagerOutput>(*this);
+    }
+    return *output_chunk_manager_;
+}
+
+bool IoUringLoop::acquirePipe(int fds[2])
+{
+    if(!free_pipes_.empty())
+    {
+        fds[0] = free_pipes_.back()[0];
+        fds[1] = free_pipes_.back()[1];
+        free_pipes_.pop_back();
+        return true;
+    }
+    if(::pipe2(fds,O_CLOEXEC)<0)
+    {
+        LOG_ERROR("IoUringLoop failed to create a pipe, error:%s",strerror(errno));
+        return false;
+    }
+    //扩大管道的容量，一次splice可以中转更多的数据，失败时使用默认的容量
+    int size = ::fcntl(fds[1],F_SETPIPE_SZ,(int)kPipeSize);
+    if(size<0) size = ::fcntl(fds[1],F_GETPIPE_SZ);
+    if(pipe_size_==0||size_t(size)<pipe_size_) pipe_size_ = size;
+    return true;
+}
+
+void IoUringLoop::releasePipe(int fds[2])
+{
+    if(free_pipes_.size()<kMaxFreePipes)
+    {
+        free_pipes_.push_back({fds[0],fds[1]});
+    }
+    else
+    {
+        ::close(fds[0]);
+        ::close(fds[1]);
+    }
+}
+
 void IoUringLoop::submitReadMultishut(ReadContext* ctx)
 {
     if(remainedSqe()<sqe_low_water_mark_)
@@ -363,7 +743,46 @@ void IoUringLoop::submitAcceptMultishut(AcceptContext* ctx)
     }
 }
 
-void IoUringLoop::submitCancel(ReadContext *ctx)
+void IoUringLoop::submitDirectRead(DirectReadContext* ctx)
+{
+    if(remainedSqe()<sqe_low_water_mark_)
+    {
+        waiting_submit_queue_
+            .emplace(static_cast<IoContext*>(ctx));
+    }
+    else
+    {
+        _submitDirectRead(ctx);
+    }
+}
+
+void IoUringLoop::submitZeroCopySend(ZeroCopySendContext* ctx)
+{
+    if(remainedSqe()<sqe_low_water_mark_)
+    {
+        waiting_submit_queue_
+            .emplace(static_cast<IoContext*>(ctx));
+    }
+    else
+    {
+        _submitZeroCopySend(ctx);
+    }
+}
+
+void IoUringLoop::submitFileSend(FileSendContext* ctx)
+{
+    if(remainedSqe()<sqe_low_water_mark_)
+    {
+        waiting_submit_queue_
+            .emplace(static_cast<IoContext*>(ctx));
+    }
+    else
+    {
+        _submitFileSend(ctx);
+    }
+}
+
+void IoUringLoop::submitCancel(IoContext *ctx)
 {
     auto sqe = getIoUringSqe(true);
 
@@ -397,6 +816,17 @@ void IoUringLoop::cancel(TimerId timer_id)
     timer_queue_->cancelTimer(timer_id);
 }
 
+void IoUringLoop::flushPendingWrites()
+{
+    //发送的过程中可能会有新的连接加入，先交换出来，两个数组交替使用避免重复分配
+    flushing_writes_.swap(pending_writes_);
+    for(auto ctx:flushing_writes_)
+    {
+        ctx->flushQueued();
+    }
+    flushing_writes_.clear();
+}
+
 void IoUringLoop::doingPendingFunctors()
 {
     //先设置正在执行追加任务的标志为true
@@ -409,9 +839,23 @@ void IoUringLoop::doingPendingFunctors()
         std::lock_guard<std::mutex>lock(this->mtx_);
         tasks.swap(this->pendingFunctors_);
     }
-    for(const auto&task:tasks)
+    size_t limit = functor_budget_?std::min(functor_budget_,tasks.size()):tasks.size();
+    for(size_t i=0;i<limit;++i)
     {
-        task();
+        bool timing = slow_threshold_us_>0;
+        MonotonicTimestamp start;
+        if(timing) start = MonotonicTimestamp::now();
+        tasks[i]();
+        if(timing) checkSlow(nullptr,-1,start);
+    }
+    stats_.functors_ += limit;
+    //超过预算的任务放回队列的前面，保持原来的顺序
+    functors_left_ = limit<tasks.size();
+    if(functors_left_)
+    {
+        stats_.budget_exhausted_++;
+        std::lock_guard<std::mutex>lock(this->mtx_);
+        pendingFunctors_.insert(pendingFunctors_.begin(),std::make_move_iterator(tasks.begin()+limit),std::make_move_iterator(tasks.end()));
     }
     this->calling_pending_functors_=false;
 }
@@ -2,7 +2,10 @@
 #include <liburing.h>
 
 #include "ReadContext.h"
+#include "DirectReadContext.h"
 #include "TcpConnection.h"
+#include "IoUringLoop.h"
+#include "ChunkPoolManagerInput.h"
 #include "Logger.h"
 
 //注意：read cqe 的返回顺序和cancel cqe 的返回顺序是随机的，所以不能靠 cancel CQE 改状态
@@ -19,6 +22,10 @@ ReadContext::ReadContext(size_t high_water_mark, size_t high_water_mark_chunk, i
     ,read_handle_(nullptr)
     ,input_buffer_(manager)
     ,is_error_(false)
+    ,frame_waiter_(nullptr)
+    ,wake_len_(0)
+    ,direct_waiter_(nullptr)
+    ,max_wait_len_(manager.chunks_data_.size()*manager.chunk_size_/2)
 {
 }
 
@@ -103,7 +110,8 @@ void ReadContext::on_completion()
         {
             buf_id = flags_ >> IORING_CQE_BUFFER_SHIFT;
         }
-        input_buffer_.append(buf_id,res_);
+        //小数据合并到前一个chunk中，避免大量几乎为空的chunk触发chunk数量的高水位线
+        input_buffer_.appendCompact(buf_id,res_);
 
         //如果输入缓冲区的数据超过了其中一个高水位线且当前的状态不为canceling，则发送cancel sqe并转换状态
         if(overLoad()&&status_!=ReadStatus::CANCELING)
@@ -120,10 +128,27 @@ void ReadContext::on_completion()
     {
         //状态为canceling且没有致命错误，说明是因为高水位线导致的停止，停止提交，应该通知协程处理数据
         //或者是因为 ENOBUFS 导致的停止，也应该暂停提交，等待用户消费数据
-        if(status_==ReadStatus::CANCELING && !need_close)
+        //有协程在等待直接接收，multishot已经停止，交给direct read context继续接收
+        if(direct_waiter_ && !need_close)
         {
+            auto waiter = direct_waiter_;
+            direct_waiter_ = nullptr;
             status_ = ReadStatus::STOPED;
-            holder_.reset();
+            waiter->start(*this,std::move(holder_));
+            return;
+        }
+        else if(status_==ReadStatus::CANCELING && !need_close)
+        {
+            //协程正在等待的帧还不完整，停止读取会导致永远无法唤醒，继续提交
+            if(read_handle_&&!readyToWake())
+            {
+                holder_->submitRead(this);
+            }
+            else
+            {
+                status_ = ReadStatus::STOPED;
+                holder_.reset();
+            }
         }
         //没有致命错误，说明是可以继续状态的错误，继续提交。
         else if(status_==ReadStatus::READING&&!need_close)
@@ -137,18 +162,20 @@ void ReadContext::on_completion()
                 read_handle_.resume();
             }
             holder_->handleClose();
-            holder_.reset();
             status_ = ReadStatus::STOPED;
+            //可能是连接的最后一个引用，释放之后不能再访问成员
+            holder_.reset();
             return;
         }
     }
 
-    if(read_handle_)
+    if(read_handle_&&readyToWake())
     {
         auto handle = read_handle_;
         read_handle_=nullptr;
         assert(!handle.done()&&"coroutine is done,some logic is wrong");
-        handle.resume();
+        //开启延迟恢复时在这一批cqe处理完之后再恢复
+        IoUringLoop::resumeHandle(handle,this);
     }
 }
 
@@ -1,7 +1,9 @@
 
 
+#include <cassert>
 #include "TcpConnection.h"
 #include "IoUringLoop.h"
+#include "ChunkPoolManagerOutput.h"
 #include "Logger.h"
 
 void TcpConnection::handleClose()
@@ -16,13 +18,21 @@ void TcpConnection::handleClose()
         /*如果业务协程并没有被read/write context阻塞挂起，则业务协程可能在其它线程中运行，这个时候不能直接
           销毁协程，会出现未定义行为，要等到业务协程执行完毕，要读取或者是发送数据的时候在调用awaiter时
           检查连接是否关闭，如果关闭则直接退出，然后向对应loop中加入销毁协程的任务*/
-        if(read_context_.read_handle_||write_context_.write_handle_)
+        //直接接收的recv还没有返回时不能销毁协程，内核还会写入协程提供的缓冲区，取消请求之后在cqe返回时再销毁
+        if(direct_read_context_.is_reading_)
+        {
+            loop_.submitCancel(&direct_read_context_);
+        }
+        else if(read_context_.read_handle_||write_context_.write_handle_||direct_read_context_.read_handle_)
         {
             task_handle_.destroy();
         }
         //将相关的资源置空
         read_context_.read_handle_ = nullptr;
+        read_context_.frame_waiter_ = nullptr;
+        read_context_.direct_waiter_ = nullptr;
         write_context_.write_handle_ = nullptr;
+        write_context_.releaseReserved();
 
         if(close_callback_)
         {
@@ -35,20 +45,31 @@ void TcpConnection::handleClose()
     }
 }
 
-void TcpConnection::sendInLoop(std::string data)
+void TcpConnection::sendInLoop(const Payload &payload)
 {
-    //向缓冲区中追加数据
-    write_context_.output_buffer_.append(std::move(data));
+    write_context_.output_buffer_.append(payload);
+    startSending();
+}
 
+void TcpConnection::startSending()
+{
     //如果检查write_context中没有已经发送的sqe就发送，否则已经有一个sqe发出去了，所以不发送
-    if(!write_context_.is_sending_)
+    if(write_context_.is_sending_||write_context_.output_buffer_.isEmpty()) return;
+
+    //先把智能指针赋值，保证生命周期，再发送数据
+    write_context_.holder_ = shared_from_this();
+    if(write_context_.low_latency_)
     {
-        //先把智能指针赋值，保证生命周期，再发送数据
-        write_context_.holder_ = shared_from_this();
         write_context_.flush();
         // is_sending_ 在 flush 中已经被设置为 true 了，这里可以省略，或者保持一致性
         write_context_.is_sending_ = true;
     }
+    //同一次循环中之后追加的数据在循环末尾和这次的数据一起提交
+    else if(!write_context_.flush_queued_)
+    {
+        write_context_.flush_queued_ = true;
+        loop_.queueWrite(&write_context_);
+    }
 }
 
 void TcpConnection::submitWrite(WriteContext *w_ctx)
@@ -56,6 +77,16 @@ void TcpConnection::submitWrite(WriteContext *w_ctx)
     loop_.submitWriteMsg(w_ctx);
 }
 
+void TcpConnection::submitZeroCopySend(ZeroCopySendContext *zc_ctx)
+{
+    loop_.submitZeroCopySend(zc_ctx);
+}
+
+void TcpConnection::submitFileSend(FileSendContext *file_ctx)
+{
+    loop_.submitFileSend(file_ctx);
+}
+
 void TcpConnection::submitRead(ReadContext *r_ctx)
 {
     read_context_.holder_ = shared_from_this();//设置holder
@@ -68,6 +99,12 @@ void TcpConnection::submitCancel(ReadContext *r_ctx)
     loop_.submitCancel(r_ctx);
 }
 
+void TcpConnection::submitDirectRead(DirectReadContext *d_ctx)
+{
+    d_ctx->is_reading_ = true;
+    loop_.submitDirectRead(d_ctx);
+}
+
 TcpConnection::TcpConnection(
     std::string name, 
     IoUringLoop&loop, 
@@ -86,42 +123,144 @@ TcpConnection::TcpConnection(
     ,local_addr_(std::move(local_addr))
     ,peer_addr_(std::move(peer_addr))
     ,read_context_(input_high_water_mark,input_high_water_mark_chunk,sockfd,loop.getInputPool())
-    ,write_context_(out_put_high_water_mark,sockfd)
+    ,write_context_(out_put_high_water_mark,sockfd,&loop.getFragmentPool())
+    ,direct_read_context_(sockfd)
 {
     LOG_INFO("new TCP connection created, name=%s, fd=%d",name_.c_str(),sockfd)
     sock_.setKeepAlive(true);
+    setMaxFrameLength(frame_decoder_.maxFrameLength());
 }
 
 TcpConnection::~TcpConnection()
 {
     LOG_INFO("TCP connection destroyed, name=%s, fd=%d",name_.c_str(),sock_.fd());
+    //先销毁业务协程，协程中挂起的awaiter在析构时还会访问连接的成员
+    task_handle_.destroy();
+}
+
+SendDataAwaiter<std::string> TcpConnection::send(std::string data, Priority priority)
+{
+    return SendDataAwaiter<std::string>(this,std::move(data),priority);
+}
+
+SendDataAwaiter<std::vector<char>> TcpConnection::send(std::vector<char> data, Priority priority)
+{
+    return SendDataAwaiter<std::vector<char>>(this,std::move(data),priority);
+}
+
+SendDataAwaiter<Payload> TcpConnection::send(Payload payload, Priority priority)
+{
+    return SendDataAwaiter<Payload>(this,std::move(payload),priority);
+}
+
+SendDataAwaiter<GuardedView> TcpConnection::send(std::string_view data, std::shared_ptr<const void> guard, Priority priority)
+{
+    return SendDataAwaiter<GuardedView>(this,GuardedView{data,std::move(guard)},priority);
+}
+
+SendDataAwaiter<GuardedIovecs> TcpConnection::send(std::span<const iovec> iovecs, std::shared_ptr<const void> guard, Priority priority)
+{
+    return SendDataAwaiter<GuardedIovecs>(this,GuardedIovecs{iovecs,std::move(guard)},priority);
+}
+
+SendDataAwaiter<FileRange> TcpConnection::sendFile(int fd, off_t offset, size_t len, std::shared_ptr<const void> guard)
+{
+    return SendDataAwaiter<FileRange>(this,FileRange{fd,offset,len,std::move(guard)});
 }
 
-SendDataAwaiter TcpConnection::send(std::string data)
+std::span<char> TcpConnection::reserve(size_t n)
 {
-    return SendDataAwaiter(this,std::move(data));
+    if(!loop_.isInLoopThread())
+    {
+        LOG_ERROR("TcpConnection::reserve must be called in the loop thread, name=%s",name_.c_str());
+        return {};
+    }
+    if(closing_) return {};
+
+    char* ptr = write_context_.reserve(loop_.getOutputPool(),n);
+    if(!ptr) return {};
+    return {ptr,write_context_.reserved_len_};
+}
+
+CommitAwaiter TcpConnection::commit(size_t n)
+{
+    return CommitAwaiter(this,n);
 }
 
 RecvDataAwaiter TcpConnection::PrepareToRead()
 {
+    releaseFrames();
     return RecvDataAwaiter(this);
 }
 
+RecvDataAwaiter TcpConnection::PrepareToRead(size_t min_len)
+{
+    releaseFrames();
+    return RecvDataAwaiter(this,std::max<size_t>(min_len,1));
+}
+
+void TcpConnection::setMaxFrameLength(size_t len)
+{
+    //等待帧时整个帧都要缓冲在输入缓冲区中，不能超过等待时允许缓冲的字节数
+    frame_decoder_.setMaxFrameLength(std::min(len,read_context_.max_wait_len_-FrameDecoder::kHeaderLen));
+}
+
 std::string TcpConnection::read(size_t size)
 {
+    releaseFrames();
     return read_context_.input_buffer_.removeAsString(size);
 }
 
 std::pair<char *, size_t> TcpConnection::peek()
 {
+    releaseFrames();
     return read_context_.input_buffer_.peek();
 }
 
 void TcpConnection::retrieve(size_t size)
 {
+    releaseFrames();
     return read_context_.input_buffer_.retrieve(size);
 }
 
+RecvIntoAwaiter TcpConnection::recvInto(char *buf, size_t len)
+{
+    return RecvIntoAwaiter(this,buf,len);
+}
+
+ChunkLease TcpConnection::lease(size_t len)
+{
+    releaseFrames();
+    return read_context_.input_buffer_.detach(len);
+}
+
+ChainReader TcpConnection::reader()
+{
+    releaseFrames();
+    return ChainReader(read_context_.input_buffer_);
+}
+
+RecvFrameAwaiter TcpConnection::readFrame()
+{
+    return RecvFrameAwaiter(this);
+}
+
+RecvFramesAwaiter TcpConnection::readFrames(size_t batch)
+{
+    return RecvFramesAwaiter(this,batch);
+}
+
+AsyncGenerator<Frame> TcpConnection::frames()
+{
+    while(true)
+    {
+        //上一个帧在这里被释放
+        Frame frame = co_await readFrame();
+        if(!frame.valid()) co_return;
+        co_yield frame;
+    }
+}
+
 void TcpConnection::Established(Task<> task_handle)
 {
     task_handle_ = std::move(task_handle);
@@ -131,49 +270,85 @@ void TcpConnection::Established(Task<> task_handle)
 
 bool RecvDataAwaiter::await_ready()
 {
-    //如果连接已经关闭，直接返回
-    if(conn_->closing()) return true;
+    //如果连接已经关闭或者等待的数据太长，直接返回
+    if(conn_->closing()||tooLong()) return true;
 
     //判断是否在当前的线程中，如果不在，直接挂起
     if(!conn_->loop_.isInLoopThread()) return false;
-    //如果在loop线程，判断是否有数据可读，如果没有，就挂起
-    return !conn_->read_context_.isEmpty();
+    //如果在loop线程，判断是否有足够的数据可读，如果没有，就挂起
+    return conn_->read_context_.input_buffer_.getTotalLen()>=min_len_;
+}
+
+void RecvDataAwaiter::suspendInLoop(std::coroutine_handle<> h)
+{
+    //这里协程挂起了，只要是协程挂起就要把handle交到一个地方以防无法唤醒
+    parked_ = h;
+    conn_->read_context_.read_handle_ = h;
+    conn_->read_context_.wake_len_ = min_len_;
+    //如果没有在提交的任务，就提交任务
+    if(conn_->read_context_.status_== ReadContext::ReadStatus::STOPED)
+    {
+        conn_->submitRead(&conn_->read_context_);
+    }
+}
+
+void RecvDataAwaiter::runHop(LoopHop *hop)
+{
+    auto self = static_cast<RecvDataAwaiter*>(hop);
+    if(self->conn_->read_context_.input_buffer_.getTotalLen()<self->min_len_)
+    {
+        self->suspendInLoop(hop->handle_);
+    }
+    //数据已经足够，和这一次循环中其它跨线程的协程一起在就绪队列中恢复
+    else
+    {
+        self->parked_ = hop->handle_;
+        self->conn_->loop_.post(hop->handle_);
+    }
 }
 
 void RecvDataAwaiter::await_suspend(std::coroutine_handle<> h)
 {
-    //如果不在当前的任务队列向loop的任务队列提交任务
+    //如果不在loop线程，把awaiter加入loop的切换链表，在loop中检查数据
     if(!conn_->loop_.isInLoopThread())
     {
-        conn_->loop_.queueInLoop([h,this](){
-            if(conn_->read_context_.isEmpty())
-            {
-                conn_->read_context_.read_handle_ = h;
-                if(conn_->read_context_.status_== ReadContext::ReadStatus::STOPED){
-                    conn_->submitRead(&conn_->read_context_);
-                }
-            }
-            else
-            {
-                h.resume();
-            }
-        });
+        handle_ = h;
+        run_ = &RecvDataAwaiter::runHop;
+        conn_->loop_.queueHop(this);
     }
     //如果在当前的线程且触发了这个函数，就代表输入缓冲区中无数据，提交读任务
     else
     {
-        //这里协程挂起了，只要是协程挂起就要把handle交到一个地方以防无法唤醒
-        conn_->read_context_.read_handle_ = h;
-        //如果没有在提交的任务，就提交任务
-        if(conn_->read_context_.status_== ReadContext::ReadStatus::STOPED)
-        {
-            conn_->submitRead(&conn_->read_context_);
-        }
+        suspendInLoop(h);
+    }
+}
+
+RecvDataAwaiter::~RecvDataAwaiter()
+{
+    //协程挂起时被销毁(比如whenAny取消了这个分支)，撤销在连接上的等待，之后收到的数据留在输入缓冲区中
+    if(!parked_) return;
+    if(conn_->read_context_.read_handle_==parked_)
+    {
+        conn_->read_context_.read_handle_ = nullptr;
+        conn_->read_context_.wake_len_ = 0;
+    }
+    //数据已经到达，协程在就绪队列中等待恢复
+    else
+    {
+        conn_->loop_.cancelReady(parked_);
+        if(!conn_->read_context_.read_handle_) conn_->read_context_.wake_len_ = 0;
     }
 }
 
 int RecvDataAwaiter::await_resume()
 {
+    parked_ = nullptr;
+    conn_->read_context_.wake_len_ = 0;
+    if(tooLong())
+    {
+        LOG_ERROR("PrepareToRead min_len %lu exceeds the limit %lu, use recvInto instead",min_len_,conn_->read_context_.max_wait_len_);
+        return -1;
+    }
     if(conn_->read_context_.is_error_) return -1;
     if(conn_->closing())
     {
@@ -183,7 +358,125 @@ int RecvDataAwaiter::await_resume()
     return conn_->read_context_.input_buffer_.getTotalLen();
 }
 
-bool SendDataAwaiter::await_ready()
+bool SendAwaiterBase::inLoopThread() const
+{
+    return conn_->loop_.isInLoopThread();
+}
+
+void SendAwaiterBase::queueHop(std::coroutine_handle<> h, void (*run)(LoopHop *))
+{
+    handle_ = h;
+    run_ = run;
+    conn_->loop_.queueHop(this);
+}
+
+bool SendAwaiterBase::readyInLoop()
+{
+    conn_->startSending();
+    //然后检查水位线，如果超过高水位线，就挂起
+    return !conn_->write_context_.overLoad();
+}
+
+void SendAwaiterBase::suspendInLoop(std::coroutine_handle<> h)
+{
+    //只有在准备挂起的时候再赋值，否则可能会导致协程的唤起顺序混乱
+    parked_ = h;
+    conn_->write_context_.write_handle_ = h;
+    LOG_DEBUG("SendDataAwaiter high water mark triggered!");
+}
+
+void SendAwaiterBase::resumeOrSuspendInLoop(bool ready)
+{
+    //没有超过高水位线，和这一次循环中其它跨线程的协程一起在就绪队列中恢复
+    if(ready)
+    {
+        parked_ = handle_;
+        conn_->loop_.post(handle_);
+    }
+    else
+    {
+        suspendInLoop(handle_);
+    }
+}
+
+SendAwaiterBase::~SendAwaiterBase()
+{
+    if(!parked_) return;
+    if(conn_->write_context_.write_handle_==parked_)
+    {
+        conn_->write_context_.write_handle_ = nullptr;
+    }
+    else
+    {
+        conn_->loop_.cancelReady(parked_);
+    }
+}
+
+//返回输出缓冲区是否出错，正确为true，错误为false
+bool SendAwaiterBase::await_resume()
+{
+    parked_ = nullptr;
+    if(conn_->closing())
+    {
+        conn_->loop_.queueInLoop([conn_=conn_->getSharedPtr()](){conn_->Destroyed();});
+        return false;
+    }
+    return !conn_->write_context_.isError();
+}
+
+
+
+bool RecvFrameAwaiter::readyInLoop()
+{
+    auto& decoder = conn_->frame_decoder_;
+    //上一次交给用户的帧在这里才真正移除，保证视图在两次读取之间有效
+    decoder.release(conn_->read_context_.input_buffer_);
+    return decoder.hasFrame(conn_->read_context_.input_buffer_)||decoder.isError();
+}
+
+void RecvFrameAwaiter::suspendInLoop(std::coroutine_handle<> h)
+{
+    auto& r_ctx = conn_->read_context_;
+    parked_ = h;
+    r_ctx.read_handle_ = h;
+    //设置等待的解码器，read context只有在帧完整的时候才会唤醒协程
+    r_ctx.frame_waiter_ = &conn_->frame_decoder_;
+    if(r_ctx.status_== ReadContext::ReadStatus::STOPED)
+    {
+        conn_->submitRead(&r_ctx);
+    }
+}
+
+bool RecvFrameAwaiter::resumeInLoop()
+{
+    parked_ = nullptr;
+    conn_->read_context_.frame_waiter_ = nullptr;
+    if(conn_->closing())
+    {
+        conn_->loop_.queueInLoop([conn_=conn_->getSharedPtr()](){conn_->Destroyed();});
+        return false;
+    }
+    //连接出错时缓冲区中仍然可能有完整的帧，先交给用户
+    return conn_->frame_decoder_.hasFrame(conn_->read_context_.input_buffer_);
+}
+
+RecvFrameAwaiter::~RecvFrameAwaiter()
+{
+    if(!parked_) return;
+    if(conn_->read_context_.read_handle_==parked_)
+    {
+        conn_->read_context_.read_handle_ = nullptr;
+        conn_->read_context_.frame_waiter_ = nullptr;
+    }
+    else
+    {
+        //帧已经完整，协程在就绪队列中等待恢复，之后的读取不再等待帧
+        conn_->loop_.cancelReady(parked_);
+        if(!conn_->read_context_.read_handle_) conn_->read_context_.frame_waiter_ = nullptr;
+    }
+}
+
+bool RecvFrameAwaiter::await_ready()
 {
     //如果连接已经关闭，直接返回
     if(conn_->closing()) return true;
@@ -191,43 +484,177 @@ bool SendDataAwaiter::await_ready()
     //判断是否在当前的线程中，如果不在，直接挂起
     if(!conn_->loop_.isInLoopThread()) return false;
 
-    //如果在loop线程，直接追加数据并提交任务
-    conn_->sendInLoop(std::move(data_));
+    return readyInLoop();
+}
+
+void RecvFrameAwaiter::runHop(LoopHop *hop)
+{
+    auto self = static_cast<RecvFrameAwaiter*>(hop);
+    if(self->readyInLoop())
+    {
+        self->parked_ = hop->handle_;
+        self->conn_->loop_.post(hop->handle_);
+    }
+    else
+    {
+        self->suspendInLoop(hop->handle_);
+    }
+}
+
+void RecvFrameAwaiter::await_suspend(std::coroutine_handle<> h)
+{
+    if(!conn_->loop_.isInLoopThread())
+    {
+        handle_ = h;
+        run_ = &RecvFrameAwaiter::runHop;
+        conn_->loop_.queueHop(this);
+    }
+    else
+    {
+        suspendInLoop(h);
+    }
+}
+
+Frame RecvFrameAwaiter::await_resume()
+{
+    if(!resumeInLoop()) return Frame();
+    return conn_->frame_decoder_.next(conn_->read_context_.input_buffer_);
+}
+
+std::vector<Frame> RecvFramesAwaiter::await_resume()
+{
+    std::vector<Frame> frames;
+    if(!resumeInLoop()) return frames;
+
+    auto& decoder = conn_->frame_decoder_;
+    auto& buffer = conn_->read_context_.input_buffer_;
+    frames.reserve(batch_);
+    do
+    {
+        frames.push_back(decoder.next(buffer));
+    } while (frames.size()<batch_&&decoder.hasFrame(buffer));
+    return frames;
+}
+
+void RecvIntoAwaiter::suspendInLoop(std::coroutine_handle<> h)
+{
+    auto& r_ctx = conn_->read_context_;
+    auto& d_ctx = conn_->direct_read_context_;
+    d_ctx.read_handle_ = h;
+
+    switch (r_ctx.status_)
+    {
+    //multishot没有运行，直接提交
+    case ReadContext::ReadStatus::STOPED:
+        d_ctx.start(r_ctx,conn_->shared_from_this());
+        break;
+    //先取消multishot，在最后一个cqe返回时把剩余的数据拷贝出来再提交
+    case ReadContext::ReadStatus::READING:
+        conn_->submitCancel(&r_ctx);
+        r_ctx.status_ = ReadContext::ReadStatus::CANCELING;
+        r_ctx.direct_waiter_ = &d_ctx;
+        break;
+    case ReadContext::ReadStatus::CANCELING:
+        r_ctx.direct_waiter_ = &d_ctx;
+        break;
+    }
+}
+
+bool RecvIntoAwaiter::await_ready()
+{
+    //如果连接已经关闭，直接返回
+    if(conn_->closing()) return true;
+
+    //判断是否在当前的线程中，如果不在，直接挂起
+    if(!conn_->loop_.isInLoopThread()) return false;
+
+    conn_->releaseFrames();
+    conn_->direct_read_context_.reset(buf_,len_);
+    return conn_->direct_read_context_.drain(conn_->read_context_);
+}
+
+void RecvIntoAwaiter::runHop(LoopHop *hop)
+{
+    auto self = static_cast<RecvIntoAwaiter*>(hop);
+    auto conn = self->conn_;
+    conn->releaseFrames();
+    conn->direct_read_context_.reset(self->buf_,self->len_);
+    if(conn->direct_read_context_.drain(conn->read_context_))
+    {
+        conn->loop_.post(hop->handle_);
+    }
+    else
+    {
+        self->suspendInLoop(hop->handle_);
+    }
+}
+
+void RecvIntoAwaiter::await_suspend(std::coroutine_handle<> h)
+{
+    if(!conn_->loop_.isInLoopThread())
+    {
+        handle_ = h;
+        run_ = &RecvIntoAwaiter::runHop;
+        conn_->loop_.queueHop(this);
+    }
+    else
+    {
+        suspendInLoop(h);
+    }
+}
+
+ssize_t RecvIntoAwaiter::await_resume()
+{
+    auto& d_ctx = conn_->direct_read_context_;
+    if(conn_->closing())
+    {
+        conn_->loop_.queueInLoop([conn_=conn_->getSharedPtr()](){conn_->Destroyed();});
+        return -1;
+    }
+    if(d_ctx.is_error_) return -1;
+    return d_ctx.filled_;
+}
+
+bool CommitAwaiter::await_ready()
+{
+    //如果连接已经关闭，直接返回
+    if(conn_->closing()) return true;
+
+    //预留的内存属于loop的输出内存池，只能在loop线程中提交
+    assert(conn_->loop_.isInLoopThread()&&"commit must be called in the loop thread");
+    if(!conn_->write_context_.commit(len_))
+    {
+        LOG_ERROR("TcpConnection::commit without reserve, name=%s",conn_->name_.c_str());
+    }
+    conn_->startSending();
 
     //然后检查水位线，如果超过高水位线，就挂起
     return !conn_->write_context_.overLoad();
 }
 
-void SendDataAwaiter::await_suspend(std::coroutine_handle<> h)
+void CommitAwaiter::await_suspend(std::coroutine_handle<> h)
 {
-    //如果不在当前的任务队列向loop的任务队列提交任务
-    if(!conn_->loop_.isInLoopThread())
+    parked_ = h;
+    conn_->write_context_.write_handle_ = h;
+}
+
+CommitAwaiter::~CommitAwaiter()
+{
+    if(!parked_) return;
+    if(conn_->write_context_.write_handle_==parked_)
     {
-        conn_->loop_.queueInLoop([h,this](){
-            //添加数据
-            conn_->sendInLoop(std::move(data_));
-
-            //检查水位线,如果高于水位线不恢复执行，否则恢复执行
-            if(!conn_->write_context_.overLoad()){
-                h.resume();
-            }
-            else{
-                //如果不在当前的线程，切换到loop的线程中再赋值，因为write_context_的数据访问必须是顺序的
-                //如果可以恢复就不要赋值，只有在准备挂起的时候再赋值，否则可能会导致协程的唤起顺序混乱
-                conn_->write_context_.write_handle_ = h;
-            }
-        });
+        conn_->write_context_.write_handle_ = nullptr;
     }
     else
     {
-        conn_->write_context_.write_handle_ = h;
-        LOG_DEBUG("SendDataAwaiter high water mark triggered!");
+        conn_->loop_.cancelReady(parked_);
     }
 }
 
 //返回输出缓冲区是否出错，正确为true，错误为false
-bool SendDataAwaiter::await_resume()
+bool CommitAwaiter::await_resume()
 {
+    parked_ = nullptr;
     if(conn_->closing())
     {
         conn_->loop_.queueInLoop([conn_=conn_->getSharedPtr()](){conn_->Destroyed();});
@@ -235,4 +662,3 @@ bool SendDataAwaiter::await_resume()
     }
     return !conn_->write_context_.isError();
 }
-
@@ -4,6 +4,7 @@
 
 #include "TcpServer.h"
 #include "Logger.h"
+#include "FramePool.h"
 
 
 TcpServer::TcpServer(IoUringLoop *base_loop, InetAddress bind_addr,
@@ -16,6 +17,8 @@ TcpServer::TcpServer(IoUringLoop *base_loop, InetAddress bind_addr,
                     ,started_(0)
                     ,next_conn_id_(1)
                     ,coroutine_handler_(std::move(coroutine_handler))
+                    ,warmup_frame_size_(0)
+                    ,warmup_frame_count_(0)
                     ,acceptor_(std::make_unique<Acceptor>(loop_,bind_addr,reuse_option==kReusePort))
                     ,pool_(std::make_shared<IoUringLoopThreadPool>(base_loop,name,loop_params))
 {
@@ -43,6 +46,17 @@ void TcpServer::start()
     if(started_.fetch_add(1)==0)
     {
         pool_->start(thread_init_callback_);
+        for(auto loop:pool_->getAllLoops())
+        {
+            loop_connections_[loop] = std::make_shared<LoopConnections>();
+            //帧内存池只能在loop线程中使用
+            if(warmup_frame_count_>0)
+            {
+                loop->runInLoop([loop,size=warmup_frame_size_,count=warmup_frame_count_](){
+                    loop->getFramePool().reserve(size,count);
+                });
+            }
+        }
 
         //在baseloop中加入acceptor，启用监听
         loop_->runInLoop([this](){acceptor_->listen();});
@@ -56,6 +70,13 @@ void TcpServer::setThreadNum(int thread_num)
     pool_->setNumThreads(thread_num);
 }
 
+void TcpServer::setFramePoolWarmup(size_t frame_size, size_t count)
+{
+    assert(!started_&&"the server has already started!");
+    warmup_frame_size_=frame_size;
+    warmup_frame_count_=count;
+}
+
 
 void TcpServer::newConnection(int sock_fd, InetAddress const &peer_addr)
 {
@@ -87,8 +108,13 @@ void TcpServer::newConnection(int sock_fd, InetAddress const &peer_addr)
     //建立新连接
     TcpConnectionPtr new_conn=std::make_shared<TcpConnection>(conn_name,*ioloop,sock_fd,local_a,peer_addr,4096*16,16,4096*16);
     
-    //绑定回调函数
-    new_conn->setCloseCallback([this](const TcpConnectionPtr&conn){removeConnection(conn);});
+    auto loop_conns = loop_connections_[ioloop];
+
+    //绑定回调函数，关闭的回调在连接所在的loop中执行，先从这个loop的连接中移除
+    new_conn->setCloseCallback([this,loop_conns](const TcpConnectionPtr&conn){
+        loop_conns->conns_.erase(conn.get());
+        removeConnection(conn);
+    });
 
     //TODO 暂时没有回调函数，以后会有的
     // new_conn->setConnecitonCallback(connection_callback_);
@@ -98,7 +124,28 @@ void TcpServer::newConnection(int sock_fd, InetAddress const &peer_addr)
     connection_map_[conn_name]=new_conn;
 
     //协程一开始是挂起的,让对应的loop启动这个连接
-    ioloop->queueInLoop([this,conn=new_conn](){conn->Established(coroutine_handler_(conn));});
+    ioloop->queueInLoop([this,loop_conns,conn=new_conn](){
+        loop_conns->conns_.insert(conn.get());
+        conn->Established(coroutine_handler_(conn));
+    });
+}
+
+void TcpServer::broadcast(Payload payload, BroadcastFilter filter)
+{
+    assert(started_&&"broadcast before the server starts!");
+    if(payload.empty()) return;
+
+    for(auto&[loop,loop_conns]:loop_connections_)
+    {
+        loop->runInLoop([loop_conns,payload,filter](){
+            for(auto conn:loop_conns->conns_)
+            {
+                if(conn->closing()) continue;
+                if(filter&&!filter(*conn)) continue;
+                conn->sendInLoop(payload);
+            }
+        });
+    }
 }
 
 void TcpServer::removeConnection(const TcpConnectionPtr &tcp_connection_ptr) 
@@ -1,5 +1,13 @@
 #include "ThreadPool.h"
 
+//工作线程所属的线程池
+thread_local ThreadPool* t_poolInThisThread = nullptr;
+
+ThreadPool* currentThreadPool()
+{
+    return t_poolInThisThread;
+}
+
 void ThreadPool::enqueue(std::coroutine_handle<> h)
 {
     {
@@ -16,19 +24,24 @@ ThreadPool::ThreadPool(size_t thread_num, size_t queue_size)
     for(int i=0;i<thread_num;++i)
     {
         threads_.emplace_back(std::thread([this](){
-            std::unique_lock<std::mutex>lock(mtx_);
-            cv_.wait(lock,[&](){
-                return !started_.load()||!tasks_.empty();
-            });
+            t_poolInThisThread = this;
+            //BUG FIX: 之前每个线程只执行一个任务就退出了，要循环取任务
+            while(true)
+            {
+                std::unique_lock<std::mutex>lock(mtx_);
+                cv_.wait(lock,[&](){
+                    return !started_.load()||!tasks_.empty();
+                });
 
-            //如果线程池停止并且任务队列中没有任务的话，直接退出
-            if(!started_.load()&&tasks_.empty()) return;
-            std::coroutine_handle<>handel = tasks_.front();
-            tasks_.pop();
-            lock.unlock();
+                //如果线程池停止并且任务队列中没有任务的话，直接退出
+                if(!started_.load()&&tasks_.empty()) return;
+                std::coroutine_handle<>handel = tasks_.front();
+                tasks_.pop();
+                lock.unlock();
 
-            //执行任务
-            handel.resume();
+                //执行任务
+                handel.resume();
+            }
         }));
     }
 }
@@ -45,7 +58,12 @@ ThreadPool::~ThreadPool()
 
 void ThreadPool::stop()
 {
-    started_.store(false);
+    {
+        //加锁之后再修改，避免工作线程在检查条件和进入等待之间错过通知
+        std::lock_guard<std::mutex>lock(mtx_);
+        started_.store(false);
+    }
+    cv_.notify_all();
 }
 
 SwitchThreadAwaiter ThreadPool::switchThread()
@@ -55,6 +73,7 @@ SwitchThreadAwaiter ThreadPool::switchThread()
 
 bool ThreadPool::isFull()
 {
+    std::lock_guard<std::mutex>lock(mtx_);
     return tasks_.size()>=max_size_;
 }
 
@@ -1,36 +1,319 @@
 #include <cassert>
+#include <algorithm>
 #include <errno.h>
 #include "WriteContext.h"
 #include "TcpConnection.h"
+#include "IoUringLoop.h"
 #include "Logger.h"
 
-WriteContext::WriteContext(size_t high_water_mark,int fd,size_t max_slices)
+WriteContext::WriteContext(size_t high_water_mark,int fd,TxFragmentPool* pool,size_t max_slices)
     :IoContext(ContextType::Write)
+    ,output_buffer_(pool,kDefaultCoalesceThreshold)
     ,high_water_mark_(high_water_mark)
     ,max_slices_(max_slices)
+    ,max_inflight_(kDefaultMaxInflight)
+    ,chain_len_(0)
+    ,completed_(0)
+    ,chain_error_(0)
+    ,zero_copy_threshold_(0)
+    ,zc_sends_(0)
+    ,zc_copied_(0)
+    ,output_pool_(nullptr)
+    ,reserved_chunk_(nullptr)
+    ,reserved_ptr_(nullptr)
+    ,reserved_len_(0)
+    ,file_splice_(true)
     ,fd_(fd)
     ,holder_(nullptr)
     ,write_handle_(nullptr)
     ,is_sending_(false)
     ,is_error_(false)
+    ,low_latency_(false)
+    ,flush_queued_(false)
+    ,submitted_ops_(0)
 {
     assert(fd&&"fd is 0 , check the logic");
 }
 
 WriteContext::~WriteContext()
 {
+    releaseReserved();
 }
 
 void WriteContext::flush()
 {
-    //可选：1.直接清空temp_data重新装填，2.偏移iovec数组，如果不为空继续发送，这里选择1
+    //高优先级的消息插入到下一个消息的边界
+    output_buffer_.placeHigh();
+
+    //文件分片在头部时单独发送，之前的数据都已经发送完成
+    if(chain_len_==0&&output_buffer_.pendingFile())
+    {
+        flushFile();
+        return;
+    }
+
+    //没有需要继续发送的请求时，先检查这一批数据是否使用零拷贝发送
+    if(chain_len_==0&&zero_copy_threshold_&&flushZeroCopy()) return;
+
+    //在没有写完的请求之后继续装填新的请求，直到达到上限或者缓冲区中没有新的数据
+    while(chain_len_<max_inflight_&&output_buffer_.pendingFragment())
+    {
+        //文件分片等到之前的请求全部完成之后再发送
+        if(output_buffer_.pendingFile()) break;
+        auto op = appendOp();
+        //固定缓冲区的分片单独使用WRITE_FIXED发送，不能和其它分片一起放入iovec中
+        if(output_buffer_.sendAlone(output_buffer_.pendingFragment()))
+        {
+            op->fixed_index_ = output_buffer_.pendingFragment()->chunk_->index_;
+            op->iovecs_.emplace_back(output_buffer_.getOneIovec());
+        }
+        else
+        {
+            output_buffer_.getBatchFragment(op->iovecs_,max_slices_,max_inflight_>1?kMaxOpBytes:SIZE_MAX);
+        }
+        op->prepare();
+    }
+    assert(chain_len_>0&&"no write op to submit ,some logic is wrong");
+
+    completed_ = 0;
+    submitted_ops_ += chain_len_;
+    holder_->submitWrite(this);
+    is_sending_ = true;
+}
+
+void WriteContext::flushQueued()
+{
+    flush_queued_ = false;
+    if(is_sending_) return;
+    //连接在等待的过程中关闭了，或者数据已经由低延迟的路径发送出去了，释放holder
+    if(holder_->closing()||output_buffer_.isEmpty())
+    {
+        auto holder = std::move(holder_);
+        return;
+    }
+    flush();
+}
+
+void WriteContext::flushFile()
+{
+    if(!file_send_)
+    {
+        file_send_ = std::make_unique<FileSendContext>(*this,*holder_->getLoop());
+    }
+    file_send_->prepare(output_buffer_.pendingFile());
+    submitted_ops_++;
+    holder_->submitFileSend(file_send_.get());
+    is_sending_ = true;
+}
+
+void WriteContext::onFileSendResult(FileSendContext *ctx)
+{
+    //理论上在请求返回的时候因为要保证连接的生命周期，shared_ptr中是不为空的
+    assert(holder_&&"the holder should not be nullptr,some logic is wrong");
+
+    //写入socket的数据从文件分片中移除，中转中剩余的数据下一次继续发送
+    if(ctx->sent_>0) output_buffer_.retrieve(ctx->sent_);
+    res_ = ctx->res_;
+    afterSend();
+}
+
+WriteOpContext *WriteContext::appendOp()
+{
+    if(chain_len_==ops_.size())
+    {
+        ops_.emplace_back(std::make_unique<WriteOpContext>(*this));
+    }
+    auto op = ops_[chain_len_++].get();
+    op->reset();
+    return op;
+}
+
+bool WriteContext::flushZeroCopy()
+{
     temp_data_.clear();
-    output_buffer_.getBatchFragment(temp_data_,max_slices_);
+    temp_fragments_.clear();
 
+    //固定缓冲区的分片足够大时使用SEND_ZC固定缓冲区发送，否则按照普通的方式使用WRITE_FIXED发送
+    auto first = output_buffer_.pendingFragment();
+    if(output_buffer_.sendAlone(first))
+    {
+        if(first->len_-first->queued_<zero_copy_threshold_) return false;
+        temp_fragments_.push_back(first);
+        temp_data_.emplace_back(output_buffer_.getOneIovec());
+        submitZeroCopy(first->chunk_->index_);
+        return true;
+    }
+
+    output_buffer_.getBatchFragment(temp_data_,max_slices_,temp_fragments_);
     assert(!temp_data_.empty()&&"temp_data_ is empty ,some logic is wrong");
 
-    holder_->submitWrite(this);
+    //只有存在大的分片时零拷贝才划算，小数据的页面固定和通知的开销比拷贝更大
+    for(auto& iov:temp_data_)
+    {
+        if(iov.iov_len>=zero_copy_threshold_)
+        {
+            submitZeroCopy(-1);
+            return true;
+        }
+    }
+
+    //已经提取出来的数据作为第一个请求发送
+    auto op = appendOp();
+    op->iovecs_.swap(temp_data_);
+    op->prepare();
+    return false;
+}
+
+void WriteContext::submitZeroCopy(int buf_index)
+{
+    ZeroCopySendContext* ctx = nullptr;
+    if(zc_free_.empty())
+    {
+        zc_contexts_.emplace_back(std::make_unique<ZeroCopySendContext>(*this));
+        ctx = zc_contexts_.back().get();
+    }
+    else
+    {
+        ctx = zc_free_.back();
+        zc_free_.pop_back();
+    }
+
+    for(auto fragment:temp_fragments_) output_buffer_.pin(fragment);
+    ctx->pinned_.swap(temp_fragments_);
+    ctx->holder_ = holder_;
+    ctx->msg_.msg_iov = temp_data_.data();
+    ctx->msg_.msg_iovlen = temp_data_.size();
+    ctx->buf_index_ = buf_index;
+
+    holder_->submitZeroCopySend(ctx);
     is_sending_ = true;
+    zc_sends_++;
+}
+
+char *WriteContext::reserve(ChunkPoolManagerOutput &pool, size_t len)
+{
+    reserved_ptr_ = nullptr;
+    reserved_len_ = 0;
+    if(len>pool.chunkSize()) return nullptr;
+
+    //优先在尾部分片的chunk末尾继续写入，多次小的写入合并成一次发送
+    auto tail = output_buffer_.fixedTail();
+    if(tail&&pool.writableBytes(tail->chunk_)>=len)
+    {
+        reserved_ptr_ = tail->chunk_->beginWrite();
+        reserved_len_ = pool.writableBytes(tail->chunk_);
+        return reserved_ptr_;
+    }
+
+    //上一次预留但是没有提交的chunk还是空的，可以直接使用
+    if(!reserved_chunk_)
+    {
+        reserved_chunk_ = pool.acquireChunk();
+        if(!reserved_chunk_) return nullptr;
+    }
+    output_pool_ = &pool;
+    reserved_ptr_ = reserved_chunk_->beginWrite();
+    reserved_len_ = pool.writableBytes(reserved_chunk_);
+    return reserved_ptr_;
+}
+
+bool WriteContext::commit(size_t len)
+{
+    if(!reserved_ptr_) return false;
+    assert(len<=reserved_len_&&"commit more than reserved ,some logic is wrong");
+    if(len==0) return true;
+
+    if(reserved_chunk_&&reserved_ptr_==reserved_chunk_->beginWrite())
+    {
+        output_buffer_.appendFixed(output_pool_,reserved_chunk_,len);
+        reserved_chunk_ = nullptr;
+    }
+    else
+    {
+        //reserve和commit之间尾部的分片不能发生变化
+        auto tail = output_buffer_.fixedTail();
+        assert(tail&&tail->chunk_->beginWrite()==reserved_ptr_&&"the tail changed between reserve and commit ,some logic is wrong");
+        output_buffer_.extendFixedTail(len);
+    }
+    reserved_ptr_ = nullptr;
+    reserved_len_ = 0;
+    return true;
+}
+
+void WriteContext::releaseReserved()
+{
+    if(reserved_chunk_)
+    {
+        output_pool_->releaseChunk(reserved_chunk_);
+        reserved_chunk_ = nullptr;
+    }
+    reserved_ptr_ = nullptr;
+    reserved_len_ = 0;
+}
+
+void WriteContext::onWriteOpResult(WriteOpContext *op)
+{
+    //理论上在请求返回的时候因为要保证连接的生命周期，shared_ptr中是不为空的
+    assert(holder_&&"the holder should not be nullptr,some logic is wrong");
+
+    completed_++;
+    if(op->res_>=0)
+    {
+        output_buffer_.consume(op->res_);
+        op->advance(op->res_);
+    }
+    //被取消的请求没有写入任何数据，整批请求返回之后和没有写完的请求一起重新提交
+    else if(op->res_!=-ECANCELED&&chain_error_==0)
+    {
+        chain_error_ = op->res_;
+    }
+
+    //这一批中还有请求没有返回，数据低于高水位线时可以先唤醒协程继续追加数据
+    if(completed_<chain_len_)
+    {
+        if(chain_error_==0) resumeWriter();
+        return;
+    }
+
+    //请求按照顺序完成，没有写完的请求一定在这一批的末尾，把它们移动到前面，下一次从写到的位置继续提交
+    size_t finished = 0;
+    while(finished<chain_len_&&ops_[finished]->done()) finished++;
+    std::rotate(ops_.begin(),ops_.begin()+finished,ops_.begin()+chain_len_);
+    chain_len_ -= finished;
+
+    //有高优先级的消息在等待时放弃没有写完的请求，重新从已经发送的位置提取，让高优先级的消息插入到正在发送的消息之后
+    if(chain_len_>0&&output_buffer_.hasPendingHigh())
+    {
+        chain_len_ = 0;
+        output_buffer_.rewind();
+    }
+
+    res_ = chain_error_;
+    chain_error_ = 0;
+    afterSend();
+}
+
+void WriteContext::onZeroCopyResult(int res)
+{
+    //内核或者socket不支持零拷贝发送，关闭零拷贝之后按照被中断处理，重新使用writev发送
+    if(res==-EOPNOTSUPP||res==-EINVAL)
+    {
+        LOG_INFO("WriteContext zero copy send is not supported, fallback to writev, error:%s",strerror(-res));
+        zero_copy_threshold_ = 0;
+        res = -EINTR;
+    }
+    res_ = res;
+    flags_ = 0;
+    on_completion();
+}
+
+void WriteContext::finishZeroCopy(ZeroCopySendContext *ctx)
+{
+    //先取出holder，连接可能在这个函数结束的时候析构
+    auto holder = std::move(ctx->holder_);
+    for(auto fragment:ctx->pinned_) output_buffer_.unpin(fragment);
+    ctx->pinned_.clear();
+    zc_free_.push_back(ctx);
 }
 
 bool WriteContext::handleError()
@@ -79,9 +362,25 @@ bool WriteContext::handleError()
 
 void WriteContext::on_completion()
 {   
-
-    
     LOG_DEBUG("WriteContext res : %d flags: %u",(int)res_,flags_);
+
+    //理论上在触发on_completion函数的时候因为要保证连接的生命周期，shared_ptr中是不为空的
+    assert(holder_&&"the holder should not be nullptr,some logic is wrong");
+
+    //零拷贝发送成功时推进缓冲区，没有发送的数据重新提取，出错时这一批数据全部重新提取
+    if(res_>=0)
+    {
+        output_buffer_.retrieve(res_);
+    }
+    else
+    {
+        output_buffer_.rewind();
+    }
+    afterSend();
+}
+
+void WriteContext::afterSend()
+{
     /*
     提示：这个头部的判断会破坏状态，应该在连接关闭的时候close fd，然后在处理错误的阶段关闭而不是由外部的状态关闭 
     */
@@ -93,9 +392,6 @@ void WriteContext::on_completion()
     //     return;
     // }
 
-    //理论上在触发on_completion函数的时候因为要保证连接的生命周期，shared_ptr中是不为空的
-    assert(holder_&&"the holder should not be nullptr,some logic is wrong");
-
     //检查res，查看发送是否成功，如果失败就处理错误
     if(res_<0)
     {
@@ -103,22 +399,20 @@ void WriteContext::on_completion()
         is_sending_ = false;
         if(need_close)
         {
+            chain_len_ = 0;
             if(write_handle_){
                 write_handle_.resume();
             }
             holder_->handleClose();
-            holder_.reset();
             is_sending_ = false;
+            //可能是连接的最后一个引用，释放之后不能再访问成员
+            holder_.reset();
             return;
         }
     }
-    else//如果发送成功，获取发送完毕的数据的数量，推进缓冲区
-    {
-        output_buffer_.retrieve(res_);
-    }
 
-    //如果缓冲区中有数据，就发送
-    if(output_buffer_.getTotalLen()>0)
+    //如果还有没写完的请求或者缓冲区中有数据，就发送
+    if(chain_len_>0||!output_buffer_.isEmpty())
     {
         flush();
     }
@@ -129,6 +423,11 @@ void WriteContext::on_completion()
         holder_.reset();
     }   
 
+    resumeWriter();
+}
+
+void WriteContext::resumeWriter()
+{
     //如果handle显示当前协程正在等待且数据量低于高水位线，就唤醒协程
     //(协程挂起是因为输出缓冲区数据太多或者是现在协程是在其它的线程中刚处理完任务)
     if(write_handle_&&!overLoad())
@@ -136,6 +435,6 @@ void WriteContext::on_completion()
         auto handle = write_handle_;
         write_handle_ = nullptr;
         assert(!handle.done()&&"coroutine is done,some logic is wrong");
-        handle.resume();
+        IoUringLoop::resumeHandle(handle,this);
     }
 }
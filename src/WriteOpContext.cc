@@ -0,0 +1,56 @@
+#include <cstring>
+
+#include "WriteOpContext.h"
+#include "WriteContext.h"
+#include "Logger.h"
+
+WriteOpContext::WriteOpContext(WriteContext &owner)
+    :IoContext(ContextType::WriteOp)
+    ,owner_(owner)
+    ,offset_(0)
+    ,bytes_(0)
+    ,fixed_index_(-1)
+{
+    std::memset(&msg_,0,sizeof(msg_));
+}
+
+WriteOpContext::~WriteOpContext()
+{
+}
+
+void WriteOpContext::reset()
+{
+    iovecs_.clear();
+    offset_ = 0;
+    bytes_ = 0;
+    fixed_index_ = -1;
+}
+
+void WriteOpContext::prepare()
+{
+    bytes_ = 0;
+    for(size_t i=offset_;i<iovecs_.size();++i) bytes_ += iovecs_[i].iov_len;
+}
+
+void WriteOpContext::advance(size_t len)
+{
+    bytes_ -= len;
+    while(len>0)
+    {
+        auto& iov = iovecs_[offset_];
+        if(len<iov.iov_len)
+        {
+            iov.iov_base = static_cast<char*>(iov.iov_base)+len;
+            iov.iov_len -= len;
+            return;
+        }
+        len -= iov.iov_len;
+        offset_++;
+    }
+}
+
+void WriteOpContext::on_completion()
+{
+    LOG_DEBUG("WriteOpContext res : %d flags: %u",(int)res_,flags_);
+    owner_.onWriteOpResult(this);
+}
@@ -0,0 +1,37 @@
+#include <cstring>
+#include <liburing.h>
+
+#include "ZeroCopySendContext.h"
+#include "WriteContext.h"
+#include "Logger.h"
+
+ZeroCopySendContext::ZeroCopySendContext(WriteContext &owner)
+    :IoContext(ContextType::ZeroCopySend)
+    ,owner_(owner)
+    ,holder_(nullptr)
+    ,buf_index_(-1)
+{
+    std::memset(&msg_,0,sizeof(msg_));
+}
+
+ZeroCopySendContext::~ZeroCopySendContext()
+{
+}
+
+void ZeroCopySendContext::on_completion()
+{
+    LOG_DEBUG("ZeroCopySendContext res : %d flags: %u",(int)res_,flags_);
+
+    //通知返回，内核已经不再引用发送的数据
+    if(flags_&IORING_CQE_F_NOTIF)
+    {
+        if(res_&IORING_NOTIF_USAGE_ZC_COPIED) owner_.zc_copied_++;
+        owner_.finishZeroCopy(this);
+        return;
+    }
+
+    //发送的结果，没有IORING_CQE_F_MORE标志时不会再有通知(比如发送出错)
+    bool wait_notif = flags_&IORING_CQE_F_MORE;
+    owner_.onZeroCopyResult(res_);
+    if(!wait_notif) owner_.finishZeroCopy(this);
+}
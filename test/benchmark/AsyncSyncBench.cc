@@ -0,0 +1,92 @@
+#include "bench_helper.h"
+#include "AsyncSync.h"
+#include "Task.hpp"
+
+#include <atomic>
+
+//1. Uncontended：没有竞争时co_await scopedLock()的开销，只有原子操作
+//2. CrossLoop：两个loop中的协程竞争同一个互斥锁，临界区中让出loop，锁在两个loop之间交接
+//统计每次加锁的耗时和两个loop线程中的堆分配次数
+
+namespace
+{
+
+constexpr int kLocks = 1000;
+
+Task<> lockLoop(AsyncMutex& mutex,int& counter)
+{
+    for(int i=0;i<kLocks;++i)
+    {
+        auto guard = co_await mutex.scopedLock();
+        counter++;
+    }
+}
+
+Task<> contend(AsyncMutex& mutex,IoUringLoop* loop,std::atomic<int>& left,std::promise<void>& done)
+{
+    for(int i=0;i<kLocks;++i)
+    {
+        auto guard = co_await mutex.scopedLock();
+        co_await loop->yield();
+    }
+    if(--left==0) done.set_value();
+}
+
+uint64_t loopAllocs(LoopbackServer& server)
+{
+    uint64_t count = 0;
+    server.runInLoopSync([&](){count = threadAllocCount();});
+    return count;
+}
+
+void BM_AsyncMutexUncontended(benchmark::State& state)
+{
+    AsyncMutex mutex;
+    int counter = 0;
+    for(auto _:state)
+    {
+        auto task = lockLoop(mutex,counter);
+        task.resume();
+    }
+    benchmark::DoNotOptimize(counter);
+    state.SetItemsProcessed(state.iterations()*kLocks);
+}
+
+void BM_AsyncMutexCrossLoop(benchmark::State& state)
+{
+    auto noop = [](std::shared_ptr<TcpConnection>)->Task<>{co_return;};
+    LoopbackServer first(noop);
+    LoopbackServer second(noop);
+    LoopbackServer* servers[2] = {&first,&second};
+
+    AsyncMutex mutex;
+    uint64_t allocs_start = loopAllocs(first)+loopAllocs(second);
+    for(auto _:state)
+    {
+        std::atomic<int> left{2};
+        std::promise<void> done;
+        auto finished = done.get_future();
+        std::unique_ptr<Task<>> tasks[2];
+        for(int i=0;i<2;++i)
+        {
+            IoUringLoop* loop = servers[i]->loop();
+            servers[i]->runInLoopSync([&,i,loop](){
+                tasks[i] = std::make_unique<Task<>>(contend(mutex,loop,left,done));
+                tasks[i]->resume();
+            });
+        }
+        finished.wait();
+        //协程在各自的loop中执行完毕之后再销毁
+        for(int i=0;i<2;++i) servers[i]->runInLoopSync([&,i](){tasks[i].reset();});
+    }
+    uint64_t allocs = loopAllocs(first)+loopAllocs(second)-allocs_start;
+
+    int64_t locks = std::max<int64_t>(1,state.iterations()*2*kLocks);
+    state.SetItemsProcessed(state.iterations()*2*kLocks);
+    state.counters["allocs/lock"] = benchmark::Counter(double(allocs)/double(locks));
+}
+
+}
+
+BENCHMARK(BM_AsyncMutexUncontended);
+BENCHMARK(BM_AsyncMutexCrossLoop)->UseRealTime();
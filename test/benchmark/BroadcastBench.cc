@@ -0,0 +1,254 @@
+#include "bench_helper.h"
+#include "TcpServer.h"
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <sys/epoll.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include <fcntl.h>
+
+//向大量订阅者发送同一份数据，比较TcpServer::broadcast和逐个连接提交任务、拷贝数据的方式
+//订阅者在子进程中运行，避免客户端和服务端的fd加在一起超过单个进程的限制
+//每轮服务端把msg个字节发送给所有订阅者，子进程收完全部数据之后回复，统计每轮的时间和服务端进程的cpu时间
+
+namespace
+{
+
+constexpr int kSubLoops = 4;
+
+//子进程中的订阅者：收到开始命令后建立n个连接，之后每收到一个长度就从每个连接中接收这么多数据，收完后回复
+[[noreturn]] void runSubscribers(int n,uint16_t port,int cmd_fd,int ack_fd)
+{
+    std::vector<int> fds(n,-1);
+    std::vector<epoll_event> events(1024);
+    static char buf[64*1024];
+
+    uint64_t cmd = 0;
+    if(::read(cmd_fd,&cmd,sizeof(cmd))!=sizeof(cmd)) _exit(1);
+
+    int epfd = ::epoll_create1(0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+    for(int i=0;i<n;++i)
+    {
+        fds[i] = ::socket(AF_INET,SOCK_STREAM,0);
+        if(fds[i]<0||::connect(fds[i],(sockaddr*)&addr,sizeof(addr))!=0) _exit(1);
+        ::fcntl(fds[i],F_SETFL,O_NONBLOCK);
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.fd = fds[i];
+        ::epoll_ctl(epfd,EPOLL_CTL_ADD,fds[i],&ev);
+    }
+    char ack = 'a';
+    if(::write(ack_fd,&ack,1)!=1) _exit(1);
+
+    while(::read(cmd_fd,&cmd,sizeof(cmd))==sizeof(cmd)&&cmd>0)
+    {
+        uint64_t remain = cmd*n;
+        while(remain>0)
+        {
+            int num = ::epoll_wait(epfd,events.data(),events.size(),1000);
+            if(num<=0) _exit(1);
+            for(int i=0;i<num;++i)
+            {
+                ssize_t len;
+                while((len = ::recv(events[i].data.fd,buf,sizeof(buf),0))>0) remain -= len;
+                if(len==0) _exit(1);
+            }
+        }
+        if(::write(ack_fd,&ack,1)!=1) _exit(1);
+    }
+    for(int fd:fds) ::close(fd);
+    _exit(0);
+}
+
+//订阅者的服务端：在单独的线程中运行baseloop和TcpServer，记录所有订阅者的连接
+class FanoutServer
+{
+private:
+    std::unique_ptr<IoUringLoop> base_loop_;
+    std::unique_ptr<TcpServer> server_;
+    std::thread loop_thread_;
+
+    inline static std::mutex mtx_;
+    inline static std::vector<TcpConnectionPtr> subscribers_;
+
+    static Task<> subscriber(TcpConnectionPtr conn)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            subscribers_.push_back(conn);
+        }
+        //等待对端关闭连接
+        while(true)
+        {
+            int size = co_await conn->PrepareToRead();
+            if(size<0) break;
+            conn->retrieve(size);
+        }
+    }
+
+public:
+    explicit FanoutServer(uint16_t port)
+    {
+        std::promise<void> p;
+        auto f = p.get_future();
+        loop_thread_ = std::thread([&,port,p = std::move(p)]() mutable {
+            IoUringLoopParams params{8192,256,64,4096,1024};
+            base_loop_ = std::make_unique<IoUringLoop>(params);
+            server_ = std::make_unique<TcpServer>(base_loop_.get(),InetAddress(port),"fanout",params,subscriber,TcpServer::kReusePort);
+            server_->setThreadNum(kSubLoops);
+            server_->start();
+            p.set_value();
+            base_loop_->loop();
+        });
+        f.wait();
+    }
+
+    ~FanoutServer()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            subscribers_.clear();
+        }
+        base_loop_->quit();
+        loop_thread_.join();
+        server_.reset();
+        base_loop_.reset();
+    }
+
+    TcpServer& server(){return *server_;}
+
+    std::vector<TcpConnectionPtr> subscribers()
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        return subscribers_;
+    }
+};
+
+//现有的方式：每个连接向它的loop提交一个任务，任务中拷贝一份数据并通过协程发送
+Task<> sendCopy(TcpConnectionPtr conn,std::string data)
+{
+    co_await conn->send(std::move(data));
+}
+
+//服务端进程消耗的cpu时间，子进程中的客户端不计算在内
+uint64_t processCpuNs()
+{
+    rusage usage{};
+    ::getrusage(RUSAGE_SELF,&usage);
+    return (uint64_t(usage.ru_utime.tv_sec+usage.ru_stime.tv_sec))*1000000000ull
+        +(uint64_t(usage.ru_utime.tv_usec+usage.ru_stime.tv_usec))*1000ull;
+}
+
+void runFanoutBench(benchmark::State& state,bool use_broadcast)
+{
+    static uint16_t next_port = 19700;
+    int n = state.range(0);
+    size_t msg_size = state.range(1);
+    uint16_t port = next_port++;
+
+    int cmd_pipe[2],ack_pipe[2];
+    if(::pipe(cmd_pipe)!=0||::pipe(ack_pipe)!=0)
+    {
+        state.SkipWithError("pipe failed");
+        return;
+    }
+    //在创建服务端的线程之前fork，子进程中只有这一个线程
+    pid_t pid = ::fork();
+    if(pid==0)
+    {
+        ::close(cmd_pipe[1]);
+        ::close(ack_pipe[0]);
+        runSubscribers(n,port,cmd_pipe[0],ack_pipe[1]);
+    }
+    ::close(cmd_pipe[0]);
+    ::close(ack_pipe[1]);
+
+    auto command = [&](uint64_t cmd){
+        char ack;
+        return ::write(cmd_pipe[1],&cmd,sizeof(cmd))==sizeof(cmd)&&::read(ack_pipe[0],&ack,1)==1;
+    };
+
+    {
+        FanoutServer server(port);
+        bool ok = command(1);
+        std::vector<TcpConnectionPtr> subs;
+        for(int i=0;ok&&i<500;++i)
+        {
+            subs = server.subscribers();
+            if(int(subs.size())==n) break;
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        if(!ok||int(subs.size())!=n)
+        {
+            state.SkipWithError("subscribers failed to connect");
+        }
+        else
+        {
+            std::string msg(msg_size,'m');
+            uint64_t cpu_start = processCpuNs();
+            for(auto _:state)
+            {
+                if(use_broadcast)
+                {
+                    server.server().broadcast(Payload(msg));
+                }
+                else
+                {
+                    for(auto& conn:subs)
+                    {
+                        conn->getLoop()->queueInLoop([conn,data = msg]() mutable {
+                            auto task = sendCopy(conn,std::move(data));
+                            task.resume();
+                        });
+                    }
+                }
+                if(!command(msg_size))
+                {
+                    state.SkipWithError("subscriber process failed");
+                    break;
+                }
+            }
+            uint64_t cpu = processCpuNs()-cpu_start;
+            double rounds = double(std::max<int64_t>(1,state.iterations()));
+            state.SetItemsProcessed(state.iterations()*n);
+            state.SetBytesProcessed(state.iterations()*n*msg_size);
+            state.counters["server_cpu_us/round"] = benchmark::Counter(cpu/1e3/rounds);
+        }
+        subs.clear();
+
+        uint64_t quit = 0;
+        ::write(cmd_pipe[1],&quit,sizeof(quit));
+        ::waitpid(pid,nullptr,0);
+        //等待服务端处理完所有连接的关闭
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    }
+    ::close(cmd_pipe[1]);
+    ::close(ack_pipe[0]);
+}
+
+void BM_FanoutBroadcast(benchmark::State& state)
+{
+    runFanoutBench(state,true);
+}
+
+void BM_FanoutPerConnection(benchmark::State& state)
+{
+    runFanoutBench(state,false);
+}
+
+}
+
+BENCHMARK(BM_FanoutBroadcast)
+    ->ArgsProduct({{1000,10000},{256,4096}})
+    ->ArgNames({"subs","msg"})
+    ->UseRealTime();
+BENCHMARK(BM_FanoutPerConnection)
+    ->ArgsProduct({{1000,10000},{256,4096}})
+    ->ArgNames({"subs","msg"})
+    ->UseRealTime();
@@ -0,0 +1,95 @@
+#include "bench_helper.h"
+#include "Channel.hpp"
+#include "Task.hpp"
+
+//一个loop中的生产者通过通道向另一个loop中的消费者发送kItems个整数，通道容量由参数指定
+//1. Spsc：读写位置是原子变量，收发不加锁
+//2. Mpsc：缓冲区和等待链表由互斥锁保护
+//统计每个数据的耗时和两个loop线程中的堆分配次数
+
+namespace
+{
+
+constexpr int kItems = 10000;
+
+template<typename ChannelType>
+Task<> producer(ChannelType& channel)
+{
+    for(int i=0;i<kItems;++i)
+    {
+        bool ok = co_await channel.send(i);
+        if(!ok) break;
+    }
+    channel.close();
+}
+
+template<typename ChannelType>
+Task<> consumer(ChannelType& channel,int64_t& sum,std::promise<void>& done)
+{
+    while(true)
+    {
+        auto value = co_await channel.receive();
+        if(!value) break;
+        sum += *value;
+    }
+    done.set_value();
+}
+
+uint64_t loopAllocs(LoopbackServer& server)
+{
+    uint64_t count = 0;
+    server.runInLoopSync([&](){count = threadAllocCount();});
+    return count;
+}
+
+template<typename ChannelType>
+void runChannel(benchmark::State& state)
+{
+    auto noop = [](std::shared_ptr<TcpConnection>)->Task<>{co_return;};
+    LoopbackServer first(noop);
+    LoopbackServer second(noop);
+
+    uint64_t allocs_start = loopAllocs(first)+loopAllocs(second);
+    int64_t sum = 0;
+    for(auto _:state)
+    {
+        ChannelType channel(state.range(0));
+        std::promise<void> done;
+        auto finished = done.get_future();
+        std::unique_ptr<Task<>> receive_task;
+        std::unique_ptr<Task<>> send_task;
+        second.runInLoopSync([&](){
+            receive_task = std::make_unique<Task<>>(consumer(channel,sum,done));
+            receive_task->resume();
+        });
+        first.runInLoopSync([&](){
+            send_task = std::make_unique<Task<>>(producer(channel));
+            send_task->resume();
+        });
+        finished.wait();
+        //协程在各自的loop中执行完毕之后再销毁
+        first.runInLoopSync([&](){send_task.reset();});
+        second.runInLoopSync([&](){receive_task.reset();});
+    }
+    uint64_t allocs = loopAllocs(first)+loopAllocs(second)-allocs_start;
+    benchmark::DoNotOptimize(sum);
+
+    int64_t items = std::max<int64_t>(1,state.iterations()*kItems);
+    state.SetItemsProcessed(state.iterations()*kItems);
+    state.counters["allocs/item"] = benchmark::Counter(double(allocs)/double(items));
+}
+
+void BM_SpscChannel(benchmark::State& state)
+{
+    runChannel<SpscChannel<int>>(state);
+}
+
+void BM_MpscChannel(benchmark::State& state)
+{
+    runChannel<Channel<int>>(state);
+}
+
+}
+
+BENCHMARK(BM_SpscChannel)->Arg(16)->Arg(256)->UseRealTime();
+BENCHMARK(BM_MpscChannel)->Arg(16)->Arg(256)->UseRealTime();
@@ -0,0 +1,76 @@
+#include "bench_helper.h"
+
+#include <string>
+
+//服务端连续发送很多小消息时，比较开启和关闭小数据合并的吞吐量和服务端cpu开销
+//每轮客户端发送一个字节的请求，服务端回复kMessagesPerRound个消息
+
+namespace
+{
+
+constexpr size_t kMessagesPerRound = 256;
+
+void runCoalesceBench(benchmark::State& state,bool coalesce)
+{
+    size_t msg_size = state.range(0);
+
+    LoopbackServer server([msg_size,coalesce](std::shared_ptr<TcpConnection> conn)->Task<>{
+        conn->setTcpNoDelay(true);
+        if(!coalesce) conn->setWriteCoalesceThreshold(0);
+        bool running = true;
+        while(running)
+        {
+            int size = co_await conn->PrepareToRead();
+            if(size<0) break;
+            conn->retrieve(size);
+            for(size_t i=0;i<kMessagesPerRound;++i)
+            {
+                if(!co_await conn->send(std::string(msg_size,'x')))
+                {
+                    running = false;
+                    break;
+                }
+            }
+        }
+    });
+
+    int fd = server.connect();
+    if(fd<0)
+    {
+        state.SkipWithError("connect failed");
+        return;
+    }
+
+    size_t round_bytes = msg_size*kMessagesPerRound;
+    uint64_t cpu_start = server.loopCpuNs();
+    for(auto _:state)
+    {
+        if(!sendAll(fd,"r",1)||!recvDiscard(fd,round_bytes))
+        {
+            state.SkipWithError("loopback io failed");
+            break;
+        }
+    }
+    uint64_t cpu = server.loopCpuNs()-cpu_start;
+    ::close(fd);
+
+    int64_t messages = std::max<int64_t>(1,state.iterations()*kMessagesPerRound);
+    state.SetBytesProcessed(state.iterations()*round_bytes);
+    state.SetItemsProcessed(messages);
+    state.counters["server_cpu_ns/msg"] = benchmark::Counter(double(cpu)/double(messages));
+}
+
+void BM_SmallWritesCoalesced(benchmark::State& state)
+{
+    runCoalesceBench(state,true);
+}
+
+void BM_SmallWritesUncoalesced(benchmark::State& state)
+{
+    runCoalesceBench(state,false);
+}
+
+}
+
+BENCHMARK(BM_SmallWritesCoalesced)->RangeMultiplier(4)->Range(16,4096)->UseRealTime();
+BENCHMARK(BM_SmallWritesUncoalesced)->RangeMultiplier(4)->Range(16,4096)->UseRealTime();
@@ -0,0 +1,87 @@
+#include "bench_helper.h"
+
+#include <string>
+
+#include "ChunkPoolManagerInput.h"
+
+//小数据频繁到达时，比较开启和关闭chunk合并时内存池的占用情况
+//每轮客户端逐个发送kMessagesPerRound个小消息，服务端收齐之后一次性消费并回复一个字节
+
+namespace
+{
+
+constexpr size_t kMessagesPerRound = 64;
+
+void runCompactionBench(benchmark::State& state,bool compact)
+{
+    size_t msg_size = state.range(0);
+    size_t round_bytes = msg_size*kMessagesPerRound;
+
+    LoopbackServer server([round_bytes](std::shared_ptr<TcpConnection> conn)->Task<>{
+        while(true)
+        {
+            int size = co_await conn->PrepareToRead(round_bytes);
+            if(size<0) break;
+            conn->retrieve(round_bytes);
+            if(!co_await conn->send(std::string(1,'k'))) break;
+        }
+    });
+
+    InputPoolStats before;
+    server.runInLoopSync([&](){
+        auto& pool = server.loop()->getInputPool();
+        if(!compact) pool.setCompactThreshold(0);
+        before = pool.stats();
+    });
+
+    int fd = server.connect();
+    if(fd<0)
+    {
+        state.SkipWithError("connect failed");
+        return;
+    }
+
+    std::string msg(msg_size,'x');
+    for(auto _:state)
+    {
+        for(size_t i=0;i<kMessagesPerRound;++i)
+        {
+            if(!sendAll(fd,msg.data(),msg.size()))
+            {
+                state.SkipWithError("loopback io failed");
+                break;
+            }
+        }
+        if(!recvDiscard(fd,1))
+        {
+            state.SkipWithError("loopback io failed");
+            break;
+        }
+    }
+    ::close(fd);
+
+    InputPoolStats after;
+    server.runInLoopSync([&](){after = server.loop()->getInputPool().stats();});
+
+    uint64_t appended = after.appended_chunks_-before.appended_chunks_;
+    uint64_t compacted = after.compacted_chunks_-before.compacted_chunks_;
+    state.SetBytesProcessed(state.iterations()*round_bytes);
+    state.counters["chunks/round"] = benchmark::Counter(double(appended-compacted)/std::max<int64_t>(1,state.iterations()));
+    state.counters["compaction_rate"] = benchmark::Counter(appended?double(compacted)/appended:0);
+    state.counters["peak_chunks"] = benchmark::Counter(after.peak_in_use_chunks_);
+}
+
+void BM_ChattyCompaction(benchmark::State& state)
+{
+    runCompactionBench(state,true);
+}
+
+void BM_ChattyNoCompaction(benchmark::State& state)
+{
+    runCompactionBench(state,false);
+}
+
+}
+
+BENCHMARK(BM_ChattyCompaction)->Arg(8)->Arg(64)->Arg(256)->UseRealTime();
+BENCHMARK(BM_ChattyNoCompaction)->Arg(8)->Arg(64)->Arg(256)->UseRealTime();
@@ -0,0 +1,76 @@
+#include "bench_helper.h"
+
+#include <string>
+
+//请求-回复协议中服务端分两次发送头部和数据体时，比较循环末尾合并提交和低延迟模式(每次发送立即提交)
+//每轮客户端发送一个字节的请求，等待完整的回复之后再发送下一个请求
+
+namespace
+{
+
+constexpr size_t kHeaderSize = 16;
+
+void runCorkingBench(benchmark::State& state,bool low_latency)
+{
+    size_t body_size = state.range(0);
+    WriteContext* w_ctx = nullptr;
+
+    LoopbackServer server([body_size,low_latency,&w_ctx](std::shared_ptr<TcpConnection> conn)->Task<>{
+        conn->setTcpNoDelay(true);
+        conn->setLowLatencySend(low_latency);
+        w_ctx = conn->getWriteContext();
+        std::string header(kHeaderSize,'h');
+        std::string body(body_size,'b');
+        while(true)
+        {
+            int size = co_await conn->PrepareToRead();
+            if(size<0) break;
+            conn->retrieve(size);
+            if(!co_await conn->send(header)) break;
+            if(!co_await conn->send(body)) break;
+        }
+    });
+
+    int fd = server.connect();
+    if(fd<0)
+    {
+        state.SkipWithError("connect failed");
+        return;
+    }
+
+    size_t ops_start = 0;
+    server.runInLoopSync([&](){if(w_ctx) ops_start = w_ctx->submitted_ops_;});
+    uint64_t cpu_start = server.loopCpuNs();
+    for(auto _:state)
+    {
+        if(!sendAll(fd,"r",1)||!recvDiscard(fd,kHeaderSize+body_size))
+        {
+            state.SkipWithError("loopback io failed");
+            break;
+        }
+    }
+    uint64_t cpu = server.loopCpuNs()-cpu_start;
+    size_t ops = 0;
+    server.runInLoopSync([&](){if(w_ctx) ops = w_ctx->submitted_ops_-ops_start;});
+    ::close(fd);
+
+    double rounds = double(std::max<int64_t>(1,state.iterations()));
+    state.SetItemsProcessed(state.iterations());
+    state.counters["write_sqes/round"] = benchmark::Counter(ops/rounds);
+    state.counters["server_cpu_ns/round"] = benchmark::Counter(cpu/rounds);
+}
+
+void BM_RequestResponseCorked(benchmark::State& state)
+{
+    runCorkingBench(state,false);
+}
+
+void BM_RequestResponseLowLatency(benchmark::State& state)
+{
+    runCorkingBench(state,true);
+}
+
+}
+
+BENCHMARK(BM_RequestResponseCorked)->RangeMultiplier(8)->Range(64,32*1024)->UseRealTime();
+BENCHMARK(BM_RequestResponseLowLatency)->RangeMultiplier(8)->Range(64,32*1024)->UseRealTime();
@@ -0,0 +1,131 @@
+#include "bench_helper.h"
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+//比较 recvInto 直接接收 和 PrepareToRead+read 从chunk拷贝 两种方式接收大消息的开销
+//每轮客户端发送一个 u32长度头+消息体，服务端收完之后回复一个字节
+
+namespace
+{
+
+//服务端从输入缓冲区拷贝到用户缓冲区的字节数
+std::atomic<uint64_t> g_copied{0};
+
+Task<> directSink(std::shared_ptr<TcpConnection> conn)
+{
+    std::vector<char> body;
+    bool running = true;
+    while(running)
+    {
+        uint32_t len = 0;
+        auto reader = conn->reader();
+        while(!reader.readBE(len))
+        {
+            if(co_await conn->PrepareToRead()<0)
+            {
+                running = false;
+                break;
+            }
+        }
+        if(!running) break;
+        reader.commit();
+
+        body.resize(len);
+        //recvInto 中只有已经进入缓冲区的那部分数据需要拷贝
+        size_t buffered = std::min<size_t>(len,conn->getReadContext()->input_buffer_.getTotalLen());
+        g_copied.fetch_add(buffered,std::memory_order_relaxed);
+        if(co_await conn->recvInto(body.data(),len)!=(ssize_t)len) break;
+        benchmark::DoNotOptimize(body.data());
+        if(!co_await conn->send(std::string(1,'k'))) break;
+    }
+}
+
+Task<> copySink(std::shared_ptr<TcpConnection> conn)
+{
+    std::vector<char> body;
+    bool running = true;
+    while(running)
+    {
+        uint32_t len = 0;
+        auto reader = conn->reader();
+        while(!reader.readBE(len))
+        {
+            if(co_await conn->PrepareToRead()<0)
+            {
+                running = false;
+                break;
+            }
+        }
+        if(!running) break;
+        reader.commit();
+
+        body.resize(len);
+        size_t filled = 0;
+        auto& buffer = conn->getReadContext()->input_buffer_;
+        while(filled<len)
+        {
+            if(buffer.getTotalLen()==0&&co_await conn->PrepareToRead()<0)
+            {
+                running = false;
+                break;
+            }
+            size_t n = buffer.remove(body.data()+filled,len-filled);
+            g_copied.fetch_add(n,std::memory_order_relaxed);
+            filled += n;
+        }
+        if(!running) break;
+        benchmark::DoNotOptimize(body.data());
+        if(!co_await conn->send(std::string(1,'k'))) break;
+    }
+}
+
+void runDirectBench(benchmark::State& state,LoopbackServer::Handler handler)
+{
+    size_t msg_size = state.range(0);
+    LoopbackServer server(std::move(handler));
+    int fd = server.connect();
+    if(fd<0)
+    {
+        state.SkipWithError("connect failed");
+        return;
+    }
+
+    uint32_t net_len = htonl(msg_size);
+    std::string data(reinterpret_cast<char*>(&net_len),sizeof(net_len));
+    data.append(msg_size,'x');
+
+    g_copied = 0;
+    uint64_t cpu_start = server.loopCpuNs();
+    for(auto _:state)
+    {
+        if(!sendAll(fd,data.data(),data.size())||!recvDiscard(fd,1))
+        {
+            state.SkipWithError("loopback io failed");
+            break;
+        }
+    }
+    uint64_t cpu_ns = server.loopCpuNs()-cpu_start;
+    ::close(fd);
+
+    double gb = double(state.iterations()*msg_size)/(1024.0*1024*1024);
+    state.SetBytesProcessed(state.iterations()*data.size());
+    state.counters["copied_bytes/GB"] = benchmark::Counter(gb>0?double(g_copied.load())/gb:0);
+    state.counters["server_cpu_ms/GB"] = benchmark::Counter(gb>0?double(cpu_ns)/1e6/gb:0);
+}
+
+void BM_RecvInto(benchmark::State& state)
+{
+    runDirectBench(state,directSink);
+}
+
+void BM_CopyFromChunks(benchmark::State& state)
+{
+    runDirectBench(state,copySink);
+}
+
+}
+
+BENCHMARK(BM_RecvInto)->RangeMultiplier(4)->Range(256*1024,16*1024*1024)->UseRealTime();
+BENCHMARK(BM_CopyFromChunks)->RangeMultiplier(4)->Range(256*1024,16*1024*1024)->UseRealTime();
@@ -0,0 +1,155 @@
+#include "bench_helper.h"
+
+#include <atomic>
+#include <string>
+
+//比较 readFrames 零拷贝解码、frames() 生成器逐帧拉取 和 PrepareToRead+read 手动拼帧 三种方式的吞吐量
+//每轮客户端发送kFramesPerRound个帧，服务端收完一轮之后回复一个字节
+
+namespace
+{
+
+constexpr size_t kFramesPerRound = 256;
+
+std::atomic<uint64_t> g_resumes{0};
+
+std::string makeFrames(size_t frame_size,size_t count)
+{
+    uint32_t len = htonl(frame_size);
+    std::string frame(reinterpret_cast<char*>(&len),sizeof(len));
+    frame.append(frame_size,'x');
+    std::string ret;
+    ret.reserve(frame.size()*count);
+    for(size_t i=0;i<count;++i) ret += frame;
+    return ret;
+}
+
+Task<> frameSink(std::shared_ptr<TcpConnection> conn)
+{
+    size_t frames = 0;
+    uint64_t checksum = 0;
+    bool running = true;
+    while(running)
+    {
+        auto batch = co_await conn->readFrames(64);
+        if(batch.empty()) break;
+        g_resumes.fetch_add(1,std::memory_order_relaxed);
+        for(auto& f:batch)
+        {
+            f.forEachSegment([&](const char* data,size_t len){checksum += data[0]+len;});
+            if(++frames%kFramesPerRound==0&&!co_await conn->send(std::string(1,'k')))
+            {
+                running = false;
+                break;
+            }
+        }
+    }
+    benchmark::DoNotOptimize(checksum);
+}
+
+//生成器每次只拉取一个帧，生成器和消费者之间通过对称转移切换
+Task<> generatorSink(std::shared_ptr<TcpConnection> conn)
+{
+    size_t frames = 0;
+    uint64_t checksum = 0;
+    auto gen = conn->frames();
+    while(true)
+    {
+        Frame* f = co_await gen.next();
+        if(!f) break;
+        g_resumes.fetch_add(1,std::memory_order_relaxed);
+        f->forEachSegment([&](const char* data,size_t len){checksum += data[0]+len;});
+        if(++frames%kFramesPerRound==0)
+        {
+            bool ok = co_await conn->send(std::string(1,'k'));
+            if(!ok) break;
+        }
+    }
+    benchmark::DoNotOptimize(checksum);
+}
+
+Task<> manualSink(std::shared_ptr<TcpConnection> conn)
+{
+    size_t frames = 0;
+    std::string pending;
+    bool running = true;
+    while(running)
+    {
+        int size = co_await conn->PrepareToRead();
+        if(size<0) break;
+        g_resumes.fetch_add(1,std::memory_order_relaxed);
+        pending += conn->read(size);
+
+        size_t pos = 0;
+        while(pending.size()-pos>=sizeof(uint32_t))
+        {
+            uint32_t len;
+            std::memcpy(&len,pending.data()+pos,sizeof(len));
+            len = ntohl(len);
+            if(pending.size()-pos-sizeof(len)<len) break;
+            std::string payload = pending.substr(pos+sizeof(len),len);
+            benchmark::DoNotOptimize(payload);
+            pos += sizeof(len)+len;
+            if(++frames%kFramesPerRound==0&&!co_await conn->send(std::string(1,'k')))
+            {
+                running = false;
+                break;
+            }
+        }
+        pending.erase(0,pos);
+    }
+}
+
+void runFrameBench(benchmark::State& state,LoopbackServer::Handler handler)
+{
+    size_t frame_size = state.range(0);
+    LoopbackOptions opt;
+    //最大的帧需要多个chunk，高水位线按照最大帧设置
+    opt.input_high_water_mark = 4096*32;
+    opt.input_high_water_mark_chunk = 32;
+    LoopbackServer server(std::move(handler),opt);
+    int fd = server.connect();
+    if(fd<0)
+    {
+        state.SkipWithError("connect failed");
+        return;
+    }
+
+    std::string data = makeFrames(frame_size,kFramesPerRound);
+    g_resumes = 0;
+    for(auto _:state)
+    {
+        if(!sendAll(fd,data.data(),data.size())||!recvDiscard(fd,1))
+        {
+            state.SkipWithError("loopback io failed");
+            break;
+        }
+    }
+    ::close(fd);
+
+    state.SetBytesProcessed(state.iterations()*data.size());
+    state.SetItemsProcessed(state.iterations()*kFramesPerRound);
+    state.counters["resumes/frame"] = benchmark::Counter(
+        double(g_resumes.load())/double(std::max<int64_t>(1,state.iterations()*kFramesPerRound)));
+}
+
+void BM_ReadFrames(benchmark::State& state)
+{
+    runFrameBench(state,frameSink);
+}
+
+void BM_FrameGenerator(benchmark::State& state)
+{
+    runFrameBench(state,generatorSink);
+}
+
+void BM_ManualReassembly(benchmark::State& state)
+{
+    runFrameBench(state,manualSink);
+}
+
+}
+
+BENCHMARK(BM_ReadFrames)->RangeMultiplier(4)->Range(64,64*1024)->UseRealTime();
+BENCHMARK(BM_FrameGenerator)->RangeMultiplier(4)->Range(64,64*1024)->UseRealTime();
+BENCHMARK(BM_ManualReassembly)->RangeMultiplier(4)->Range(64,64*1024)->UseRealTime();
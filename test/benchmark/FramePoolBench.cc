@@ -0,0 +1,147 @@
+#include "bench_helper.h"
+#include "FramePool.h"
+
+//协程帧的分配：
+//1. FrameChurn：在loop线程中创建并执行一批嵌套的Task，统计每个帧的分配和释放的时间，比较帧内存池和直接使用堆(缓存上限为0)
+//2. NestedHandler：每个请求调用一层嵌套的Task读取请求并发送回复，统计每次往返服务端的帧分配次数、其中从堆中分配的次数和cpu时间
+
+namespace
+{
+
+constexpr int kBatch = 1000;
+
+Task<int> frameChain(int depth)
+{
+    if(depth==0) co_return 0;
+    int value = co_await frameChain(depth-1);
+    co_return value+1;
+}
+
+uint64_t frameAllocs(const FramePool::Stats& stats)
+{
+    return stats.hits_+stats.misses_+stats.oversize_;
+}
+
+void reportFrames(benchmark::State& state,const FramePool::Stats& start,const FramePool::Stats& end,uint64_t heap_allocs,int64_t ops)
+{
+    ops = std::max<int64_t>(1,ops);
+    state.counters["frames/op"] = benchmark::Counter(double(frameAllocs(end)-frameAllocs(start))/double(ops));
+    state.counters["pool_hits/op"] = benchmark::Counter(double(end.hits_-start.hits_)/double(ops));
+    state.counters["heap_allocs/op"] = benchmark::Counter(double(heap_allocs)/double(ops));
+}
+
+void runFrameChurn(benchmark::State& state,bool pooled)
+{
+    int depth = state.range(0);
+    LoopbackServer server([](std::shared_ptr<TcpConnection>)->Task<>{co_return;});
+    FramePool::Stats start{},end{};
+    uint64_t heap_allocs = 0;
+    server.runInLoopSync([&](){
+        if(!pooled) server.loop()->getFramePool().setCacheLimit(0);
+        start = server.loop()->getFramePool().stats();
+    });
+
+    for(auto _:state)
+    {
+        server.runInLoopSync([&](){
+            uint64_t allocs_start = threadAllocCount();
+            for(int i=0;i<kBatch;++i)
+            {
+                auto task = frameChain(depth);
+                task.resume();
+                benchmark::DoNotOptimize(task.returnValue());
+            }
+            heap_allocs += threadAllocCount()-allocs_start;
+        });
+    }
+    server.runInLoopSync([&](){end = server.loop()->getFramePool().stats();});
+
+    int64_t frames = state.iterations()*kBatch*(depth+1);
+    state.SetItemsProcessed(frames);
+    reportFrames(state,start,end,heap_allocs,frames);
+}
+
+void BM_FrameChurnPool(benchmark::State& state)
+{
+    runFrameChurn(state,true);
+}
+
+void BM_FrameChurnHeap(benchmark::State& state)
+{
+    runFrameChurn(state,false);
+}
+
+//一次请求和回复，每一次调用都会创建一个新的帧
+Task<bool> echoOnce(std::shared_ptr<TcpConnection> conn)
+{
+    int size = co_await conn->PrepareToRead();
+    if(size<0) co_return false;
+    conn->retrieve(size);
+    bool ok = co_await conn->send(std::string(size,'e'));
+    co_return ok;
+}
+
+Task<> nestedEchoHandler(std::shared_ptr<TcpConnection> conn)
+{
+    while(true)
+    {
+        bool ok = co_await echoOnce(conn);
+        if(!ok) break;
+    }
+}
+
+void runNestedHandler(benchmark::State& state,bool pooled)
+{
+    LoopbackServer server(nestedEchoHandler);
+    int fd = server.connect();
+    if(fd<0)
+    {
+        state.SkipWithError("connect failed");
+        return;
+    }
+
+    FramePool::Stats start{},end{};
+    uint64_t allocs_start = 0,allocs_end = 0;
+    server.runInLoopSync([&](){
+        if(!pooled) server.loop()->getFramePool().setCacheLimit(0);
+        start = server.loop()->getFramePool().stats();
+        allocs_start = threadAllocCount();
+    });
+    uint64_t cpu_start = server.loopCpuNs();
+    for(auto _:state)
+    {
+        if(!sendAll(fd,"q",1)||!recvDiscard(fd,1))
+        {
+            state.SkipWithError("loopback io failed");
+            break;
+        }
+    }
+    uint64_t cpu = server.loopCpuNs()-cpu_start;
+    server.runInLoopSync([&](){
+        end = server.loop()->getFramePool().stats();
+        allocs_end = threadAllocCount();
+    });
+    ::close(fd);
+
+    int64_t rounds = std::max<int64_t>(1,state.iterations());
+    state.SetItemsProcessed(state.iterations());
+    state.counters["server_cpu_ns/rt"] = benchmark::Counter(double(cpu)/double(rounds));
+    reportFrames(state,start,end,allocs_end-allocs_start,rounds);
+}
+
+void BM_NestedHandlerPool(benchmark::State& state)
+{
+    runNestedHandler(state,true);
+}
+
+void BM_NestedHandlerHeap(benchmark::State& state)
+{
+    runNestedHandler(state,false);
+}
+
+}
+
+BENCHMARK(BM_FrameChurnPool)->Arg(0)->Arg(4)->Arg(16)->UseRealTime();
+BENCHMARK(BM_FrameChurnHeap)->Arg(0)->Arg(4)->Arg(16)->UseRealTime();
+BENCHMARK(BM_NestedHandlerPool)->UseRealTime();
+BENCHMARK(BM_NestedHandlerHeap)->UseRealTime();
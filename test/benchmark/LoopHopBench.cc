@@ -0,0 +1,91 @@
+#include "bench_helper.h"
+#include "Task.hpp"
+
+//在两个loop之间来回切换kHops次：
+//1. SwitchTo：协程通过co_await switchTo(loop)切换，节点保存在协程帧中
+//2. QueueInLoop：每一次切换都通过queueInLoop追加一个std::function
+//统计每次切换的耗时和两个loop线程中的堆分配次数
+
+namespace
+{
+
+constexpr int kHops = 1000;
+
+Task<> pingPong(IoUringLoop* a,IoUringLoop* b,std::promise<void>& done)
+{
+    for(int i=0;i<kHops/2;++i)
+    {
+        co_await switchTo(*b);
+        co_await switchTo(*a);
+    }
+    done.set_value();
+}
+
+void hopByFunctor(IoUringLoop* a,IoUringLoop* b,int left,std::promise<void>& done)
+{
+    if(left==0)
+    {
+        done.set_value();
+        return;
+    }
+    IoUringLoop* next = left%2?a:b;
+    next->queueInLoop([a,b,left,&done](){hopByFunctor(a,b,left-1,done);});
+}
+
+uint64_t loopAllocs(LoopbackServer& server)
+{
+    uint64_t count = 0;
+    server.runInLoopSync([&](){count = threadAllocCount();});
+    return count;
+}
+
+void runHops(benchmark::State& state,bool coroutine)
+{
+    auto noop = [](std::shared_ptr<TcpConnection>)->Task<>{co_return;};
+    LoopbackServer first(noop);
+    LoopbackServer second(noop);
+    IoUringLoop* a = first.loop();
+    IoUringLoop* b = second.loop();
+
+    uint64_t allocs_start = loopAllocs(first)+loopAllocs(second);
+    for(auto _:state)
+    {
+        std::promise<void> done;
+        auto finished = done.get_future();
+        std::unique_ptr<Task<>> task;
+        if(coroutine)
+        {
+            first.runInLoopSync([&](){
+                task = std::make_unique<Task<>>(pingPong(a,b,done));
+                task->resume();
+            });
+        }
+        else
+        {
+            first.runInLoopSync([&](){hopByFunctor(a,b,kHops,done);});
+        }
+        finished.wait();
+        //协程在a中执行完毕之后再销毁
+        if(task) first.runInLoopSync([&](){task.reset();});
+    }
+    uint64_t allocs = loopAllocs(first)+loopAllocs(second)-allocs_start;
+
+    int64_t hops = std::max<int64_t>(1,state.iterations()*kHops);
+    state.SetItemsProcessed(state.iterations()*kHops);
+    state.counters["allocs/hop"] = benchmark::Counter(double(allocs)/double(hops));
+}
+
+void BM_SwitchToPingPong(benchmark::State& state)
+{
+    runHops(state,true);
+}
+
+void BM_QueueInLoopPingPong(benchmark::State& state)
+{
+    runHops(state,false);
+}
+
+}
+
+BENCHMARK(BM_SwitchToPingPong)->UseRealTime();
+BENCHMARK(BM_QueueInLoopPingPong)->UseRealTime();
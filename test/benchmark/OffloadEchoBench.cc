@@ -0,0 +1,100 @@
+#include "bench_helper.h"
+#include "ThreadPool.h"
+
+#include <string>
+
+//每个请求都在线程池中处理的回显：协程切换到线程池之后在工作线程中调用PrepareToRead和send，
+//awaiter跨线程把协程交回loop，在loop中读写之后恢复
+//每轮客户端同时向所有连接发送一个请求，然后按顺序接收所有回复
+//统计每个往返在loop线程和工作线程中的堆分配次数
+
+namespace
+{
+
+constexpr size_t kRequestSize = 8;
+
+ThreadPool* g_pool = nullptr;
+
+Task<> offloadEchoHandler(std::shared_ptr<TcpConnection> conn)
+{
+    while(true)
+    {
+        co_await g_pool->switchThread();
+        int size = co_await conn->PrepareToRead();
+        if(size<0) break;
+        std::string data = conn->read(size);
+        co_await g_pool->switchThread();
+        bool ok = co_await conn->send(std::move(data));
+        if(!ok) break;
+    }
+}
+
+Task<> readAllocs(ThreadPool& pool,uint64_t& count)
+{
+    co_await pool.switchThread();
+    count = threadAllocCount();
+}
+
+//工作线程中的堆分配次数，线程池只有一个线程
+uint64_t poolAllocs(ThreadPool& pool)
+{
+    uint64_t count = 0;
+    auto task = readAllocs(pool,count);
+    task.resume();
+    while(!task.handle_.done()) std::this_thread::yield();
+    return count;
+}
+
+void BM_OffloadEcho(benchmark::State& state)
+{
+    size_t conns = state.range(0);
+    LoopbackServer server(offloadEchoHandler);
+    //线程池先于服务器析构，队列中剩下的协程在loop退出之前交回loop
+    ThreadPool pool(1,1024);
+    g_pool = &pool;
+
+    std::vector<int> fds;
+    for(size_t i=0;i<conns;++i)
+    {
+        int fd = server.connect();
+        if(fd<0)
+        {
+            state.SkipWithError("connect failed");
+            for(int f:fds) ::close(f);
+            return;
+        }
+        fds.push_back(fd);
+    }
+
+    std::string request(kRequestSize,'q');
+    //先完成一轮，连接的协程和缓冲区都已经创建
+    for(int fd:fds) sendAll(fd,request.data(),request.size());
+    for(int fd:fds) recvDiscard(fd,request.size());
+
+    uint64_t loop_allocs = 0;
+    server.runInLoopSync([&](){loop_allocs = threadAllocCount();});
+    uint64_t worker_allocs = poolAllocs(pool);
+    for(auto _:state)
+    {
+        bool ok = true;
+        for(int fd:fds) ok = ok&&sendAll(fd,request.data(),request.size());
+        for(int fd:fds) ok = ok&&recvDiscard(fd,request.size());
+        if(!ok)
+        {
+            state.SkipWithError("loopback io failed");
+            break;
+        }
+    }
+    server.runInLoopSync([&](){loop_allocs = threadAllocCount()-loop_allocs;});
+    worker_allocs = poolAllocs(pool)-worker_allocs;
+    for(int fd:fds) ::close(fd);
+
+    int64_t round_trips = std::max<int64_t>(1,state.iterations()*conns);
+    state.SetItemsProcessed(state.iterations()*conns);
+    state.counters["loop_allocs/rt"] = benchmark::Counter(double(loop_allocs)/double(round_trips));
+    state.counters["worker_allocs/rt"] = benchmark::Counter(double(worker_allocs)/double(round_trips));
+}
+
+}
+
+BENCHMARK(BM_OffloadEcho)->Arg(1)->Arg(16)->UseRealTime();
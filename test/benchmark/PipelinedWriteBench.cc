@@ -0,0 +1,70 @@
+#include "bench_helper.h"
+
+#include <string>
+
+//比较一个连接同时有1个和多个发送请求在内核中时的吞吐量
+//每轮客户端发送一个字节的请求，服务端把kRoundBytes按照消息大小切分之后发送
+//只有一个请求时，请求返回到下一个请求提交之间socket是空闲的；多个请求链接在一起时内核写完一个请求之后直接开始下一个
+
+namespace
+{
+
+constexpr size_t kRoundBytes = 16*1024*1024;
+
+void BM_PipelinedWrite(benchmark::State& state)
+{
+    size_t msg_size = state.range(0);
+    size_t max_inflight = state.range(1);
+
+    LoopbackOptions opt;
+    opt.output_high_water_mark = 4*1024*1024;
+    LoopbackServer server([msg_size,max_inflight](std::shared_ptr<TcpConnection> conn)->Task<>{
+        conn->setMaxInflightWrites(max_inflight);
+        std::string payload(msg_size,'p');
+        bool running = true;
+        while(running)
+        {
+            int size = co_await conn->PrepareToRead();
+            if(size<0) break;
+            conn->retrieve(size);
+            for(size_t sent=0;sent<kRoundBytes;sent+=msg_size)
+            {
+                if(!co_await conn->send(payload))
+                {
+                    running = false;
+                    break;
+                }
+            }
+        }
+    },opt);
+
+    int fd = server.connect();
+    if(fd<0)
+    {
+        state.SkipWithError("connect failed");
+        return;
+    }
+
+    uint64_t cpu_start = server.loopCpuNs();
+    for(auto _:state)
+    {
+        if(!sendAll(fd,"r",1)||!recvDiscard(fd,kRoundBytes))
+        {
+            state.SkipWithError("loopback io failed");
+            break;
+        }
+    }
+    uint64_t cpu = server.loopCpuNs()-cpu_start;
+    ::close(fd);
+
+    double gb = double(state.iterations())*kRoundBytes/(1024.0*1024*1024);
+    state.SetBytesProcessed(state.iterations()*kRoundBytes);
+    state.counters["server_cpu_ms/GB"] = benchmark::Counter(gb>0?cpu/1e6/gb:0);
+}
+
+}
+
+BENCHMARK(BM_PipelinedWrite)
+    ->ArgsProduct({{64*1024,256*1024,1024*1024},{1,2,4,8}})
+    ->ArgNames({"msg","inflight"})
+    ->UseRealTime();
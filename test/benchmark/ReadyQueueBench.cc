@@ -0,0 +1,95 @@
+#include "bench_helper.h"
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+
+//比较读写完成之后直接恢复协程和放入就绪队列延迟恢复两种方式
+//每轮客户端同时向所有连接发送一个请求，服务端的一批cqe中包含多个连接的数据，然后按顺序接收所有回复
+//统计每轮的耗时，p50/p99反映同一批中排在后面的连接要等待多久
+
+namespace
+{
+
+constexpr size_t kRequestSize = 64;
+
+Task<> echoHandler(std::shared_ptr<TcpConnection> conn)
+{
+    while(true)
+    {
+        int size = co_await conn->PrepareToRead();
+        if(size<0) break;
+        bool ok = co_await conn->send(conn->read(size));
+        if(!ok) break;
+    }
+}
+
+//budget为0表示直接恢复，否则开启延迟恢复并使用这个预算
+void runEchoBench(benchmark::State& state,bool deferred)
+{
+    size_t conns = state.range(0);
+    size_t budget = deferred?state.range(1):0;
+    LoopbackServer server(echoHandler);
+    server.runInLoopSync([&](){
+        server.loop()->setDeferredResume(deferred);
+        server.loop()->setResumeBudget(budget);
+    });
+
+    std::vector<int> fds;
+    for(size_t i=0;i<conns;++i)
+    {
+        int fd = server.connect();
+        if(fd<0)
+        {
+            state.SkipWithError("connect failed");
+            for(int f:fds) ::close(f);
+            return;
+        }
+        fds.push_back(fd);
+    }
+
+    std::string request(kRequestSize,'q');
+    std::vector<double> rounds;
+    uint64_t cpu_start = server.loopCpuNs();
+    for(auto _:state)
+    {
+        auto start = std::chrono::steady_clock::now();
+        bool ok = true;
+        for(int fd:fds) ok = ok&&sendAll(fd,request.data(),request.size());
+        for(int fd:fds) ok = ok&&recvDiscard(fd,request.size());
+        if(!ok)
+        {
+            state.SkipWithError("loopback io failed");
+            break;
+        }
+        rounds.push_back(std::chrono::duration<double,std::micro>(std::chrono::steady_clock::now()-start).count());
+    }
+    uint64_t cpu = server.loopCpuNs()-cpu_start;
+    for(int fd:fds) ::close(fd);
+
+    int64_t requests = std::max<int64_t>(1,state.iterations()*conns);
+    state.SetItemsProcessed(state.iterations()*conns);
+    state.counters["server_cpu_ns/req"] = benchmark::Counter(double(cpu)/double(requests));
+    if(!rounds.empty())
+    {
+        std::sort(rounds.begin(),rounds.end());
+        state.counters["p50_us"] = rounds[rounds.size()/2];
+        state.counters["p99_us"] = rounds[std::min(rounds.size()-1,rounds.size()*99/100)];
+    }
+}
+
+void BM_EchoInlineResume(benchmark::State& state)
+{
+    runEchoBench(state,false);
+}
+
+void BM_EchoDeferredResume(benchmark::State& state)
+{
+    runEchoBench(state,true);
+}
+
+}
+
+BENCHMARK(BM_EchoInlineResume)->Args({1,0})->Args({16,0})->Args({64,0})->UseRealTime();
+//预算为0表示不限制
+BENCHMARK(BM_EchoDeferredResume)->Args({1,0})->Args({16,0})->Args({64,0})->Args({64,8})->UseRealTime();
@@ -0,0 +1,125 @@
+#include "bench_helper.h"
+
+#include <string>
+
+#include "ChunkPoolManagerOutput.h"
+
+//服务端序列化响应的两种方式：先构造std::string再send，直接在注册过的输出内存中reserve/commit
+//每轮客户端发送一个字节的请求，服务端回复kMessagesPerRound个消息，统计吞吐量、服务端cpu和loop线程每个消息的堆分配次数
+
+namespace
+{
+
+constexpr size_t kMessagesPerRound = 256;
+
+//模拟序列化，把消息写入target
+void serialize(char* target,size_t len,size_t seq)
+{
+    std::memset(target,'a'+seq%26,len);
+    std::memcpy(target,&seq,std::min(len,sizeof(seq)));
+}
+
+Task<> stringSender(std::shared_ptr<TcpConnection> conn,size_t msg_size)
+{
+    conn->setTcpNoDelay(true);
+    size_t seq = 0;
+    bool running = true;
+    while(running)
+    {
+        int size = co_await conn->PrepareToRead();
+        if(size<0) break;
+        conn->retrieve(size);
+        for(size_t i=0;i<kMessagesPerRound;++i)
+        {
+            std::string msg(msg_size,'\0');
+            serialize(msg.data(),msg_size,seq++);
+            if(!co_await conn->send(std::move(msg)))
+            {
+                running = false;
+                break;
+            }
+        }
+    }
+}
+
+Task<> reserveSender(std::shared_ptr<TcpConnection> conn,size_t msg_size)
+{
+    conn->setTcpNoDelay(true);
+    size_t seq = 0;
+    bool running = true;
+    while(running)
+    {
+        int size = co_await conn->PrepareToRead();
+        if(size<0) break;
+        conn->retrieve(size);
+        for(size_t i=0;i<kMessagesPerRound;++i)
+        {
+            auto buf = conn->reserve(msg_size);
+            if(buf.empty())
+            {
+                running = false;
+                break;
+            }
+            serialize(buf.data(),msg_size,seq++);
+            if(!co_await conn->commit(msg_size))
+            {
+                running = false;
+                break;
+            }
+        }
+    }
+}
+
+void runReserveBench(benchmark::State& state,bool reserve)
+{
+    size_t msg_size = state.range(0);
+    LoopbackOptions opt;
+    opt.output_high_water_mark = 4*1024*1024;
+    LoopbackServer server([msg_size,reserve](std::shared_ptr<TcpConnection> conn)->Task<>{
+        return reserve?reserveSender(conn,msg_size):stringSender(conn,msg_size);
+    },opt);
+
+    int fd = server.connect();
+    if(fd<0)
+    {
+        state.SkipWithError("connect failed");
+        return;
+    }
+
+    size_t round_bytes = msg_size*kMessagesPerRound;
+    uint64_t allocs_start = 0,allocs_end = 0;
+    server.runInLoopSync([&](){allocs_start = threadAllocCount();});
+    uint64_t cpu_start = server.loopCpuNs();
+    for(auto _:state)
+    {
+        if(!sendAll(fd,"r",1)||!recvDiscard(fd,round_bytes))
+        {
+            state.SkipWithError("loopback io failed");
+            break;
+        }
+    }
+    uint64_t cpu = server.loopCpuNs()-cpu_start;
+    server.runInLoopSync([&](){allocs_end = threadAllocCount();});
+    ::close(fd);
+
+    int64_t messages = std::max<int64_t>(1,state.iterations()*kMessagesPerRound);
+    state.SetBytesProcessed(state.iterations()*round_bytes);
+    state.SetItemsProcessed(messages);
+    state.counters["server_cpu_ns/msg"] = benchmark::Counter(double(cpu)/double(messages));
+    state.counters["server_allocs/msg"] = benchmark::Counter(double(allocs_end-allocs_start)/double(messages));
+}
+
+void BM_SerializeToString(benchmark::State& state)
+{
+    runReserveBench(state,false);
+}
+
+void BM_SerializeReserveCommit(benchmark::State& state)
+{
+    runReserveBench(state,true);
+}
+
+}
+
+BENCHMARK(BM_SerializeToString)->RangeMultiplier(8)->Range(64,32*1024)->UseRealTime();
+BENCHMARK(BM_SerializeReserveCommit)->RangeMultiplier(8)->Range(64,32*1024)->UseRealTime();
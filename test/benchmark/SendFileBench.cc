@@ -0,0 +1,142 @@
+#include "bench_helper.h"
+
+#include <string>
+#include <cstdlib>
+#include <fcntl.h>
+#include <sys/resource.h>
+
+//通过回环发送一个大文件，比较三种方式：
+//1. sendFile使用splice经过管道发送，数据不经过用户态
+//2. sendFile关闭splice，文件读入注册过的输出内存再发送
+//3. 现有的方式：把文件读入std::string，再通过send发送
+//每轮客户端发送一个字节的请求，服务端把整个文件发送回来，统计吞吐量和服务端loop线程每GB数据的cpu时间
+//注意splice的请求通常由内核的io-wq线程执行，这部分cpu时间不计入loop线程，比较的时候同时参考进程总的cpu时间(包括客户端)
+
+namespace
+{
+
+enum class FileMode
+{
+    Splice,
+    ReadFallback,
+    ReadIntoString,
+};
+
+//所有测试共用的文件，第一次使用时创建，进程退出时关闭(文件已经unlink)
+int benchFile(size_t size)
+{
+    static int fd = -1;
+    static size_t file_size = 0;
+    if(fd>=0&&file_size>=size) return fd;
+    if(fd>=0) ::close(fd);
+
+    char path[] = "/tmp/send_file_bench_XXXXXX";
+    fd = ::mkstemp(path);
+    if(fd<0) return -1;
+    ::unlink(path);
+    std::string block(1024*1024,'f');
+    for(size_t written=0;written<size;written+=block.size())
+    {
+        if(::write(fd,block.data(),block.size())!=ssize_t(block.size()))
+        {
+            ::close(fd);
+            fd = -1;
+            return -1;
+        }
+    }
+    file_size = size;
+    //数据写回磁盘并留在页缓存中，测试的是发送路径而不是磁盘
+    ::fsync(fd);
+    return fd;
+}
+
+//进程消耗的cpu时间，包括io_uring的内核工作线程和客户端
+uint64_t processCpuNs()
+{
+    rusage usage{};
+    ::getrusage(RUSAGE_SELF,&usage);
+    return (uint64_t(usage.ru_utime.tv_sec+usage.ru_stime.tv_sec))*1000000000ull
+        +(uint64_t(usage.ru_utime.tv_usec+usage.ru_stime.tv_usec))*1000ull;
+}
+
+void runSendFileBench(benchmark::State& state,FileMode mode)
+{
+    size_t file_size = state.range(0);
+    int file_fd = benchFile(file_size);
+    if(file_fd<0)
+    {
+        state.SkipWithError("create file failed");
+        return;
+    }
+
+    LoopbackOptions opt;
+    opt.output_high_water_mark = 4*1024*1024;
+    LoopbackServer server([file_fd,file_size,mode](std::shared_ptr<TcpConnection> conn)->Task<>{
+        conn->setFileSplice(mode==FileMode::Splice);
+        while(true)
+        {
+            int size = co_await conn->PrepareToRead();
+            if(size<0) break;
+            conn->retrieve(size);
+            bool ok = false;
+            if(mode==FileMode::ReadIntoString)
+            {
+                std::string data(file_size,'\0');
+                if(::pread(file_fd,data.data(),file_size,0)!=ssize_t(file_size)) break;
+                ok = co_await conn->send(std::move(data));
+            }
+            else
+            {
+                ok = co_await conn->sendFile(file_fd,0,file_size);
+            }
+            if(!ok) break;
+        }
+    },opt);
+
+    int fd = server.connect();
+    if(fd<0)
+    {
+        state.SkipWithError("connect failed");
+        return;
+    }
+
+    uint64_t cpu_start = server.loopCpuNs();
+    uint64_t process_cpu_start = processCpuNs();
+    for(auto _:state)
+    {
+        if(!sendAll(fd,"r",1)||!recvDiscard(fd,file_size))
+        {
+            state.SkipWithError("loopback io failed");
+            break;
+        }
+    }
+    uint64_t cpu = server.loopCpuNs()-cpu_start;
+    uint64_t process_cpu = processCpuNs()-process_cpu_start;
+    ::close(fd);
+
+    double gb = double(std::max<int64_t>(1,state.iterations()))*file_size/(1024.0*1024*1024);
+    state.SetBytesProcessed(state.iterations()*file_size);
+    state.counters["server_cpu_ms/GB"] = benchmark::Counter(cpu/1e6/gb);
+    state.counters["process_cpu_ms/GB"] = benchmark::Counter(process_cpu/1e6/gb);
+}
+
+void BM_SendFileSplice(benchmark::State& state)
+{
+    runSendFileBench(state,FileMode::Splice);
+}
+
+void BM_SendFileReadFallback(benchmark::State& state)
+{
+    runSendFileBench(state,FileMode::ReadFallback);
+}
+
+void BM_SendFileReadIntoString(benchmark::State& state)
+{
+    runSendFileBench(state,FileMode::ReadIntoString);
+}
+
+}
+
+BENCHMARK(BM_SendFileSplice)->Arg(64<<20)->Arg(1<<30)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK(BM_SendFileReadFallback)->Arg(64<<20)->Arg(1<<30)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK(BM_SendFileReadIntoString)->Arg(64<<20)->Arg(1<<30)->Unit(benchmark::kMillisecond)->UseRealTime();
@@ -0,0 +1,88 @@
+#include "bench_helper.h"
+
+#include <string>
+#include <vector>
+
+#include "SendQueue.hpp"
+
+//SendQueue 追加和移除的开销
+//每轮追加kBatch个分片，模拟一次flush取出iovec，然后全部移除，统计每个分片的耗时和堆分配次数
+//NoPool 为不使用对象池、每个分片单独new/delete的情况
+
+namespace
+{
+
+constexpr size_t kBatch = 64;
+
+void reportAllocs(benchmark::State& state,uint64_t allocs)
+{
+    state.SetItemsProcessed(state.iterations()*kBatch);
+    state.counters["allocs/op"] = benchmark::Counter(
+        double(allocs)/double(std::max<int64_t>(1,state.iterations()*kBatch)));
+}
+
+//拷贝调用方的数据
+void runAppendCopy(benchmark::State& state,TxFragmentPool* pool)
+{
+    size_t size = state.range(0);
+    std::string payload(size,'x');
+    SendQueue q(pool);
+    std::vector<iovec> iovecs;
+    iovecs.reserve(kBatch);
+
+    uint64_t start = threadAllocCount();
+    for(auto _:state)
+    {
+        for(size_t i=0;i<kBatch;++i) q.append(payload.data(),payload.size());
+        iovecs.clear();
+        q.getBatchFragment(iovecs,kBatch);
+        benchmark::DoNotOptimize(iovecs.data());
+        q.retrieve(q.getTotalLen());
+    }
+    reportAllocs(state,threadAllocCount()-start);
+}
+
+void BM_SendQueueAppendCopy(benchmark::State& state)
+{
+    TxFragmentPool pool;
+    runAppendCopy(state,&pool);
+}
+
+void BM_SendQueueAppendCopyNoPool(benchmark::State& state)
+{
+    runAppendCopy(state,nullptr);
+}
+
+//转移std::string的所有权，预先准备好的string在每轮中被移动进队列，不计入分配次数
+void BM_SendQueueAppendMove(benchmark::State& state)
+{
+    size_t size = state.range(0);
+    TxFragmentPool pool;
+    SendQueue q(&pool);
+    std::vector<iovec> iovecs;
+    iovecs.reserve(kBatch);
+    std::vector<std::string> payloads(kBatch);
+
+    uint64_t allocs = 0;
+    for(auto _:state)
+    {
+        state.PauseTiming();
+        for(auto& p:payloads) p.assign(size,'x');
+        state.ResumeTiming();
+
+        uint64_t start = threadAllocCount();
+        for(auto& p:payloads) q.append(std::move(p));
+        iovecs.clear();
+        q.getBatchFragment(iovecs,kBatch);
+        benchmark::DoNotOptimize(iovecs.data());
+        q.retrieve(q.getTotalLen());
+        allocs += threadAllocCount()-start;
+    }
+    reportAllocs(state,allocs);
+}
+
+}
+
+BENCHMARK(BM_SendQueueAppendCopy)->Arg(16)->Arg(64)->Arg(512)->Arg(4096);
+BENCHMARK(BM_SendQueueAppendCopyNoPool)->Arg(16)->Arg(64)->Arg(512)->Arg(4096);
+BENCHMARK(BM_SendQueueAppendMove)->Arg(16)->Arg(64)->Arg(512)->Arg(4096);
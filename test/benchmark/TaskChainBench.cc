@@ -0,0 +1,80 @@
+#include "bench_helper.h"
+#include "Task.hpp"
+
+//深的调用链：每一层都是一个独立的协程，比较co_await直接对称转移、普通函数调用和每一层都经过loop任务队列的开销
+//开启优化时co_await的调用链不会增加调用栈的深度，每一层的开销和调用链的深度无关
+
+namespace
+{
+
+Task<int> awaitChain(int depth)
+{
+    if(depth==0) co_return 0;
+    int value = co_await awaitChain(depth-1);
+    co_return value+1;
+}
+
+__attribute__((noinline)) int callChain(int depth)
+{
+    if(depth==0) return 0;
+    int value = callChain(depth-1);
+    benchmark::DoNotOptimize(value);
+    return value+1;
+}
+
+void BM_AwaitChain(benchmark::State& state)
+{
+    int depth = state.range(0);
+    for(auto _:state)
+    {
+        auto task = awaitChain(depth);
+        task.resume();
+        if(!task.done()||task.returnValue()!=depth)
+        {
+            state.SkipWithError("wrong result");
+            break;
+        }
+    }
+    state.SetItemsProcessed(state.iterations()*depth);
+}
+
+void BM_CallChain(benchmark::State& state)
+{
+    int depth = state.range(0);
+    for(auto _:state)
+    {
+        int value = callChain(depth);
+        benchmark::DoNotOptimize(value);
+    }
+    state.SetItemsProcessed(state.iterations()*depth);
+}
+
+//没有Task组合时，每一层完成之后只能通过loop的任务队列继续下一层
+void BM_LoopHopChain(benchmark::State& state)
+{
+    int depth = state.range(0);
+    LoopbackServer server([](std::shared_ptr<TcpConnection>)->Task<>{co_return;});
+    IoUringLoop* loop = server.loop();
+    for(auto _:state)
+    {
+        std::promise<void> p;
+        auto done = p.get_future();
+        std::function<void(int)> step = [&](int n){
+            if(n==0)
+            {
+                p.set_value();
+                return;
+            }
+            loop->queueInLoop([&step,n](){step(n-1);});
+        };
+        loop->runInLoop([&](){step(depth);});
+        done.wait();
+    }
+    state.SetItemsProcessed(state.iterations()*depth);
+}
+
+}
+
+BENCHMARK(BM_AwaitChain)->RangeMultiplier(16)->Range(1,4096);
+BENCHMARK(BM_CallChain)->RangeMultiplier(16)->Range(1,4096);
+BENCHMARK(BM_LoopHopChain)->RangeMultiplier(16)->Range(1,4096)->UseRealTime();
@@ -0,0 +1,115 @@
+#include "bench_helper.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+
+//混合负载：一个连接的每个请求需要约2ms的计算，其它连接只做回显
+//比较重的处理一次做完和每50us调用一次co_await loop.yield()两种方式下轻请求的往返延迟
+//同时开启慢处理计时，统计loop记录的慢处理次数和最慢的一次耗时
+
+namespace
+{
+
+constexpr int kSlices = 40;
+constexpr int64_t kSliceUs = 50;
+
+std::atomic<bool> g_yield{false};
+
+void spin(int64_t us)
+{
+    auto end = std::chrono::steady_clock::now()+std::chrono::microseconds(us);
+    while(std::chrono::steady_clock::now()<end) {}
+}
+
+//请求'h'需要分段计算，其它请求直接回复一个字节
+Task<> mixedHandler(std::shared_ptr<TcpConnection> conn)
+{
+    IoUringLoop* loop = conn->getLoop();
+    while(true)
+    {
+        int size = co_await conn->PrepareToRead();
+        if(size<0) break;
+        std::string request = conn->read(size);
+        if(request.find('h')!=std::string::npos)
+        {
+            for(int i=0;i<kSlices;++i)
+            {
+                spin(kSliceUs);
+                if(g_yield.load(std::memory_order_relaxed)) co_await loop->yield();
+            }
+        }
+        bool ok = co_await conn->send(std::string(1,'r'));
+        if(!ok) break;
+    }
+}
+
+void runMixed(benchmark::State& state,bool yield)
+{
+    g_yield = yield;
+    LoopbackServer server(mixedHandler);
+    server.runInLoopSync([&](){server.loop()->setSlowHandlerThreshold(1000,[](const IoContext*,int64_t){});});
+    int heavy_fd = server.connect();
+    int light_fd = server.connect();
+    if(heavy_fd<0||light_fd<0)
+    {
+        state.SkipWithError("connect failed");
+        return;
+    }
+
+    //重的连接一直发送请求
+    std::atomic<bool> stop{false};
+    std::atomic<uint64_t> heavy_done{0};
+    std::thread heavy([&](){
+        while(!stop.load())
+        {
+            if(!sendAll(heavy_fd,"h",1)||!recvDiscard(heavy_fd,1)) break;
+            heavy_done++;
+        }
+    });
+
+    std::vector<double> rtts;
+    for(auto _:state)
+    {
+        auto start = std::chrono::steady_clock::now();
+        if(!sendAll(light_fd,"q",1)||!recvDiscard(light_fd,1))
+        {
+            state.SkipWithError("loopback io failed");
+            break;
+        }
+        rtts.push_back(std::chrono::duration<double,std::micro>(std::chrono::steady_clock::now()-start).count());
+    }
+    stop = true;
+    heavy.join();
+
+    LoopStats stats{};
+    server.runInLoopSync([&](){stats = server.loop()->stats();});
+    ::close(heavy_fd);
+    ::close(light_fd);
+
+    state.SetItemsProcessed(state.iterations());
+    state.counters["heavy_reqs"] = benchmark::Counter(double(heavy_done.load()));
+    state.counters["slow_handlers"] = benchmark::Counter(double(stats.slow_handlers_));
+    state.counters["max_handler_us"] = benchmark::Counter(double(stats.max_handler_us_));
+    if(!rtts.empty())
+    {
+        std::sort(rtts.begin(),rtts.end());
+        state.counters["p50_us"] = rtts[rtts.size()/2];
+        state.counters["p99_us"] = rtts[std::min(rtts.size()-1,rtts.size()*99/100)];
+    }
+}
+
+void BM_MixedNoYield(benchmark::State& state)
+{
+    runMixed(state,false);
+}
+
+void BM_MixedYield(benchmark::State& state)
+{
+    runMixed(state,true);
+}
+
+}
+
+BENCHMARK(BM_MixedNoYield)->UseRealTime();
+BENCHMARK(BM_MixedYield)->UseRealTime();
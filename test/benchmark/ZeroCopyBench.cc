@@ -0,0 +1,87 @@
+#include "bench_helper.h"
+
+#include <string>
+
+//大块数据发送时比较 writev 和 SENDMSG_ZC 的吞吐量和服务端cpu开销
+//每轮客户端发送一个字节的请求，服务端把kRoundBytes按照消息大小切分之后发送
+//注意：回环网卡上内核仍然会拷贝数据(copied_ratio接近1)，零拷贝的收益要在真实网卡上才能体现
+
+namespace
+{
+
+constexpr size_t kRoundBytes = 8*1024*1024;
+
+void runZeroCopyBench(benchmark::State& state,bool zero_copy)
+{
+    size_t msg_size = state.range(0);
+    WriteContext* w_ctx = nullptr;
+
+    LoopbackOptions opt;
+    opt.output_high_water_mark = 4*1024*1024;
+    LoopbackServer server([msg_size,zero_copy,&w_ctx](std::shared_ptr<TcpConnection> conn)->Task<>{
+        if(zero_copy) conn->setZeroCopyThreshold(msg_size);
+        w_ctx = conn->getWriteContext();
+        bool running = true;
+        while(running)
+        {
+            int size = co_await conn->PrepareToRead();
+            if(size<0) break;
+            conn->retrieve(size);
+            for(size_t sent=0;sent<kRoundBytes;sent+=msg_size)
+            {
+                if(!co_await conn->send(std::string(msg_size,'z')))
+                {
+                    running = false;
+                    break;
+                }
+            }
+        }
+    },opt);
+
+    int fd = server.connect();
+    if(fd<0)
+    {
+        state.SkipWithError("connect failed");
+        return;
+    }
+
+    uint64_t cpu_start = server.loopCpuNs();
+    for(auto _:state)
+    {
+        if(!sendAll(fd,"r",1)||!recvDiscard(fd,kRoundBytes))
+        {
+            state.SkipWithError("loopback io failed");
+            break;
+        }
+    }
+    uint64_t cpu = server.loopCpuNs()-cpu_start;
+
+    size_t zc_sends = 0,zc_copied = 0;
+    server.runInLoopSync([&](){
+        if(!w_ctx) return;
+        zc_sends = w_ctx->zc_sends_;
+        zc_copied = w_ctx->zc_copied_;
+    });
+    ::close(fd);
+
+    double gb = double(state.iterations())*kRoundBytes/(1024.0*1024*1024);
+    state.SetBytesProcessed(state.iterations()*kRoundBytes);
+    state.counters["server_cpu_ms/GB"] = benchmark::Counter(gb>0?cpu/1e6/gb:0);
+    state.counters["zc_sends"] = benchmark::Counter(zc_sends);
+    state.counters["copied_ratio"] = benchmark::Counter(zc_sends?double(zc_copied)/zc_sends:0);
+}
+
+void BM_BulkSendWritev(benchmark::State& state)
+{
+    runZeroCopyBench(state,false);
+}
+
+void BM_BulkSendZeroCopy(benchmark::State& state)
+{
+    runZeroCopyBench(state,true);
+}
+
+}
+
+BENCHMARK(BM_BulkSendWritev)->RangeMultiplier(4)->Range(4*1024,1024*1024)->UseRealTime();
+BENCHMARK(BM_BulkSendZeroCopy)->RangeMultiplier(4)->Range(4*1024,1024*1024)->UseRealTime();
@@ -0,0 +1,43 @@
+#include <csignal>
+#include <cstdlib>
+#include <new>
+#include <benchmark/benchmark.h>
+
+#include "bench_helper.h"
+
+//统计当前线程的堆分配次数，用于衡量各个路径每次操作的分配数量
+thread_local uint64_t t_alloc_count = 0;
+
+uint64_t threadAllocCount()
+{
+    return t_alloc_count;
+}
+
+void* operator new(std::size_t size)
+{
+    ++t_alloc_count;
+    if(void* p = std::malloc(size?size:1)) return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p)noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p,std::size_t)noexcept
+{
+    std::free(p);
+}
+
+int main(int argc, char** argv)
+{
+    //对端关闭后继续写入会触发SIGPIPE，忽略这个信号
+    std::signal(SIGPIPE, SIG_IGN);
+
+    ::benchmark::Initialize(&argc, argv);
+    if (::benchmark::ReportUnrecognizedArguments(argc, argv)) return 1;
+    ::benchmark::RunSpecifiedBenchmarks();
+    ::benchmark::Shutdown();
+    return 0;
+}
@@ -0,0 +1,163 @@
+#pragma once
+#include <benchmark/benchmark.h>
+
+#include <memory>
+#include <thread>
+#include <future>
+#include <functional>
+#include <vector>
+#include <cstring>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "TcpConnection.h"
+#include "Acceptor.h"
+#include "IoUringLoop.h"
+
+//当前线程到目前为止的堆分配次数，在bench.cc中替换全局的operator new进行统计
+uint64_t threadAllocCount();
+
+//回环测试服务器的配置
+struct LoopbackOptions
+{
+    size_t chunk_size = 4096;
+    size_t chunk_num = 1024;
+    size_t input_high_water_mark = 4096*16;
+    size_t input_high_water_mark_chunk = 16;
+    size_t output_high_water_mark = 1024*1024;
+};
+
+//回环测试使用的服务器，在单独的线程中运行一个loop，每个连接运行一个handler协程
+class LoopbackServer
+{
+public:
+    using Handler = std::function<Task<>(std::shared_ptr<TcpConnection>)>;
+
+private:
+    std::unique_ptr<Acceptor> acceptor_;
+    std::unique_ptr<IoUringLoop> loop_;
+    std::unique_ptr<std::thread> loop_thread_;
+    std::vector<std::shared_ptr<TcpConnection>> conns_;
+    uint16_t port_;
+
+    inline static uint16_t next_port_ = 19000;
+
+public:
+    explicit LoopbackServer(Handler handler,LoopbackOptions opt = LoopbackOptions())
+        :port_(next_port_++)
+    {
+        std::promise<void> p;
+        auto f = p.get_future();
+        loop_thread_ = std::make_unique<std::thread>([&, handler, opt, p = std::move(p)]() mutable {
+            loop_ = std::make_unique<IoUringLoop>(4096,1024,1,opt.chunk_size,opt.chunk_num);
+            acceptor_ = std::make_unique<Acceptor>(loop_.get(), InetAddress(port_), true);
+            acceptor_->setConnetionCallback([this, handler, opt](int sockfd, const InetAddress& peer_addr) {
+                auto conn = std::make_shared<TcpConnection>(
+                    "Bench-" + std::to_string(sockfd),
+                    *loop_,
+                    sockfd,
+                    InetAddress(0),
+                    peer_addr,
+                    opt.input_high_water_mark,
+                    opt.input_high_water_mark_chunk,
+                    opt.output_high_water_mark
+                );
+                conn->Established(handler(conn));
+                conns_.emplace_back(conn);
+            });
+            acceptor_->listen();
+            p.set_value();
+            loop_->loop();
+        });
+        f.wait();
+    }
+
+    ~LoopbackServer()
+    {
+        loop_->quit();
+        loop_thread_->join();
+        acceptor_.reset();
+        conns_.clear();
+        loop_.reset();
+    }
+
+    IoUringLoop* loop()const {return loop_.get();}
+
+    //在loop线程中执行f并等待执行完毕，用于读取或修改只能在loop线程中访问的数据
+    template <typename F>
+    void runInLoopSync(F&& f)
+    {
+        std::promise<void> p;
+        auto done = p.get_future();
+        loop_->runInLoop([&](){
+            f();
+            p.set_value();
+        });
+        done.wait();
+    }
+
+    //loop线程消耗的cpu时间，用于统计服务端每GB数据的cpu开销
+    uint64_t loopCpuNs()const
+    {
+        clockid_t cid;
+        timespec ts{};
+        if(pthread_getcpuclockid(loop_thread_->native_handle(),&cid)!=0) return 0;
+        clock_gettime(cid,&ts);
+        return uint64_t(ts.tv_sec)*1000000000ull+ts.tv_nsec;
+    }
+
+    //连接到服务器，返回客户端的fd
+    int connect()const
+    {
+        int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr;
+        std::memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port_);
+        inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+        for(int i=0; i<50; ++i)
+        {
+            if(::connect(fd, (sockaddr*)&addr, sizeof(addr))==0)
+            {
+                int one = 1;
+                ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+                return fd;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        }
+        ::close(fd);
+        return -1;
+    }
+};
+
+//阻塞发送全部数据
+inline bool sendAll(int fd,const char* data,size_t len)
+{
+    size_t sent = 0;
+    while(sent<len)
+    {
+        ssize_t n = ::send(fd, data+sent, len-sent, 0);
+        if(n<=0) return false;
+        sent += n;
+    }
+    return true;
+}
+
+//阻塞接收并丢弃len个字节
+inline bool recvDiscard(int fd,size_t len)
+{
+    static thread_local char buf[64*1024];
+    size_t received = 0;
+    while(received<len)
+    {
+        ssize_t n = ::recv(fd, buf, std::min(sizeof(buf),len-received), 0);
+        if(n<=0) return false;
+        received += n;
+    }
+    return true;
+}
@@ -2,6 +2,9 @@
 #include <string>
 #include <memory>
 #include <thread>
+#include <mutex>
+#include <future>
+#include <unordered_set>
 #include <gtest/gtest.h>
 
 #include "TcpServer.h"
@@ -45,6 +48,7 @@ protected:
         base_loop = std::make_unique<IoUringLoop>(params);
         tcp_server=std::make_unique<TcpServer>(base_loop.get(),addr,"server1",params,echo_server);
         tcp_server->setThreadNum(4);
+        tcp_server->setFramePoolWarmup(1024,64);
 
         tcp_server->start();
     }
@@ -128,3 +132,159 @@ TEST_F(IntegrationTest,BaseTest)
     t.join();
 }
 
+
+
+//订阅的客户端先发送's'，不订阅的发送'n'，服务端回复'k'之后才会参与广播
+class BroadcastTest:public ::testing::Test
+{
+protected:
+    static Task<> subscriber(std::shared_ptr<TcpConnection> conn)
+    {
+        int size = co_await conn->PrepareToRead();
+        if(size>0)
+        {
+            std::string cmd = conn->read(1);
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                if(cmd=="s") subscribed.insert(conn.get());
+            }
+            size = co_await conn->send(std::string("k"))?1:-1;
+        }
+        //等待对端关闭连接
+        while(size>0)
+        {
+            size = co_await conn->PrepareToRead();
+            if(size>0) conn->retrieve(size);
+        }
+        std::lock_guard<std::mutex> lock(mtx);
+        subscribed.erase(conn.get());
+    }
+
+    void SetUp()override
+    {
+        std::promise<void> p;
+        auto f = p.get_future();
+        loop_thread = std::thread([&,p = std::move(p)]() mutable {
+            base_loop = std::make_unique<IoUringLoop>(params);
+            tcp_server = std::make_unique<TcpServer>(base_loop.get(),InetAddress(test_port),"broadcast",params,subscriber);
+            tcp_server->setThreadNum(3);
+            tcp_server->start();
+            p.set_value();
+            base_loop->loop();
+        });
+        f.wait();
+    }
+
+    void TearDown()override
+    {
+        base_loop->quit();
+        loop_thread.join();
+        tcp_server.reset();
+        base_loop.reset();
+    }
+
+    inline static uint16_t test_port=9998;
+    inline static IoUringLoopParams params{4096,256,64,4096,1024};
+    inline static std::mutex mtx;
+    inline static std::unordered_set<TcpConnection*> subscribed;
+
+    std::unique_ptr<IoUringLoop>base_loop;
+    std::unique_ptr<TcpServer>tcp_server;
+    std::thread loop_thread;
+};
+
+TEST_F(BroadcastTest,SharedPayloadReachesSubscribersOnly)
+{
+    constexpr int kClients = 40;
+    std::vector<int> fds;
+    sockaddr_in addr{};
+    addr.sin_family=AF_INET;
+    addr.sin_addr.s_addr=inet_addr("127.0.0.1");
+    addr.sin_port=htons(test_port);
+    for(int i=0;i<kClients;++i)
+    {
+        int fd=socket(AF_INET,SOCK_STREAM,0);
+        ASSERT_EQ(connect(fd,(sockaddr*)&addr,sizeof(addr)),0);
+        ASSERT_EQ(write(fd,i%4==0?"n":"s",1),1);
+        char ack=0;
+        ASSERT_EQ(read(fd,&ack,1),1);
+        EXPECT_EQ(ack,'k');
+        fds.push_back(fd);
+    }
+
+    //大于inline容量的数据，所有订阅者共享同一块内存
+    Payload payload(std::string(100*1024,'b'));
+    tcp_server->broadcast(payload,[](const TcpConnection& conn){
+        std::lock_guard<std::mutex> lock(mtx);
+        return subscribed.count(const_cast<TcpConnection*>(&conn))>0;
+    });
+
+    std::string expected = std::string(payload.view());
+    for(int i=0;i<kClients;++i)
+    {
+        if(i%4==0) continue;
+        std::string recv_data;
+        char buf[65536];
+        while(recv_data.size()<expected.size())
+        {
+            ssize_t n = ::recv(fds[i],buf,sizeof(buf),0);
+            if(n<=0) break;
+            recv_data.append(buf,n);
+        }
+        EXPECT_EQ(recv_data,expected) << "client " << i;
+    }
+
+    //没有订阅的客户端收不到数据
+    for(int i=0;i<kClients;i+=4)
+    {
+        char c;
+        EXPECT_EQ(::recv(fds[i],&c,1,MSG_DONTWAIT),-1);
+        EXPECT_EQ(errno,EAGAIN);
+    }
+
+    for(int fd:fds) ::close(fd);
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    //所有连接都释放了payload的引用
+    EXPECT_EQ(payload.useCount(),1u);
+}
+
+//单线程的服务器中，对端关闭之后读完成的处理函数会释放连接和其中的上下文，
+//慢处理的统计和日志不能再访问已经释放的上下文
+TEST(SlowHandlerTest,ConnectionReleasedInsideHandler)
+{
+    constexpr uint16_t port = 9997;
+    IoUringLoopParams params{256,32,1,4096,16};
+    std::unique_ptr<IoUringLoop> loop;
+    std::unique_ptr<TcpServer> server;
+    std::promise<void> p;
+    auto f = p.get_future();
+    std::thread loop_thread([&](){
+        loop = std::make_unique<IoUringLoop>(params);
+        //阈值为1微秒，每一次处理都会被记录，没有回调时打印日志
+        loop->setSlowHandlerThreshold(1);
+        server = std::make_unique<TcpServer>(loop.get(),InetAddress(port),"slow",params,echo_server);
+        server->start();
+        p.set_value();
+        loop->loop();
+    });
+    f.wait();
+
+    sockaddr_in addr{};
+    addr.sin_family=AF_INET;
+    addr.sin_addr.s_addr=inet_addr("127.0.0.1");
+    addr.sin_port=htons(port);
+    int fd=socket(AF_INET,SOCK_STREAM,0);
+    ASSERT_EQ(connect(fd,(sockaddr*)&addr,sizeof(addr)),0);
+    ASSERT_EQ(write(fd,"ping",4),4);
+    char buf[4];
+    EXPECT_EQ(read(fd,buf,sizeof(buf)),4);
+    ::close(fd);
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    loop->quit();
+    loop_thread.join();
+    EXPECT_GT(loop->stats().slow_handlers_,0u);
+    server.reset();
+    loop.reset();
+}
@@ -0,0 +1,181 @@
+#include "test_helper.h"
+
+#include "AsyncGenerator.hpp"
+#include "Task.hpp"
+
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+namespace
+{
+
+//手动恢复的awaiter，模拟生成器挂起在连接上等待数据
+struct ManualEvent
+{
+    std::coroutine_handle<> waiter_;
+
+    void set()
+    {
+        auto h = std::exchange(waiter_,nullptr);
+        h.resume();
+    }
+};
+
+struct EventAwaiter
+{
+    ManualEvent* event_;
+
+    bool await_ready(){return false;}
+    void await_suspend(std::coroutine_handle<>h){event_->waiter_ = h;}
+    void await_resume(){}
+};
+
+AsyncGenerator<int> counter(int count,int& produced)
+{
+    for(int i=0;i<count;++i)
+    {
+        produced++;
+        co_yield i;
+    }
+}
+
+AsyncGenerator<int> waitEach(ManualEvent& event,int count,[[maybe_unused]] std::shared_ptr<int> guard = nullptr)
+{
+    for(int i=0;i<count;++i)
+    {
+        co_await EventAwaiter{&event};
+        co_yield i*10;
+    }
+}
+
+AsyncGenerator<int> throwAfterFirst()
+{
+    co_yield 1;
+    throw std::runtime_error("generator failure");
+}
+
+Task<> collect(AsyncGenerator<int>& gen,std::vector<int>& values)
+{
+    while(true)
+    {
+        int* value = co_await gen.next();
+        if(!value) break;
+        values.push_back(*value);
+    }
+}
+
+//每次只取一个值，取完之后挂起在外部事件上
+Task<> takeOne(AsyncGenerator<int>& gen,ManualEvent& next,std::vector<int>& values)
+{
+    while(true)
+    {
+        int* value = co_await gen.next();
+        if(!value) break;
+        values.push_back(*value);
+        co_await EventAwaiter{&next};
+    }
+}
+
+Task<> catchGenerator(std::vector<int>& values,std::string& message)
+{
+    auto gen = throwAfterFirst();
+    try
+    {
+        while(true)
+        {
+            int* value = co_await gen.next();
+            if(!value) break;
+            values.push_back(*value);
+        }
+    }
+    catch(const std::runtime_error& e)
+    {
+        message = e.what();
+    }
+}
+
+}
+
+TEST(AsyncGeneratorTest, YieldsAllValuesInOrder)
+{
+    int produced = 0;
+    auto gen = counter(4,produced);
+    std::vector<int> values;
+    auto task = collect(gen,values);
+    task.resume();
+    EXPECT_TRUE(task.done());
+    EXPECT_EQ(values, std::vector<int>({0,1,2,3}));
+    EXPECT_TRUE(gen.done());
+}
+
+//只有在被拉取时才产生下一个值
+TEST(AsyncGeneratorTest, ProducesLazily)
+{
+    int produced = 0;
+    auto gen = counter(4,produced);
+    EXPECT_EQ(produced, 0);
+
+    ManualEvent next;
+    std::vector<int> values;
+    auto task = takeOne(gen,next,values);
+    task.resume();
+    EXPECT_EQ(produced, 1);
+    EXPECT_EQ(values, std::vector<int>({0}));
+
+    next.set();
+    EXPECT_EQ(produced, 2);
+    next.set();
+    next.set();
+    next.set();
+    EXPECT_TRUE(task.done());
+    EXPECT_EQ(values, std::vector<int>({0,1,2,3}));
+}
+
+//生成器挂起时消费者一起挂起，生成器恢复之后转移回消费者
+TEST(AsyncGeneratorTest, ConsumerWaitsForSuspendedGenerator)
+{
+    ManualEvent event;
+    auto gen = waitEach(event,3);
+    std::vector<int> values;
+    auto task = collect(gen,values);
+    task.resume();
+    EXPECT_TRUE(values.empty());
+
+    event.set();
+    EXPECT_EQ(values, std::vector<int>({0}));
+    event.set();
+    event.set();
+    EXPECT_TRUE(task.done());
+    EXPECT_EQ(values, std::vector<int>({0,10,20}));
+}
+
+TEST(AsyncGeneratorTest, RethrowsGeneratorException)
+{
+    std::vector<int> values;
+    std::string message;
+    auto task = catchGenerator(values,message);
+    task.resume();
+    EXPECT_TRUE(task.done());
+    EXPECT_EQ(values, std::vector<int>({1}));
+    EXPECT_EQ(message, "generator failure");
+}
+
+//消费者提前停止时销毁生成器，挂起的生成器帧一起释放
+TEST(AsyncGeneratorTest, DestroyReleasesSuspendedGenerator)
+{
+    ManualEvent event;
+    auto guard = std::make_shared<int>(0);
+    std::weak_ptr<int> weak = guard;
+    {
+        auto gen = waitEach(event,3,std::move(guard));
+        std::vector<int> values;
+        ManualEvent next;
+        auto task = takeOne(gen,next,values);
+        task.resume();
+        event.set();
+        EXPECT_EQ(values, std::vector<int>({0}));
+        EXPECT_FALSE(weak.expired());
+    }
+    EXPECT_TRUE(weak.expired());
+}
@@ -0,0 +1,213 @@
+#include "test_helper.h"
+
+#include "AsyncSync.h"
+#include "IoUringLoop.h"
+#include "IoUringLoopThread.h"
+#include "Task.hpp"
+
+#include <atomic>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+Task<> lockAndAppend(AsyncMutex& mutex,char name,std::string& trace)
+{
+    auto guard = co_await mutex.scopedLock();
+    trace += name;
+}
+
+//获取许可之后等待gate，记录同时持有许可的最大数量
+Task<> acquireAndWait(AsyncSemaphore& sem,AsyncEvent& gate,int& running,int& max_running,int& finished)
+{
+    co_await sem.acquire();
+    running++;
+    max_running = std::max(max_running,running);
+    co_await gate.wait();
+    running--;
+    finished++;
+    sem.release();
+}
+
+Task<> waitEvent(AsyncEvent& event,int& woken)
+{
+    co_await event.wait();
+    woken++;
+}
+
+//被其它loop唤醒之后检查是否回到了挂起时所在的loop
+Task<> waitOnLoop(AsyncEvent& event,IoUringLoop* loop,bool& on_loop,std::promise<void>& done)
+{
+    co_await event.wait();
+    on_loop = loop->isInLoopThread();
+    done.set_value();
+}
+
+//在临界区中让出loop，没有互斥时其它协程的修改会丢失
+Task<> increment(AsyncMutex& mutex,IoUringLoop* loop,int rounds,int& counter,std::atomic<bool>& on_loop,std::atomic<int>& left,std::promise<void>& done)
+{
+    for(int i=0;i<rounds;++i)
+    {
+        auto guard = co_await mutex.scopedLock();
+        if(!loop->isInLoopThread()) on_loop = false;
+        int value = counter;
+        co_await loop->yield();
+        counter = value+1;
+    }
+    if(--left==0) done.set_value();
+}
+
+}
+
+//解锁时锁按照等待的顺序交给下一个协程
+TEST(AsyncSyncTest, MutexHandsOffInFifoOrder)
+{
+    AsyncMutex mutex;
+    std::string trace;
+    ASSERT_TRUE(mutex.tryLock());
+    EXPECT_FALSE(mutex.tryLock());
+
+    auto a = lockAndAppend(mutex,'a',trace);
+    auto b = lockAndAppend(mutex,'b',trace);
+    auto c = lockAndAppend(mutex,'c',trace);
+    a.resume();
+    b.resume();
+    c.resume();
+    EXPECT_EQ(trace, "");
+
+    //没有loop时由解锁者直接恢复等待者
+    mutex.unlock();
+    EXPECT_EQ(trace, "abc");
+    EXPECT_FALSE(mutex.isLocked());
+    EXPECT_TRUE(mutex.tryLock());
+    mutex.unlock();
+}
+
+//同时持有许可的协程数量不超过许可数量
+TEST(AsyncSyncTest, SemaphoreLimitsConcurrency)
+{
+    AsyncSemaphore sem(2);
+    AsyncEvent gate;
+    int running = 0;
+    int max_running = 0;
+    int finished = 0;
+
+    std::vector<Task<>> tasks;
+    for(int i=0;i<4;++i) tasks.push_back(acquireAndWait(sem,gate,running,max_running,finished));
+    for(auto& task:tasks) task.resume();
+    EXPECT_EQ(running, 2);
+    EXPECT_EQ(sem.available(), 0);
+
+    gate.set();
+    EXPECT_EQ(finished, 4);
+    EXPECT_EQ(max_running, 2);
+    EXPECT_EQ(sem.available(), 2);
+}
+
+//设置之后唤醒所有等待者，之后的等待直接返回，复位之后重新等待
+TEST(AsyncSyncTest, EventSetAndReset)
+{
+    AsyncEvent event;
+    int woken = 0;
+    auto a = waitEvent(event,woken);
+    auto b = waitEvent(event,woken);
+    a.resume();
+    b.resume();
+    EXPECT_EQ(woken, 0);
+
+    event.set();
+    EXPECT_TRUE(event.isSet());
+    EXPECT_EQ(woken, 2);
+
+    auto c = waitEvent(event,woken);
+    c.resume();
+    EXPECT_EQ(woken, 3);
+
+    event.reset();
+    EXPECT_FALSE(event.isSet());
+    auto d = waitEvent(event,woken);
+    d.resume();
+    EXPECT_EQ(woken, 3);
+    event.set();
+    EXPECT_EQ(woken, 4);
+}
+
+//在其它loop中设置事件，等待者在自己的loop中恢复
+TEST(AsyncSyncTest, EventWakesWaiterOnItsLoop)
+{
+    IoUringLoopParams params{256,32,1,4096,16};
+    IoUringLoopThread waiter_thread(nullptr,params,"waiter");
+    IoUringLoopThread setter_thread(nullptr,params,"setter");
+    IoUringLoop* waiter_loop = waiter_thread.startLoop();
+    IoUringLoop* setter_loop = setter_thread.startLoop();
+
+    AsyncEvent event;
+    bool on_loop = false;
+    std::promise<void> done;
+    auto finished = done.get_future();
+    std::unique_ptr<Task<>> task;
+    std::promise<void> started;
+    waiter_loop->runInLoop([&](){
+        task = std::make_unique<Task<>>(waitOnLoop(event,waiter_loop,on_loop,done));
+        task->resume();
+        started.set_value();
+    });
+    started.get_future().wait();
+    setter_loop->runInLoop([&](){event.set();});
+
+    ASSERT_EQ(finished.wait_for(std::chrono::seconds(5)), std::future_status::ready);
+    EXPECT_TRUE(on_loop);
+
+    std::promise<void> destroyed;
+    waiter_loop->runInLoop([&](){
+        task.reset();
+        destroyed.set_value();
+    });
+    destroyed.get_future().wait();
+}
+
+//两个loop中的协程通过同一个互斥锁修改计数器，临界区中让出loop也不会丢失修改
+TEST(AsyncSyncTest, MutexAcrossLoops)
+{
+    constexpr int kTasksPerLoop = 3;
+    constexpr int kRounds = 50;
+    IoUringLoopParams params{256,32,1,4096,16};
+    IoUringLoopThread first_thread(nullptr,params,"first");
+    IoUringLoopThread second_thread(nullptr,params,"second");
+    IoUringLoop* loops[2] = {first_thread.startLoop(),second_thread.startLoop()};
+
+    AsyncMutex mutex;
+    int counter = 0;
+    std::atomic<bool> on_loop{true};
+    std::atomic<int> left{2*kTasksPerLoop};
+    std::promise<void> done;
+    auto finished = done.get_future();
+    std::vector<Task<>> tasks[2];
+    for(int i=0;i<2;++i)
+    {
+        IoUringLoop* loop = loops[i];
+        auto& loop_tasks = tasks[i];
+        loop->runInLoop([&,loop](){
+            for(int j=0;j<kTasksPerLoop;++j) loop_tasks.push_back(increment(mutex,loop,kRounds,counter,on_loop,left,done));
+            for(auto& task:loop_tasks) task.resume();
+        });
+    }
+
+    ASSERT_EQ(finished.wait_for(std::chrono::seconds(10)), std::future_status::ready);
+    EXPECT_EQ(counter, 2*kTasksPerLoop*kRounds);
+    EXPECT_TRUE(on_loop.load());
+    EXPECT_FALSE(mutex.isLocked());
+
+    for(int i=0;i<2;++i)
+    {
+        std::promise<void> destroyed;
+        loops[i]->runInLoop([&](){
+            tasks[i].clear();
+            destroyed.set_value();
+        });
+        destroyed.get_future().wait();
+    }
+}
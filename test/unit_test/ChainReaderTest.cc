@@ -0,0 +1,253 @@
+#include "test_helper.h"
+#include "ChunkPoolManagerInput.h"
+#include "InputChainBuffer.h"
+#include "ChainReader.h"
+#include "IoUringLoop.h"
+
+#include <liburing.h>
+#include <memory>
+#include <thread>
+#include <cstring>
+
+class ChainReaderTest : public ::testing::Test
+{
+protected:
+    inline static std::unique_ptr<IoUringLoop> loop_;
+    inline static std::unique_ptr<ChunkPoolManagerInput> cpm_;
+    std::unique_ptr<InputChainBuffer> icb_;
+    uint16_t next_index_ = 0;
+
+    static void SetUpTestSuite()
+    {
+        // 因为测试需要在一个线程中创建多个loop，所以要规避one loop per thread的检查
+        std::thread t([&](){
+            loop_ = std::make_unique<IoUringLoop>(1024, 32,1,4096,32);
+        });
+        t.join();
+        cpm_ = std::make_unique<ChunkPoolManagerInput>(*loop_);
+    }
+
+    static void TearDownTestSuite()
+    {
+        cpm_.reset();
+        loop_.reset();
+    }
+
+    void SetUp()
+    {
+        icb_ = std::make_unique<InputChainBuffer>(*cpm_);
+        next_index_ = 0;
+    }
+
+    void TearDown()
+    {
+        icb_.reset();
+    }
+
+    //模拟内核把数据按照piece的大小分散写入多个chunk中
+    void feed(const std::string& data,size_t piece)
+    {
+        for(size_t pos=0;pos<data.size();pos+=piece)
+        {
+            size_t len = std::min(piece,data.size()-pos);
+            uint16_t index = next_index_++;
+            std::memcpy(cpm_->getChunkById(index)->data_ptr_,data.data()+pos,len);
+            icb_->append(index,len);
+        }
+    }
+};
+
+static std::string bytes(std::initializer_list<uint8_t> list)
+{
+    return std::string(list.begin(),list.end());
+}
+
+// 测试1：读取一个chunk中的大端和小端整数
+TEST_F(ChainReaderTest, ReadIntegersInOneChunk)
+{
+    feed(bytes({0x01,0x02,0x03,0x04, 0x04,0x03,0x02,0x01, 0xff, 0x12,0x34}),4096);
+    ChainReader reader(*icb_);
+
+    uint32_t be = 0,le = 0;
+    int8_t i8 = 0;
+    uint16_t u16 = 0;
+    ASSERT_TRUE(reader.readBE(be));
+    ASSERT_TRUE(reader.readLE(le));
+    ASSERT_TRUE(reader.readBE(i8));
+    ASSERT_TRUE(reader.readBE(u16));
+    EXPECT_EQ(be, 0x01020304u);
+    EXPECT_EQ(le, 0x01020304u);
+    EXPECT_EQ(i8, -1);
+    EXPECT_EQ(u16, 0x1234);
+    EXPECT_EQ(reader.readable(), 0);
+
+    //commit之前缓冲区中的数据不会被移除
+    EXPECT_EQ(icb_->getTotalLen(), 11);
+    reader.commit();
+    EXPECT_EQ(icb_->getTotalLen(), 0);
+}
+
+// 测试2：整数跨越chunk的边界
+TEST_F(ChainReaderTest, ReadIntegerAcrossChunks)
+{
+    feed(bytes({0x01,0x02,0x03,0x04,0x05,0x06,0x07,0x08,0x09}),3);
+    ChainReader reader(*icb_);
+
+    uint8_t first = 0;
+    uint64_t value = 0;
+    ASSERT_TRUE(reader.readBE(first));
+    ASSERT_TRUE(reader.readBE(value));
+    EXPECT_EQ(first, 0x01);
+    EXPECT_EQ(value, 0x0203040506070809ull);
+}
+
+// 测试3：数据不足时不移动游标
+TEST_F(ChainReaderTest, NotEnoughData)
+{
+    feed(bytes({0x00,0x00,0x01}),4096);
+    ChainReader reader(*icb_);
+
+    uint32_t value = 0;
+    EXPECT_FALSE(reader.readBE(value));
+    EXPECT_EQ(reader.consumed(), 0);
+
+    //数据追加之后可以继续读取
+    feed(bytes({0x00}),4096);
+    ASSERT_TRUE(reader.readBE(value));
+    EXPECT_EQ(value, 0x100u);
+}
+
+// 测试4：varint和zigzag
+TEST_F(ChainReaderTest, ReadVarint)
+{
+    //300 = 0xac 0x02，-3 = zigzag(5) = 0x05，varint跨越chunk边界
+    feed(bytes({0xac,0x02, 0x05, 0xff,0xff,0xff,0xff,0x0f}),2);
+    ChainReader reader(*icb_);
+
+    uint64_t u = 0;
+    int64_t s = 0;
+    ASSERT_TRUE(reader.readVarint(u));
+    EXPECT_EQ(u, 300u);
+    ASSERT_TRUE(reader.readVarintSigned(s));
+    EXPECT_EQ(s, -3);
+    ASSERT_TRUE(reader.readVarint(u));
+    EXPECT_EQ(u, 0xffffffffu);
+}
+
+// 测试5：不完整的varint
+TEST_F(ChainReaderTest, IncompleteVarint)
+{
+    feed(bytes({0x80,0x80}),1);
+    ChainReader reader(*icb_);
+
+    uint64_t u = 0;
+    EXPECT_FALSE(reader.readVarint(u));
+    EXPECT_EQ(reader.consumed(), 0);
+
+    feed(bytes({0x01}),1);
+    ASSERT_TRUE(reader.readVarint(u));
+    EXPECT_EQ(u, 1u<<14);
+    EXPECT_FALSE(reader.isError());
+}
+
+// 测试5.1：格式错误的varint和数据不完整区分开
+TEST_F(ChainReaderTest, MalformedVarint)
+{
+    uint64_t u = 0;
+    {
+        //第10个字节为1时正好是64位的最大值
+        feed(bytes({0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0x01}),3);
+        ChainReader reader(*icb_);
+        ASSERT_TRUE(reader.readVarint(u));
+        EXPECT_EQ(u, UINT64_MAX);
+        EXPECT_FALSE(reader.isError());
+        reader.commit();
+    }
+    {
+        //第10个字节大于1，超出64位
+        feed(bytes({0x80,0x80,0x80,0x80,0x80,0x80,0x80,0x80,0x80,0x02}),4096);
+        ChainReader reader(*icb_);
+        EXPECT_FALSE(reader.readVarint(u));
+        EXPECT_TRUE(reader.isError());
+        EXPECT_EQ(reader.consumed(), 0);
+        reader.commit();
+        icb_->retrieve(icb_->getTotalLen());
+    }
+    {
+        //超过10个字节仍然没有结束，跨越chunk边界
+        feed(std::string(11,'\x80'),3);
+        ChainReader reader(*icb_);
+        EXPECT_FALSE(reader.readVarint(u));
+        EXPECT_TRUE(reader.isError());
+        int64_t s = 0;
+        EXPECT_FALSE(reader.readVarintSigned(s));
+    }
+}
+
+// 测试6：定长结构体、跳过和回退
+TEST_F(ChainReaderTest, ReadStructSkipAndRewind)
+{
+    struct __attribute__((packed)) Header
+    {
+        uint8_t type;
+        uint16_t flags;
+        uint32_t len;
+    };
+    Header h{7,0x0102,0x03040506};
+    std::string data(reinterpret_cast<char*>(&h),sizeof(h));
+    data += "payload";
+    feed(data,5);
+
+    ChainReader reader(*icb_);
+    Header out{};
+    ASSERT_TRUE(reader.readStruct(out));
+    EXPECT_EQ(out.type, 7);
+    EXPECT_EQ(out.flags, 0x0102);
+    EXPECT_EQ(out.len, 0x03040506u);
+
+    std::string payload;
+    ASSERT_TRUE(reader.skip(3));
+    ASSERT_TRUE(reader.readString(payload,4));
+    EXPECT_EQ(payload, "load");
+
+    //回退之后重新从头读取
+    reader.rewind();
+    uint8_t type = 0;
+    ASSERT_TRUE(reader.readBE(type));
+    EXPECT_EQ(type, 7);
+    reader.commit();
+    EXPECT_EQ(icb_->getTotalLen(), data.size()-1);
+}
+
+// 测试7：空缓冲区和长度为0的读取
+TEST_F(ChainReaderTest, EmptyBufferAndZeroLength)
+{
+    ChainReader reader(*icb_);
+    char buf[4];
+    std::string str("old");
+    uint32_t value = 0;
+    uint64_t u = 0;
+
+    //空缓冲区上长度为0的读取直接成功，其它读取失败
+    EXPECT_TRUE(reader.skip(0));
+    EXPECT_TRUE(reader.readBytes(buf,0));
+    EXPECT_TRUE(reader.readString(str,0));
+    EXPECT_EQ(str, "");
+    EXPECT_FALSE(reader.readBE(value));
+    EXPECT_FALSE(reader.readVarint(u));
+    EXPECT_FALSE(reader.skip(1));
+    EXPECT_EQ(reader.consumed(), 0);
+    reader.commit();
+
+    //游标在chunk末尾时长度为0的读取不移动游标
+    feed("abcd",2);
+    ASSERT_TRUE(reader.skip(2));
+    EXPECT_TRUE(reader.skip(0));
+    EXPECT_TRUE(reader.readString(str,0));
+    ASSERT_TRUE(reader.readString(str,2));
+    EXPECT_EQ(str, "cd");
+    EXPECT_TRUE(reader.readBytes(buf,0));
+    EXPECT_EQ(reader.consumed(), 4);
+    reader.commit();
+    EXPECT_EQ(icb_->getTotalLen(), 0);
+}
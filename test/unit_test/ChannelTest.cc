@@ -0,0 +1,217 @@
+#include "test_helper.h"
+
+#include "Channel.hpp"
+#include "IoUringLoop.h"
+#include "IoUringLoopThread.h"
+#include "ThreadPool.h"
+#include "Task.hpp"
+
+#include <atomic>
+#include <future>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+template<typename ChannelType>
+Task<> produce(ChannelType& channel,int begin,int end,int& sent)
+{
+    for(int i=begin;i<end;++i)
+    {
+        bool ok = co_await channel.send(i);
+        if(!ok) co_return;
+        sent++;
+    }
+}
+
+template<typename ChannelType>
+Task<> consume(ChannelType& channel,std::vector<int>& received,bool& finished)
+{
+    while(true)
+    {
+        auto value = co_await channel.receive();
+        if(!value) break;
+        received.push_back(*value);
+    }
+    finished = true;
+}
+
+Task<> sendOne(Channel<std::string>& channel,std::string value,std::vector<bool>& results)
+{
+    bool ok = co_await channel.send(std::move(value));
+    results.push_back(ok);
+}
+
+//流水线的第一阶段：在loop中发送数据，最后一个生产者关闭通道
+template<typename ChannelType>
+Task<> source(ChannelType& out,IoUringLoop* loop,int begin,int end,std::atomic<int>& producers,std::atomic<bool>& on_thread)
+{
+    for(int i=begin;i<end;++i)
+    {
+        bool ok = co_await out.send(i);
+        if(!ok||!loop->isInLoopThread()) on_thread = false;
+    }
+    if(--producers==0) out.close();
+}
+
+//第二阶段：在线程池中处理
+template<typename InType,typename OutType>
+Task<> process(InType& in,OutType& out,ThreadPool& pool,std::atomic<bool>& on_thread)
+{
+    bool switched = co_await pool.switchThread();
+    if(!switched) on_thread = false;
+    while(true)
+    {
+        auto value = co_await in.receive();
+        if(currentThreadPool()!=&pool) on_thread = false;
+        if(!value) break;
+        bool ok = co_await out.send(*value*2);
+        if(!ok||currentThreadPool()!=&pool) on_thread = false;
+    }
+    out.close();
+}
+
+//第三阶段：在另一个loop中汇总
+template<typename ChannelType>
+Task<> sink(ChannelType& in,IoUringLoop* loop,int64_t& sum,int& count,std::atomic<bool>& on_thread,std::promise<void>& done)
+{
+    while(true)
+    {
+        auto value = co_await in.receive();
+        if(!loop->isInLoopThread()) on_thread = false;
+        if(!value) break;
+        sum += *value;
+        count++;
+    }
+    done.set_value();
+}
+
+//producers个生产者分别在两个loop中发送，线程池处理之后在第二个loop中汇总
+template<typename FirstChannel,typename SecondChannel>
+void runPipeline(int producers)
+{
+    constexpr int kItems = 2000;
+    IoUringLoopParams params{256,32,1,4096,16};
+    IoUringLoopThread first_thread(nullptr,params,"first");
+    IoUringLoopThread second_thread(nullptr,params,"second");
+    IoUringLoop* loops[2] = {first_thread.startLoop(),second_thread.startLoop()};
+    ThreadPool pool(2,16);
+
+    FirstChannel first(8);
+    SecondChannel second(4);
+    std::atomic<int> left{producers};
+    std::atomic<bool> on_thread{true};
+    int64_t sum = 0;
+    int count = 0;
+    std::promise<void> done;
+    auto finished = done.get_future();
+
+    std::vector<Task<>> tasks;
+    tasks.push_back(sink(second,loops[1],sum,count,on_thread,done));
+    tasks.push_back(process(first,second,pool,on_thread));
+    for(int i=0;i<producers;++i) tasks.push_back(source(first,loops[i%2],i*kItems/producers,(i+1)*kItems/producers,left,on_thread));
+
+    std::promise<void> started;
+    loops[1]->runInLoop([&](){
+        tasks[0].resume();
+        started.set_value();
+    });
+    started.get_future().wait();
+    tasks[1].resume();
+    for(int i=0;i<producers;++i)
+    {
+        auto& task = tasks[2+i];
+        loops[i%2]->runInLoop([&task](){task.resume();});
+    }
+
+    ASSERT_EQ(finished.wait_for(std::chrono::seconds(10)), std::future_status::ready);
+    EXPECT_EQ(count, kItems);
+    EXPECT_EQ(sum, int64_t(kItems)*(kItems-1));
+    EXPECT_TRUE(on_thread.load());
+    //等所有阶段都执行完毕再销毁
+    for(auto& task:tasks)
+    {
+        while(!task.handle_.done()) std::this_thread::yield();
+    }
+}
+
+}
+
+//缓冲区满时发送者挂起，空时接收者挂起，没有loop时由对方直接恢复
+TEST(ChannelTest, SpscSuspendsOnFullAndEmpty)
+{
+    SpscChannel<int> channel(2);
+    int sent = 0;
+    std::vector<int> received;
+    bool finished = false;
+
+    auto producer = produce(channel,0,5,sent);
+    producer.resume();
+    EXPECT_EQ(sent, 2);
+    EXPECT_EQ(channel.size(), 2u);
+
+    auto consumer = consume(channel,received,finished);
+    consumer.resume();
+    EXPECT_EQ(sent, 5);
+    EXPECT_EQ(received, std::vector<int>({0,1,2,3,4}));
+    EXPECT_FALSE(finished);
+
+    channel.close();
+    EXPECT_TRUE(finished);
+    EXPECT_FALSE(channel.trySend(5));
+}
+
+//关闭之后发送失败，剩余的数据仍然可以取出，之后返回std::nullopt
+TEST(ChannelTest, CloseDrainsRemainingItems)
+{
+    Channel<std::string> channel(2);
+    EXPECT_TRUE(channel.trySend(std::string("a")));
+    EXPECT_TRUE(channel.trySend(std::string("b")));
+    std::string rejected("c");
+    EXPECT_FALSE(channel.trySend(std::move(rejected)));
+    EXPECT_EQ(rejected, "c");
+
+    //满的时候等待，关闭时返回false
+    std::vector<bool> results;
+    auto blocked = sendOne(channel,"d",results);
+    blocked.resume();
+    EXPECT_TRUE(results.empty());
+    channel.close();
+    EXPECT_EQ(results, std::vector<bool>({false}));
+
+    auto late = sendOne(channel,"e",results);
+    late.resume();
+    EXPECT_EQ(results, std::vector<bool>({false,false}));
+
+    EXPECT_EQ(channel.tryReceive(), std::optional<std::string>("a"));
+    EXPECT_EQ(channel.tryReceive(), std::optional<std::string>("b"));
+    EXPECT_EQ(channel.tryReceive(), std::nullopt);
+}
+
+//缓冲区满时发送者按照先后顺序排队，接收时依次移入缓冲区
+TEST(ChannelTest, MpscKeepsSenderOrder)
+{
+    Channel<std::string> channel(1);
+    std::vector<bool> results;
+    std::vector<Task<>> senders;
+    for(auto value:{"a","b","c","d"}) senders.push_back(sendOne(channel,value,results));
+    for(auto& sender:senders) sender.resume();
+    EXPECT_EQ(results.size(), 1u);
+
+    std::string order;
+    while(auto value = channel.tryReceive()) order += *value;
+    EXPECT_EQ(order, "abcd");
+    EXPECT_EQ(results, std::vector<bool>(4,true));
+}
+
+//两个loop和线程池组成的流水线，每一阶段都在自己的loop或者线程池中恢复
+TEST(ChannelTest, SpscPipelineAcrossLoopsAndWorkers)
+{
+    runPipeline<SpscChannel<int>,SpscChannel<int>>(1);
+}
+
+TEST(ChannelTest, MpscPipelineAcrossLoopsAndWorkers)
+{
+    runPipeline<Channel<int>,SpscChannel<int>>(4);
+}
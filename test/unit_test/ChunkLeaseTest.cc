@@ -0,0 +1,248 @@
+#include "test_helper.h"
+#include "ChunkPoolManagerInput.h"
+#include "InputChainBuffer.h"
+#include "ChunkLease.h"
+#include "IoUringLoop.h"
+#include "TcpConnection.h"
+#include "Acceptor.h"
+#include "ThreadPool.h"
+
+#include <liburing.h>
+#include <memory>
+#include <thread>
+#include <future>
+#include <cstring>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+class ChunkLeaseTest : public ::testing::Test
+{
+protected:
+    inline static std::unique_ptr<IoUringLoop> loop_;
+    inline static std::unique_ptr<ChunkPoolManagerInput> cpm_;
+    std::unique_ptr<InputChainBuffer> icb_;
+    uint16_t next_index_ = 0;
+
+    static void SetUpTestSuite()
+    {
+        // 因为测试需要在一个线程中创建多个loop，所以要规避one loop per thread的检查
+        // loop不在当前线程，所以这里释放租约走的都是跨线程归还的路径
+        std::thread t([&](){
+            loop_ = std::make_unique<IoUringLoop>(1024, 32,1,4096,32);
+        });
+        t.join();
+        cpm_ = std::make_unique<ChunkPoolManagerInput>(*loop_);
+    }
+
+    static void TearDownTestSuite()
+    {
+        cpm_.reset();
+        loop_.reset();
+    }
+
+    void SetUp()
+    {
+        icb_ = std::make_unique<InputChainBuffer>(*cpm_);
+        next_index_ = 0;
+    }
+
+    void TearDown()
+    {
+        icb_.reset();
+        cpm_->drainRemoteReturns();
+    }
+
+    void feed(const std::string& data,size_t piece)
+    {
+        for(size_t pos=0;pos<data.size();pos+=piece)
+        {
+            size_t len = std::min(piece,data.size()-pos);
+            uint16_t index = next_index_++;
+            std::memcpy(cpm_->getChunkById(index)->data_ptr_,data.data()+pos,len);
+            icb_->append(index,len);
+        }
+    }
+};
+
+// 测试1：取出完整的chunk
+TEST_F(ChunkLeaseTest, DetachWholeChunks)
+{
+    feed("aaaabbbbcccc",4);
+    ChunkLease lease = icb_->detach(8);
+
+    EXPECT_EQ(lease.size(), 8);
+    EXPECT_EQ(lease.segments().size(), 2);
+    EXPECT_EQ(lease.toString(), "aaaabbbb");
+    EXPECT_EQ(icb_->getTotalLen(), 4);
+    EXPECT_EQ(icb_->getTotalChunk(), 1);
+    EXPECT_EQ(icb_->removeAllAsString(), "cccc");
+}
+
+// 测试2：最后一个chunk只取一部分时由缓冲区和租约共同持有
+TEST_F(ChunkLeaseTest, DetachPartialChunkIsShared)
+{
+    feed("aaaabbbb",4);
+    ChunkLease lease = icb_->detach(6);
+    Chunk* shared = cpm_->getChunkById(1);
+
+    EXPECT_EQ(lease.toString(), "aaaabb");
+    EXPECT_EQ(shared->shares_, 1);
+    EXPECT_EQ(icb_->getTotalChunk(), 1);
+
+    //缓冲区消费完之后，chunk仍然被租约持有，数据不会被重置
+    EXPECT_EQ(icb_->removeAllAsString(), "bb");
+    EXPECT_EQ(shared->shares_, 0);
+    EXPECT_EQ(lease.toString(), "aaaabb");
+
+    //其它线程释放租约，chunk在loop中统一归还
+    lease.release();
+    EXPECT_TRUE(lease.empty());
+    EXPECT_EQ(cpm_->remote_returns_.size(), 2);
+    cpm_->drainRemoteReturns();
+    EXPECT_TRUE(cpm_->remote_returns_.empty());
+    EXPECT_EQ(shared->readableBytes(), 0);
+}
+
+// 测试3：多个租约的归还合并为一次
+TEST_F(ChunkLeaseTest, RemoteReturnsAreBatched)
+{
+    feed("aaaabbbbcccc",4);
+    {
+        ChunkLease l1 = icb_->detach(4);
+        ChunkLease l2 = icb_->detach(4);
+        ChunkLease l3 = std::move(l2);
+        EXPECT_TRUE(l2.empty());
+        EXPECT_EQ(l3.toString(), "bbbb");
+    }
+    EXPECT_EQ(cpm_->remote_returns_.size(), 2);
+    cpm_->drainRemoteReturns();
+    EXPECT_EQ(icb_->removeAllAsString(), "cccc");
+}
+
+
+//把消息体租出去，在线程池中计算校验和，然后把校验和发回
+Task<> lease_checksum_server(std::shared_ptr<TcpConnection> conn,ThreadPool& pool,size_t msg_len)
+{
+    while(true)
+    {
+        //等待完整的消息
+        int size = co_await conn->PrepareToRead(msg_len);
+        if(size<0) break;
+
+        ChunkLease lease = conn->lease(msg_len);
+        //切换到线程池中处理数据，不拷贝
+        bool switched = co_await pool.switchThread();
+        if(!switched) break;
+
+        uint32_t sum = 0;
+        lease.forEachSegment([&](const char* data,size_t len){
+            for(size_t i=0;i<len;++i) sum += static_cast<uint8_t>(data[i]);
+        });
+        //在工作线程中释放，由loop批量归还
+        lease.release();
+
+        uint32_t net_sum = htonl(sum);
+        bool need_continue = co_await conn->send(std::string(reinterpret_cast<char*>(&net_sum),sizeof(net_sum)));
+        if(!need_continue) break;
+    }
+}
+
+class ChunkLeaseHandoffTest: public ::testing::Test
+{
+protected:
+    static constexpr size_t kMsgLen = 4096*3+100;
+
+    void SetUp()override
+    {
+        std::promise<void> p;
+        auto f = p.get_future();
+        pool = std::make_unique<ThreadPool>(2,64);
+
+        loop_thread = std::make_unique<std::thread>([&, p = std::move(p)]() mutable {
+            //chunk很少，如果租约没有归还，很快就会耗尽buffer ring
+            loop = std::make_unique<IoUringLoop>(1024,32,1,4096,16);
+            InetAddress listenAddr(port_);
+            acceptor = std::make_unique<Acceptor>(loop.get(), listenAddr, true);
+            acceptor->setConnetionCallback([&](int sockfd, const InetAddress& peerAddr) {
+                auto conn = std::make_shared<TcpConnection>(
+                    "Conn-" + std::to_string(sockfd),
+                    *loop,
+                    sockfd,
+                    InetAddress(0),
+                    peerAddr,
+                    4096 * 16,
+                    16,
+                    1024 * 1024
+                );
+                conn->Established(lease_checksum_server(conn,*pool,kMsgLen));
+                conns.emplace_back(conn);
+            });
+            acceptor->listen();
+            p.set_value();
+            loop->loop();
+        });
+        f.wait();
+    }
+
+    void TearDown()override
+    {
+        if(loop) loop->quit();
+        if(loop_thread && loop_thread->joinable())
+        {
+            loop_thread->join();
+        }
+        pool.reset();
+        acceptor.reset();
+        conns.clear();
+        loop.reset();
+        loop_thread.reset();
+        port_++;
+    }
+
+    std::unique_ptr<ThreadPool> pool;
+    std::unique_ptr<Acceptor> acceptor;
+    std::unique_ptr<IoUringLoop> loop;
+    std::unique_ptr<std::thread> loop_thread;
+    std::vector<std::shared_ptr<TcpConnection>>conns;
+    inline static uint16_t port_ = 9188;
+};
+
+// 测试4：租约在工作线程中处理和释放，chunk可以被循环使用
+TEST_F(ChunkLeaseHandoffTest, ProcessOnWorkerAndReturn)
+{
+    int client_fd = socket(AF_INET, SOCK_STREAM, 0);
+    ASSERT_GT(client_fd, 0);
+    struct sockaddr_in server_addr;
+    memset(&server_addr, 0, sizeof(server_addr));
+    server_addr.sin_family = AF_INET;
+    server_addr.sin_port = htons(port_);
+    inet_pton(AF_INET, "127.0.0.1", &server_addr.sin_addr);
+    int ret = -1;
+    for(int i=0; i<20; ++i) {
+        ret = connect(client_fd, (struct sockaddr*)&server_addr, sizeof(server_addr));
+        if(ret == 0) break;
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+    ASSERT_EQ(ret, 0) << "Failed to connect to server";
+
+    //发送的总数据量远大于buffer ring的容量
+    for(int round=0;round<64;++round)
+    {
+        std::string msg(kMsgLen,0);
+        uint32_t expect = 0;
+        for(size_t i=0;i<kMsgLen;++i)
+        {
+            msg[i] = static_cast<char>(i*31+round);
+            expect += static_cast<uint8_t>(msg[i]);
+        }
+        ASSERT_EQ(::send(client_fd,msg.data(),msg.size(),0),(ssize_t)msg.size());
+
+        uint32_t net_sum = 0;
+        ASSERT_EQ(::recv(client_fd,&net_sum,sizeof(net_sum),MSG_WAITALL),(ssize_t)sizeof(net_sum));
+        EXPECT_EQ(ntohl(net_sum), expect) << "round " << round;
+    }
+
+    EXPECT_EQ(close(client_fd),0);
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+}
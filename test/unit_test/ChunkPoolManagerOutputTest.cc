@@ -0,0 +1,279 @@
+#include "test_helper.h"
+#include "ChunkPoolManagerOutput.h"
+#include "SendQueue.hpp"
+#include "IoUringLoop.h"
+#include "TcpConnection.h"
+#include "Acceptor.h"
+
+#include <liburing.h>
+#include <memory>
+#include <thread>
+#include <future>
+#include <cstring>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+class ChunkPoolManagerOutputTest : public ::testing::Test
+{
+protected:
+    std::unique_ptr<IoUringLoop> loop_;
+    std::unique_ptr<ChunkPoolManagerOutput> cpm_;
+
+    void SetUp() override
+    {
+        //因为测试需要在一个线程中创建多个loop，所以要规避one loop per thread的检查
+        std::thread t([&](){
+            loop_ = std::make_unique<IoUringLoop>(1024,32,1,4096,64);
+        });
+        t.join();
+        cpm_ = std::make_unique<ChunkPoolManagerOutput>(*loop_,1024,8);
+    }
+
+    void TearDown() override
+    {
+        cpm_.reset();
+        loop_.reset();
+    }
+};
+
+TEST_F(ChunkPoolManagerOutputTest, ConstructorRegistersBuffers)
+{
+    EXPECT_TRUE(cpm_->registered());
+    EXPECT_EQ(cpm_->chunkSize(), 1024u);
+    EXPECT_EQ(cpm_->freeChunks(), 8u);
+    EXPECT_EQ(cpm_->chunks_data_.size(), 8u);
+    for(size_t i=0;i<cpm_->chunks_data_.size();++i)
+    {
+        //chunk的序号就是固定缓冲区的序号
+        EXPECT_EQ(cpm_->chunks_data_[i].index_, i);
+    }
+}
+
+TEST_F(ChunkPoolManagerOutputTest, AcquireUntilExhausted)
+{
+    std::vector<Chunk*> chunks;
+    for(int i=0;i<8;++i)
+    {
+        chunks.push_back(cpm_->acquireChunk());
+        EXPECT_TRUE(cpm_->isRegistered(chunks.back()));
+    }
+    EXPECT_EQ(cpm_->freeChunks(), 0u);
+
+    //内存池耗尽时临时分配没有注册的chunk
+    Chunk* overflow = cpm_->acquireChunk();
+    ASSERT_NE(overflow, nullptr);
+    EXPECT_FALSE(cpm_->isRegistered(overflow));
+    EXPECT_EQ(cpm_->overflowChunks(), 1u);
+    cpm_->releaseChunk(overflow);
+    EXPECT_EQ(cpm_->freeChunks(), 0u);
+
+    chunks[0]->tail_ = 100;
+    cpm_->releaseChunk(chunks[0]);
+    EXPECT_EQ(cpm_->freeChunks(), 1u);
+
+    //归还的chunk被重置
+    Chunk* again = cpm_->acquireChunk();
+    EXPECT_EQ(again, chunks[0]);
+    EXPECT_EQ(again->tail_, 0u);
+    EXPECT_EQ(cpm_->writableBytes(again), 1024u);
+}
+
+TEST_F(ChunkPoolManagerOutputTest, FixedFragmentsInSendQueue)
+{
+    TxFragmentPool pool;
+    {
+        SendQueue q(&pool);
+        Chunk* chunk = cpm_->acquireChunk();
+        std::memcpy(chunk->beginWrite(), "abc", 3);
+        q.appendFixed(cpm_.get(), chunk, 3);
+
+        //在尾部的chunk中继续写入
+        ASSERT_EQ(q.fixedTail()->chunk_, chunk);
+        std::memcpy(chunk->beginWrite(), "def", 3);
+        q.extendFixedTail(3);
+        q.append("xyz", 3);
+        EXPECT_EQ(q.getTotalLen(), 9u);
+
+        //固定缓冲区的分片单独发送
+        std::vector<iovec> iovecs;
+        q.getBatchFragment(iovecs, 8);
+        EXPECT_TRUE(iovecs.empty());
+        ASSERT_TRUE(q.sendAlone(q.pendingFragment()));
+        auto iov = q.getOneIovec();
+        EXPECT_EQ(std::string(static_cast<char*>(iov.iov_base), iov.iov_len), "abcdef");
+
+        q.getBatchFragment(iovecs, 8);
+        ASSERT_EQ(iovecs.size(), 1u);
+        EXPECT_EQ(std::string(static_cast<char*>(iovecs[0].iov_base), iovecs[0].iov_len), "xyz");
+
+        //发送完成之后chunk归还到内存池
+        q.retrieve(6);
+        EXPECT_EQ(cpm_->freeChunks(), 8u);
+        q.retrieve(3);
+        EXPECT_TRUE(q.isEmpty());
+
+        //没有被发送的chunk在队列析构时归还
+        chunk = cpm_->acquireChunk();
+        q.appendFixed(cpm_.get(), chunk, 10);
+        EXPECT_EQ(cpm_->freeChunks(), 7u);
+    }
+    EXPECT_EQ(cpm_->freeChunks(), 8u);
+}
+
+
+//第i个消息的内容
+static std::string makeMessage(size_t i)
+{
+    std::string msg(1+(i*37)%3000, 'a'+i%26);
+    msg[0] = '#';
+    return msg;
+}
+
+constexpr size_t kMessageCount = 2000;
+
+//直接在输出内存中序列化消息，每隔几个消息使用一次send，检查两种方式混合时的顺序
+Task<> reserve_commit_server(std::shared_ptr<TcpConnection> conn)
+{
+    int size = co_await conn->PrepareToRead();
+    if(size>0) conn->retrieve(size);
+
+    for(size_t i=0;size>0&&i<kMessageCount;++i)
+    {
+        std::string msg = makeMessage(i);
+        bool ok = false;
+        if(i%7==3)
+        {
+            ok = co_await conn->send(std::move(msg));
+        }
+        else
+        {
+            auto buf = conn->reserve(msg.size());
+            if(buf.size()<msg.size()) break;
+            std::memcpy(buf.data(), msg.data(), msg.size());
+            ok = co_await conn->commit(msg.size());
+        }
+        if(!ok) break;
+    }
+    //等待对端关闭连接
+    while(size>0)
+    {
+        size = co_await conn->PrepareToRead();
+        if(size>0) conn->retrieve(size);
+    }
+}
+
+class ReserveCommitTest: public ::testing::Test
+{
+protected:
+    void SetUp()override
+    {
+        std::promise<void> p;
+        auto f = p.get_future();
+
+        loop_thread = std::make_unique<std::thread>([&, p = std::move(p)]() mutable {
+            loop = std::make_unique<IoUringLoop>(1024,32,1,4096,32);
+            InetAddress listenAddr(port_);
+            acceptor = std::make_unique<Acceptor>(loop.get(), listenAddr, true);
+            acceptor->setConnetionCallback([&](int sockfd, const InetAddress& peerAddr) {
+                auto conn = std::make_shared<TcpConnection>(
+                    "Conn-" + std::to_string(sockfd),
+                    *loop,
+                    sockfd,
+                    InetAddress(0),
+                    peerAddr,
+                    4096 * 16,
+                    16,
+                    64 * 1024   // output high water mark，比较小，让协程在发送的过程中挂起
+                );
+                conn->setMaxInflightWrites(max_inflight_writes_);
+                conn->Established(reserve_commit_server(conn));
+                conns.emplace_back(conn);
+            });
+            acceptor->listen();
+            p.set_value();
+            loop->loop();
+        });
+        f.wait();
+    }
+
+    void TearDown()override
+    {
+        if(loop) loop->quit();
+        if(loop_thread && loop_thread->joinable())
+        {
+            loop_thread->join();
+        }
+        acceptor.reset();
+        conns.clear();
+        loop.reset();
+        loop_thread.reset();
+        port_++;
+        max_inflight_writes_ = 1;
+    }
+
+    std::unique_ptr<Acceptor> acceptor;
+    std::unique_ptr<IoUringLoop> loop;
+    std::unique_ptr<std::thread> loop_thread;
+    std::vector<std::shared_ptr<TcpConnection>>conns;
+    inline static uint16_t port_ = 9288;
+    inline static size_t max_inflight_writes_ = 1;  //新连接同时在内核中的发送请求数量
+
+    //客户端发起请求之后接收服务端发送的全部消息并检查
+    void checkMixedSends();
+};
+
+void ReserveCommitTest::checkMixedSends()
+{
+    int client_fd = socket(AF_INET, SOCK_STREAM, 0);
+    ASSERT_GT(client_fd, 0);
+
+    struct sockaddr_in server_addr;
+    memset(&server_addr, 0, sizeof(server_addr));
+    server_addr.sin_family = AF_INET;
+    server_addr.sin_port = htons(port_);
+    inet_pton(AF_INET, "127.0.0.1", &server_addr.sin_addr);
+
+    int ret = -1;
+    for(int i=0; i<20; ++i) {
+        ret = connect(client_fd, (struct sockaddr*)&server_addr, sizeof(server_addr));
+        if(ret == 0) break;
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+    ASSERT_EQ(ret, 0) << "Failed to connect to server";
+
+    std::string expected;
+    for(size_t i=0;i<kMessageCount;++i) expected += makeMessage(i);
+
+    ASSERT_EQ(::send(client_fd, "go", 2, 0), 2);
+    std::string recv_data;
+    char buf[65536];
+    while(recv_data.size()<expected.size())
+    {
+        ssize_t n = ::recv(client_fd, buf, sizeof(buf), 0);
+        if(n<=0) break;
+        recv_data.append(buf, n);
+    }
+    ASSERT_EQ(recv_data.size(), expected.size());
+    EXPECT_EQ(recv_data, expected);
+
+    EXPECT_EQ(close(client_fd),0);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    //所有的chunk都已经归还
+    std::promise<size_t> free_chunks;
+    loop->runInLoop([&](){free_chunks.set_value(loop->getOutputPool().freeChunks());});
+    EXPECT_EQ(free_chunks.get_future().get(), ChunkPoolManagerOutput::kDefaultChunkNum);
+}
+
+TEST_F(ReserveCommitTest, MixedFixedAndNormalSends)
+{
+    checkMixedSends();
+}
+
+//每个固定缓冲区的chunk是一个单独的请求，多个WRITE_FIXED和普通的发送链接在一起
+TEST_F(ReserveCommitTest, MixedSendsPipelined)
+{
+    max_inflight_writes_ = 8;
+    checkMixedSends();
+}
@@ -0,0 +1,172 @@
+#include "test_helper.h"
+
+#include <coroutine>
+#include <thread>
+#include <future>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "TcpConnection.h"
+#include "Acceptor.h"
+#include "IoUringLoop.h"
+
+//读取u32长度头之后，用recvInto把消息体直接接收到自己的缓冲区中，然后原样发回
+Task<> recv_into_echo_server(std::shared_ptr<TcpConnection> conn)
+{
+    while(true)
+    {
+        uint32_t len = 0;
+        auto reader = conn->reader();
+        while(!reader.readBE(len))
+        {
+            int size = co_await conn->PrepareToRead();
+            if(size<0) break;
+        }
+        if(conn->closing()||conn->getReadContext()->is_error_) break;
+        reader.commit();
+
+        std::string body(len,0);
+        ssize_t n = co_await conn->recvInto(body.data(),len);
+        if(n!=(ssize_t)len) break;
+
+        uint32_t net_len = htonl(len);
+        std::string out(reinterpret_cast<char*>(&net_len),sizeof(net_len));
+        out += body;
+        bool need_continue = co_await conn->send(std::move(out));
+        if(!need_continue) break;
+    }
+}
+
+class DirectReadContextTest: public ::testing::Test
+{
+protected:
+    void SetUp()override
+    {
+        std::promise<void> p;
+        auto f = p.get_future();
+
+        loop_thread = std::make_unique<std::thread>([&, p = std::move(p)]() mutable {
+            loop = std::make_unique<IoUringLoop>(1024,32,1,4096,32);
+            InetAddress listenAddr(port_);
+            acceptor = std::make_unique<Acceptor>(loop.get(), listenAddr, true);
+            acceptor->setConnetionCallback([&](int sockfd, const InetAddress& peerAddr) {
+                auto conn = std::make_shared<TcpConnection>(
+                    "Conn-" + std::to_string(sockfd),
+                    *loop,
+                    sockfd,
+                    InetAddress(0),
+                    peerAddr,
+                    4096 * 16, // input high water mark
+                    16,        // input chunk high water mark
+                    1024 * 1024 * 8
+                );
+                conn->Established(recv_into_echo_server(conn));
+                conns.emplace_back(conn);
+            });
+            acceptor->listen();
+            p.set_value();
+            loop->loop();
+        });
+        f.wait();
+    }
+
+    void TearDown()override
+    {
+        if(loop) loop->quit();
+        if(loop_thread && loop_thread->joinable())
+        {
+            loop_thread->join();
+        }
+        acceptor.reset();
+        loop.reset();
+        loop_thread.reset();
+        conns.clear();
+        port_++;
+    }
+
+    int connectServer()
+    {
+        int client_fd = socket(AF_INET, SOCK_STREAM, 0);
+        struct sockaddr_in server_addr;
+        memset(&server_addr, 0, sizeof(server_addr));
+        server_addr.sin_family = AF_INET;
+        server_addr.sin_port = htons(port_);
+        inet_pton(AF_INET, "127.0.0.1", &server_addr.sin_addr);
+        for(int i=0; i<20; ++i) {
+            if(connect(client_fd, (struct sockaddr*)&server_addr, sizeof(server_addr))==0) return client_fd;
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        }
+        close(client_fd);
+        return -1;
+    }
+
+    std::unique_ptr<Acceptor> acceptor;
+    std::unique_ptr<IoUringLoop> loop;
+    std::unique_ptr<std::thread> loop_thread;
+    std::vector<std::shared_ptr<TcpConnection>>conns;
+    inline static uint16_t port_ = 9088;
+};
+
+// 测试1：小消息和多MB的大消息连续发送，直接接收的数据顺序和内容都正确
+TEST_F(DirectReadContextTest, RecvIntoMixedSizes)
+{
+    int client_fd = connectServer();
+    ASSERT_GT(client_fd, 0) << "Failed to connect to server";
+
+    std::string send_data;
+    for(size_t size : {16ul, 4ul*1024*1024, 100ul, 4096ul*3+5, 1ul, 2ul*1024*1024})
+    {
+        std::string payload(size,0);
+        for(size_t i=0;i<size;++i) payload[i] = 'a'+(i*7+size)%26;
+        uint32_t net_len = htonl(size);
+        send_data.append(reinterpret_cast<char*>(&net_len),sizeof(net_len));
+        send_data += payload;
+    }
+
+    std::thread sender([&](){
+        size_t sent = 0;
+        while(sent<send_data.size())
+        {
+            ssize_t n = ::send(client_fd,send_data.data()+sent,send_data.size()-sent,0);
+            if(n<=0) break;
+            sent += n;
+        }
+    });
+
+    std::string recv_data;
+    std::vector<char> buf(64*1024);
+    while(recv_data.size()<send_data.size())
+    {
+        ssize_t n = ::recv(client_fd,buf.data(),buf.size(),0);
+        if(n<=0) break;
+        recv_data.append(buf.data(),n);
+    }
+    sender.join();
+
+    EXPECT_EQ(recv_data.size(), send_data.size());
+    EXPECT_TRUE(recv_data==send_data);
+
+    EXPECT_EQ(close(client_fd),0);
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+}
+
+// 测试2：接收过程中对端关闭连接
+TEST_F(DirectReadContextTest, PeerCloseDuringRecvInto)
+{
+    int client_fd = connectServer();
+    ASSERT_GT(client_fd, 0) << "Failed to connect to server";
+
+    //声明了1MB的消息但是只发送一部分就关闭
+    uint32_t net_len = htonl(1024*1024);
+    std::string data(reinterpret_cast<char*>(&net_len),sizeof(net_len));
+    data += std::string(1000,'x');
+    ASSERT_EQ(::send(client_fd,data.data(),data.size(),0),(ssize_t)data.size());
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    EXPECT_EQ(close(client_fd),0);
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    EXPECT_EQ(conns.size(), 1);
+    EXPECT_TRUE(conns[0]->closing());
+    //业务协程已经销毁，协程帧中持有的连接也已经释放，只剩下测试中保存的引用
+    EXPECT_EQ(conns[0].use_count(), 1);
+}
@@ -0,0 +1,430 @@
+#include "test_helper.h"
+#include "ChunkPoolManagerInput.h"
+#include "InputChainBuffer.h"
+#include "FrameCodec.h"
+#include "IoUringLoop.h"
+#include "TcpConnection.h"
+#include "Acceptor.h"
+
+#include <liburing.h>
+#include <memory>
+#include <thread>
+#include <future>
+#include <cstring>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+//生成一个带u32长度前缀的帧
+static std::string makeFrame(const std::string& payload)
+{
+    uint32_t len = htonl(payload.size());
+    std::string ret(reinterpret_cast<char*>(&len),sizeof(len));
+    ret += payload;
+    return ret;
+}
+
+class FrameCodecTest : public ::testing::Test
+{
+protected:
+    inline static std::unique_ptr<IoUringLoop> loop_;
+    inline static std::unique_ptr<ChunkPoolManagerInput> cpm_;
+    std::unique_ptr<InputChainBuffer> icb_;
+    uint16_t next_index_ = 0;
+
+    static void SetUpTestSuite()
+    {
+        // 因为测试需要在一个线程中创建多个loop，所以要规避one loop per thread的检查
+        std::thread t([&](){
+            loop_ = std::make_unique<IoUringLoop>(1024, 32,1,4096,32);
+        });
+        t.join();
+        cpm_ = std::make_unique<ChunkPoolManagerInput>(*loop_);
+    }
+
+    static void TearDownTestSuite()
+    {
+        cpm_.reset();
+        loop_.reset();
+    }
+
+    void SetUp()
+    {
+        icb_ = std::make_unique<InputChainBuffer>(*cpm_);
+        next_index_ = 0;
+    }
+
+    void TearDown()
+    {
+        icb_.reset();
+    }
+
+    //模拟内核把数据按照piece的大小分散写入多个chunk中
+    void feed(const std::string& data,size_t piece)
+    {
+        for(size_t pos=0;pos<data.size();pos+=piece)
+        {
+            size_t len = std::min(piece,data.size()-pos);
+            uint16_t index = next_index_++;
+            std::memcpy(cpm_->getChunkById(index)->data_ptr_,data.data()+pos,len);
+            icb_->append(index,len);
+        }
+    }
+};
+
+// 测试1：数据不足时没有完整的帧
+TEST_F(FrameCodecTest, IncompleteFrame)
+{
+    FrameDecoder decoder;
+    std::string frame = makeFrame("hello world");
+
+    feed(frame.substr(0,2),2);
+    EXPECT_FALSE(decoder.hasFrame(*icb_));
+    EXPECT_EQ(decoder.need(), FrameDecoder::kHeaderLen);
+
+    feed(frame.substr(2,6),6);
+    EXPECT_FALSE(decoder.hasFrame(*icb_));
+    EXPECT_EQ(decoder.need(), frame.size());
+
+    feed(frame.substr(8),frame.size());
+    ASSERT_TRUE(decoder.hasFrame(*icb_));
+
+    Frame f = decoder.next(*icb_);
+    EXPECT_TRUE(f.valid());
+    EXPECT_EQ(f.size(), 11);
+    EXPECT_EQ(f.toString(), "hello world");
+}
+
+// 测试2：一个chunk中的帧是连续的，可以直接获取视图
+TEST_F(FrameCodecTest, ContiguousView)
+{
+    FrameDecoder decoder;
+    feed(makeFrame("abc")+makeFrame("defg"),4096);
+
+    ASSERT_TRUE(decoder.hasFrame(*icb_));
+    Frame f1 = decoder.next(*icb_);
+    ASSERT_TRUE(decoder.hasFrame(*icb_));
+    Frame f2 = decoder.next(*icb_);
+    EXPECT_FALSE(decoder.hasFrame(*icb_));
+
+    EXPECT_TRUE(f1.isContiguous());
+    EXPECT_EQ(f1.view(), "abc");
+    EXPECT_EQ(f2.view(), "defg");
+
+    //释放之后缓冲区中的数据被移除
+    decoder.release(*icb_);
+    EXPECT_EQ(icb_->getTotalLen(), 0);
+}
+
+// 测试3：跨越chunk边界的帧和头部
+TEST_F(FrameCodecTest, FrameAcrossChunks)
+{
+    FrameDecoder decoder;
+    std::string payload(100,'x');
+    for(size_t i=0;i<payload.size();++i) payload[i] = 'a'+i%26;
+
+    //每个chunk只有7个字节，头部和数据都跨越边界
+    feed(makeFrame(payload),7);
+    ASSERT_TRUE(decoder.hasFrame(*icb_));
+    Frame f = decoder.next(*icb_);
+
+    EXPECT_FALSE(f.isContiguous());
+    EXPECT_TRUE(f.view().empty());
+    EXPECT_EQ(f.toString(), payload);
+
+    size_t segments = 0;
+    f.forEachSegment([&](const char*,size_t){++segments;});
+    EXPECT_GT(segments, 1);
+}
+
+// 测试4：超过最大长度的帧视为协议错误
+TEST_F(FrameCodecTest, FrameTooLarge)
+{
+    FrameDecoder decoder(16);
+    feed(makeFrame(std::string(17,'a')),4096);
+
+    EXPECT_FALSE(decoder.hasFrame(*icb_));
+    EXPECT_TRUE(decoder.isError());
+}
+
+// 测试5：空帧
+TEST_F(FrameCodecTest, EmptyFrame)
+{
+    FrameDecoder decoder;
+    feed(makeFrame("")+makeFrame("x"),4096);
+
+    ASSERT_TRUE(decoder.hasFrame(*icb_));
+    Frame f = decoder.next(*icb_);
+    EXPECT_TRUE(f.valid());
+    EXPECT_EQ(f.size(), 0);
+    ASSERT_TRUE(decoder.hasFrame(*icb_));
+    EXPECT_EQ(decoder.next(*icb_).toString(), "x");
+}
+
+
+//把收到的每一帧原样发送回去
+Task<> frame_echo_server(std::shared_ptr<TcpConnection> conn)
+{
+    while(true)
+    {
+        auto frames = co_await conn->readFrames(8);
+        if(frames.empty()) break;
+
+        std::string out;
+        for(auto& f:frames)
+        {
+            out += makeFrame(f.toString());
+        }
+        bool need_continue = co_await conn->send(std::move(out));
+        if(!need_continue) break;
+    }
+}
+
+//通过生成器逐个拉取帧，每一帧单独发送回去
+Task<> frame_generator_echo_server(std::shared_ptr<TcpConnection> conn)
+{
+    auto frames = conn->frames();
+    while(true)
+    {
+        Frame* frame = co_await frames.next();
+        if(!frame) break;
+        bool need_continue = co_await conn->send(makeFrame(frame->toString()));
+        if(!need_continue) break;
+    }
+}
+
+class ReadFrameTest: public ::testing::Test
+{
+protected:
+    virtual Task<> handle(std::shared_ptr<TcpConnection> conn)
+    {
+        return frame_echo_server(std::move(conn));
+    }
+
+    void SetUp()override
+    {
+        std::promise<void> p;
+        auto f = p.get_future();
+
+        loop_thread = std::make_unique<std::thread>([&, p = std::move(p)]() mutable {
+            loop = std::make_unique<IoUringLoop>(1024,32,1,4096,32);
+            InetAddress listenAddr(port_);
+            acceptor = std::make_unique<Acceptor>(loop.get(), listenAddr, true);
+            acceptor->setConnetionCallback([&](int sockfd, const InetAddress& peerAddr) {
+                auto conn = std::make_shared<TcpConnection>(
+                    "Conn-" + std::to_string(sockfd),
+                    *loop,
+                    sockfd,
+                    InetAddress(0),
+                    peerAddr,
+                    4096 * 4,  // input high water mark，比最大的帧要小
+                    4,         // input chunk high water mark
+                    1024 * 1024
+                );
+                conn->Established(handle(conn));
+                conns.emplace_back(conn);
+            });
+            acceptor->listen();
+            p.set_value();
+            loop->loop();
+        });
+        f.wait();
+    }
+
+    void TearDown()override
+    {
+        if(loop) loop->quit();
+        if(loop_thread && loop_thread->joinable())
+        {
+            loop_thread->join();
+        }
+        acceptor.reset();
+        loop.reset();
+        loop_thread.reset();
+        conns.clear();
+        port_++;
+    }
+
+    //连接到服务器，失败返回-1
+    int connectClient()
+    {
+        int client_fd = socket(AF_INET, SOCK_STREAM, 0);
+        EXPECT_GT(client_fd, 0);
+
+        struct sockaddr_in server_addr;
+        memset(&server_addr, 0, sizeof(server_addr));
+        server_addr.sin_family = AF_INET;
+        server_addr.sin_port = htons(port_);
+        inet_pton(AF_INET, "127.0.0.1", &server_addr.sin_addr);
+
+        int ret = -1;
+        for(int i=0; i<20; ++i) {
+            ret = connect(client_fd, (struct sockaddr*)&server_addr, sizeof(server_addr));
+            if(ret == 0) break;
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        }
+        EXPECT_EQ(ret, 0) << "Failed to connect to server";
+        if(ret != 0)
+        {
+            close(client_fd);
+            return -1;
+        }
+        return client_fd;
+    }
+
+    //发送不同大小的帧，检查回显的数据
+    void echoFrames()
+    {
+        int client_fd = connectClient();
+        ASSERT_GE(client_fd, 0);
+
+        std::string send_data;
+        for(size_t size : {1ul, 64ul, 4096ul, 4096ul*8, 7ul})
+        {
+            std::string payload(size,'a');
+            for(size_t i=0;i<size;++i) payload[i] = 'a'+i%26;
+            send_data += makeFrame(payload);
+        }
+
+        std::thread sender([&](){
+            size_t sent = 0;
+            while(sent<send_data.size())
+            {
+                ssize_t n = ::send(client_fd,send_data.data()+sent,send_data.size()-sent,0);
+                if(n<=0) break;
+                sent += n;
+            }
+        });
+
+        std::string recv_data;
+        char buf[4096];
+        while(recv_data.size()<send_data.size())
+        {
+            ssize_t n = ::recv(client_fd,buf,sizeof(buf),0);
+            if(n<=0) break;
+            recv_data.append(buf,n);
+        }
+        sender.join();
+
+        EXPECT_EQ(recv_data, send_data);
+
+        EXPECT_EQ(close(client_fd),0);
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    }
+
+    std::unique_ptr<Acceptor> acceptor;
+    std::unique_ptr<IoUringLoop> loop;
+    std::unique_ptr<std::thread> loop_thread;
+    std::vector<std::shared_ptr<TcpConnection>>conns;
+    inline static uint16_t port_ = 8988;
+};
+
+// 测试6：帧大于输入缓冲区的高水位线时仍然可以完整接收
+TEST_F(ReadFrameTest, EchoFramesLargerThanHighWaterMark)
+{
+    echoFrames();
+}
+
+class FrameGeneratorTest: public ReadFrameTest
+{
+protected:
+    Task<> handle(std::shared_ptr<TcpConnection> conn)override
+    {
+        return frame_generator_echo_server(std::move(conn));
+    }
+};
+
+// 测试7：通过生成器拉取帧，消费者发送回复时后面的数据留在缓冲区中
+TEST_F(FrameGeneratorTest, EchoFramesLargerThanHighWaterMark)
+{
+    echoFrames();
+}
+
+
+//丢弃之后收到的所有数据，直到对端关闭连接
+Task<> discard_until_close(std::shared_ptr<TcpConnection> conn)
+{
+    while(true)
+    {
+        int size = co_await conn->PrepareToRead();
+        if(size<0) break;
+        conn->retrieve(size);
+    }
+}
+
+//读取一帧，回复"F"表示收到有效帧，"E"表示协议错误
+Task<> frame_limit_server(std::shared_ptr<TcpConnection> conn)
+{
+    Frame frame = co_await conn->readFrame();
+    if(!co_await conn->send(std::string(frame.valid()?"F":"E"))) co_return;
+    co_await discard_until_close(conn);
+}
+
+//等待一个比输入buffer ring容量一半还长的消息，回复"D"表示收到，"E"表示被拒绝
+Task<> long_message_server(std::shared_ptr<TcpConnection> conn)
+{
+    int size = co_await conn->PrepareToRead(4096*16+1);
+    if(!co_await conn->send(std::string(size<0?"E":"D"))) co_return;
+    co_await discard_until_close(conn);
+}
+
+class FrameLimitTest: public ReadFrameTest
+{
+protected:
+    Task<> handle(std::shared_ptr<TcpConnection> conn)override
+    {
+        return frame_limit_server(std::move(conn));
+    }
+
+    //发送payload_len长度的帧，返回服务端回复的一个字节
+    char sendFrame(size_t payload_len)
+    {
+        int client_fd = connectClient();
+        if(client_fd < 0) return 0;
+        std::string data = makeFrame(std::string(payload_len,'x'));
+        size_t sent = 0;
+        while(sent<data.size())
+        {
+            ssize_t n = ::send(client_fd,data.data()+sent,data.size()-sent,0);
+            if(n<=0) break;
+            sent += n;
+        }
+        char reply = 0;
+        EXPECT_EQ(::recv(client_fd,&reply,1,0),1);
+        EXPECT_EQ(close(client_fd),0);
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        return reply;
+    }
+};
+
+// 测试8：帧长度被限制在buffer ring容量(32个4096字节的chunk)的一半以内，不能为了等待帧占满共享的buffer ring
+TEST_F(FrameLimitTest, FrameLongerThanHalfRingIsError)
+{
+    EXPECT_EQ(sendFrame(4096*16), 'E');
+}
+
+TEST_F(FrameLimitTest, FrameWithinHalfRingIsReceived)
+{
+    EXPECT_EQ(sendFrame(4096*16-FrameDecoder::kHeaderLen), 'F');
+}
+
+class LongMessageTest: public FrameLimitTest
+{
+protected:
+    Task<> handle(std::shared_ptr<TcpConnection> conn)override
+    {
+        return long_message_server(std::move(conn));
+    }
+};
+
+// 测试9：PrepareToRead等待的长度超过buffer ring容量的一半时直接失败
+TEST_F(LongMessageTest, PrepareToReadRejectsTooLongMessage)
+{
+    int client_fd = connectClient();
+    ASSERT_GE(client_fd, 0);
+    char reply = 0;
+    EXPECT_EQ(::recv(client_fd,&reply,1,0),1);
+    EXPECT_EQ(reply, 'E');
+    EXPECT_EQ(close(client_fd),0);
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+}
@@ -0,0 +1,104 @@
+#include "test_helper.h"
+
+#include "FramePool.h"
+#include "IoUringLoop.h"
+#include "Task.hpp"
+
+#include <thread>
+
+namespace
+{
+
+Task<int> leaf(int value)
+{
+    co_return value;
+}
+
+Task<int> twoLevels(int value)
+{
+    int result = co_await leaf(value);
+    co_return result+1;
+}
+
+}
+
+//释放的块缓存之后被同一级的下一次分配复用
+TEST(FramePoolTest, ReusesReleasedBlock)
+{
+    FramePool pool;
+    void* first = pool.allocate(100);
+    pool.release(first,100);
+    EXPECT_EQ(pool.stats().cached_, 1u);
+
+    //100和120属于同一级
+    void* second = pool.allocate(120);
+    EXPECT_EQ(second, first);
+    pool.release(second,120);
+
+    auto stats = pool.stats();
+    EXPECT_EQ(stats.misses_, 1u);
+    EXPECT_EQ(stats.hits_, 1u);
+    EXPECT_EQ(stats.released_, 2u);
+}
+
+TEST(FramePoolTest, OversizeAndFullCacheGoToHeap)
+{
+    FramePool pool;
+    pool.setCacheLimit(1);
+    void* big = pool.allocate(FramePool::kMaxClassSize+1);
+    void* a = pool.allocate(64);
+    void* b = pool.allocate(64);
+    pool.release(big,FramePool::kMaxClassSize+1);
+    pool.release(a,64);
+    pool.release(b,64);
+
+    auto stats = pool.stats();
+    EXPECT_EQ(stats.oversize_, 1u);
+    EXPECT_EQ(stats.released_, 1u);
+    EXPECT_EQ(stats.dropped_, 1u);
+    EXPECT_EQ(stats.cached_, 1u);
+}
+
+//预先分配之后前count次分配都不经过堆
+TEST(FramePoolTest, ReserveWarmsSizeClass)
+{
+    FramePool pool;
+    pool.reserve(300,2000);
+    EXPECT_EQ(pool.stats().cached_, 2000u);
+
+    std::vector<void*> frames;
+    for(int i=0;i<2000;++i) frames.push_back(pool.allocate(512));
+    EXPECT_EQ(pool.stats().hits_, 2000u);
+    EXPECT_EQ(pool.stats().misses_, 0u);
+
+    //缓存上限被提高到预先分配的数量，全部可以放回缓存
+    for(auto frame:frames) pool.release(frame,512);
+    EXPECT_EQ(pool.stats().cached_, 2000u);
+    EXPECT_EQ(pool.stats().dropped_, 0u);
+}
+
+//loop线程中的Task使用loop的帧内存池，没有loop的线程使用堆
+TEST(FramePoolTest, TaskFramesUseLoopPool)
+{
+    FramePool::Stats stats{};
+    int result = 0;
+    std::thread loop_thread([&](){
+        IoUringLoop loop(256,32,1,4096,16);
+        ASSERT_EQ(FramePool::current(), &loop.getFramePool());
+        for(int i=0;i<2;++i)
+        {
+            auto task = twoLevels(i);
+            task.resume();
+            result = task.returnValue();
+        }
+        //第一轮的两个帧从堆中分配，第二轮复用第一轮释放的帧
+        stats = loop.getFramePool().stats();
+    });
+    loop_thread.join();
+
+    EXPECT_EQ(result, 2);
+    EXPECT_EQ(stats.misses_, 2u);
+    EXPECT_EQ(stats.hits_, 2u);
+    EXPECT_EQ(stats.cached_, 2u);
+    EXPECT_EQ(FramePool::current(), nullptr);
+}
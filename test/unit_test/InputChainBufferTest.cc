@@ -228,4 +228,61 @@ TEST_F(InputChainBufferTest, RetrieveOnEmptyBuffer)
 {
     icb_->retrieve(10);
     EXPECT_EQ(icb_->getTotalLen(), 0);
-}
\ No newline at end of file
+}
+// 测试16：小数据合并到尾节点中，新的chunk立即归还
+TEST_F(InputChainBufferTest, AppendCompactMergesSmallData)
+{
+    auto stats = cpm_->stats();
+    std::memcpy(cpm_->getChunkById(0)->data_ptr_, "hello", 5);
+    std::memcpy(cpm_->getChunkById(1)->data_ptr_, " world", 6);
+    icb_->appendCompact(0, 5);
+    icb_->appendCompact(1, 6);
+
+    EXPECT_EQ(icb_->getTotalChunk(), 1);
+    EXPECT_EQ(icb_->getTotalLen(), 11);
+    EXPECT_EQ(cpm_->getChunkById(1)->readableBytes(), 0);
+    EXPECT_EQ(cpm_->stats().appended_chunks_-stats.appended_chunks_, 2);
+    EXPECT_EQ(cpm_->stats().compacted_chunks_-stats.compacted_chunks_, 1);
+    EXPECT_EQ(cpm_->stats().compacted_bytes_-stats.compacted_bytes_, 6);
+    EXPECT_EQ(icb_->removeAllAsString(), "hello world");
+}
+
+// 测试17：数据超过阈值或者尾节点空间不足时不合并
+TEST_F(InputChainBufferTest, AppendCompactSkipsLargeData)
+{
+    size_t chunk_size = cpm_->chunk_size_;
+    icb_->appendCompact(0, chunk_size-10);
+    icb_->appendCompact(1, 20);
+    EXPECT_EQ(icb_->getTotalChunk(), 2);
+
+    icb_->appendCompact(2, cpm_->compact_threshold_+1);
+    EXPECT_EQ(icb_->getTotalChunk(), 3);
+}
+
+// 测试18：阈值为0时关闭合并
+TEST_F(InputChainBufferTest, AppendCompactDisabled)
+{
+    cpm_->setCompactThreshold(0);
+    icb_->appendCompact(0, 5);
+    icb_->appendCompact(1, 5);
+    EXPECT_EQ(icb_->getTotalChunk(), 2);
+    cpm_->setCompactThreshold(cpm_->chunk_size_/8);
+}
+
+// 测试19：通过append和appendCompact进入缓冲区的chunk都计入持有数量，归还之后恢复
+TEST_F(InputChainBufferTest, InUseChunksBalanced)
+{
+    int64_t in_use = cpm_->stats().in_use_chunks_;
+    size_t chunk_size = cpm_->chunk_size_;
+    icb_->append(0, chunk_size);
+    icb_->appendCompact(1, chunk_size);
+    icb_->appendCompact(2, 5);
+    EXPECT_EQ(cpm_->stats().in_use_chunks_-in_use, 3);
+    //尾节点还有空间，小数据合并之后chunk立即归还
+    icb_->appendCompact(3, 5);
+    EXPECT_EQ(cpm_->stats().in_use_chunks_-in_use, 3);
+    EXPECT_GE(cpm_->stats().peak_in_use_chunks_, in_use+3);
+
+    icb_->retrieve(icb_->getTotalLen());
+    EXPECT_EQ(cpm_->stats().in_use_chunks_, in_use);
+}
@@ -0,0 +1,224 @@
+#include "test_helper.h"
+
+#include "IoUringLoop.h"
+#include "IoUringLoopThread.h"
+#include "ThreadPool.h"
+#include "Task.hpp"
+
+#include <future>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+Task<> count(int& counter)
+{
+    counter++;
+    co_return;
+}
+
+//子协程在其它loop中创建，被等待之后属于等待者的loop
+Task<bool> backHome(IoUringLoop* home)
+{
+    co_await resumeOnOwnLoop();
+    co_return home->isInLoopThread();
+}
+
+//在两个loop和线程池之间切换，记录每一步是否在预期的线程中
+Task<> hopAround(IoUringLoop* home,IoUringLoop* other,ThreadPool& pool,std::vector<bool>& checks,std::promise<void>& done)
+{
+    checks.push_back(home->isInLoopThread());
+    co_await switchTo(*other);
+    checks.push_back(other->isInLoopThread());
+    //已经在other中，不挂起
+    co_await switchTo(*other);
+    checks.push_back(other->isInLoopThread());
+    co_await resumeOnOwnLoop();
+    checks.push_back(home->isInLoopThread());
+
+    bool ok = co_await pool.switchThread();
+    checks.push_back(ok&&!home->isInLoopThread());
+    co_await resumeOnOwnLoop();
+    checks.push_back(home->isInLoopThread());
+
+    co_await switchTo(*other);
+    bool back = co_await backHome(home);
+    checks.push_back(back);
+    done.set_value();
+}
+
+//分段执行，每一段之后让出loop
+Task<> worker(IoUringLoop& loop,char name,int steps,std::string& trace,int& running)
+{
+    for(int i=0;i<steps;++i)
+    {
+        trace += name;
+        co_await loop.yield();
+    }
+    if(--running==0) loop.quit();
+}
+
+}
+
+//关闭延迟恢复时直接恢复协程
+TEST(IoUringLoopTest, ResumeHandleInlineByDefault)
+{
+    int counter = 0;
+    size_t ready = 1;
+    std::thread loop_thread([&](){
+        IoUringLoop loop(256,32,1,4096,16);
+        auto task = count(counter);
+        IoUringLoop::resumeHandle(task.handle_);
+        ready = loop.readyCount();
+    });
+    loop_thread.join();
+    EXPECT_EQ(counter, 1);
+    EXPECT_EQ(ready, 0u);
+}
+
+//就绪队列在这一批cqe处理完之后恢复，每次循环最多恢复budget个，被撤销的协程不会恢复也不占用预算
+TEST(IoUringLoopTest, ReadyQueueHonorsBudgetAndCancel)
+{
+    int counter = 0;
+    std::vector<int> seen;
+    size_t queued = 0;
+    std::thread loop_thread([&](){
+        IoUringLoop loop(256,32,1,4096,16);
+        loop.setDeferredResume(true);
+        loop.setResumeBudget(2);
+
+        std::vector<Task<>> tasks;
+        for(int i=0;i<4;++i) tasks.push_back(count(counter));
+        for(auto& task:tasks) IoUringLoop::resumeHandle(task.handle_);
+        loop.cancelReady(tasks[2].handle_);
+        queued = loop.readyCount();
+
+        //任务队列在就绪队列之后执行，记录每一次循环结束时恢复的数量
+        loop.queueInLoop([&](){
+            seen.push_back(counter);
+            loop.queueInLoop([&](){
+                seen.push_back(counter);
+                loop.quit();
+            });
+        });
+        loop.loop();
+    });
+    loop_thread.join();
+
+    EXPECT_EQ(queued, 4u);
+    EXPECT_EQ(seen, std::vector<int>({2,3}));
+    EXPECT_EQ(counter, 3);
+}
+
+//yield的协程在这一次循环中不会再被恢复，两个协程交替执行
+TEST(IoUringLoopTest, YieldInterleavesCoroutines)
+{
+    std::string trace;
+    LoopStats stats{};
+    std::thread loop_thread([&](){
+        IoUringLoop loop(256,32,1,4096,16);
+        int running = 2;
+        auto a = worker(loop,'a',3,trace,running);
+        auto b = worker(loop,'b',3,trace,running);
+        a.resume();
+        b.resume();
+        loop.loop();
+        stats = loop.stats();
+    });
+    loop_thread.join();
+    EXPECT_EQ(trace, "ababab");
+    EXPECT_EQ(stats.yields_, 6u);
+    EXPECT_EQ(stats.resumes_, 6u);
+}
+
+//超过预算的任务按照顺序留到下一次循环
+TEST(IoUringLoopTest, FunctorBudgetKeepsOrder)
+{
+    std::vector<std::pair<int,uint64_t>> runs;
+    LoopStats stats{};
+    std::thread loop_thread([&](){
+        IoUringLoop loop(256,32,1,4096,16);
+        loop.setFunctorBudget(2);
+        for(int i=0;i<5;++i)
+        {
+            loop.queueInLoop([&,i](){
+                runs.push_back({i,loop.stats().iterations_});
+                if(i==4) loop.quit();
+            });
+        }
+        //在loop线程中开始循环之前追加的任务不会自动唤醒
+        loop.wakeUp();
+        loop.loop();
+        stats = loop.stats();
+    });
+    loop_thread.join();
+
+    ASSERT_EQ(runs.size(), 5u);
+    for(int i=0;i<5;++i) EXPECT_EQ(runs[i].first, i);
+    //每次循环执行两个
+    EXPECT_EQ(runs[0].second, runs[1].second);
+    EXPECT_EQ(runs[1].second+1, runs[2].second);
+    EXPECT_EQ(runs[2].second, runs[3].second);
+    EXPECT_EQ(runs[3].second+1, runs[4].second);
+    EXPECT_EQ(stats.functors_, 5u);
+    EXPECT_GE(stats.budget_exhausted_, 2u);
+}
+
+//耗时超过阈值的处理被记录下来
+TEST(IoUringLoopTest, SlowHandlerIsReported)
+{
+    std::vector<std::pair<const IoContext*,int64_t>> slow;
+    LoopStats stats{};
+    std::thread loop_thread([&](){
+        IoUringLoop loop(256,32,1,4096,16);
+        loop.setSlowHandlerThreshold(2000,[&](const IoContext* ctx,int64_t us){slow.push_back({ctx,us});});
+        loop.queueInLoop([](){});
+        loop.queueInLoop([&](){
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            loop.quit();
+        });
+        loop.wakeUp();
+        loop.loop();
+        stats = loop.stats();
+    });
+    loop_thread.join();
+
+    ASSERT_EQ(slow.size(), 1u);
+    EXPECT_EQ(slow[0].first, nullptr);
+    EXPECT_GE(slow[0].second, 5000);
+    EXPECT_EQ(stats.slow_handlers_, 1u);
+    EXPECT_GE(stats.max_handler_us_, 5000);
+}
+
+//switchTo切换到指定的loop，resumeOnOwnLoop回到协程创建时所在的loop
+TEST(IoUringLoopTest, SwitchToAndResumeOnOwnLoop)
+{
+    IoUringLoopParams params{256,32,1,4096,16};
+    IoUringLoopThread home_thread(nullptr,params,"home");
+    IoUringLoopThread other_thread(nullptr,params,"other");
+    IoUringLoop* home = home_thread.startLoop();
+    IoUringLoop* other = other_thread.startLoop();
+    ThreadPool pool(1,16);
+
+    std::vector<bool> checks;
+    std::promise<void> done;
+    auto finished = done.get_future();
+    std::unique_ptr<Task<>> task;
+    home->runInLoop([&](){
+        task = std::make_unique<Task<>>(hopAround(home,other,pool,checks,done));
+        EXPECT_EQ(task->handle_.promise().home_loop_, home);
+        task->resume();
+    });
+    ASSERT_EQ(finished.wait_for(std::chrono::seconds(5)), std::future_status::ready);
+    EXPECT_EQ(checks, std::vector<bool>(7,true));
+
+    //协程在home中执行完毕，在home中销毁
+    std::promise<void> destroyed;
+    home->runInLoop([&](){
+        task.reset();
+        destroyed.set_value();
+    });
+    destroyed.get_future().wait();
+}
@@ -78,3 +78,347 @@ TEST(SendQueueTest, BatchLimitRespected)
     EXPECT_TRUE(q.isEmpty());
 }
 
+
+TEST(SendQueueTest, PooledFragmentsAreReused)
+{
+    TxFragmentPool pool(8);
+    SendQueue q(&pool);
+
+    for(int round=0;round<4;++round)
+    {
+        for(int i=0;i<6;++i) q.append("abc", 3);
+        EXPECT_EQ(pool.inUse(), 6u);
+        q.retrieve(q.getTotalLen());
+        EXPECT_EQ(pool.inUse(), 0u);
+    }
+    //稳定状态下只使用第一个slab
+    EXPECT_EQ(pool.capacity(), 8u);
+
+    for(int i=0;i<10;++i) q.append("abc", 3);
+    EXPECT_EQ(pool.capacity(), 16u);
+    q.retrieve(q.getTotalLen());
+    EXPECT_TRUE(q.isEmpty());
+}
+
+TEST(SendQueueTest, LargeBufferIsMovedWithoutCopy)
+{
+    SendQueue q;
+    std::string s(1024, 'a');
+    std::vector<char> v(1024, 'b');
+    const char* s_data = s.data();
+    const char* v_data = v.data();
+    q.append(std::move(s));
+    q.append(std::move(v));
+
+    std::vector<iovec> iovecs;
+    q.getBatchFragment(iovecs, 4);
+    ASSERT_EQ(iovecs.size(), 2u);
+    //大数据的所有权直接转移到分片中，指针不变
+    EXPECT_EQ(iovecs[0].iov_base, s_data);
+    EXPECT_EQ(iovecs[1].iov_base, v_data);
+    EXPECT_EQ(q.getTotalLen(), 2048u);
+
+    //部分发送之后剩余的数据仍然正确
+    q.retrieve(1500);
+    auto iov = q.getOneIovec();
+    ASSERT_EQ(iov.iov_len, 548u);
+    EXPECT_EQ(std::string(static_cast<char*>(iov.iov_base), iov.iov_len), std::string(548, 'b'));
+    q.retrieve(548);
+    EXPECT_TRUE(q.isEmpty());
+}
+
+TEST(SendQueueTest, SmallDataIsStoredInline)
+{
+    TxFragmentPool pool;
+    SendQueue q(&pool);
+    std::string small(TxFragment::kInlineCapacity, 's');
+    q.append(small);
+    q.append(std::string());
+
+    //空数据不产生分片
+    EXPECT_EQ(pool.inUse(), 1u);
+    auto iov = q.getOneIovec();
+    ASSERT_EQ(iov.iov_len, small.size());
+    EXPECT_NE(iov.iov_base, small.data());
+    EXPECT_EQ(std::string(static_cast<char*>(iov.iov_base), iov.iov_len), small);
+    q.retrieve(small.size());
+    EXPECT_EQ(pool.inUse(), 0u);
+}
+
+TEST(SendQueueTest, CoalesceSmallWrites)
+{
+    TxFragmentPool pool(8, 64);
+    SendQueue q(&pool, 16);
+
+    //小数据合并到一个暂存块中，大数据仍然是单独的分片
+    q.append("hello ", 6);
+    q.append(std::string("world"));
+    q.append(std::string(32, 'L'));
+    q.append("!", 1);
+    EXPECT_EQ(q.sliceSize(), 3u);
+
+    std::vector<iovec> iovecs;
+    q.getBatchFragment(iovecs, 8);
+    ASSERT_EQ(iovecs.size(), 3u);
+    EXPECT_EQ(std::string(static_cast<char*>(iovecs[0].iov_base), iovecs[0].iov_len), "hello world");
+    EXPECT_EQ(iovecs[1].iov_len, 32u);
+    EXPECT_EQ(std::string(static_cast<char*>(iovecs[2].iov_base), iovecs[2].iov_len), "!");
+    q.retrieve(q.getTotalLen());
+    EXPECT_TRUE(q.isEmpty());
+    EXPECT_EQ(pool.inUse(), 0u);
+}
+
+TEST(SendQueueTest, CoalesceWhileInFlight)
+{
+    TxFragmentPool pool(8, 64);
+    SendQueue q(&pool, 16);
+
+    q.append("abcd", 4);
+    std::vector<iovec> iovecs;
+    q.getBatchFragment(iovecs, 8);
+    ASSERT_EQ(iovecs.size(), 1u);
+    const char* in_flight = static_cast<char*>(iovecs[0].iov_base);
+
+    //发送的过程中继续追加，已经交给内核的数据不能移动
+    q.append("efgh", 4);
+    EXPECT_EQ(std::string(in_flight, 4), "abcd");
+
+    //部分发送完成之后剩余的数据和新追加的数据一起发送
+    q.retrieve(2);
+    iovecs.clear();
+    q.getBatchFragment(iovecs, 8);
+    ASSERT_EQ(iovecs.size(), 1u);
+    EXPECT_EQ(std::string(static_cast<char*>(iovecs[0].iov_base), iovecs[0].iov_len), "cdefgh");
+
+    //暂存块写满之后使用新的暂存块
+    for(int i=0;i<10;++i) q.append("0123456789", 10);
+    EXPECT_EQ(q.getTotalLen(), 106u);
+    EXPECT_EQ(q.sliceSize(), 2u);
+    q.retrieve(q.getTotalLen());
+    EXPECT_TRUE(q.isEmpty());
+}
+
+TEST(SendQueueTest, ConsumeWithoutRegather)
+{
+    TxFragmentPool pool(8, 64);
+    SendQueue q(&pool, 16);
+    q.append(std::string(100, 'a'));
+    q.append("bcd", 3);
+
+    //按照字节数限制分成两个请求，第一个分片只取出一部分
+    std::vector<iovec> first, second;
+    q.getBatchFragment(first, 8, 60);
+    ASSERT_EQ(first.size(), 1u);
+    EXPECT_EQ(first[0].iov_len, 60u);
+    q.getBatchFragment(second, 8, 60);
+    ASSERT_EQ(second.size(), 2u);
+    EXPECT_EQ(second[0].iov_len, 40u);
+    EXPECT_EQ(std::string(static_cast<char*>(second[1].iov_base), second[1].iov_len), "bcd");
+    EXPECT_EQ(q.pendingFragment(), nullptr);
+
+    //第一个请求写完之后不会重新提取第二个请求中的数据
+    q.consume(60);
+    EXPECT_EQ(q.getTotalLen(), 43u);
+    EXPECT_EQ(q.pendingFragment(), nullptr);
+
+    //已经交给iovec的暂存块中追加的数据可以继续提取
+    q.append("efg", 3);
+    auto iov = q.getOneIovec();
+    EXPECT_EQ(std::string(static_cast<char*>(iov.iov_base), iov.iov_len), "efg");
+
+    //第二个请求只写了一部分，放弃之后从没有写完的位置重新提取
+    q.consume(10);
+    q.rewind();
+    std::vector<iovec> retry;
+    q.getBatchFragment(retry, 8);
+    ASSERT_EQ(retry.size(), 2u);
+    EXPECT_EQ(retry[0].iov_len, 30u);
+    EXPECT_EQ(std::string(static_cast<char*>(retry[1].iov_base), retry[1].iov_len), "bcdefg");
+    q.consume(36);
+    EXPECT_TRUE(q.isEmpty());
+    EXPECT_EQ(pool.inUse(), 0u);
+}
+
+TEST(SendQueueTest, SharedPayloadIsReferencedNotCopied)
+{
+    Payload payload(std::string(1000, 'p'));
+    TxFragmentPool pool;
+    {
+        SendQueue q1(&pool);
+        SendQueue q2(&pool);
+        q1.append(payload);
+        q2.append(payload);
+        EXPECT_EQ(payload.useCount(), 3u);
+
+        //两个队列中的分片指向同一块数据
+        auto iov1 = q1.getOneIovec();
+        auto iov2 = q2.getOneIovec();
+        EXPECT_EQ(iov1.iov_base, payload.data());
+        EXPECT_EQ(iov2.iov_base, payload.data());
+        EXPECT_EQ(iov1.iov_len, 1000u);
+
+        q1.retrieve(1000);
+        EXPECT_TRUE(q1.isEmpty());
+        EXPECT_EQ(payload.useCount(), 2u);
+    }
+    //没有发送完的队列析构时释放引用
+    EXPECT_EQ(payload.useCount(), 1u);
+
+    //小数据和std::string一样直接拷贝
+    Payload small(std::string("tiny"));
+    SendQueue q(&pool);
+    q.append(small);
+    EXPECT_EQ(small.useCount(), 1u);
+    auto iov = q.getOneIovec();
+    EXPECT_EQ(std::string(static_cast<char*>(iov.iov_base), iov.iov_len), "tiny");
+}
+
+TEST(SendQueueTest, GuardedDataIsReferencedUntilSent)
+{
+    auto body = std::make_shared<const std::string>(1000, 'b');
+    std::weak_ptr<const std::string> weak = body;
+    static const char head[] = "HEAD";
+    SendQueue q;
+    {
+        //头部和数据体作为两个分片追加，数据体只引用调用者的内存
+        iovec iov[2] = {{(void*)head, 4}, {(void*)body->data(), body->size()}};
+        q.append(GuardedIovecs{iov, body});
+    }
+    body.reset();
+    EXPECT_FALSE(weak.expired());
+    EXPECT_EQ(q.sliceSize(), 2u);
+
+    std::vector<iovec> iovecs;
+    q.getBatchFragment(iovecs, 8);
+    ASSERT_EQ(iovecs.size(), 2u);
+    EXPECT_EQ(std::string(static_cast<char*>(iovecs[0].iov_base), 4), "HEAD");
+    EXPECT_EQ(iovecs[1].iov_base, weak.lock()->data());
+
+    //发送完成之后释放guard
+    q.retrieve(1004);
+    EXPECT_TRUE(weak.expired());
+
+    //没有guard时拷贝数据
+    std::string temp(1000, 't');
+    q.append(GuardedView{temp, nullptr});
+    temp.assign(1000, 'x');
+    auto iov = q.getOneIovec();
+    EXPECT_EQ(std::string(static_cast<char*>(iov.iov_base), iov.iov_len), std::string(1000, 't'));
+}
+
+TEST(SendQueueTest, FileRangeIsSentAlone)
+{
+    auto file = std::make_shared<int>(42);
+    std::weak_ptr<int> weak = file;
+    SendQueue q;
+    q.append(GuardedView{"HDR", nullptr});
+    q.append(FileRange{*file, 100, 5000, file});
+    q.append(GuardedView{"TAIL", nullptr});
+    file.reset();
+    EXPECT_EQ(q.getTotalLen(), 5007u);
+
+    //文件分片之前的数据单独取出，不会越过文件分片
+    std::vector<iovec> iovecs;
+    q.getBatchFragment(iovecs, 8);
+    ASSERT_EQ(iovecs.size(), 1u);
+    EXPECT_EQ(std::string(static_cast<char*>(iovecs[0].iov_base), iovecs[0].iov_len), "HDR");
+    q.retrieve(3);
+
+    auto fragment = q.pendingFile();
+    ASSERT_NE(fragment, nullptr);
+    EXPECT_TRUE(q.sendAlone(fragment));
+    EXPECT_EQ(fragment->file_fd_, 42);
+    EXPECT_EQ(fragment->file_offset_, 100);
+
+    //文件分片发送一部分之后仍然在头部，全部发送之后释放guard
+    q.retrieve(3000);
+    ASSERT_EQ(q.pendingFile(), fragment);
+    EXPECT_EQ(fragment->written_, 3000u);
+    EXPECT_FALSE(weak.expired());
+    q.retrieve(2000);
+    EXPECT_TRUE(weak.expired());
+    EXPECT_EQ(q.pendingFile(), nullptr);
+
+    iovecs.clear();
+    q.getBatchFragment(iovecs, 8);
+    ASSERT_EQ(iovecs.size(), 1u);
+    EXPECT_EQ(std::string(static_cast<char*>(iovecs[0].iov_base), iovecs[0].iov_len), "TAIL");
+}
+
+//按照提取的顺序取出所有数据，每个分片用首字母表示
+static std::string drainOrder(SendQueue& q)
+{
+    q.placeHigh();
+    std::string order;
+    while(q.pendingFragment())
+    {
+        auto iov = q.getOneIovec();
+        order += static_cast<char*>(iov.iov_base)[0];
+    }
+    return order;
+}
+
+TEST(SendQueueTest, HighPriorityWaitsForMessageBoundary)
+{
+    SendQueue q;
+    static const std::string a(1000, 'a'), b(1000, 'b'), c(1000, 'c'), d(1000, 'd');
+    q.append(std::string(a));
+    //b和c是同一条消息的两个分片
+    iovec iov[2] = {{(void*)b.data(), b.size()}, {(void*)c.data(), c.size()}};
+    q.append(GuardedIovecs{iov, std::make_shared<int>(0)});
+    q.append(std::string(d));
+
+    //a已经发送了一部分，高优先级的消息插入到a之后，计入总的数据量
+    q.getOneIovec(10);
+    q.retrieve(10);
+    q.append(std::string(100, 'H'), Priority::High);
+    EXPECT_TRUE(q.hasPendingHigh());
+    EXPECT_EQ(q.getTotalLen(), 4090u);
+    EXPECT_EQ(drainOrder(q), "aHbcd");
+    EXPECT_FALSE(q.hasPendingHigh());
+
+    //b已经发送了一部分，高优先级的消息不能插入到b和c之间，多条高优先级的消息按照追加的顺序发送
+    q.retrieve(990+100);
+    q.getOneIovec(10);
+    q.retrieve(10);
+    q.append(std::string(100, 'X'), Priority::High);
+    q.append(std::string(100, 'Y'), Priority::High);
+    EXPECT_EQ(drainOrder(q), "bcXYd");
+
+    //插入之后还没有发送的高优先级消息之后继续插入
+    q.retrieve(990+1000);
+    q.append(std::string(100, 'Z'), Priority::High);
+    EXPECT_EQ(drainOrder(q), "XYZd");
+    q.retrieve(300+1000);
+    EXPECT_TRUE(q.isEmpty());
+
+    //队列为空时直接作为第一个分片
+    q.append(std::string(100, 'W'), Priority::High);
+    q.append(std::string(100, 'n'));
+    EXPECT_EQ(drainOrder(q), "Wn");
+}
+
+//发送出错之后放弃已经提取的数据，下一次从头部重新提取
+TEST(SendQueueTest, RewindRegathersUnsentData)
+{
+    TxFragmentPool pool(8, 64);
+    SendQueue q(&pool, 16);
+    q.append(std::string(100, 'a'));
+    q.append("bcd", 3);
+
+    std::vector<iovec> iovecs;
+    q.getBatchFragment(iovecs, 8);
+    ASSERT_EQ(iovecs.size(), 2u);
+    iovecs.clear();
+    q.getBatchFragment(iovecs, 8);
+    EXPECT_TRUE(iovecs.empty());
+
+    q.rewind();
+    q.getBatchFragment(iovecs, 8);
+    ASSERT_EQ(iovecs.size(), 2u);
+    EXPECT_EQ(iovecs[0].iov_len, 100u);
+    EXPECT_EQ(std::string(static_cast<char*>(iovecs[1].iov_base), iovecs[1].iov_len), "bcd");
+    q.retrieve(q.getTotalLen());
+    EXPECT_TRUE(q.isEmpty());
+    EXPECT_EQ(pool.inUse(), 0u);
+}
@@ -0,0 +1,367 @@
+#include "test_helper.h"
+
+#include "TaskCombinators.hpp"
+#include "Task.hpp"
+#include "ThreadPool.h"
+#include "IoUringLoop.h"
+#include "IoUringLoopThread.h"
+
+#include <future>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+namespace
+{
+
+//手动恢复的awaiter，不能取消，在whenAny中会被分离
+struct ManualEvent
+{
+    std::coroutine_handle<> waiter_;
+
+    void set()
+    {
+        auto h = std::exchange(waiter_,nullptr);
+        h.resume();
+    }
+};
+
+struct EventAwaiter
+{
+    ManualEvent* event_;
+
+    bool await_ready(){return false;}
+    void await_suspend(std::coroutine_handle<>h){event_->waiter_ = h;}
+    void await_resume(){}
+};
+
+//可以取消的awaiter，挂起时被销毁会撤销等待
+struct CancellableEventAwaiter
+{
+    static constexpr bool kCancelOnDestroy = true;
+    ManualEvent* event_;
+    bool parked_ = false;
+
+    ~CancellableEventAwaiter()
+    {
+        if(parked_) event_->waiter_ = nullptr;
+    }
+    bool await_ready(){return false;}
+    void await_suspend(std::coroutine_handle<>h){event_->waiter_ = h;parked_ = true;}
+    void await_resume(){parked_ = false;}
+};
+
+Task<int> waitValue(ManualEvent& event,int value,[[maybe_unused]] std::shared_ptr<int> guard = nullptr)
+{
+    co_await EventAwaiter{&event};
+    co_return value;
+}
+
+//在Task中逐层等待可以取消的awaiter
+Task<int> waitCancellable(ManualEvent& event,int value,[[maybe_unused]] std::shared_ptr<int> guard)
+{
+    co_await CancellableEventAwaiter{&event};
+    co_return value;
+}
+
+Task<int> waitNested(ManualEvent& event,int value,std::shared_ptr<int> guard)
+{
+    int result = co_await waitCancellable(event,value,std::move(guard));
+    co_return result;
+}
+
+//切换到线程池之后阻塞，直到测试允许它继续
+Task<int> blockOnPool(ThreadPool& pool,std::promise<void>& started,std::shared_future<void> release,[[maybe_unused]] std::shared_ptr<int> guard)
+{
+    co_await pool.switchThread();
+    started.set_value();
+    release.wait();
+    co_return 1;
+}
+
+Task<std::string> readyString(std::string value)
+{
+    co_return value;
+}
+
+Task<> throwAfterWait(ManualEvent& event)
+{
+    co_await EventAwaiter{&event};
+    throw std::runtime_error("branch failure");
+}
+
+Task<> storeAll(ManualEvent& first,ManualEvent& second,std::tuple<int,std::string,int>& result)
+{
+    auto [a,b,c] = co_await whenAll(waitValue(first,1),readyString("two"),waitValue(second,3));
+    result = {a,b,c};
+}
+
+Task<> storeReady(int& result)
+{
+    auto [a,b] = co_await whenAll(readyString("x"),readyString("yz"));
+    result = a.size()+b.size();
+}
+
+Task<> storeRange(std::vector<ManualEvent>& events,std::vector<int>& result)
+{
+    std::vector<Task<int>> tasks;
+    for(size_t i=0;i<events.size();++i) tasks.push_back(waitValue(events[i],int(i)));
+    result = co_await whenAll(std::move(tasks));
+}
+
+Task<> catchAll(ManualEvent& first,ManualEvent& second,std::string& message)
+{
+    try
+    {
+        co_await whenAll(throwAfterWait(first),waitValue(second,1));
+    }
+    catch(const std::runtime_error& e)
+    {
+        message = e.what();
+    }
+}
+
+Task<> storeAny(ManualEvent& first,ManualEvent& second,std::shared_ptr<int> guard,size_t& index,int& value)
+{
+    auto result = co_await whenAny(waitValue(first,1,std::move(guard)),waitValue(second,2));
+    index = result.index();
+    value = index==0?std::get<0>(result):std::get<1>(result);
+}
+
+Task<> storeAnyNested(ManualEvent& first,ManualEvent& second,std::shared_ptr<int> guard,size_t& index)
+{
+    auto result = co_await whenAny(waitNested(first,1,std::move(guard)),waitValue(second,2));
+    index = result.index();
+}
+
+Task<> storeAnyOnPool(ThreadPool& pool,std::promise<void>& started,std::shared_future<void> release,std::shared_ptr<int> guard,
+    ManualEvent& event,size_t& index)
+{
+    auto result = co_await whenAny(blockOnPool(pool,started,release,std::move(guard)),waitValue(event,2));
+    index = result.index();
+}
+
+Task<> allWithPool(ThreadPool& pool,std::promise<void>& started,std::shared_future<void> release,std::shared_ptr<int> guard,
+    ManualEvent& event)
+{
+    co_await whenAll(blockOnPool(pool,started,release,std::move(guard)),waitValue(event,2));
+}
+
+//等待guard被释放，也就是分支的协程帧被销毁
+bool waitExpired(const std::weak_ptr<int>& weak)
+{
+    for(int i=0;i<500&&!weak.expired();++i) std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    return weak.expired();
+}
+
+Task<> storeAnyDetached(ManualEvent& first,ManualEvent& second,size_t& index)
+{
+    auto result = co_await whenAny(EventAwaiter{&first},waitValue(second,2));
+    index = result.index();
+}
+
+Task<> storeAnyReady(ManualEvent& event,std::shared_ptr<int> guard,size_t& index)
+{
+    auto result = co_await whenAny(readyString("now"),waitValue(event,1,std::move(guard)));
+    index = result.index();
+}
+
+//两个分支都切换到线程池中执行，等待的协程在最后完成的分支所在的线程中恢复
+Task<> allOnPool(ThreadPool& pool,std::promise<std::pair<bool,bool>>& done)
+{
+    auto [a,b] = co_await whenAll(pool.switchThread(),pool.switchThread());
+    done.set_value({a,b});
+}
+
+}
+
+//所有分支完成之后按照参数的顺序返回结果
+TEST(TaskCombinatorsTest, WhenAllCollectsResultsInOrder)
+{
+    ManualEvent first,second;
+    std::tuple<int,std::string,int> result;
+    auto task = storeAll(first,second,result);
+    task.resume();
+    EXPECT_FALSE(task.done());
+
+    second.set();
+    EXPECT_FALSE(task.done());
+    first.set();
+    EXPECT_TRUE(task.done());
+    EXPECT_EQ(result, std::make_tuple(1,std::string("two"),3));
+}
+
+//所有分支都同步完成时不挂起
+TEST(TaskCombinatorsTest, WhenAllCompletesSynchronously)
+{
+    int result = 0;
+    auto task = storeReady(result);
+    task.resume();
+    EXPECT_TRUE(task.done());
+    EXPECT_EQ(result, 3);
+}
+
+TEST(TaskCombinatorsTest, WhenAllOverRange)
+{
+    std::vector<ManualEvent> events(5);
+    std::vector<int> result;
+    auto task = storeRange(events,result);
+    task.resume();
+    for(size_t i=events.size();i>0;--i) events[i-1].set();
+    EXPECT_TRUE(task.done());
+    EXPECT_EQ(result, std::vector<int>({0,1,2,3,4}));
+}
+
+//分支的异常在所有分支完成之后重新抛出
+TEST(TaskCombinatorsTest, WhenAllRethrowsBranchException)
+{
+    ManualEvent first,second;
+    std::string message;
+    auto task = catchAll(first,second,message);
+    task.resume();
+    first.set();
+    EXPECT_TRUE(message.empty());
+    second.set();
+    EXPECT_TRUE(task.done());
+    EXPECT_EQ(message, "branch failure");
+}
+
+//第一个完成的分支决定结果，在同一个loop中挂起在可以取消的awaiter上的Task分支被立即销毁
+TEST(TaskCombinatorsTest, WhenAnyCancelsLosingTask)
+{
+    IoUringLoopParams params{256,32,1,4096,16};
+    IoUringLoopThread loop_thread(nullptr,params,"any");
+    IoUringLoop* loop = loop_thread.startLoop();
+
+    ManualEvent first,second;
+    auto guard = std::make_shared<int>(0);
+    std::weak_ptr<int> weak = guard;
+    size_t index = 9;
+    std::promise<void> done;
+    loop->runInLoop([&](){
+        auto task = storeAnyNested(first,second,std::move(guard),index);
+        task.resume();
+        EXPECT_FALSE(weak.expired());
+
+        second.set();
+        EXPECT_TRUE(task.done());
+        EXPECT_EQ(index, 1u);
+        EXPECT_TRUE(weak.expired());
+        EXPECT_FALSE(first.waiter_);
+        done.set_value();
+    });
+    done.get_future().wait();
+}
+
+//挂起在不能取消的awaiter上的Task分支被分离，之后恢复时执行完毕并自己销毁
+TEST(TaskCombinatorsTest, WhenAnyDetachesTaskOnNonCancellableAwaiter)
+{
+    ManualEvent first,second;
+    auto guard = std::make_shared<int>(0);
+    std::weak_ptr<int> weak = guard;
+    size_t index = 9;
+    int value = 0;
+    auto task = storeAny(first,second,std::move(guard),index,value);
+    task.resume();
+
+    second.set();
+    EXPECT_TRUE(task.done());
+    EXPECT_EQ(index, 1u);
+    EXPECT_EQ(value, 2);
+    EXPECT_FALSE(weak.expired());
+
+    ASSERT_TRUE(first.waiter_);
+    first.set();
+    EXPECT_TRUE(weak.expired());
+}
+
+//Task分支在线程池中执行时另一个分支完成，这个分支被分离，在线程池中执行完毕之后自己销毁
+TEST(TaskCombinatorsTest, WhenAnyDetachesTaskOnSwitchThread)
+{
+    ThreadPool pool(1,16);
+    ManualEvent event;
+    std::promise<void> started;
+    std::promise<void> release;
+    auto guard = std::make_shared<int>(0);
+    std::weak_ptr<int> weak = guard;
+    size_t index = 9;
+    auto task = storeAnyOnPool(pool,started,release.get_future().share(),std::move(guard),event,index);
+    task.resume();
+    started.get_future().wait();
+
+    event.set();
+    EXPECT_TRUE(task.done());
+    EXPECT_EQ(index, 1u);
+    EXPECT_FALSE(weak.expired());
+
+    release.set_value();
+    EXPECT_TRUE(waitExpired(weak));
+}
+
+//等待的协程在whenAll中被销毁时，正在线程池中执行的分支被分离，不会和工作线程同时销毁
+TEST(TaskCombinatorsTest, DestroyingWaiterDetachesRunningBranch)
+{
+    ThreadPool pool(1,16);
+    ManualEvent event;
+    std::promise<void> started;
+    std::promise<void> release;
+    auto guard = std::make_shared<int>(0);
+    std::weak_ptr<int> weak = guard;
+    auto task = allWithPool(pool,started,release.get_future().share(),std::move(guard),event);
+    task.resume();
+    started.get_future().wait();
+
+    task.destroy();
+    EXPECT_FALSE(weak.expired());
+
+    release.set_value();
+    EXPECT_TRUE(waitExpired(weak));
+    //另一个分支挂起在不能取消的awaiter上，也被分离
+    ASSERT_TRUE(event.waiter_);
+    event.set();
+}
+
+//同步完成的分支获胜时，后面的分支不会开始
+TEST(TaskCombinatorsTest, WhenAnySkipsBranchesAfterReadyWinner)
+{
+    ManualEvent event;
+    auto guard = std::make_shared<int>(0);
+    std::weak_ptr<int> weak = guard;
+    size_t index = 9;
+    auto task = storeAnyReady(event,std::move(guard),index);
+    task.resume();
+    EXPECT_TRUE(task.done());
+    EXPECT_EQ(index, 0u);
+    EXPECT_FALSE(event.waiter_);
+    EXPECT_TRUE(weak.expired());
+}
+
+//不能取消的分支被分离，之后恢复时执行完毕并自己销毁
+TEST(TaskCombinatorsTest, WhenAnyDetachesNonCancellableBranch)
+{
+    ManualEvent first,second;
+    size_t index = 9;
+    auto task = storeAnyDetached(first,second,index);
+    task.resume();
+    second.set();
+    EXPECT_TRUE(task.done());
+    EXPECT_EQ(index, 1u);
+
+    ASSERT_TRUE(first.waiter_);
+    task.destroy();
+    first.set();
+}
+
+TEST(TaskCombinatorsTest, WhenAllWithSwitchThread)
+{
+    ThreadPool pool(2,16);
+    std::promise<std::pair<bool,bool>> done;
+    auto result = done.get_future();
+    auto task = allOnPool(pool,done);
+    task.resume();
+    ASSERT_EQ(result.wait_for(std::chrono::seconds(5)), std::future_status::ready);
+    EXPECT_EQ(result.get(), std::make_pair(true,true));
+    //task在线程池中执行完毕之后才能销毁
+    while(!task.done()) std::this_thread::yield();
+}
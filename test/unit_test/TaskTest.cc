@@ -0,0 +1,163 @@
+#include "test_helper.h"
+
+#include "Task.hpp"
+
+#include <stdexcept>
+#include <memory>
+
+namespace
+{
+
+//手动恢复的awaiter，模拟挂起在连接上等待数据
+struct ManualEvent
+{
+    std::coroutine_handle<> waiter_;
+
+    bool await_ready(){return false;}
+    void await_suspend(std::coroutine_handle<>h){waiter_ = h;}
+    void await_resume(){}
+
+    void set()
+    {
+        auto h = std::exchange(waiter_,nullptr);
+        h.resume();
+    }
+};
+
+Task<int> addOne(int value)
+{
+    co_return value+1;
+}
+
+Task<int> chain(int depth)
+{
+    if(depth==0) co_return 0;
+    int value = co_await chain(depth-1);
+    co_return value+1;
+}
+
+Task<std::unique_ptr<int>> waitAndMake(ManualEvent& event,int value)
+{
+    co_await event;
+    co_return std::make_unique<int>(value);
+}
+
+Task<> throwAfterWait(ManualEvent& event)
+{
+    co_await event;
+    throw std::runtime_error("inner failure");
+}
+
+Task<int> nothing()
+{
+    co_return 7;
+}
+
+Task<> storeAddOne(int& result)
+{
+    result = co_await addOne(41);
+}
+
+Task<> storeMade(ManualEvent& event,int& result)
+{
+    auto ptr = co_await waitAndMake(event,5);
+    result = *ptr;
+}
+
+Task<> catchInner(ManualEvent& event,std::string& message)
+{
+    try
+    {
+        co_await throwAfterWait(event);
+    }
+    catch(const std::runtime_error& e)
+    {
+        message = e.what();
+    }
+}
+
+Task<> storeChain(int depth,int& result)
+{
+    result = co_await chain(depth);
+}
+
+Task<> holdAndWait(ManualEvent& event,[[maybe_unused]] std::shared_ptr<int> held)
+{
+    co_await event;
+}
+
+Task<> awaitHolder(ManualEvent& event,std::shared_ptr<int> held)
+{
+    co_await holdAndWait(event,std::move(held));
+}
+
+}
+
+TEST(TaskTest, AwaitReturnsValue)
+{
+    int result = 0;
+    auto outer = storeAddOne(result);
+    outer.resume();
+    EXPECT_TRUE(outer.done());
+    EXPECT_EQ(result, 42);
+}
+
+//内层的协程挂起之后由外部恢复，执行完毕后直接恢复外层的协程
+TEST(TaskTest, SuspendedChildResumesParent)
+{
+    ManualEvent event;
+    int result = 0;
+    auto outer = storeMade(event,result);
+    outer.resume();
+    EXPECT_FALSE(outer.done());
+    ASSERT_TRUE(event.waiter_);
+
+    event.set();
+    EXPECT_TRUE(outer.done());
+    EXPECT_EQ(result, 5);
+}
+
+TEST(TaskTest, ExceptionPropagatesToAwaiter)
+{
+    ManualEvent event;
+    std::string message;
+    auto outer = catchInner(event,message);
+    outer.resume();
+    event.set();
+    EXPECT_TRUE(outer.done());
+    EXPECT_EQ(message, "inner failure");
+}
+
+//逐层co_await的调用链，每一层的返回值依次传回最外层
+//不开启优化时gcc不会把对称转移编译成尾调用，所以这里的深度保持在调试构建的栈也能容纳的范围，更深的调用链见TaskChainBench
+TEST(TaskTest, DeepChainReturnsThroughEveryLevel)
+{
+    int result = 0;
+    auto outer = storeChain(2000,result);
+    outer.resume();
+    EXPECT_TRUE(outer.done());
+    EXPECT_EQ(result, 2000);
+}
+
+//外层的协程销毁时，挂起中的内层协程一起销毁
+TEST(TaskTest, DestroyingParentDestroysSuspendedChild)
+{
+    ManualEvent event;
+    auto guard = std::make_shared<int>(0);
+    std::weak_ptr<int> weak = guard;
+    {
+        auto outer = awaitHolder(event,std::move(guard));
+        outer.resume();
+        EXPECT_FALSE(weak.expired());
+    }
+    EXPECT_TRUE(weak.expired());
+}
+
+//没有被等待的Task仍然可以手动执行并读取返回值
+TEST(TaskTest, TopLevelTaskKeepsReturnValue)
+{
+    auto task = nothing();
+    task.resume();
+    EXPECT_TRUE(task.done());
+    EXPECT_EQ(task.returnValue(), 7);
+}
@@ -9,6 +9,8 @@
 #include "TcpConnection.h"
 #include "Acceptor.h"
 #include "IoUringLoop.h"
+#include "TaskCombinators.hpp"
+#include "ThreadPool.h"
 
 
 Task<> echo_server(std::shared_ptr<TcpConnection> conn)
@@ -84,6 +86,9 @@ protected:
                     std::cout << "Connection closed: " << c->getName() << std::endl;
                 });
 
+                conn->setZeroCopyThreshold(zero_copy_threshold_);
+                conn->setMaxInflightWrites(max_inflight_writes_);
+
                 // 启动业务协程并绑定到连接
                 conn->Established(echo_server(conn));
 
@@ -117,6 +122,8 @@ protected:
         loop_thread.reset();
         conns.clear();
         port_++;
+        zero_copy_threshold_ = 0;
+        max_inflight_writes_ = 1;
     }
 
 
@@ -125,6 +132,8 @@ protected:
     std::unique_ptr<std::thread> loop_thread;
     std::vector<std::shared_ptr<TcpConnection>>conns;
     inline static uint16_t port_ = 8888;
+    inline static size_t zero_copy_threshold_ = 0;  //新连接的零拷贝发送阈值
+    inline static size_t max_inflight_writes_ = 1;  //新连接同时在内核中的发送请求数量
 };
 
 TEST_F(TcpConnectionTest, EchoFunctionality)
@@ -243,3 +252,652 @@ TEST_F(TcpConnectionTest, LargeDataEcho)
 
 
 
+
+TEST_F(TcpConnectionTest, LargeDataEchoZeroCopy)
+{
+    zero_copy_threshold_ = 1024;
+
+    int client_fd = socket(AF_INET, SOCK_STREAM, 0);
+    ASSERT_GT(client_fd, 0);
+
+    struct sockaddr_in server_addr;
+    memset(&server_addr, 0, sizeof(server_addr));
+    server_addr.sin_family = AF_INET;
+    server_addr.sin_port = htons(port_);
+    inet_pton(AF_INET, "127.0.0.1", &server_addr.sin_addr);
+
+    int ret = -1;
+    for(int i=0; i<20; ++i) {
+        ret = connect(client_fd, (struct sockaddr*)&server_addr, sizeof(server_addr));
+        if(ret == 0) break;
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+    ASSERT_EQ(ret, 0) << "Failed to connect";
+
+    const size_t data_size = 4 * 1024 * 1024;
+    std::string send_data(data_size, 'A');
+    for(size_t i=0; i<data_size; ++i) {
+        send_data[i] = (char)('A' + (i*7 % 26));
+    }
+
+    std::thread sender([&]() {
+        size_t sent = 0;
+        while(sent < data_size) {
+            ssize_t n = ::send(client_fd, send_data.c_str() + sent, data_size - sent, 0);
+            if(n <= 0) break;
+            sent += n;
+        }
+    });
+
+    std::string recv_data;
+    recv_data.reserve(data_size);
+    char buf[65536];
+    while(recv_data.size() < data_size) {
+        ssize_t n = ::recv(client_fd, buf, sizeof(buf), 0);
+        if(n <= 0) break;
+        recv_data.append(buf, n);
+    }
+    sender.join();
+
+    //零拷贝发送的数据在通知返回之前不能被释放或者覆盖，否则这里的数据会出错
+    ASSERT_EQ(recv_data.size(), data_size);
+    EXPECT_EQ(recv_data, send_data);
+
+    EXPECT_EQ(close(client_fd),0);
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    loop->quit();
+    loop_thread->join();
+
+    ASSERT_EQ(conns.size(), 1u);
+    auto w_ctx = conns[0]->getWriteContext();
+    EXPECT_GT(w_ctx->zc_sends_, 0u);
+    //所有的通知都已经返回，请求都被回收
+    EXPECT_EQ(w_ctx->zc_free_.size(), w_ctx->zc_contexts_.size());
+}
+
+TEST_F(TcpConnectionTest, LargeDataEchoPipelined)
+{
+    max_inflight_writes_ = 4;
+
+    int client_fd = socket(AF_INET, SOCK_STREAM, 0);
+    ASSERT_GT(client_fd, 0);
+
+    struct sockaddr_in server_addr;
+    memset(&server_addr, 0, sizeof(server_addr));
+    server_addr.sin_family = AF_INET;
+    server_addr.sin_port = htons(port_);
+    inet_pton(AF_INET, "127.0.0.1", &server_addr.sin_addr);
+
+    int ret = -1;
+    for(int i=0; i<20; ++i) {
+        ret = connect(client_fd, (struct sockaddr*)&server_addr, sizeof(server_addr));
+        if(ret == 0) break;
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+    ASSERT_EQ(ret, 0) << "Failed to connect";
+
+    const size_t data_size = 8 * 1024 * 1024;
+    std::string send_data(data_size, 'A');
+    for(size_t i=0; i<data_size; ++i) {
+        send_data[i] = (char)('A' + (i*13 % 26));
+    }
+
+    std::thread sender([&]() {
+        size_t sent = 0;
+        while(sent < data_size) {
+            ssize_t n = ::send(client_fd, send_data.c_str() + sent, data_size - sent, 0);
+            if(n <= 0) break;
+            sent += n;
+        }
+    });
+
+    //先不读取，让服务端的输出缓冲区积压数据，多个请求链接在一起发送
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    std::string recv_data;
+    recv_data.reserve(data_size);
+    char buf[65536];
+    while(recv_data.size() < data_size) {
+        ssize_t n = ::recv(client_fd, buf, sizeof(buf), 0);
+        if(n <= 0) break;
+        recv_data.append(buf, n);
+    }
+    sender.join();
+
+    //链接的请求之间不能乱序，部分写入之后要从正确的位置继续发送
+    ASSERT_EQ(recv_data.size(), data_size);
+    EXPECT_EQ(recv_data, send_data);
+
+    EXPECT_EQ(close(client_fd),0);
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    loop->quit();
+    loop_thread->join();
+
+    ASSERT_EQ(conns.size(), 1u);
+    auto w_ctx = conns[0]->getWriteContext();
+    EXPECT_GT(w_ctx->ops_.size(), 1u);
+    EXPECT_EQ(w_ctx->chain_len_, 0u);
+}
+
+
+//每收到一个请求就分两次发送头部和数据体
+Task<> header_body_server(std::shared_ptr<TcpConnection> conn)
+{
+    while(true)
+    {
+        int size = co_await conn->PrepareToRead();
+        if(size<0) break;
+        conn->retrieve(size);
+        if(!co_await conn->send(std::string("HEAD"))) break;
+        if(!co_await conn->send(std::string(1000,'b'))) break;
+    }
+}
+
+//头部和数据体由调用者持有，轮流使用iovec、string_view和shared_ptr的发送方式，都不需要拼接
+Task<> scatter_gather_server(std::shared_ptr<TcpConnection> conn)
+{
+    static const char head[] = "HEAD";
+    auto body = std::make_shared<const std::string>(1000,'b');
+    size_t round = 0;
+    while(true)
+    {
+        int size = co_await conn->PrepareToRead();
+        if(size<0) break;
+        conn->retrieve(size);
+        bool ok = false;
+        iovec iov[2] = {{(void*)head,4},{(void*)body->data(),body->size()}};
+        switch(round++%3)
+        {
+        case 0:
+            ok = co_await conn->send(std::span<const iovec>(iov),body);
+            break;
+        case 1:
+            ok = co_await conn->send(std::string_view(head,4),nullptr)&&co_await conn->send(body);
+            break;
+        default:
+            //没有guard时拷贝数据
+            ok = co_await conn->send(std::span<const iovec>(iov));
+            break;
+        }
+        if(!ok) break;
+    }
+}
+
+//等待一个请求，连接出错时返回false
+Task<bool> read_request(std::shared_ptr<TcpConnection> conn)
+{
+    int size = co_await conn->PrepareToRead();
+    if(size<0) co_return false;
+    conn->retrieve(size);
+    co_return true;
+}
+
+Task<bool> send_reply(std::shared_ptr<TcpConnection> conn)
+{
+    bool ok = co_await conn->send(std::string("HEAD"));
+    if(ok) ok = co_await conn->send(std::string(1000,'b'));
+    co_return ok;
+}
+
+//和header_body_server相同，但是读取和发送都在被等待的子协程中，子协程挂起在连接上，恢复之后直接返回外层的协程
+Task<> nested_header_body_server(std::shared_ptr<TcpConnection> conn)
+{
+    while(true)
+    {
+        bool ok = co_await read_request(conn);
+        if(!ok) break;
+        ok = co_await send_reply(conn);
+        if(!ok) break;
+    }
+}
+
+//头部和数据体作为whenAll的两个分支发送，按照参数的顺序追加，同一次循环中仍然合并成一个发送请求
+Task<> when_all_server(std::shared_ptr<TcpConnection> conn)
+{
+    while(true)
+    {
+        int size = co_await conn->PrepareToRead();
+        if(size<0) break;
+        conn->retrieve(size);
+        auto [head_ok,body_ok] = co_await whenAll(conn->send(std::string("HEAD")),conn->send(std::string(1000,'b')));
+        if(!head_ok||!body_ok) break;
+    }
+}
+
+//通过loop的任务队列恢复协程，不能取消
+struct LoopTickAwaiter
+{
+    IoUringLoop* loop_;
+
+    bool await_ready(){return false;}
+    void await_suspend(std::coroutine_handle<>h){loop_->queueInLoop([h](){h.resume();});}
+    void await_resume(){}
+};
+
+//等待请求和下一次循环之间先发生的一个，tick先发生时读取的分支被取消，之后重新等待请求
+size_t cancelled_reads = 0;
+
+Task<> when_any_server(std::shared_ptr<TcpConnection> conn)
+{
+    while(true)
+    {
+        auto first = co_await whenAny(conn->PrepareToRead(),LoopTickAwaiter{conn->getLoop()});
+        int size = 0;
+        if(first.index()==0)
+        {
+            size = std::get<0>(first);
+        }
+        else
+        {
+            //被取消的分支已经撤销了在连接上的等待
+            if(conn->getReadContext()->read_handle_) break;
+            cancelled_reads++;
+            size = co_await conn->PrepareToRead();
+        }
+        if(size<0) break;
+        conn->retrieve(size);
+        bool ok = co_await conn->send(std::string("HEAD")+std::string(1000,'b'));
+        if(!ok) break;
+    }
+}
+
+//读取和发送都在线程池中调用，awaiter跨线程把协程交回loop，在loop中读写之后恢复
+ThreadPool* offload_pool = nullptr;
+
+Task<> offload_header_body_server(std::shared_ptr<TcpConnection> conn)
+{
+    while(true)
+    {
+        co_await offload_pool->switchThread();
+        int size = co_await conn->PrepareToRead();
+        if(size<0) break;
+        conn->retrieve(size);
+        co_await offload_pool->switchThread();
+        if(!co_await conn->send(std::string("HEAD"))) break;
+        if(!co_await conn->send(std::string(1000,'b'))) break;
+    }
+}
+
+//在loop线程中监听端口，每个连接按照选项配置之后交给handler_处理
+//选项在连接建立时才读取，测试中可以在SetUp之后修改，TearDown时恢复默认值
+class LoopbackConnectionTest: public ::testing::Test
+{
+protected:
+    void SetUp()override
+    {
+        std::promise<void> p;
+        auto f = p.get_future();
+
+        loop_thread = std::make_unique<std::thread>([&, p = std::move(p)]() mutable {
+            loop = std::make_unique<IoUringLoop>(1024,32,1,4096,32);
+            InetAddress listenAddr(port_);
+            acceptor = std::make_unique<Acceptor>(loop.get(), listenAddr, true);
+            acceptor->setConnetionCallback([&](int sockfd, const InetAddress& peerAddr) {
+                loop->setDeferredResume(deferred_resume_);
+                loop->setResumeBudget(resume_budget_);
+                auto conn = std::make_shared<TcpConnection>(
+                    "Conn-" + std::to_string(sockfd),
+                    *loop,
+                    sockfd,
+                    InetAddress(0),
+                    peerAddr,
+                    4096 * 16,
+                    16,
+                    output_high_water_mark_
+                );
+                conn->setLowLatencySend(low_latency_);
+                conn->setFileSplice(file_splice_);
+                conn->Established(handler_(conn));
+                conns.emplace_back(conn);
+            });
+            acceptor->listen();
+            p.set_value();
+            loop->loop();
+        });
+        f.wait();
+    }
+
+    void TearDown()override
+    {
+        if(loop) loop->quit();
+        if(loop_thread && loop_thread->joinable())
+        {
+            loop_thread->join();
+        }
+        acceptor.reset();
+        conns.clear();
+        loop.reset();
+        loop_thread.reset();
+        port_++;
+        handler_ = nullptr;
+        output_high_water_mark_ = 1024 * 1024;
+        low_latency_ = false;
+        file_splice_ = true;
+        deferred_resume_ = false;
+        resume_budget_ = IoUringLoop::kDefaultResumeBudget;
+    }
+
+    //连接到服务器，返回客户端的fd
+    int connectClient()
+    {
+        int client_fd = socket(AF_INET, SOCK_STREAM, 0);
+        EXPECT_GT(client_fd, 0);
+
+        struct sockaddr_in server_addr;
+        memset(&server_addr, 0, sizeof(server_addr));
+        server_addr.sin_family = AF_INET;
+        server_addr.sin_port = htons(port_);
+        inet_pton(AF_INET, "127.0.0.1", &server_addr.sin_addr);
+
+        int ret = -1;
+        for(int i=0; i<20; ++i) {
+            ret = connect(client_fd, (struct sockaddr*)&server_addr, sizeof(server_addr));
+            if(ret == 0) break;
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        }
+        EXPECT_EQ(ret, 0) << "Failed to connect";
+        return client_fd;
+    }
+
+    //在loop线程中执行f并等待它完成，用于读取连接的统计信息
+    template <typename F>
+    void runInLoopAndWait(F&& f)
+    {
+        std::promise<void> done;
+        loop->runInLoop([&](){
+            f();
+            done.set_value();
+        });
+        done.get_future().wait();
+    }
+
+    //关闭客户端，等待服务端处理完连接关闭
+    void closeClient(int client_fd)
+    {
+        EXPECT_EQ(close(client_fd),0);
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+
+    std::unique_ptr<Acceptor> acceptor;
+    std::unique_ptr<IoUringLoop> loop;
+    std::unique_ptr<std::thread> loop_thread;
+    std::vector<std::shared_ptr<TcpConnection>>conns;
+    inline static uint16_t port_ = 9388;
+    inline static Task<>(*handler_)(std::shared_ptr<TcpConnection>) = nullptr;
+    inline static size_t output_high_water_mark_ = 1024 * 1024;
+    inline static bool low_latency_ = false;
+    inline static bool file_splice_ = true;
+    inline static bool deferred_resume_ = false;
+    inline static size_t resume_budget_ = IoUringLoop::kDefaultResumeBudget;
+};
+
+class WriteCorkingTest: public LoopbackConnectionTest
+{
+protected:
+    void SetUp()override
+    {
+        handler_ = header_body_server;
+        LoopbackConnectionTest::SetUp();
+    }
+
+    //发送rounds个请求，每次都等待完整的回复，返回服务端提交的发送请求的数量
+    size_t runRounds(size_t rounds)
+    {
+        int client_fd = connectClient();
+
+        const std::string expected = "HEAD"+std::string(1000,'b');
+        for(size_t i=0;i<rounds;++i)
+        {
+            EXPECT_EQ(::send(client_fd, "r", 1, 0), 1);
+            std::string recv_data;
+            char buf[4096];
+            while(recv_data.size()<expected.size())
+            {
+                ssize_t n = ::recv(client_fd, buf, sizeof(buf), 0);
+                if(n<=0) break;
+                recv_data.append(buf, n);
+            }
+            EXPECT_EQ(recv_data, expected);
+        }
+
+        size_t ops = 0;
+        runInLoopAndWait([&](){
+            ops = conns.at(0)->getWriteContext()->submitted_ops_;
+        });
+
+        closeClient(client_fd);
+        return ops;
+    }
+};
+
+//同一次循环中的头部和数据体合并成一个发送请求
+TEST_F(WriteCorkingTest, HeaderAndBodyInOneWrite)
+{
+    EXPECT_EQ(runRounds(50), 50u);
+}
+
+//低延迟模式下第一次发送立即提交，数据体要等到头部的请求返回之后再提交
+TEST_F(WriteCorkingTest, LowLatencyWritesImmediately)
+{
+    low_latency_ = true;
+    EXPECT_EQ(runRounds(50), 100u);
+}
+
+//多段数据和调用者持有的数据和std::string的发送结果相同，同一次循环中仍然合并成一个发送请求
+TEST_F(WriteCorkingTest, ScatterGatherAndGuardedSends)
+{
+    handler_ = scatter_gather_server;
+    EXPECT_EQ(runRounds(51), 51u);
+}
+
+//读取和发送在co_await的子协程中进行，结果和在一个协程中相同
+TEST_F(WriteCorkingTest, NestedTasksAwaitConnection)
+{
+    handler_ = nested_header_body_server;
+    EXPECT_EQ(runRounds(50), 50u);
+}
+
+TEST_F(WriteCorkingTest, WhenAllSendsBranchesInOrder)
+{
+    handler_ = when_all_server;
+    EXPECT_EQ(runRounds(50), 50u);
+}
+
+TEST_F(WriteCorkingTest, WhenAnyCancelsPendingRead)
+{
+    handler_ = when_any_server;
+    cancelled_reads = 0;
+    EXPECT_EQ(runRounds(50), 50u);
+    EXPECT_GT(cancelled_reads, 0u);
+}
+
+//延迟恢复时协程在这一批cqe之后恢复，同一次循环中的发送仍然合并
+TEST_F(WriteCorkingTest, DeferredResumeKeepsCorking)
+{
+    deferred_resume_ = true;
+    resume_budget_ = 1;
+    EXPECT_EQ(runRounds(50), 50u);
+}
+
+TEST_F(WriteCorkingTest, DeferredResumeWithWhenAny)
+{
+    deferred_resume_ = true;
+    handler_ = when_any_server;
+    cancelled_reads = 0;
+    EXPECT_EQ(runRounds(50), 50u);
+    EXPECT_GT(cancelled_reads, 0u);
+}
+
+//在工作线程中发送的头部在loop中追加，协程在同一次循环中恢复之后追加数据体，仍然合并成一个发送请求
+TEST_F(WriteCorkingTest, OffloadedIoResumesOnLoop)
+{
+    ThreadPool pool(1,64);
+    offload_pool = &pool;
+    handler_ = offload_header_body_server;
+    EXPECT_EQ(runRounds(50), 50u);
+}
+
+//收到请求之后在内存数据之间交替发送文件中的两段数据
+Task<> file_server(std::shared_ptr<TcpConnection> conn,int file_fd)
+{
+    while(true)
+    {
+        int size = co_await conn->PrepareToRead();
+        if(size<0) break;
+        conn->retrieve(size);
+        bool ok = co_await conn->send(std::string("HDR"))
+            &&co_await conn->sendFile(file_fd,1000,3*1024*1024)
+            &&co_await conn->send(std::string("MID"))
+            &&co_await conn->sendFile(file_fd,5,100)
+            &&co_await conn->send(std::string("TAIL"));
+        if(!ok) break;
+    }
+}
+
+class FileSendTest: public LoopbackConnectionTest
+{
+protected:
+    void SetUp()override
+    {
+        //文件中每个位置的内容都不同，错位或者重复发送都能检查出来
+        char path[] = "/tmp/file_send_test_XXXXXX";
+        file_fd_ = ::mkstemp(path);
+        ASSERT_GE(file_fd_, 0);
+        ::unlink(path);
+        content_.resize(4*1024*1024);
+        for(size_t i=0;i<content_.size();++i) content_[i] = char('a'+(i*7+i/4096)%26);
+        ASSERT_EQ(::write(file_fd_, content_.data(), content_.size()), ssize_t(content_.size()));
+
+        handler_ = [](std::shared_ptr<TcpConnection> conn){return file_server(std::move(conn),file_fd_);};
+        LoopbackConnectionTest::SetUp();
+    }
+
+    void TearDown()override
+    {
+        LoopbackConnectionTest::TearDown();
+        if(file_fd_>=0) ::close(file_fd_);
+        file_fd_ = -1;
+    }
+
+    //发送rounds个请求并检查回复，返回服务端通过splice和内存中转发送的字节数
+    std::pair<size_t,size_t> runRounds(size_t rounds)
+    {
+        int client_fd = connectClient();
+
+        const std::string expected = "HDR"+content_.substr(1000,3*1024*1024)+"MID"+content_.substr(5,100)+"TAIL";
+        for(size_t i=0;i<rounds;++i)
+        {
+            EXPECT_EQ(::send(client_fd, "r", 1, 0), 1);
+            std::string recv_data;
+            char buf[64*1024];
+            while(recv_data.size()<expected.size())
+            {
+                ssize_t n = ::recv(client_fd, buf, std::min(sizeof(buf),expected.size()-recv_data.size()), 0);
+                if(n<=0) break;
+                recv_data.append(buf, n);
+            }
+            EXPECT_TRUE(recv_data==expected) << "round " << i << " received " << recv_data.size() << " bytes";
+        }
+
+        std::pair<size_t,size_t> bytes;
+        runInLoopAndWait([&](){
+            auto& file_send = conns.at(0)->getWriteContext()->file_send_;
+            if(file_send) bytes = {file_send->spliced_bytes_,file_send->copied_bytes_};
+        });
+
+        closeClient(client_fd);
+        return bytes;
+    }
+
+    std::string content_;
+    inline static int file_fd_ = -1;
+};
+
+//文件分片通过管道splice到socket，和内存中的数据按照追加的顺序发送
+TEST_F(FileSendTest, SpliceKeepsOrderWithMemoryData)
+{
+    auto [spliced,copied] = runRounds(3);
+    EXPECT_EQ(spliced, 3*(3*1024*1024+100u));
+    EXPECT_EQ(copied, 0u);
+}
+
+//关闭splice时文件读入输出内存池再发送，结果相同
+TEST_F(FileSendTest, ReadFallbackKeepsOrderWithMemoryData)
+{
+    file_splice_ = false;
+    auto [spliced,copied] = runRounds(3);
+    EXPECT_EQ(spliced, 0u);
+    EXPECT_EQ(copied, 3*(3*1024*1024+100u));
+}
+
+//收到请求之后连续发送多条大的普通消息，最后发送一条高优先级的消息
+Task<> priority_server(std::shared_ptr<TcpConnection> conn)
+{
+    while(true)
+    {
+        int size = co_await conn->PrepareToRead();
+        if(size<0) break;
+        conn->retrieve(size);
+        bool ok = true;
+        for(int i=0;ok&&i<16;++i)
+        {
+            ok = co_await conn->send(std::string(256*1024,char('a'+i)));
+        }
+        ok = ok&&co_await conn->send(std::string("PING"),Priority::High);
+        if(!ok) break;
+    }
+}
+
+class PrioritySendTest: public LoopbackConnectionTest
+{
+protected:
+    void SetUp()override
+    {
+        handler_ = priority_server;
+        //高水位线大于所有的数据，发送的协程不会挂起
+        output_high_water_mark_ = 64 * 1024 * 1024;
+        LoopbackConnectionTest::SetUp();
+    }
+
+    //发送一个请求，接收全部的回复，返回PING在数据中的位置
+    size_t pingOffset()
+    {
+        int client_fd = connectClient();
+
+        const size_t total = 16*256*1024+4;
+        EXPECT_EQ(::send(client_fd, "r", 1, 0), 1);
+        std::string recv_data;
+        char buf[64*1024];
+        while(recv_data.size()<total)
+        {
+            ssize_t n = ::recv(client_fd, buf, std::min(sizeof(buf),total-recv_data.size()), 0);
+            if(n<=0) break;
+            recv_data.append(buf, n);
+        }
+        EXPECT_EQ(recv_data.size(), total);
+
+        //去掉PING之后普通消息的顺序和内容不变
+        size_t offset = recv_data.find("PING");
+        EXPECT_NE(offset, std::string::npos);
+        if(offset!=std::string::npos) recv_data.erase(offset,4);
+        std::string expected;
+        for(int i=0;i<16;++i) expected.append(256*1024,char('a'+i));
+        EXPECT_TRUE(recv_data==expected);
+
+        closeClient(client_fd);
+        return offset;
+    }
+};
+
+//同一次循环中追加的数据在循环末尾才开始发送，高优先级的消息排在所有的普通消息之前
+TEST_F(PrioritySendTest, HighPriorityOvertakesQueuedBulk)
+{
+    EXPECT_EQ(pingOffset(), 0u);
+}
+
+//低延迟模式下第一条消息已经开始发送，高优先级的消息不能打断它，紧跟在它之后
+TEST_F(PrioritySendTest, HighPriorityKeepsMessageBoundary)
+{
+    low_latency_ = true;
+    EXPECT_EQ(pingOffset(), 256*1024u);
+}